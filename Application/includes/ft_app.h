@@ -7,6 +7,7 @@
 #include "ft_descriptor.h"
 #include "ft_device.h"
 #include "ft_event.h"
+#include "ft_frameGraph.h"
 #include "ft_gui.h"
 #include "ft_headers.h"
 #include "ft_instance.h"
@@ -18,9 +19,9 @@
 #include "ft_rendering_systems.h"
 #include "ft_rigidComponent.h"
 #include "ft_scene.h"
+#include "ft_scheduler.h"
 #include "ft_surface.h"
 #include "ft_texture.h"
-#include "ft_threads.h"
 #include "ft_window.h"
 
 namespace ft {
@@ -29,6 +30,17 @@ public:
   static constexpr uint32_t W_WIDTH = 800;
   static constexpr uint32_t W_HEIGHT = 600;
 
+  // the resources the nodes of the frame graph read and write
+  enum FrameResource : uint64_t {
+    FRAME_INPUT = 1 << 0,
+    FRAME_GUI = 1 << 1,
+    FRAME_PHYSICS_POSES = 1 << 2,
+    FRAME_MODEL_TRANSFORMS = 1 << 3,
+    FRAME_UNIFORM_BUFFERS = 1 << 4,
+    FRAME_SWAPCHAIN_IMAGE = 1 << 5,
+    FRAME_COMMAND_BUFFERS = 1 << 6,
+  };
+
   Application();
   ~Application();
 
@@ -41,10 +53,14 @@ private:
   void initEventListener();
   void initApplication();
   void createScene();
-  static void printFPS();
+  void buildFrameGraph();
+  static bool printFPS(double updateTime);
+  void updatePerformanceStats();
   void updateScene(int key);
+  void acquireFrame();
   void drawFrame();
   void checkEventQueue();
+  void loadPhysicsSettings();
   void handleEven(Event::uniq_ptr e);
   void test();
 
@@ -70,7 +86,7 @@ private:
   LineRdrSys::pointer _ftLineRdrSys;
   NormDebugRdrSys::pointer _ftNormDebugRdrSys;
   MousePicker::pointer _ftMousePicker;
-  ThreadPool::pointer _ftThreadPool;
+  Scheduler::pointer _ftScheduler;
   ft::JsonParser::pointer _ftJsonParser;
 
   DescriptorPool::pointer _ftDescriptorPool;
@@ -83,6 +99,19 @@ private:
 
   ft::SimpleRigidApplication::pointer _ftPhysicsApplication;
   bool _play = false;
+
+  FrameGraph::pointer _ftFrameGraph;
+  float _frameDuration = 0.0f;
+  uint32_t _frameImage = 0;
+  CommandBuffer::pointer _frameCommandBuffer;
+
+  // the events dispatched by the last frame, a task each
+  std::vector<Event::uniq_ptr> _dispatchedEvents;
+  std::vector<Task> _eventTasks;
+
+  // what the scheduler had been busy for, and when, at the last frame
+  std::chrono::steady_clock::time_point _performanceTime;
+  uint64_t _busyTime = 0;
 };
 
 } // namespace ft
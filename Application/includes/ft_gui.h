@@ -6,6 +6,7 @@
 #include "ft_device.h"
 #include "ft_headers.h"
 #include "ft_instance.h"
+#include "ft_physicsApp.h"
 #include "ft_renderPass.h"
 #include "ft_scene.h"
 #include "ft_window.h"
@@ -13,9 +14,21 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_vulkan.h"
 #include <cstdint>
+#include <vector>
 
 namespace ft {
 
+// What the performance panel shows of a frame. The times are in
+// milliseconds, the pool usage is the share of the time the threads of
+// the scheduler spent running tasks, for the frame and the physics.
+struct PerformanceStats {
+  float frameTime = 0.0f;
+  double sceneUpdateTime = 0.0;
+  double criticalPathTime = 0.0;
+  RigidBodyApplication::StepStats physics;
+  float poolUsage = 0.0f;
+};
+
 class Gui {
 
 public:
@@ -39,8 +52,14 @@ public:
 
   float getFramerate() const;
 
+  // adds a frame to the performance panel, unless it is paused
+  void pushPerformanceStats(const PerformanceStats &stats);
+
 protected:
+  static constexpr uint32_t FRAME_HISTORY = 240;
+
   void showMetrics(bool *p_open);
+  void showPerformance(bool *p_open);
   void showMainMenue(const ft::Scene::pointer &scene);
   void showTitleBar();
   void showExampleMenuFile();
@@ -60,6 +79,18 @@ protected:
   // flags
   bool show_app_metrics = false;
   bool show_app_about = false;
+  bool show_app_performance = false;
+
+  // the last frames' times, as a ring, and the stats of the last frame
+  // pushed. Pausing freezes them, by hand or on the first frame slower
+  // than the spike time, so that a spike can be looked into.
+  std::vector<float> _frameTimes;
+  std::vector<float> _sortedFrameTimes;
+  uint32_t _frameTimeHead = 0;
+  PerformanceStats _performance;
+  bool _performancePaused = false;
+  bool _pauseOnSpike = false;
+  float _spikeTime = 33.0f;
 };
 
 } // namespace ft
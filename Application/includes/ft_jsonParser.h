@@ -4,8 +4,8 @@
 #include "ft_device.h"
 #include "ft_parser.h"
 #include "ft_scene.h"
+#include "ft_scheduler.h"
 #include "ft_texture.h"
-#include "ft_threads.h"
 #include <memory>
 #include <nlohmann/json.hpp>
 
@@ -16,7 +16,7 @@ public:
   using pointer = std::shared_ptr<JsonParser>;
 
   JsonParser(const Device::pointer &, const TexturePool::pointer &,
-             const ThreadPool::pointer &, const OneTextureRdrSys::pointer &,
+             const Scheduler::pointer &, const OneTextureRdrSys::pointer &,
              const TwoTextureRdrSys::pointer &, const SkyBoxRdrSys::pointer &);
 
   ~JsonParser() = default;
@@ -27,18 +27,29 @@ public:
   void saveSceneToFile(const ft::Scene::pointer &scene,
                        const std::string &filePath) override;
 
+  // the fixed step of the physics and the most steps taken per frame,
+  // from the "physics" object of the scene file
+  struct PhysicsSettings {
+    float timeStep = 1.0f / 60.0f;
+    uint32_t maxSubsteps = 5;
+  };
+
+  const PhysicsSettings &getPhysicsSettings() const { return _physics; }
+
 private:
   void loadCamera(const Scene::pointer &scene, nlohmann::json &data,
                   float aspect);
   void loadSkyBox(const Scene::pointer &scene, nlohmann::json &data);
   void loadModels(const Scene::pointer &scene, nlohmann::json &data);
   void loadLights(const Scene::pointer &scene, nlohmann::json &data);
+  void loadPhysics(nlohmann::json &data);
 
   OneTextureRdrSys::pointer _ftTexturedRdrSys;
   TwoTextureRdrSys::pointer _ft2TexturedRdrSys;
   SkyBoxRdrSys::pointer _ftSkyBoxRdrSys;
   std::string _loadedFile;
   nlohmann::json _ignored;
+  PhysicsSettings _physics;
 };
 
 } // namespace ft
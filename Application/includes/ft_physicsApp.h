@@ -1,10 +1,23 @@
 #ifndef FT_PHYSICS_APPLICATION
 #define FT_PHYSICS_APPLICATION
 
+#include "ft_broadphase.h"
 #include "ft_collideFine.h"
+#include "ft_contactArena.h"
 #include "ft_contacts.h"
-#include "ft_headers.h"
+#include "ft_def.h"
+#include "ft_impulseSolver.h"
+#include "ft_island.h"
+#include "ft_islandSolver.h"
+#include "ft_manifold.h"
 #include "ft_rigidObject.h"
+#include "ft_snapshot.h"
+#include "ft_tripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 namespace ft {
 
@@ -25,19 +38,167 @@ public:
   using pointer = std::shared_ptr<RigidBodyApplication>;
   using raw_ptr = RigidBodyApplication *;
 
-  RigidBodyApplication(uint32_t maxContacts = 256);
-  ~RigidBodyApplication(){/*delete _contacts;*/};
+  /**
+   * What the last step of an advance did, and how long its phases
+   * took, in milliseconds.
+   */
+  struct StepStats {
+    double integrateTime = 0;
+    double contactTime = 0;
+    double islandTime = 0;
+    double solveTime = 0;
+    double stepTime = 0;
+    uint32_t steps = 0;
+    uint32_t contacts = 0;
+    uint32_t contactCapacity = 0;
+    uint32_t contactHighWaterMark = 0;
+    uint32_t islands = 0;
+    uint32_t velocityIterations = 0;
+    uint32_t positionIterations = 0;
+    uint32_t awakeBodies = 0;
+    uint32_t sleepingBodies = 0;
+    /**
+     * The hash of the state of the bodies after the step, in
+     * deterministic mode, zero otherwise. See setDeterministic.
+     */
+    uint64_t stateHash = 0;
+  };
+
+  /**
+   * Makes room for contactCapacity contacts to start with; the
+   * frames that find more get more room.
+   */
+  RigidBodyApplication(uint32_t contactCapacity = 256,
+                       Broadphase::pointer broadphase = nullptr);
+  RigidBodyApplication(uint32_t contactCapacity, BroadphaseType type);
+  ~RigidBodyApplication(){};
 
   void play();
   void pause();
 
+  /**
+   * Advances the simulation by the time of a frame, in fixed steps
+   * of getTimeStep(). The time short of a step is kept for the next
+   * frame. No more than getMaxSubsteps() steps are taken: the time
+   * left over after those is dropped, so that a slow frame doesn't
+   * make the next one slower still. Returns the number of steps.
+   *
+   * The queued commands are run before each step, and the poses are
+   * published once the steps are done. While the simulation is
+   * paused, the commands are still run, and the poses published if
+   * there were any.
+   */
+  uint32_t advance(real_t frameTime);
+
+  /**
+   * Runs the simulation on a thread of its own, advancing it at its
+   * own rate until stop is called. From then on, the simulation may
+   * only be changed through enqueue, and read through the published
+   * poses.
+   */
+  void start();
+  void stop();
+  bool isRunning() const { return _running.load(std::memory_order_acquire); }
+
+  /**
+   * Queues a change to the simulation, run by the simulation between
+   * two steps. It may be called from any thread.
+   */
+  void enqueue(std::function<void()> command);
+
+  /**
+   * Sets the step and the largest number of steps per call to
+   * advance. They are read by the simulation, so are set through
+   * enqueue once it runs on its thread.
+   */
+  void setTimeStep(real_t timeStep);
+  real_t getTimeStep() const { return _timeStep; }
+  void setMaxSubsteps(uint32_t maxSubsteps);
+  uint32_t getMaxSubsteps() const { return _maxSubsteps; }
+
+  /**
+   * Solves the islands on the given scheduler, with workerCount
+   * workers counting the calling thread.
+   */
+  void setScheduler(const Scheduler::pointer &scheduler, uint32_t workerCount);
+
+  /**
+   * Sets the solver used to resolve the contacts, the iterative
+   * resolver by default. The new solver is used from the next step.
+   */
+  void setSolverType(ContactSolverType type) { _solverType = type; }
+  ContactSolverType getSolverType() const { return _solverType; }
+
+  /**
+   * Sets whether the simulation runs in deterministic mode, as
+   * World::setDeterministic: the same objects, added in the same
+   * order and given the same commands, then end up in the same state
+   * to the bit on every run, with any number of threads. The bodies
+   * are integrated one at a time with the scalar code, and the state
+   * of the bodies is hashed after every step into the stats. Only the
+   * last step of an advance is in the stats: an application running
+   * in lockstep advances one step at a time.
+   */
+  void setDeterministic(bool deterministic) { _deterministic = deterministic; }
+  bool getDeterministic() const { return _deterministic; }
+
+  /**
+   * Takes the stats of the last advance that stepped. They are handed
+   * over like the poses, so only one thread may take them.
+   */
+  const StepStats &getStats();
+
 protected:
-  const uint32_t _maxContacts;
-  // ft::Contact::raw_ptr _contacts;
-  std::vector<ft::Contact> _contacts;
+  Broadphase::pointer _broadphase;
+  std::vector<BroadphasePair> _pairs;
+  /**
+   * The contacts found in a step, and the block of the arena holding
+   * the ones solved: the points of the manifolds.
+   */
+  ft::ContactArena _contactArena;
+  ft::Contact *_contacts = nullptr;
+  uint32_t _contactCount = 0;
   ft::CollisionData _collisionData;
   ft::ContactResolver _resolver;
-  bool _pauseSimulation = false;
+  ft::SequentialImpulseSolver _impulseSolver;
+  ft::ContactManifoldCache _manifolds;
+  ft::IslandBuilder _islands;
+  ft::IslandSolver _islandSolver;
+  std::atomic<ContactSolverType> _solverType{ContactSolverType::ITERATIVE};
+  std::atomic<bool> _deterministic{false};
+  std::atomic<bool> _pauseSimulation{false};
+  real_t _timeStep = 1.0f / 60.0f;
+  uint32_t _maxSubsteps = 5;
+  real_t _accumulator = 0.0f;
+
+  /**
+   * The stats of the step in progress, filled by update, and the ones
+   * published.
+   */
+  StepStats _stepStats;
+  TripleBuffer<StepStats> _stats;
+
+  /**
+   * Runs the commands queued so far. Returns false if there were
+   * none.
+   */
+  bool runCommands();
+
+  /**
+   * The loop of the simulation thread.
+   */
+  void simulate();
+
+  /**
+   * Publishes the poses of the objects for the drawing thread.
+   */
+  virtual void publish() = 0;
+
+  std::thread _thread;
+  std::atomic<bool> _running{false};
+  std::mutex _commandMutex;
+  std::vector<std::function<void()>> _commands;
+  std::vector<std::function<void()>> _runningCommands;
 };
 
 class SimpleRigidApplication : public RigidBodyApplication {
@@ -46,25 +207,155 @@ public:
   using pointer = std::shared_ptr<SimpleRigidApplication>;
   using raw_ptr = SimpleRigidApplication *;
 
-  SimpleRigidApplication(uint32_t maxContacts = 256);
+  /**
+   * The poses of the objects after the last two steps, by slot. A
+   * pose belongs to the object in its slot only if their generations
+   * match: the slot may have been given to another object since.
+   */
+  struct PoseSnapshot {
+    struct Pose {
+      uint32_t generation;
+      glm::vec3 previousPosition;
+      glm::quat previousOrientation;
+      glm::vec3 position;
+      glm::quat orientation;
+    };
+
+    std::vector<Pose> poses;
+    real_t timeStep = 0;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  SimpleRigidApplication(uint32_t contactCapacity = 256,
+                         Broadphase::pointer broadphase = nullptr);
+  SimpleRigidApplication(uint32_t contactCapacity, BroadphaseType type);
+  ~SimpleRigidApplication() override;
   void update(real_t duration) override;
 
   inline std::vector<ft::RigidBox::pointer> &getBoxes();
   inline std::vector<ft::RigidBall::pointer> &getBalls();
+
+  /**
+   * Adds or removes an object. The object is given its slot at once,
+   * and handed to the simulation through enqueue, which makes its body
+   * when adding it and destroys it when removing it: the bodies live
+   * in the default store, which only the simulation may change once
+   * it runs on its thread.
+   */
   void addRigidBox(const RigidBox::pointer &box);
   void addRigidBall(const RigidBall::pointer &ball);
   void removeRigidBox(RigidBox::pointer box);
   void removeRigidBall(RigidBall::pointer ball);
+
+  /**
+   * Adds or removes a plane, through enqueue as well: the simulation
+   * reads the planes every step. Removing a plane that isn't there
+   * does nothing.
+   */
   void addCollisionPlane(const CollisionPlane::pointer &plane);
   void removeCollisionPlane(CollisionPlane::pointer plane);
 
+  /**
+   * Takes the last poses published and sets the drawn pose of each
+   * object, between the last two steps at the time of the call. It
+   * never waits: if an object is being added or removed at the same
+   * time, the poses are left as they are until the next call.
+   */
+  void syncDrawnPoses();
+
+  /**
+   * Saves the state of the simulation into the given snapshot, or
+   * takes the simulation back to it, as World::saveState and
+   * World::restoreState. They fail if the default store holds bodies
+   * other than those of the objects, or, for restoreState, if objects
+   * were added or removed since the snapshot was saved.
+   *
+   * They touch the state of the simulation, so are called while it
+   * doesn't run on its thread, or from a command given to enqueue.
+   */
+  bool saveState(SimulationSnapshot &snapshot) const;
+  bool restoreState(const SimulationSnapshot &snapshot);
+
 protected:
+  /**
+   * Maps a broad phase proxy back to the object that owns it.
+   * Exactly one of the two pointers is set for a live proxy.
+   */
+  struct ProxyEntry {
+    RigidBox::raw_ptr box;
+    RigidBall::raw_ptr ball;
+  };
+
+  /**
+   * The object drawn from a slot of the snapshots, if any.
+   */
+  struct DrawnEntry {
+    RigidBox::pointer box;
+    RigidBall::pointer ball;
+  };
+
   void generateContacts();
   void updateObjects(real_t duration);
+  void publish() override;
+  void registerProxy(uint32_t proxy, const ProxyEntry &entry);
+
+  /**
+   * Gives a slot to the object, or takes it back.
+   */
+  uint32_t acquireSlot(const DrawnEntry &entry);
+  void releaseSlot(uint32_t slot);
+
+  /**
+   * The parts of adding and removing run by the simulation.
+   */
+  void insertRigidBox(const RigidBox::pointer &box);
+  void insertRigidBall(const RigidBall::pointer &ball);
+  void eraseRigidBox(const RigidBox::pointer &box);
+  void eraseRigidBall(const RigidBall::pointer &ball);
+
+  /**
+   * Hashes the state of the bodies, in the order of their handles.
+   */
+  uint64_t hashState();
+
+  void writePose(PoseSnapshot::Pose &pose, uint32_t generation,
+                 const glm::vec3 &previousPosition,
+                 const glm::quat &previousOrientation, const RigidBody &body);
 
   std::vector<ft::RigidBox::pointer> _boxes;
   std::vector<ft::RigidBall::pointer> _balls;
   std::vector<ft::CollisionPlane::pointer> _planes;
+  std::vector<ProxyEntry> _proxies;
+
+  /**
+   * The bodies of the objects in the order of their handles, sorted
+   * again when an object is added or removed.
+   */
+  std::vector<RigidBody *> _sortedBodies;
+  bool _bodiesSorted = true;
+
+  /**
+   * The handles of the sleeping bodies restoreState has moved, and a
+   * flag for each handle of the default store telling whether it is
+   * one of them.
+   */
+  std::vector<uint32_t> _movedBodies;
+  std::vector<uint8_t> _movedFlags;
+
+  /**
+   * The snapshots, written by the simulation and read by the drawing
+   * thread.
+   */
+  TripleBuffer<PoseSnapshot> _snapshots;
+
+  /**
+   * The objects in each slot, and the free slots. They belong to the
+   * drawing side, not to the simulation.
+   */
+  std::mutex _slotMutex;
+  std::vector<DrawnEntry> _drawn;
+  std::vector<uint32_t> _freeSlots;
+  uint32_t _nextGeneration = 1;
 };
 
 } // namespace ft
@@ -4,6 +4,7 @@
 #include "ft_component.h"
 #include "ft_headers.h"
 #include "ft_model.h"
+#include "ft_physicsApp.h"
 #include "ft_rigidObject.h"
 
 namespace ft {
@@ -19,7 +20,9 @@ public:
 
   void update(float duration) override;
 
-  void backwardUpdate(float duration);
+  // Queues the pose of the model on the simulation, for the body to
+  // follow it.
+  void backwardUpdate(RigidBodyApplication &physics);
   void setPause(bool pause);
   bool getPause() const;
 
@@ -40,7 +43,9 @@ public:
   RigidBallComponent(const Model::pointer &, const RigidBall::pointer &);
   ~RigidBallComponent() override = default;
 
-  void backwardUpdate(float duration);
+  // Queues the pose of the model on the simulation, for the body to
+  // follow it.
+  void backwardUpdate(RigidBodyApplication &physics);
   void update(float duration) override;
   void setPause(bool pause);
   bool getPause() const;
@@ -2,8 +2,9 @@
 #define FT_SIMPLE_RIGID_OBJECT
 
 #include "ft_body.h"
+#include "ft_broadphase.h"
 #include "ft_collideFine.h"
-#include "ft_headers.h"
+#include "ft_def.h"
 
 namespace ft {
 
@@ -12,24 +13,79 @@ public:
   using pointer = std::shared_ptr<RigidBall>;
   using raw_ptr = RigidBall *;
 
-  RigidBall() { body = new ft::RigidBody; }
+  // The body is made by the simulation, see createBody.
+  RigidBall() { body = nullptr; }
 
   ~RigidBall() { delete body; }
 
+  /**
+   * Sets the state the body starts from. It is kept until the body
+   * is made, and applied to the body at once if it exists.
+   */
   void setState(const glm::vec3 &position, const glm::quat &orientation,
                 const float radius, const glm::vec3 &velocity);
 
+  /**
+   * Makes the body, in the default store, with the state last set,
+   * or destroys it. The store is shared with the simulation, so they
+   * are only called by it, between two steps.
+   */
+  void createBody();
+  void destroyBody();
+
+  inline const glm::vec3 &getStartPosition() const { return _startPosition; }
+  inline const glm::quat &getStartOrientation() const {
+    return _startOrientation;
+  }
+
   inline void setIsUpdated(bool updated) { _isUpdated = updated; }
   inline bool isUpdated() const { return _isUpdated; }
-  inline void setIsAsleep(bool asleep) { _isAsleep = asleep; }
-  inline bool isAsleep() const { return _isAsleep; }
+  // The sleep state is the one of the body.
+  inline void setIsAsleep(bool asleep) { body->setAwake(!asleep); }
+  inline bool isAsleep() const { return !body->getAwake(); }
+  inline void setProxy(uint32_t proxy) { _proxy = proxy; }
+  inline uint32_t getProxy() const { return _proxy; }
+
+  // The pose before the last step, kept by the simulation.
+  void savePreviousState();
+  inline const glm::vec3 &getPreviousPosition() const {
+    return _previousPosition;
+  }
+  inline const glm::quat &getPreviousOrientation() const {
+    return _previousOrientation;
+  }
+
+  // The place of the object in the snapshots of the simulation, and
+  // the pose it is drawn with, taken from them by the drawing thread.
+  inline void setSlot(uint32_t slot, uint32_t generation) {
+    _slot = slot;
+    _generation = generation;
+  }
+  inline uint32_t getSlot() const { return _slot; }
+  inline uint32_t getGeneration() const { return _generation; }
+  void setDrawnPose(const glm::vec3 &position, const glm::quat &orientation);
+  inline const glm::vec3 &getDrawnPosition() const { return _drawnPosition; }
+  inline const glm::quat &getDrawnOrientation() const {
+    return _drawnOrientation;
+  }
 
 protected:
   glm::mat3 getMatrixFromInertiaTensor(float ix, float iy, float iz,
                                        float ixy = 0, float ixz = 0,
                                        float iyz = 0);
+  void applyState();
+
+  glm::vec3 _startPosition = glm::vec3(0.0f);
+  glm::quat _startOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 _startVelocity = glm::vec3(0.0f);
   bool _isUpdated = true;
-  bool _isAsleep = false;
+  uint32_t _proxy = Broadphase::NULL_PROXY;
+  glm::vec3 _previousPosition = glm::vec3(0.0f);
+  glm::quat _previousOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  uint32_t _slot = 0;
+  uint32_t _generation = 0;
+  glm::vec3 _drawnPosition = glm::vec3(0.0f);
+  glm::quat _drawnOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 };
 
 class RigidBox : public ft::CollisionBox {
@@ -37,27 +93,81 @@ public:
   using pointer = std::shared_ptr<RigidBox>;
   using raw_ptr = RigidBox *;
 
-  RigidBox() { body = new RigidBody; }
+  // The body is made by the simulation, see createBody.
+  RigidBox() { body = nullptr; }
   ~RigidBox() { delete body; }
 
+  /**
+   * Sets the state the body starts from. It is kept until the body
+   * is made, and applied to the body at once if it exists.
+   */
   void setState(const glm::vec3 &position, const glm::quat &orientation,
                 const glm::vec3 &extents, const glm::vec3 &velocity);
 
+  /**
+   * Makes the body, in the default store, with the state last set,
+   * or destroys it. The store is shared with the simulation, so they
+   * are only called by it, between two steps.
+   */
+  void createBody();
+  void destroyBody();
+
+  inline const glm::vec3 &getStartPosition() const { return _startPosition; }
+  inline const glm::quat &getStartOrientation() const {
+    return _startOrientation;
+  }
+
   inline void setOverlap(bool overlap) { _isOverlapping = overlap; }
   inline bool isOverlapping() const { return _isOverlapping; }
   inline void setIsUpdated(bool updated) { _isUpdated = updated; }
   inline bool isUpdated() const { return _isUpdated; }
-  inline void setIsAsleep(bool asleep) { _isAsleep = asleep; }
-  inline bool isAsleep() const { return _isAsleep; }
+  // The sleep state is the one of the body.
+  inline void setIsAsleep(bool asleep) { body->setAwake(!asleep); }
+  inline bool isAsleep() const { return !body->getAwake(); }
+  inline void setProxy(uint32_t proxy) { _proxy = proxy; }
+  inline uint32_t getProxy() const { return _proxy; }
+
+  // The pose before the last step, kept by the simulation.
+  void savePreviousState();
+  inline const glm::vec3 &getPreviousPosition() const {
+    return _previousPosition;
+  }
+  inline const glm::quat &getPreviousOrientation() const {
+    return _previousOrientation;
+  }
+
+  // The place of the object in the snapshots of the simulation, and
+  // the pose it is drawn with, taken from them by the drawing thread.
+  inline void setSlot(uint32_t slot, uint32_t generation) {
+    _slot = slot;
+    _generation = generation;
+  }
+  inline uint32_t getSlot() const { return _slot; }
+  inline uint32_t getGeneration() const { return _generation; }
+  void setDrawnPose(const glm::vec3 &position, const glm::quat &orientation);
+  inline const glm::vec3 &getDrawnPosition() const { return _drawnPosition; }
+  inline const glm::quat &getDrawnOrientation() const {
+    return _drawnOrientation;
+  }
 
 protected:
   glm::mat3 getMatrixFromInertiaTensor(float ix, float iy, float iz,
                                        float ixy = 0, float ixz = 0,
                                        float iyz = 0);
+  void applyState();
 
+  glm::vec3 _startPosition = glm::vec3(0.0f);
+  glm::quat _startOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  glm::vec3 _startVelocity = glm::vec3(0.0f);
   bool _isOverlapping = false;
   bool _isUpdated = true;
-  bool _isAsleep = false;
+  uint32_t _proxy = Broadphase::NULL_PROXY;
+  glm::vec3 _previousPosition = glm::vec3(0.0f);
+  glm::quat _previousOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  uint32_t _slot = 0;
+  uint32_t _generation = 0;
+  glm::vec3 _drawnPosition = glm::vec3(0.0f);
+  glm::quat _drawnOrientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 };
 
 }; // namespace ft
@@ -0,0 +1,98 @@
+#ifndef FT_SIM_SCENE_H
+#define FT_SIM_SCENE_H
+
+#include "ft_collideFine.h"
+#include "ft_def.h"
+#include "ft_physicsApp.h"
+#include "ft_rigidObject.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ft {
+
+/**
+ * The rigid bodies of a scene and the planes around them, without
+ * anything to draw them with: what the simulation needs to run on its
+ * own. The simulation has a ground plane of its own, at y = 0; the
+ * planes are the ones added to it, walls for instance.
+ */
+class SimScene {
+public:
+  struct Body {
+    enum class Shape { BOX, BALL };
+
+    Shape shape = Shape::BOX;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat orientation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    /**
+     * The half sizes of a box; a ball has its radius in x.
+     */
+    glm::vec3 extents = glm::vec3(0.5f);
+    glm::vec3 velocity = glm::vec3(0.0f);
+  };
+
+  std::vector<Body> bodies;
+  std::vector<CollisionPlane> planes;
+  /**
+   * The step and the substeps of the physics section, if the scene
+   * has one.
+   */
+  real_t timeStep = 1.0f / 60.0f;
+  uint32_t maxSubsteps = 5;
+
+  /**
+   * Reads the objects and the planes of the rigidBodies section of a
+   * scene file, and the physics section. Throws if the file can't be
+   * read or has no rigid bodies.
+   *
+   *   "rigidBodies": {
+   *     "planes": [{"direction": [1, 0, 0], "offset": -10}],
+   *     "objects": [
+   *       {"type": "box", "position": [0, 4, 0],
+   *        "rotation": [45, 0, 1, 0], "extents": [0.5, 0.5, 0.5],
+   *        "velocity": [0, 0, 0]},
+   *       {"type": "ball", "position": [0, 6, 0], "radius": 0.5}
+   *     ]
+   *   }
+   *
+   * The rotation is an angle in degrees and an axis, like the one of
+   * the models; only the type and the position are required.
+   */
+  static SimScene load(const std::string &path);
+
+  /**
+   * A pile of count boxes and balls, dropped in columns onto the
+   * ground. The same seed gives the same pile.
+   */
+  static SimScene generate(uint32_t count, unsigned seed = 1234);
+
+  /**
+   * The generated scenes, by name, made of count bodies:
+   *  - pile: the pile above,
+   *  - pyramid: a square pyramid of boxes resting on the ground,
+   *  - pit: balls dropped into a pit walled by four planes,
+   *  - piles: piles of five boxes, too far apart to touch each other,
+   *    a thousand of them for 5000 bodies,
+   *  - dominoes: rows of upright thin boxes, the first of each row
+   *    tipped over onto the next,
+   *  - rain: boxes falling from above onto the ground, a few at a
+   *    time.
+   * Throws if the layout is none of those.
+   */
+  static SimScene generate(const std::string &layout, uint32_t count,
+                           unsigned seed = 1234);
+  static const std::vector<std::string> &getLayouts();
+
+  /**
+   * Adds the bodies and the planes to the simulation, and sets its
+   * step. The objects made are appended to boxes and balls.
+   */
+  void build(SimpleRigidApplication &app,
+             std::vector<RigidBox::pointer> &boxes,
+             std::vector<RigidBall::pointer> &balls) const;
+};
+
+} // namespace ft
+
+#endif // FT_SIM_SCENE_H
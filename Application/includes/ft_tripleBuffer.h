@@ -0,0 +1,49 @@
+#ifndef FT_TRIPLE_BUFFER_H
+#define FT_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace ft {
+
+// Hands values from one writing thread to one reading thread without
+// locks. The writer fills its buffer and publishes it, the reader takes
+// the last one published; neither ever waits for the other. The third
+// buffer sits between them and is swapped with theirs.
+template <typename T> class TripleBuffer {
+public:
+  // The buffer the writer fills. Only the writer may touch it.
+  T &getWriteBuffer() { return _buffers[_write]; }
+
+  // Hands the write buffer to the reader, and gives the writer the
+  // one the reader isn't using.
+  void publish() {
+    _write =
+        _middle.exchange(_write | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Takes the last buffer published, if there is a new one. Returns
+  // false if there isn't.
+  bool update() {
+    if (!(_middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    _read = _middle.exchange(_read, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  // The buffer the reader took. Only the reader may touch it.
+  const T &getReadBuffer() const { return _buffers[_read]; }
+
+private:
+  static constexpr uint8_t INDEX = 3;
+  static constexpr uint8_t FRESH = 4;
+
+  T _buffers[3];
+  uint8_t _write = 0;
+  uint8_t _read = 1;
+  std::atomic<uint8_t> _middle{2};
+};
+
+} // namespace ft
+
+#endif // FT_TRIPLE_BUFFER_H
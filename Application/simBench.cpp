@@ -0,0 +1,338 @@
+// Runs the generated scenes at several sizes and measures their steps,
+// to tell whether a change to the engine made it slower.
+//
+// Each scene is stepped a fixed number of frames, one step per frame,
+// and gets the mean and the 99th percentile of the time of its steps,
+// the lowest of a few runs if it is repeated, the contacts per step
+// and the iterations of the resolvers per step. The results are
+// written as JSON, the format of the baseline, or CSV.
+//
+// Given a baseline, the results are compared to the ones of the same
+// scene and size in it, and the run fails if the mean step time grew
+// by more than the threshold, or the 99th percentile, noisier, by
+// more than twice the threshold. The contacts and the iterations are
+// compared as well, to tell a slower engine from one doing more work:
+// the contacts are solved in the order of the handles of their
+// bodies, so every run of a scene plays out the same way.
+#include "includes/ft_simScene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::vector<std::string> layouts = {"pyramid", "pit", "piles", "dominoes",
+                                      "rain"};
+  std::vector<uint32_t> sizes = {100, 1000, 10000, 50000};
+  uint32_t frames = 300;
+  uint32_t repeats = 1;
+  uint32_t threads = 0;
+  ft::ContactSolverType solver = ft::ContactSolverType::ITERATIVE;
+  std::string json;
+  std::string csv;
+  std::string baseline;
+  double threshold = 0.25;
+};
+
+struct Result {
+  std::string layout;
+  uint32_t bodies = 0;
+  uint32_t frames = 0;
+  double meanStepTime = 0;
+  double p99StepTime = 0;
+  double contacts = 0;
+  double velocityIterations = 0;
+  double positionIterations = 0;
+};
+
+/**
+ * A step time within this many milliseconds of its baseline is never
+ * a regression: the small scenes are too fast to be timed closer.
+ */
+constexpr double TIME_SLACK = 0.02;
+
+void usage(const char *name) {
+  std::cout
+      << "usage: " << name << " [options]\n"
+      << "  --scenes <names>     pyramid,pit,piles,dominoes,rain by default\n"
+      << "  --sizes <counts>     100,1000,10000,50000 by default\n"
+      << "  --frames <count>     the steps of each run (300)\n"
+      << "  --repeat <count>     runs each scene count times, and keeps the\n"
+      << "                       fastest step times (1)\n"
+      << "  --threads <count>    the threads solving the islands (0)\n"
+      << "  --solver <name>      iterative or impulse (iterative)\n"
+      << "  --json <file>        writes the results as JSON\n"
+      << "  --csv <file>         writes the results as CSV\n"
+      << "  --baseline <file>    compares the results to a JSON baseline\n"
+      << "  --threshold <ratio>  the growth of the mean step time that fails\n"
+      << "                       the run, twice that for the p99 (0.25)\n";
+}
+
+std::vector<std::string> splitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h")
+      return false;
+    if (i + 1 >= argc) {
+      std::cerr << "missing value for " << arg << std::endl;
+      return false;
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--scenes") {
+      options.layouts = splitList(value);
+    } else if (arg == "--sizes") {
+      options.sizes.clear();
+      for (auto &size : splitList(value))
+        options.sizes.push_back((uint32_t)std::stoul(size));
+    } else if (arg == "--frames") {
+      options.frames = std::max(1u, (uint32_t)std::stoul(value));
+    } else if (arg == "--repeat") {
+      options.repeats = std::max(1u, (uint32_t)std::stoul(value));
+    } else if (arg == "--threads") {
+      options.threads = (uint32_t)std::stoul(value);
+    } else if (arg == "--solver") {
+      if (value == "iterative")
+        options.solver = ft::ContactSolverType::ITERATIVE;
+      else if (value == "impulse")
+        options.solver = ft::ContactSolverType::SEQUENTIAL_IMPULSE;
+      else {
+        std::cerr << "unknown solver " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--json") {
+      options.json = value;
+    } else if (arg == "--csv") {
+      options.csv = value;
+    } else if (arg == "--baseline") {
+      options.baseline = value;
+    } else if (arg == "--threshold") {
+      options.threshold = std::stod(value);
+    } else {
+      std::cerr << "unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+Result run(const std::string &layout, uint32_t count,
+           const Options &options) {
+  ft::SimScene scene = ft::SimScene::generate(layout, count);
+
+  ft::SimpleRigidApplication app(256);
+  app.setSolverType(options.solver);
+  ft::Scheduler::pointer scheduler;
+  if (options.threads > 0) {
+    scheduler = std::make_shared<ft::Scheduler>(options.threads);
+    app.setScheduler(scheduler, scheduler->getWorkerCount());
+  }
+
+  std::vector<ft::RigidBox::pointer> boxes;
+  std::vector<ft::RigidBall::pointer> balls;
+  scene.build(app, boxes, balls);
+
+  Result result;
+  result.layout = layout;
+  result.bodies = count;
+  result.frames = options.frames;
+
+  std::vector<double> stepTimes;
+  stepTimes.reserve(options.frames);
+  for (uint32_t frame = 0; frame < options.frames; ++frame) {
+    app.advance(scene.timeStep);
+    const ft::RigidBodyApplication::StepStats &stats = app.getStats();
+    stepTimes.push_back(stats.stepTime);
+    result.meanStepTime += stats.stepTime;
+    result.contacts += stats.contacts;
+    result.velocityIterations += stats.velocityIterations;
+    result.positionIterations += stats.positionIterations;
+  }
+
+  double frames = (double)options.frames;
+  result.meanStepTime /= frames;
+  result.contacts /= frames;
+  result.velocityIterations /= frames;
+  result.positionIterations /= frames;
+
+  size_t rank = (size_t)std::ceil(0.99 * frames) - 1;
+  std::nth_element(stepTimes.begin(), stepTimes.begin() + rank,
+                   stepTimes.end());
+  result.p99StepTime = stepTimes[rank];
+  return result;
+}
+
+nlohmann::json toJson(const std::vector<Result> &results,
+                      const Options &options) {
+  nlohmann::json data;
+  data["frames"] = options.frames;
+  data["threads"] = options.threads;
+  data["solver"] = options.solver == ft::ContactSolverType::ITERATIVE
+                       ? "iterative"
+                       : "impulse";
+  data["results"] = nlohmann::json::array();
+  for (auto &r : results) {
+    nlohmann::json result;
+    result["scene"] = r.layout;
+    result["bodies"] = r.bodies;
+    result["frames"] = r.frames;
+    result["meanStepMs"] = r.meanStepTime;
+    result["p99StepMs"] = r.p99StepTime;
+    result["contactsPerStep"] = r.contacts;
+    result["velocityIterationsPerStep"] = r.velocityIterations;
+    result["positionIterationsPerStep"] = r.positionIterations;
+    data["results"].push_back(result);
+  }
+  return data;
+}
+
+void writeCsv(std::ostream &out, const std::vector<Result> &results) {
+  out << "scene,bodies,frames,meanStepMs,p99StepMs,contactsPerStep,"
+      << "velocityIterationsPerStep,positionIterationsPerStep\n";
+  for (auto &r : results)
+    out << r.layout << "," << r.bodies << "," << r.frames << ","
+        << r.meanStepTime << "," << r.p99StepTime << "," << r.contacts
+        << "," << r.velocityIterations << "," << r.positionIterations
+        << "\n";
+}
+
+// Returns how much value grew over the one of the baseline.
+double growth(double value, double base) {
+  return base > 0 ? value / base - 1.0 : 0.0;
+}
+
+/**
+ * Compares the results to the ones of the same scenes and sizes in the
+ * baseline, and prints the comparison. Returns the number of
+ * regressions.
+ */
+uint32_t compare(const std::vector<Result> &results,
+                 const nlohmann::json &baseline, double threshold) {
+  uint32_t regressions = 0;
+  for (auto &r : results) {
+    const nlohmann::json *base = nullptr;
+    for (auto &b : baseline["results"])
+      if (b["scene"] == r.layout && b["bodies"] == r.bodies)
+        base = &b;
+    if (!base) {
+      std::printf("%-9s %6u: not in the baseline\n", r.layout.c_str(),
+                  r.bodies);
+      continue;
+    }
+    if ((*base)["frames"] != r.frames) {
+      std::printf("%-9s %6u: the baseline ran %u frames, skipped\n",
+                  r.layout.c_str(), r.bodies,
+                  (*base)["frames"].get<uint32_t>());
+      continue;
+    }
+
+    double mean = (*base)["meanStepMs"];
+    double p99 = (*base)["p99StepMs"];
+    double iterations = (double)(*base)["velocityIterationsPerStep"] +
+                        (double)(*base)["positionIterationsPerStep"];
+    double contacts = (*base)["contactsPerStep"];
+    double rIterations = r.velocityIterations + r.positionIterations;
+
+    bool slower =
+        (r.meanStepTime > mean * (1.0 + threshold) + TIME_SLACK) ||
+        (r.p99StepTime > p99 * (1.0 + 2.0 * threshold) + TIME_SLACK);
+    std::printf("%-9s %6u: mean %+6.1f%%, p99 %+6.1f%%, iterations "
+                "%+6.1f%%, contacts %+6.1f%%%s\n",
+                r.layout.c_str(), r.bodies,
+                100.0 * growth(r.meanStepTime, mean),
+                100.0 * growth(r.p99StepTime, p99),
+                100.0 * growth(rIterations, iterations),
+                100.0 * growth(r.contacts, contacts),
+                slower ? "  REGRESSION" : "");
+    regressions += slower;
+  }
+  return regressions;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  nlohmann::json baseline;
+  if (!options.baseline.empty()) {
+    std::ifstream file(options.baseline);
+    if (!file) {
+      std::cerr << "Could not load " << options.baseline << std::endl;
+      return 1;
+    }
+    file >> baseline;
+  }
+
+  std::vector<Result> results;
+  std::printf("%-9s %6s %10s %10s %10s %12s\n", "scene", "bodies",
+              "mean ms", "p99 ms", "contacts", "iterations");
+  for (auto &layout : options.layouts) {
+    for (uint32_t size : options.sizes) {
+      try {
+        // the fastest of the runs is the one least disturbed by the
+        // rest of the machine
+        Result result = run(layout, size, options);
+        for (uint32_t i = 1; i < options.repeats; ++i) {
+          Result again = run(layout, size, options);
+          result.meanStepTime =
+              std::min(result.meanStepTime, again.meanStepTime);
+          result.p99StepTime =
+              std::min(result.p99StepTime, again.p99StepTime);
+        }
+        results.push_back(result);
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+      }
+      const Result &r = results.back();
+      std::printf("%-9s %6u %10.4f %10.4f %10.1f %12.1f\n", r.layout.c_str(),
+                  r.bodies, r.meanStepTime, r.p99StepTime, r.contacts,
+                  r.velocityIterations + r.positionIterations);
+      std::fflush(stdout);
+    }
+  }
+
+  if (!options.json.empty()) {
+    std::ofstream file(options.json);
+    file << toJson(results, options).dump(4) << std::endl;
+  }
+  if (!options.csv.empty()) {
+    std::ofstream file(options.csv);
+    writeCsv(file, results);
+  }
+
+  if (!options.baseline.empty()) {
+    std::printf("\ncompared to %s, failing above %+.1f%%:\n",
+                options.baseline.c_str(), 100.0 * options.threshold);
+    uint32_t regressions = compare(results, baseline, options.threshold);
+    if (regressions) {
+      std::printf("%u regressions\n", regressions);
+      return 1;
+    }
+    std::printf("no regression\n");
+  }
+  return 0;
+}
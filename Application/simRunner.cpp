@@ -0,0 +1,232 @@
+// Runs the simulation of a scene without the viewer, as fast as it
+// goes, and reports how fast that was.
+//
+// The bodies come from the rigidBodies section of a scene file, or
+// make one of the generated scenes. The simulation takes one fixed
+// step per frame, on the calling thread, and the islands are solved on
+// a scheduler if it is given threads. The state checksum at the end
+// tells whether two runs, on two builds or two machines, ended up in
+// the same place. In deterministic mode, the hash of the state after
+// every step can be written out as well, to find the step where two
+// runs parted.
+#include "ft_stateHash.h"
+#include "includes/ft_simScene.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+
+struct Options {
+  std::string scene;
+  std::string layout = "pile";
+  uint32_t bodies = 1000;
+  unsigned seed = 1234;
+  uint32_t frames = 1000;
+  real_t timeStep = 0;
+  uint32_t threads = 0;
+  ft::ContactSolverType solver = ft::ContactSolverType::ITERATIVE;
+  ft::BroadphaseType broadphase = ft::BroadphaseType::AABB_TREE;
+  bool deterministic = false;
+  std::string hashes;
+};
+
+void usage(const char *name) {
+  std::cout
+      << "usage: " << name << " [options]\n"
+      << "  --scene <file>       the rigidBodies of a scene file\n"
+      << "  --generate <count>   a generated scene of count bodies (1000)\n"
+      << "  --layout <name>      the generated scene: pile, pyramid, pit,\n"
+      << "                       piles, dominoes or rain (pile)\n"
+      << "  --seed <seed>        the seed of the generated scene (1234)\n"
+      << "  --frames <count>     the number of steps to take (1000)\n"
+      << "  --dt <seconds>       the step, the one of the scene by default\n"
+      << "  --threads <count>    the threads solving the islands (0)\n"
+      << "  --solver <name>      iterative or impulse (iterative)\n"
+      << "  --broadphase <name>  brute, sort, tree, sap or hash (tree)\n"
+      << "  --deterministic      runs in deterministic mode\n"
+      << "  --hashes <file>      writes the state hash of every step, in\n"
+      << "                       deterministic mode\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h")
+      return false;
+    if (arg == "--deterministic") {
+      options.deterministic = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "missing value for " << arg << std::endl;
+      return false;
+    }
+
+    std::string value = argv[++i];
+    if (arg == "--scene") {
+      options.scene = value;
+    } else if (arg == "--generate") {
+      options.bodies = (uint32_t)std::stoul(value);
+    } else if (arg == "--layout") {
+      options.layout = value;
+    } else if (arg == "--seed") {
+      options.seed = (unsigned)std::stoul(value);
+    } else if (arg == "--frames") {
+      options.frames = (uint32_t)std::stoul(value);
+    } else if (arg == "--dt") {
+      options.timeStep = std::stof(value);
+    } else if (arg == "--threads") {
+      options.threads = (uint32_t)std::stoul(value);
+    } else if (arg == "--solver") {
+      if (value == "iterative")
+        options.solver = ft::ContactSolverType::ITERATIVE;
+      else if (value == "impulse")
+        options.solver = ft::ContactSolverType::SEQUENTIAL_IMPULSE;
+      else {
+        std::cerr << "unknown solver " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--broadphase") {
+      if (value == "brute")
+        options.broadphase = ft::BroadphaseType::BRUTE_FORCE;
+      else if (value == "sort")
+        options.broadphase = ft::BroadphaseType::SORT_AND_SWEEP;
+      else if (value == "tree")
+        options.broadphase = ft::BroadphaseType::AABB_TREE;
+      else if (value == "sap")
+        options.broadphase = ft::BroadphaseType::SWEEP_AND_PRUNE;
+      else if (value == "hash")
+        options.broadphase = ft::BroadphaseType::SPATIAL_HASH;
+      else {
+        std::cerr << "unknown broad phase " << value << std::endl;
+        return false;
+      }
+    } else if (arg == "--hashes") {
+      options.hashes = value;
+      options.deterministic = true;
+    } else {
+      std::cerr << "unknown option " << arg << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  ft::SimScene scene;
+  try {
+    if (options.scene.empty())
+      scene = ft::SimScene::generate(options.layout, options.bodies,
+                                     options.seed);
+    else
+      scene = ft::SimScene::load(options.scene);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  if (options.timeStep > 0)
+    scene.timeStep = options.timeStep;
+
+  ft::SimpleRigidApplication app(256, options.broadphase);
+  app.setSolverType(options.solver);
+  app.setDeterministic(options.deterministic);
+  ft::Scheduler::pointer scheduler;
+  if (options.threads > 0) {
+    scheduler = std::make_shared<ft::Scheduler>(options.threads);
+    app.setScheduler(scheduler, scheduler->getWorkerCount());
+  }
+
+  std::vector<ft::RigidBox::pointer> boxes;
+  std::vector<ft::RigidBall::pointer> balls;
+  scene.build(app, boxes, balls);
+
+  std::cout << (options.scene.empty() ? "generated " + options.layout
+                                      : options.scene)
+            << ": " << boxes.size() << " boxes, " << balls.size()
+            << " balls, " << scene.planes.size() + 1 << " planes, "
+            << options.frames << " steps of " << scene.timeStep << " s"
+            << std::endl;
+
+  std::ofstream hashes;
+  if (!options.hashes.empty()) {
+    hashes.open(options.hashes);
+    if (!hashes) {
+      std::cerr << "Could not write " << options.hashes << std::endl;
+      return 1;
+    }
+  }
+
+  // one step per frame: the frame is the step itself
+  ft::RigidBodyApplication::StepStats total;
+  uint64_t contacts = 0;
+  uint64_t velocityIterations = 0;
+  uint64_t positionIterations = 0;
+  uint32_t maxContacts = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < options.frames; ++frame) {
+    app.advance(scene.timeStep);
+
+    const ft::RigidBodyApplication::StepStats &stats = app.getStats();
+    total.integrateTime += stats.integrateTime;
+    total.contactTime += stats.contactTime;
+    total.islandTime += stats.islandTime;
+    total.solveTime += stats.solveTime;
+    total.stepTime += stats.stepTime;
+    contacts += stats.contacts;
+    velocityIterations += stats.velocityIterations;
+    positionIterations += stats.positionIterations;
+    maxContacts = std::max(maxContacts, stats.contacts);
+    total.awakeBodies = stats.awakeBodies;
+    total.sleepingBodies = stats.sleepingBodies;
+    if (hashes.is_open()) {
+      char line[20];
+      std::snprintf(line, sizeof(line), "%016llx\n",
+                    (unsigned long long)stats.stateHash);
+      hashes << line;
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  // the boxes first and then the balls, each in the order they were
+  // made
+  ft::StateHash checksum;
+  // the bodies are made by the first step
+  for (auto &box : boxes)
+    if (box->body)
+      checksum.addBody(*box->body);
+  for (auto &ball : balls)
+    if (ball->body)
+      checksum.addBody(*ball->body);
+
+  double frames = std::max(options.frames, 1u);
+  std::printf("%u steps in %.3f s: %.1f steps/s\n", options.frames, seconds,
+              seconds > 0 ? options.frames / seconds : 0.0);
+  std::printf("per step: %.4f ms\n", total.stepTime / frames);
+  std::printf("  integrate  %.4f ms\n", total.integrateTime / frames);
+  std::printf("  contacts   %.4f ms\n", total.contactTime / frames);
+  std::printf("  islands    %.4f ms\n", total.islandTime / frames);
+  std::printf("  solve      %.4f ms\n", total.solveTime / frames);
+  std::printf("contacts: %.1f per step, %u at most\n",
+              contacts / frames, maxContacts);
+  std::printf("iterations: %.1f velocity, %.1f position per step\n",
+              velocityIterations / frames, positionIterations / frames);
+  std::printf("bodies: %u awake, %u asleep\n", total.awakeBodies,
+              total.sleepingBodies);
+  std::printf("checksum: %016llx\n", (unsigned long long)checksum.get());
+  return 0;
+}
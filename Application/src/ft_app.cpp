@@ -29,7 +29,7 @@ ft::Application::Application()
     : _ftEventListener(std::make_shared<ft::EventListener>()),
       _ftWindow{std::make_shared<Window>(W_WIDTH, W_HEIGHT, "applicationWindow",
                                          nullptr, _ftEventListener)},
-      _ftThreadPool(std::make_shared<ft::ThreadPool>(ft::THREAD_POOL_SIZE)) {
+      _ftScheduler(std::make_shared<ft::Scheduler>(ft::THREAD_POOL_SIZE)) {
   _validationLayers = {
       "VK_LAYER_KHRONOS_validation",
   };
@@ -41,32 +41,74 @@ ft::Application::Application()
   initEventListener();
   initApplication();
   createScene();
+  buildFrameGraph();
 }
 
 ft::Application::~Application() = default;
 
 void ft::Application::run() {
 
-  float duration = 0.1f;
+  auto lastFrame = std::chrono::steady_clock::now();
   while (!_ftWindow->shouldClose()) {
-    _ftWindow->pollEvents();
-    _ftGui->newFrame();
-    _ftGui->showGUI(_ftScene);
-    // _ftGui->showDemo();
-    duration = 1.0f / _ftGui->getFramerate();
-    if (_play) {
-      _ftPhysicsApplication->update(duration);
-      _ftScene->updateSceneObjects(duration, _ftThreadPool);
-    }
-    drawFrame();
-    checkEventQueue();
+    auto now = std::chrono::steady_clock::now();
+    _frameDuration = std::chrono::duration<float>(now - lastFrame).count();
+    lastFrame = now;
+    _ftFrameGraph->run(*_ftScheduler);
+    updatePerformanceStats();
 #ifdef SHOW_FRAME_RATE
-    printFPS();
+    if (printFPS(_ftScene->getMeanUpdateTime()))
+      _ftFrameGraph->report(std::cout);
 #endif
   }
+  _ftPhysicsApplication->stop();
   vkDeviceWaitIdle(_ftDevice->getVKDevice());
 }
 
+// The window, the gui and the vulkan queue stay on the main thread.
+// Acquiring the next image waits for the gpu to be done with an older
+// frame; the poses of the physics and the scene objects are updated on
+// the scheduler in the meantime.
+void ft::Application::buildFrameGraph() {
+  _ftFrameGraph = std::make_shared<FrameGraph>();
+
+  _ftFrameGraph->addNode(
+      "events", 0, FRAME_INPUT | FRAME_GUI | FRAME_MODEL_TRANSFORMS, true,
+      [this]() {
+        _ftWindow->pollEvents();
+        _ftGui->newFrame();
+        _ftGui->showGUI(_ftScene);
+        // _ftGui->showDemo();
+      });
+
+  // The physics steps on its own thread, the objects are drawn
+  // between the last two steps it published.
+  _ftFrameGraph->addNode("physics sync", 0, FRAME_PHYSICS_POSES, false,
+                         [this]() {
+                           if (_play)
+                             _ftPhysicsApplication->syncDrawnPoses();
+                         });
+
+  _ftFrameGraph->addNode(
+      "scene update", FRAME_PHYSICS_POSES, FRAME_MODEL_TRANSFORMS, false,
+      [this]() {
+        if (_play)
+          _ftScene->updateSceneObjects(_frameDuration, _ftScheduler);
+      });
+
+  _ftFrameGraph->addNode("acquire", 0, FRAME_SWAPCHAIN_IMAGE, true,
+                         [this]() { acquireFrame(); });
+
+  _ftFrameGraph->addNode("draw",
+                         FRAME_GUI | FRAME_MODEL_TRANSFORMS |
+                             FRAME_UNIFORM_BUFFERS | FRAME_SWAPCHAIN_IMAGE,
+                         FRAME_COMMAND_BUFFERS, true,
+                         [this]() { drawFrame(); });
+
+  _ftFrameGraph->addNode("dispatch events", FRAME_INPUT,
+                         FRAME_MODEL_TRANSFORMS | FRAME_UNIFORM_BUFFERS, true,
+                         [this]() { checkEventQueue(); });
+}
+
 void ft::Application::initEventListener() {
   _ftEventListener->addCallbackForEventType(
       Event::EventType::KEYBOARD_EVENT, [&](ft::Event &ev) {
@@ -163,12 +205,12 @@ void ft::Application::initEventListener() {
 
               rball = obj->getComponent<RigidBallComponent>();
               if (rball) {
-                rball->backwardUpdate(1.0f);
+                rball->backwardUpdate(*_ftPhysicsApplication);
               }
 
               rbox = obj->getComponent<RigidBoxComponent>();
               if (rbox) {
-                rbox->backwardUpdate(1.0f);
+                rbox->backwardUpdate(*_ftPhysicsApplication);
               }
             }
           }
@@ -252,12 +294,12 @@ void ft::Application::initEventListener() {
 
               rball = obj->getComponent<RigidBallComponent>();
               if (rball) {
-                rball->backwardUpdate(1.0f);
+                rball->backwardUpdate(*_ftPhysicsApplication);
               }
 
               rbox = obj->getComponent<RigidBoxComponent>();
               if (rbox) {
-                rbox->backwardUpdate(1.0f);
+                rbox->backwardUpdate(*_ftPhysicsApplication);
               }
             }
           }
@@ -299,6 +341,7 @@ void ft::Application::initEventListener() {
         if (!_scenePath.empty()) {
           _ftJsonParser->parseSceneFile(
               _ftScene, _scenePath, _ftRenderer->getSwapChain()->getAspect());
+          loadPhysicsSettings();
           _ftScene->updateCameraUBO();
           _ftMousePicker->notifyUpdatedView();
         } else {
@@ -533,10 +576,18 @@ void ft::Application::initApplication() {
   _ftNormDebugRdrSys = std::make_shared<ft::NormDebugRdrSys>(
       _ftDevice, _ftRenderer, _ftDescriptorPool);
   _ftJsonParser = std::make_shared<ft::JsonParser>(
-      _ftDevice, _ftMaterialPool, _ftThreadPool, _ftTexturedRdrSys,
+      _ftDevice, _ftMaterialPool, _ftScheduler, _ftTexturedRdrSys,
       _ft2TexturedRdrSys, _ftSkyBoxRdrSys);
 
+  // The simulation shares the scheduler of the frame: its thread
+  // submits and waits like the main thread does, and the threads of
+  // the scheduler take the tasks of both. It starts paused, like the
+  // scene.
   _ftPhysicsApplication = std::make_shared<ft::SimpleRigidApplication>(512);
+  _ftPhysicsApplication->setScheduler(_ftScheduler,
+                                      _ftScheduler->getWorkerCount());
+  _ftPhysicsApplication->pause();
+  _ftPhysicsApplication->start();
 }
 
 // TODO: replace this with a scene manager, read scene from disk
@@ -713,7 +764,7 @@ void ft::Application::createScene() {
   (void)id;
 }
 
-void ft::Application::printFPS() {
+bool ft::Application::printFPS(double updateTime) {
   static auto oldTime = std::chrono::high_resolution_clock::now();
   static int fps;
 
@@ -722,16 +773,50 @@ void ft::Application::printFPS() {
           std::chrono::high_resolution_clock::now() - oldTime) >=
       std::chrono::seconds{1}) {
     oldTime = std::chrono::high_resolution_clock::now();
-    std::cout << "FPS: " << fps << std::endl;
+    std::cout << "FPS: " << fps << ", scene update: " << updateTime << " ms"
+              << std::endl;
     fps = 0;
+    return true;
   }
+  return false;
+}
+
+// Gathered on the main thread between two runs of the frame graph,
+// while none of its nodes are writing.
+void ft::Application::updatePerformanceStats() {
+  auto now = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double, std::nano>(
+                       now - _performanceTime)
+                       .count();
+  _performanceTime = now;
+
+  auto usage = [elapsed](const Scheduler &scheduler, uint64_t &busyTime) {
+    uint64_t busy = scheduler.getBusyTime();
+    double used = (double)(busy - busyTime);
+    busyTime = busy;
+    if (elapsed <= 0.0 || scheduler.getThreadCount() == 0)
+      return 0.0f;
+    return (float)std::min(
+        used / (elapsed * (double)scheduler.getThreadCount()), 1.0);
+  };
+
+  PerformanceStats stats;
+  stats.frameTime = _frameDuration * 1000.0f;
+  stats.sceneUpdateTime = _ftScene->getUpdateTime();
+  stats.criticalPathTime = _ftFrameGraph->getCriticalPathTime();
+  stats.physics = _ftPhysicsApplication->getStats();
+  stats.poolUsage = usage(*_ftScheduler, _busyTime);
+  _ftGui->pushPerformanceStats(stats);
 }
 
 // draw a frame
+void ft::Application::acquireFrame() {
+  std::tie(_frameImage, _frameCommandBuffer) = _ftRenderer->beginFrame();
+}
+
 void ft::Application::drawFrame() {
-  CommandBuffer::pointer commandBuffer;
-  uint32_t index;
-  std::tie(index, commandBuffer) = _ftRenderer->beginFrame();
+  CommandBuffer::pointer commandBuffer = std::move(_frameCommandBuffer);
+  uint32_t index = _frameImage;
   if (!commandBuffer)
     return;
 
@@ -852,6 +937,15 @@ void ft::Application::updateScene(int key) {
   } else if (key == _ftWindow->KEY(KeyboardKeys::KEY_O)) {
     _ftPhysicsApplication->pause();
     _play = false;
+  } else if (key == _ftWindow->KEY(KeyboardKeys::KEY_M)) {
+    bool iterative = _ftPhysicsApplication->getSolverType() ==
+                     ContactSolverType::ITERATIVE;
+    _ftPhysicsApplication->setSolverType(
+        iterative ? ContactSolverType::SEQUENTIAL_IMPULSE
+                  : ContactSolverType::ITERATIVE);
+    std::cout << "contact solver: "
+              << (iterative ? "sequential impulses" : "iterative")
+              << std::endl;
   } else if (key == _ftWindow->KEY(KeyboardKeys::KEY_X)) {
     std::cout << "testing: " << std::endl;
     std::cout << "sizeof ubo: " << sizeof(ft::UniformBufferObject) << std::endl;
@@ -867,20 +961,41 @@ void ft::Application::setScenePath(const std::string &path) {
   if (!_scenePath.empty()) {
     _ftJsonParser->parseSceneFile(_ftScene, _scenePath,
                                   _ftRenderer->getSwapChain()->getAspect());
+    loadPhysicsSettings();
   } else {
     std::cout << "scene file empty!" << std::endl;
   }
 }
 
-// todo! reimplement for multi-threading
+void ft::Application::loadPhysicsSettings() {
+  auto settings = _ftJsonParser->getPhysicsSettings();
+  auto physics = _ftPhysicsApplication.get();
+  physics->enqueue([physics, settings]() {
+    physics->setTimeStep(settings.timeStep);
+    physics->setMaxSubsteps(settings.maxSubsteps);
+  });
+}
+
+// The events are handled on the scheduler, and all of them before the
+// node is done: the node writes what their callbacks write.
 void ft::Application::checkEventQueue() {
-  while (!_ftEventListener->isQueueEmpty()) {
-    auto ev = _ftEventListener->popEvent();
-    _ftThreadPool->addTask([&, e = ev.release()]() mutable {
-      _ftEventListener->fireInstante(*e);
-      delete e;
-    });
+  _dispatchedEvents.clear();
+  while (!_ftEventListener->isQueueEmpty())
+    _dispatchedEvents.push_back(_ftEventListener->popEvent());
+  if (_dispatchedEvents.empty())
+    return;
+
+  // The tasks don't move once submitted.
+  _eventTasks.resize(_dispatchedEvents.size());
+  WaitGroup group;
+  for (size_t i = 0; i < _dispatchedEvents.size(); ++i) {
+    EventListener *listener = _ftEventListener.get();
+    Event *event = _dispatchedEvents[i].get();
+    _eventTasks[i].set([listener, event]() { listener->fireInstante(*event); });
+    _ftScheduler->submit(_eventTasks[i], group);
   }
+  _ftScheduler->wait(group);
+  _dispatchedEvents.clear();
 }
 
 void ft::Application::test() {
@@ -3,8 +3,11 @@
 #include "../includes/ft_rigidComponent.h"
 #include "../includes/ft_rigidObject.h"
 #include "ft_defines.h"
+#include "ft_profiler.h"
 #include "ft_scene.h"
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
 #include <glm/fwd.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iomanip>
@@ -132,6 +135,8 @@ void ft::Gui::showGUI(const ft::Scene::pointer &scene, uint32_t flags,
     showMetrics(&show_app_metrics);
   if (show_app_about)
     showAboutWindow(&show_app_about);
+  if (show_app_performance)
+    showPerformance(&show_app_performance);
 }
 
 void ft::Gui::render(ft::CommandBuffer::pointer commandBuffer) {
@@ -172,6 +177,113 @@ void ft::Gui::showMetrics(bool *p_open) {
   ImGui::End();
 }
 
+void ft::Gui::pushPerformanceStats(const PerformanceStats &stats) {
+  if (_performancePaused)
+    return;
+
+  if (_frameTimes.size() < FRAME_HISTORY) {
+    _frameTimes.push_back(stats.frameTime);
+  } else {
+    _frameTimes[_frameTimeHead] = stats.frameTime;
+    _frameTimeHead = (_frameTimeHead + 1) % FRAME_HISTORY;
+  }
+  _performance = stats;
+
+  if (_pauseOnSpike && stats.frameTime > _spikeTime)
+    _performancePaused = true;
+}
+
+void ft::Gui::showPerformance(bool *p_open) {
+  if (!ImGui::Begin("Performance", p_open)) {
+    ImGui::End();
+    return;
+  }
+
+  // frame times, oldest first
+  ImGui::Checkbox("Pause", &_performancePaused);
+  ImGui::SameLine();
+  ImGui::Checkbox("Pause on spike over", &_pauseOnSpike);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(80.0f);
+  ImGui::DragFloat("ms##spike", &_spikeTime, 0.5f, 1.0f, 1000.0f, "%.1f");
+
+  // the percentiles are picked in a copy kept from frame to frame, so
+  // the panel allocates nothing once the history is full
+  std::vector<float> &sorted = _sortedFrameTimes;
+  sorted.assign(_frameTimes.begin(), _frameTimes.end());
+  auto percentile = [&sorted](float p) {
+    if (sorted.empty())
+      return 0.0f;
+    auto nth = sorted.begin() + std::min((size_t)(p * (float)sorted.size()),
+                                         sorted.size() - 1);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+  };
+  float p50 = percentile(0.50f);
+  float p95 = percentile(0.95f);
+  float p99 = percentile(0.99f);
+
+  char overlay[64];
+  std::snprintf(overlay, sizeof(overlay), "last %.2f ms",
+                _performance.frameTime);
+  ImGui::PlotHistogram("##frame times", _frameTimes.data(),
+                       (int)_frameTimes.size(), (int)_frameTimeHead, overlay,
+                       0.0f, std::max(p99 * 1.25f, 1.0f),
+                       ImVec2(-1.0f, 80.0f));
+  ImGui::Text("frame: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms", p50, p95, p99);
+  ImGui::Text("critical path %.2f ms, scene update %.2f ms",
+              _performance.criticalPathTime, _performance.sceneUpdateTime);
+
+  const RigidBodyApplication::StepStats &physics = _performance.physics;
+  if (ImGui::CollapsingHeader("Physics", ImGuiTreeNodeFlags_DefaultOpen)) {
+    ImGui::Text("step: %.3f ms, %u steps in the last frame", physics.stepTime,
+                physics.steps);
+    struct {
+      const char *name;
+      double time;
+    } phases[] = {{"integrate", physics.integrateTime},
+                  {"contacts", physics.contactTime},
+                  {"islands", physics.islandTime},
+                  {"solve", physics.solveTime}};
+    for (auto &phase : phases) {
+      char text[32];
+      std::snprintf(text, sizeof(text), "%.3f ms", phase.time);
+      float share = physics.stepTime > 0.0
+                        ? (float)(phase.time / physics.stepTime)
+                        : 0.0f;
+      ImGui::ProgressBar(share, ImVec2(160.0f, 0.0f), text);
+      ImGui::SameLine();
+      ImGui::TextUnformatted(phase.name);
+    }
+
+    char text[32];
+    std::snprintf(text, sizeof(text), "%u / %u", physics.contacts,
+                  physics.contactCapacity);
+    ImGui::ProgressBar(physics.contactCapacity
+                           ? (float)physics.contacts /
+                                 (float)physics.contactCapacity
+                           : 0.0f,
+                       ImVec2(160.0f, 0.0f), text);
+    ImGui::SameLine();
+    ImGui::TextUnformatted("contacts");
+    ImGui::Text("contact storage high water mark: %u",
+                physics.contactHighWaterMark);
+    ImGui::Text("islands: %u", physics.islands);
+    ImGui::Text("iterations: %u velocity, %u position",
+                physics.velocityIterations, physics.positionIterations);
+    ImGui::Text("bodies: %u awake, %u asleep", physics.awakeBodies,
+                physics.sleepingBodies);
+  }
+
+  if (ImGui::CollapsingHeader("Scheduler", ImGuiTreeNodeFlags_DefaultOpen)) {
+    ImGui::ProgressBar(_performance.poolUsage, ImVec2(160.0f, 0.0f));
+    ImGui::SameLine();
+    ImGui::Text("%u threads", THREAD_POOL_SIZE);
+  }
+
+  ImGui::End();
+}
+
 void ft::Gui::showTitleBar() {
   IM_ASSERT(ImGui::GetCurrentContext() != NULL &&
             "Missing dear imgui context. Refer to examples app!");
@@ -642,6 +754,14 @@ void ft::Gui::showMainMenue(const ft::Scene::pointer &scene) {
   if (ImGui::CollapsingHeader("Debugging Tools")) {
     static bool showBoundingBoxes = false;
     ImGui::Checkbox("Show Bounding Boxes", &showBoundingBoxes);
+#ifdef FT_PROFILING
+    if (ImGui::Button("Export Trace")) {
+      if (ft::Profiler::get().writeChromeTrace(PROFILER_TRACE_FILE))
+        std::cout << "trace written to " << PROFILER_TRACE_FILE << std::endl;
+      else
+        std::cerr << "failed to write " << PROFILER_TRACE_FILE << std::endl;
+    }
+#endif
     // Add more debugging tools as needed
   }
 
@@ -759,6 +879,7 @@ void ft::Gui::showInsertMenueFile() {
 
 void ft::Gui::showToolsMenueFile() {
   ImGui::MenuItem("Metrics", NULL, &show_app_metrics, true);
+  ImGui::MenuItem("Performance", NULL, &show_app_performance, true);
   ImGui::MenuItem("About", NULL, &show_app_about);
 }
 
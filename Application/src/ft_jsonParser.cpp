@@ -11,11 +11,11 @@
 
 ft::JsonParser::JsonParser(const Device::pointer &device,
                            const TexturePool::pointer &mPool,
-                           const ThreadPool::pointer &tPool,
+                           const Scheduler::pointer &scheduler,
                            const OneTextureRdrSys::pointer &otrdr,
                            const TwoTextureRdrSys::pointer &ttrdr,
                            const SkyBoxRdrSys::pointer &sbrdr)
-    : Parser(device, mPool, tPool), _ftTexturedRdrSys(otrdr),
+    : Parser(device, mPool, scheduler), _ftTexturedRdrSys(otrdr),
       _ft2TexturedRdrSys(ttrdr), _ftSkyBoxRdrSys(sbrdr) {}
 
 void ft::JsonParser::parseSceneFile(const ft::Scene::pointer &scene,
@@ -47,6 +47,14 @@ void ft::JsonParser::parseSceneFile(const ft::Scene::pointer &scene,
 
   if (jsonData.contains("models"))
     loadModels(scene, jsonData);
+
+  _physics = PhysicsSettings{};
+  if (jsonData.contains("physics"))
+    loadPhysics(jsonData);
+
+  // only read by the sim runner, kept as it is when the scene is saved
+  if (jsonData.contains("rigidBodies"))
+    _ignored["rigidBodies"] = jsonData["rigidBodies"];
 }
 
 void ft::JsonParser::saveSceneToFile(const ft::Scene::pointer &scene,
@@ -130,6 +138,10 @@ void ft::JsonParser::saveSceneToFile(const ft::Scene::pointer &scene,
     jsonData["skyBox"]["scaling"] = {m[0][0], m[1][1], m[2][2]};
   }
 
+  // physics
+  jsonData["physics"]["timeStep"] = _physics.timeStep;
+  jsonData["physics"]["maxSubsteps"] = _physics.maxSubsteps;
+
   // models
   nlohmann::json jmodels;
   if (_ignored.contains("models")) {
@@ -535,3 +547,21 @@ void ft::JsonParser::loadLights(const Scene::pointer &scene,
 
   scene->setGeneralLight(color, direction, ambient);
 }
+
+void ft::JsonParser::loadPhysics(nlohmann::json &data) {
+  auto physics = data["physics"];
+
+  if (physics.contains("timeStep")) {
+    float timeStep = physics["timeStep"];
+    if (timeStep <= 0.0f)
+      throw std::runtime_error("the physics time step must be positive !");
+    _physics.timeStep = timeStep;
+  }
+
+  if (physics.contains("maxSubsteps")) {
+    uint32_t maxSubsteps = physics["maxSubsteps"];
+    if (maxSubsteps == 0)
+      throw std::runtime_error("the physics needs at least one substep !");
+    _physics.maxSubsteps = maxSubsteps;
+  }
+}
@@ -1,13 +1,132 @@
 #include "../includes/ft_physicsApp.h"
 #include "ft_collideFine.h"
 #include "ft_contacts.h"
-#include "ft_headers.h"
+#include "ft_profiler.h"
+#include "ft_stateHash.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+
+// Returns the time since the given one, in milliseconds, and moves it
+// to now.
+static double _lapTime(std::chrono::steady_clock::time_point &since) {
+  auto now = std::chrono::steady_clock::now();
+  double time = std::chrono::duration<double, std::milli>(now - since).count();
+  since = now;
+  return time;
+}
+
+ft::RigidBodyApplication::RigidBodyApplication(
+    uint32_t contactCapacity, Broadphase::pointer broadphase)
+    : _broadphase(broadphase), _contactArena(contactCapacity),
+      _resolver(contactCapacity * 8) {
+  if (!_broadphase)
+    _broadphase = std::make_shared<AABBTreeBroadphase>();
+  _collisionData.contactArray = nullptr;
+  // Large piles have their contacts solved batch by batch on the
+  // scheduler, once there is one.
+  _impulseSolver.setBatching(true);
+}
+
+ft::RigidBodyApplication::RigidBodyApplication(uint32_t contactCapacity,
+                                               BroadphaseType type)
+    : RigidBodyApplication(contactCapacity, createBroadphase(type)) {}
+
+void ft::RigidBodyApplication::setScheduler(
+    const Scheduler::pointer &scheduler, uint32_t workerCount) {
+  _islandSolver.setScheduler(scheduler, workerCount);
+}
+
+uint32_t ft::RigidBodyApplication::advance(real_t frameTime) {
+  if (_pauseSimulation || frameTime <= 0) {
+    // The edits made while paused are shown all the same.
+    if (runCommands())
+      publish();
+    return 0;
+  }
+
+  _accumulator += frameTime;
+  uint32_t steps = 0;
+  while (_accumulator >= _timeStep && steps < _maxSubsteps) {
+    runCommands();
+    update(_timeStep);
+    _accumulator -= _timeStep;
+    ++steps;
+  }
+  if (_accumulator >= _timeStep)
+    _accumulator = std::fmod(_accumulator, _timeStep);
+
+  if (steps) {
+    publish();
+    _stepStats.steps = steps;
+    _stats.getWriteBuffer() = _stepStats;
+    _stats.publish();
+  }
+  return steps;
+}
+
+const ft::RigidBodyApplication::StepStats &
+ft::RigidBodyApplication::getStats() {
+  _stats.update();
+  return _stats.getReadBuffer();
+}
+
+void ft::RigidBodyApplication::start() {
+  if (_running.exchange(true))
+    return;
+  _thread = std::thread(&RigidBodyApplication::simulate, this);
+}
+
+void ft::RigidBodyApplication::stop() {
+  if (!_running.exchange(false))
+    return;
+  if (_thread.joinable())
+    _thread.join();
+}
+
+void ft::RigidBodyApplication::simulate() {
+  using clock = std::chrono::steady_clock;
+  FT_PROFILE_THREAD("physics");
+
+  auto last = clock::now();
+  while (_running.load(std::memory_order_acquire)) {
+    auto now = clock::now();
+    advance(std::chrono::duration<real_t>(now - last).count());
+    last = now;
+
+    // Sleep until the next step is due, or for a step while paused.
+    real_t wait = _pauseSimulation ? _timeStep : _timeStep - _accumulator;
+    std::this_thread::sleep_until(
+        now + std::chrono::duration_cast<clock::duration>(
+                  std::chrono::duration<real_t>(wait)));
+  }
+}
+
+void ft::RigidBodyApplication::enqueue(std::function<void()> command) {
+  std::lock_guard<std::mutex> lock(_commandMutex);
+  _commands.push_back(std::move(command));
+}
+
+bool ft::RigidBodyApplication::runCommands() {
+  {
+    std::lock_guard<std::mutex> lock(_commandMutex);
+    if (_commands.empty())
+      return false;
+    _commands.swap(_runningCommands);
+  }
+  for (auto &command : _runningCommands)
+    command();
+  _runningCommands.clear();
+  return true;
+}
+
+void ft::RigidBodyApplication::setTimeStep(real_t timeStep) {
+  if (timeStep > 0)
+    _timeStep = timeStep;
+}
 
-ft::RigidBodyApplication::RigidBodyApplication(uint32_t maxContacts)
-    : _maxContacts(maxContacts), _resolver(maxContacts * 8) {
-  // _contacts = new ft::Contact[maxContacts];
-  _contacts.resize(maxContacts);
-  _collisionData.contactArray = _contacts.data();
+void ft::RigidBodyApplication::setMaxSubsteps(uint32_t maxSubsteps) {
+  _maxSubsteps = std::max(maxSubsteps, (uint32_t)1);
 }
 
 void ft::RigidBodyApplication::play() { _pauseSimulation = false; }
@@ -15,14 +134,23 @@ void ft::RigidBodyApplication::pause() { _pauseSimulation = true; }
 
 /************************************SimplePhysicsApplication********************************/
 
-ft::SimpleRigidApplication::SimpleRigidApplication(uint32_t maxContacts)
-    : RigidBodyApplication(maxContacts) {
+ft::SimpleRigidApplication::SimpleRigidApplication(
+    uint32_t contactCapacity, Broadphase::pointer broadphase)
+    : RigidBodyApplication(contactCapacity, broadphase) {
   auto p = std::make_shared<CollisionPlane>();
   p->direction = glm::vec3(0.0f, 1.0f, 0.0f);
   p->offset = 0.0f;
   _planes.push_back(p);
 }
 
+ft::SimpleRigidApplication::SimpleRigidApplication(uint32_t contactCapacity,
+                                                   BroadphaseType type)
+    : SimpleRigidApplication(contactCapacity, createBroadphase(type)) {}
+
+// The thread runs update and publish, which are gone once this
+// destructor is done.
+ft::SimpleRigidApplication::~SimpleRigidApplication() { stop(); }
+
 void ft::SimpleRigidApplication::update(real_t duration) {
 
   if (duration <= 0)
@@ -30,32 +158,264 @@ void ft::SimpleRigidApplication::update(real_t duration) {
 
   if (_pauseSimulation)
     return;
+  FT_PROFILE_ZONE("SimpleRigidApplication::update");
+  auto start = std::chrono::steady_clock::now();
+  auto lap = start;
+
+  {
+    FT_PROFILE_ZONE("integrate");
+    for (auto &b : _boxes)
+      b->savePreviousState();
+    for (auto &b : _balls)
+      b->savePreviousState();
+
+    updateObjects(duration);
+  }
+  _stepStats.integrateTime = _lapTime(lap);
+
+  {
+    FT_PROFILE_ZONE("contacts");
+    generateContacts();
+    _contactCount = _manifolds.update(_contactArena);
+    _contacts = _contactArena.allocate(_contactCount);
+    _manifolds.write(_contacts);
+  }
+  _stepStats.contactTime = _lapTime(lap);
+
+  {
+    FT_PROFILE_ZONE("islands");
+    _islands.build(_contacts, _contactCount);
+  }
+  _stepStats.islandTime = _lapTime(lap);
+
+  {
+    FT_PROFILE_ZONE("solve");
+    _islandSolver.setSolverType(_solverType);
+    _islandSolver.setSolvers(_resolver, _impulseSolver);
+    _islandSolver.solve(_islands, _contacts, duration);
+  }
+  _islands.sleepIslands();
+
+  if (_solverType == ContactSolverType::SEQUENTIAL_IMPULSE)
+    _manifolds.storeImpulses(_contacts);
+  _stepStats.solveTime = _lapTime(lap);
+  _stepStats.stepTime = _lapTime(start);
+
+  _stepStats.contacts = _contactCount;
+  _stepStats.contactCapacity = _contactArena.getCapacity();
+  _stepStats.contactHighWaterMark = _contactArena.getHighWaterMark();
+  _stepStats.islands = _islands.getIslandCount();
+  _stepStats.velocityIterations = _islandSolver.getVelocityIterationsUsed();
+  _stepStats.positionIterations = _islandSolver.getPositionIterationsUsed();
+  _stepStats.awakeBodies = 0;
+  for (auto &b : _boxes)
+    _stepStats.awakeBodies += b->body->getAwake();
+  for (auto &b : _balls)
+    _stepStats.awakeBodies += b->body->getAwake();
+  _stepStats.sleepingBodies =
+      (uint32_t)(_boxes.size() + _balls.size()) - _stepStats.awakeBodies;
+  _stepStats.stateHash = _deterministic ? hashState() : 0;
+}
+
+uint64_t ft::SimpleRigidApplication::hashState() {
+  if (!_bodiesSorted) {
+    _sortedBodies.clear();
+    for (auto &b : _boxes)
+      _sortedBodies.push_back(b->body);
+    for (auto &b : _balls)
+      _sortedBodies.push_back(b->body);
+    std::sort(_sortedBodies.begin(), _sortedBodies.end(),
+              RigidBody::handleOrder);
+    _bodiesSorted = true;
+  }
+
+  StateHash hash;
+  for (const RigidBody *body : _sortedBodies)
+    hash.addBody(*body);
+  return hash.get();
+}
+
+bool ft::SimpleRigidApplication::saveState(
+    SimulationSnapshot &snapshot) const {
+  const RigidBodyStore &store = RigidBodyStore::getDefault();
+  if (store.getCount() != _boxes.size() + _balls.size())
+    return false;
+  store.saveState(snapshot.bodies);
+  _manifolds.saveState(snapshot.contacts);
+  _islands.saveState(snapshot.islands);
+  snapshot.stateHash = _stepStats.stateHash;
+  return true;
+}
+
+bool ft::SimpleRigidApplication::restoreState(
+    const SimulationSnapshot &snapshot) {
+  RigidBodyStore &store = RigidBodyStore::getDefault();
+  size_t count = _boxes.size() + _balls.size();
+  if (store.getCount() != count || snapshot.islands.sleepNext.size() != count)
+    return false;
+  if (!store.restoreState(snapshot.bodies, &_movedBodies))
+    return false;
+  _manifolds.restoreState(snapshot.contacts);
+  _islands.restoreState(snapshot.islands);
+  _stepStats.stateHash = snapshot.stateHash;
+
+  // The sleeping objects aren't brought up to date by the next step.
+  if (!_movedBodies.empty()) {
+    _movedFlags.assign(store.getCapacity(), 0);
+    for (uint32_t handle : _movedBodies)
+      _movedFlags[handle] = 1;
+    for (uint32_t proxy = 0; proxy < _proxies.size(); ++proxy) {
+      const ProxyEntry &entry = _proxies[proxy];
+      if (entry.box && _movedFlags[entry.box->body->getHandle()]) {
+        entry.box->calculateInternals();
+        _broadphase->moveProxy(proxy, entry.box->getBoundingBox());
+      } else if (entry.ball && _movedFlags[entry.ball->body->getHandle()]) {
+        entry.ball->calculateInternals();
+        _broadphase->moveProxy(proxy, entry.ball->getBoundingBox());
+      }
+    }
+  }
+  return true;
+}
+
+void ft::SimpleRigidApplication::publish() {
+  PoseSnapshot &snapshot = _snapshots.getWriteBuffer();
+
+  uint32_t slots = 0;
+  for (auto &b : _boxes)
+    slots = std::max(slots, b->getSlot() + 1);
+  for (auto &b : _balls)
+    slots = std::max(slots, b->getSlot() + 1);
+  snapshot.poses.resize(slots);
+  for (auto &pose : snapshot.poses)
+    pose.generation = 0;
+
+  for (auto &b : _boxes)
+    writePose(snapshot.poses[b->getSlot()], b->getGeneration(),
+              b->getPreviousPosition(), b->getPreviousOrientation(), *b->body);
+  for (auto &b : _balls)
+    writePose(snapshot.poses[b->getSlot()], b->getGeneration(),
+              b->getPreviousPosition(), b->getPreviousOrientation(), *b->body);
+
+  snapshot.timeStep = _timeStep;
+  snapshot.time = std::chrono::steady_clock::now();
+  _snapshots.publish();
+}
+
+void ft::SimpleRigidApplication::writePose(
+    PoseSnapshot::Pose &pose, uint32_t generation,
+    const glm::vec3 &previousPosition, const glm::quat &previousOrientation,
+    const RigidBody &body) {
+  pose.generation = generation;
+  // Paused, the object stays where it is.
+  if (_pauseSimulation) {
+    pose.previousPosition = body.getPosition();
+    pose.previousOrientation = body.getOrientation();
+  } else {
+    pose.previousPosition = previousPosition;
+    pose.previousOrientation = previousOrientation;
+  }
+  pose.position = body.getPosition();
+  pose.orientation = body.getOrientation();
+}
+
+void ft::SimpleRigidApplication::syncDrawnPoses() {
+  _snapshots.update();
+  const PoseSnapshot &snapshot = _snapshots.getReadBuffer();
+  if (snapshot.timeStep <= 0)
+    return;
 
-  updateObjects(duration);
+  // The snapshot holds the last step; the objects are drawn between
+  // it and the one before, a step behind the simulation.
+  real_t alpha = std::chrono::duration<real_t>(
+                     std::chrono::steady_clock::now() - snapshot.time)
+                     .count() /
+                 snapshot.timeStep;
+  alpha = std::clamp(alpha, (real_t)0, (real_t)1);
 
-  generateContacts();
+  std::unique_lock<std::mutex> lock(_slotMutex, std::try_to_lock);
+  if (!lock.owns_lock())
+    return;
 
-  _resolver.resolveContacts(_collisionData.contactArray,
-                            _collisionData.contactCount, duration);
+  uint32_t slots = (uint32_t)std::min(snapshot.poses.size(), _drawn.size());
+  for (uint32_t slot = 0; slot < slots; ++slot) {
+    const PoseSnapshot::Pose &pose = snapshot.poses[slot];
+    const DrawnEntry &entry = _drawn[slot];
+    glm::vec3 position =
+        glm::mix(pose.previousPosition, pose.position, alpha);
+    glm::quat orientation =
+        glm::slerp(pose.previousOrientation, pose.orientation, alpha);
+    if (entry.box && entry.box->getGeneration() == pose.generation)
+      entry.box->setDrawnPose(position, orientation);
+    else if (entry.ball && entry.ball->getGeneration() == pose.generation)
+      entry.ball->setDrawnPose(position, orientation);
+  }
+}
+
+uint32_t ft::SimpleRigidApplication::acquireSlot(const DrawnEntry &entry) {
+  std::lock_guard<std::mutex> lock(_slotMutex);
+  uint32_t slot;
+  if (_freeSlots.empty()) {
+    slot = (uint32_t)_drawn.size();
+    _drawn.push_back(entry);
+  } else {
+    slot = _freeSlots.back();
+    _freeSlots.pop_back();
+    _drawn[slot] = entry;
+  }
+  if (entry.box)
+    entry.box->setSlot(slot, _nextGeneration++);
+  else
+    entry.ball->setSlot(slot, _nextGeneration++);
+  return slot;
+}
+
+void ft::SimpleRigidApplication::releaseSlot(uint32_t slot) {
+  std::lock_guard<std::mutex> lock(_slotMutex);
+  if (slot >= _drawn.size() || (!_drawn[slot].box && !_drawn[slot].ball))
+    return;
+  _drawn[slot] = {nullptr, nullptr};
+  _freeSlots.push_back(slot);
 }
 
 void ft::SimpleRigidApplication::updateObjects(real_t duration) {
 
+  // The boxes and balls create their bodies in the default store. If
+  // they are the only bodies in it, the whole store is integrated in
+  // one batch, otherwise each body is integrated on its own. So is
+  // every body in deterministic mode, with the scalar code whatever
+  // the processor.
+  RigidBodyStore &store = RigidBodyStore::getDefault();
+  bool batched = !_deterministic &&
+                 store.getCount() == _boxes.size() + _balls.size();
+  if (batched)
+    store.integrateAll(duration);
+
+  // The sleeping objects haven't moved.
   for (auto &b : _boxes) {
-    b->body->integrate(duration);
+    if (b->isAsleep())
+      continue;
+    if (!batched)
+      b->body->integrate(duration);
     b->calculateInternals();
+    _broadphase->moveProxy(b->getProxy(), b->getBoundingBox());
   }
 
   for (auto &b : _balls) {
-    b->body->integrate(duration);
+    if (b->isAsleep())
+      continue;
+    if (!batched)
+      b->body->integrate(duration);
     b->calculateInternals();
+    _broadphase->moveProxy(b->getProxy(), b->getBoundingBox());
   }
 }
 
 void ft::SimpleRigidApplication::generateContacts() {
 
   // set up the collision data structure
-  _collisionData.reset(_maxContacts);
+  _contactArena.reset();
+  _collisionData.reset(_contactArena);
   _collisionData.friction = 0.9f;
   _collisionData.restitution = 0.6;
   _collisionData.tolerance = 0.15f;
@@ -63,60 +423,51 @@ void ft::SimpleRigidApplication::generateContacts() {
   // perform collision detection
   // todo: make use of the threadpool
 
-  // first for the boxes
+  // first against the planes, only the awake objects can hit them
   for (auto &b : _boxes) {
-
     if (b->isAsleep())
       continue;
-
-    if (!_collisionData.hasMoreContacts())
-      return;
-
-    // collision with the ground plane
     for (auto &p : _planes)
       ft::CollisionDetector::boxAndHalfSpace(*b, *p, &_collisionData);
-
-    // collision with other boxes
-    for (auto &bb : _boxes) {
-      if (bb == b)
-        continue;
-      if (!_collisionData.hasMoreContacts())
-        return;
-
-      ft::CollisionDetector::boxAndBox(*b, *bb, &_collisionData);
-      if (ft::IntersectionTests::boxAndBox(*b, *bb)) {
-        b->setOverlap(true);
-        bb->setOverlap(true);
-      }
-    }
-
-    // collision with other balls
-    for (auto &ba : _balls) {
-      if (!_collisionData.hasMoreContacts())
-        return;
-      ft::CollisionDetector::boxAndSphere(*b, *ba, &_collisionData);
-    }
   }
 
-  // then for the balls
   for (auto &b : _balls) {
-    if (!_collisionData.hasMoreContacts())
-      return;
-
     if (b->isAsleep())
       continue;
-
-    // collision with the ground plane
     for (auto &p : _planes)
       ft::CollisionDetector::sphereAndHalfSpace(*b, *p, &_collisionData);
+  }
 
-    // collision with other balls
-    for (auto &ba : _balls) {
-      if (ba == b)
+  // then the pairs reported by the broad phase, each one only once
+  _broadphase->findPairs(_pairs);
+
+  for (auto &pair : _pairs) {
+    const ProxyEntry &one = _proxies[pair.first];
+    const ProxyEntry &two = _proxies[pair.second];
+
+    if (one.box && two.box) {
+      if (one.box->isAsleep() && two.box->isAsleep())
         continue;
-      if (!_collisionData.hasMoreContacts())
-        return;
-      ft::CollisionDetector::sphereAndSphere(*b, *ba, &_collisionData);
+      ft::CollisionDetector::boxAndBox(*one.box, *two.box, &_collisionData);
+      if (ft::IntersectionTests::boxAndBox(*one.box, *two.box)) {
+        one.box->setOverlap(true);
+        two.box->setOverlap(true);
+      }
+    } else if (one.box && two.ball) {
+      if (one.box->isAsleep() && two.ball->isAsleep())
+        continue;
+      ft::CollisionDetector::boxAndSphere(*one.box, *two.ball,
+                                          &_collisionData);
+    } else if (one.ball && two.box) {
+      if (one.ball->isAsleep() && two.box->isAsleep())
+        continue;
+      ft::CollisionDetector::boxAndSphere(*two.box, *one.ball,
+                                          &_collisionData);
+    } else if (one.ball && two.ball) {
+      if (one.ball->isAsleep() && two.ball->isAsleep())
+        continue;
+      ft::CollisionDetector::sphereAndSphere(*one.ball, *two.ball,
+                                             &_collisionData);
     }
   }
 }
@@ -130,27 +481,99 @@ std::vector<ft::RigidBall::pointer> &ft::SimpleRigidApplication::getBalls() {
 };
 
 void ft::SimpleRigidApplication::addRigidBox(const RigidBox::pointer &box) {
-  _boxes.push_back(box);
+  // The body is made by the simulation, from the state set so far.
+  box->setDrawnPose(box->getStartPosition(), box->getStartOrientation());
+  acquireSlot({box, nullptr});
+  enqueue([this, box]() { insertRigidBox(box); });
 }
 
 void ft::SimpleRigidApplication::addRigidBall(const RigidBall::pointer &ball) {
-  _balls.push_back(ball);
+  ball->setDrawnPose(ball->getStartPosition(), ball->getStartOrientation());
+  acquireSlot({nullptr, ball});
+  enqueue([this, ball]() { insertRigidBall(ball); });
 }
 
 void ft::SimpleRigidApplication::removeRigidBox(RigidBox::pointer box) {
-  _boxes.erase(std::find(_boxes.begin(), _boxes.end(), box));
+  releaseSlot(box->getSlot());
+  enqueue([this, box]() { eraseRigidBox(box); });
 }
 
 void ft::SimpleRigidApplication::removeRigidBall(RigidBall::pointer ball) {
-  _balls.erase(std::find(_balls.begin(), _balls.end(), ball));
+  releaseSlot(ball->getSlot());
+  enqueue([this, ball]() { eraseRigidBall(ball); });
+}
+
+void ft::SimpleRigidApplication::insertRigidBox(const RigidBox::pointer &box) {
+  box->createBody();
+  _boxes.push_back(box);
+  _islands.addBody(box->body);
+  box->calculateInternals();
+  box->setProxy(_broadphase->createProxy(box->getBoundingBox()));
+  registerProxy(box->getProxy(), {box.get(), nullptr});
+  _bodiesSorted = false;
+}
+
+void ft::SimpleRigidApplication::insertRigidBall(
+    const RigidBall::pointer &ball) {
+  ball->createBody();
+  _balls.push_back(ball);
+  _islands.addBody(ball->body);
+  ball->calculateInternals();
+  ball->setProxy(_broadphase->createProxy(ball->getBoundingBox()));
+  registerProxy(ball->getProxy(), {nullptr, ball.get()});
+  _bodiesSorted = false;
+}
+
+void ft::SimpleRigidApplication::eraseRigidBox(const RigidBox::pointer &box) {
+  auto it = std::find(_boxes.begin(), _boxes.end(), box);
+  if (it == _boxes.end())
+    return;
+  _broadphase->destroyProxy(box->getProxy());
+  registerProxy(box->getProxy(), {nullptr, nullptr});
+  box->setProxy(Broadphase::NULL_PROXY);
+  _islands.removeBody(box->body);
+  box->destroyBody();
+  _boxes.erase(it);
+  _bodiesSorted = false;
+  // A new body may be given the same address.
+  _impulseSolver.clearCache();
+  _manifolds.clear();
+}
+
+void ft::SimpleRigidApplication::eraseRigidBall(
+    const RigidBall::pointer &ball) {
+  auto it = std::find(_balls.begin(), _balls.end(), ball);
+  if (it == _balls.end())
+    return;
+  _broadphase->destroyProxy(ball->getProxy());
+  registerProxy(ball->getProxy(), {nullptr, nullptr});
+  ball->setProxy(Broadphase::NULL_PROXY);
+  _islands.removeBody(ball->body);
+  ball->destroyBody();
+  _balls.erase(it);
+  _bodiesSorted = false;
+  // A new body may be given the same address.
+  _impulseSolver.clearCache();
+  _manifolds.clear();
+}
+
+void ft::SimpleRigidApplication::registerProxy(uint32_t proxy,
+                                               const ProxyEntry &entry) {
+  if (proxy >= _proxies.size())
+    _proxies.resize(proxy + 1, {nullptr, nullptr});
+  _proxies[proxy] = entry;
 }
 
 void ft::SimpleRigidApplication::addCollisionPlane(
     const ft::CollisionPlane::pointer &plane) {
-  _planes.push_back(plane);
+  enqueue([this, plane]() { _planes.push_back(plane); });
 }
 
 void ft::SimpleRigidApplication::removeCollisionPlane(
     ft::CollisionPlane::pointer plane) {
-  _planes.erase(std::find(_planes.begin(), _planes.end(), plane));
+  enqueue([this, plane]() {
+    auto it = std::find(_planes.begin(), _planes.end(), plane);
+    if (it != _planes.end())
+      _planes.erase(it);
+  });
 }
@@ -13,18 +13,23 @@ void ft::RigidBoxComponent::update(float duration) {
   if (_pause || !_box->isUpdated())
     return;
 
-  auto translation = glm::translate(glm::mat4(1.0f), _box->body->getPosition());
-  auto rotation = glm::mat4_cast(_box->body->getOrientation());
+  // Drawn with the pose taken from the last snapshot of the
+  // simulation.
+  auto translation = glm::translate(glm::mat4(1.0f), _box->getDrawnPosition());
+  auto rotation = glm::mat4_cast(_box->getDrawnOrientation());
 
   _model->translate(translation).rotate(rotation);
 }
 
-void ft::RigidBoxComponent::backwardUpdate(float duration) {
-  (void)duration;
-
-  _box->setState(_model->getCentroid(),
-                 glm::quat_cast(_model->getState().rotation), _box->halfSize,
-                 {0.0f, 1.0f, 0.0f});
+void ft::RigidBoxComponent::backwardUpdate(RigidBodyApplication &physics) {
+  // The model is read now, the body is set by the simulation between
+  // two steps.
+  glm::vec3 position = _model->getCentroid();
+  glm::quat orientation = glm::quat_cast(_model->getState().rotation);
+  physics.enqueue([object = _box, position, orientation]() {
+    object->setState(position, orientation, object->halfSize,
+                     {0.0f, 1.0f, 0.0f});
+  });
 }
 
 void ft::RigidBoxComponent::setPause(bool pause) { _pause = pause; }
@@ -46,19 +51,21 @@ void ft::RigidBallComponent::update(float duration) {
   if (_pause || !_ball->isUpdated())
     return;
 
-  auto translation =
-      glm::translate(glm::mat4(1.0f), _ball->body->getPosition());
-  auto rotation = glm::mat4_cast(_ball->body->getOrientation());
+  auto translation = glm::translate(glm::mat4(1.0f), _ball->getDrawnPosition());
+  auto rotation = glm::mat4_cast(_ball->getDrawnOrientation());
 
   _model->translate(translation).rotate(rotation);
 }
 
-void ft::RigidBallComponent::backwardUpdate(float duration) {
-  (void)duration;
-
-  _ball->setState(_model->getCentroid(),
-                  glm::quat_cast(_model->getState().rotation), _ball->radius,
-                  {0.0f, 1.0f, 0.0f});
+void ft::RigidBallComponent::backwardUpdate(RigidBodyApplication &physics) {
+  // The model is read now, the body is set by the simulation between
+  // two steps.
+  glm::vec3 position = _model->getCentroid();
+  glm::quat orientation = glm::quat_cast(_model->getState().rotation);
+  physics.enqueue([object = _ball, position, orientation]() {
+    object->setState(position, orientation, object->radius,
+                     {0.0f, 1.0f, 0.0f});
+  });
 }
 
 void ft::RigidBallComponent::setPause(bool pause) { _pause = pause; }
@@ -1,18 +1,37 @@
 #include "../includes/ft_rigidObject.h"
 #include <glm/fwd.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 /*********************************RigidBall***************************/
 
 void ft::RigidBall::setState(const glm::vec3 &position,
                              const glm::quat &orientation, const float radius,
                              const glm::vec3 &velocity) {
+  _startPosition = position;
+  _startOrientation = orientation;
+  _startVelocity = velocity;
+  RigidBall::radius = radius;
+  if (body)
+    applyState();
+}
 
-  body->setPosition(position);
-  body->setOrientation(orientation);
-  body->setVelocity(velocity);
-  body->setRotation(glm::vec3(0.0f));
+void ft::RigidBall::createBody() {
+  if (body)
+    return;
+  body = new ft::RigidBody;
+  applyState();
+}
 
-  RigidBall::radius = radius;
+void ft::RigidBall::destroyBody() {
+  delete body;
+  body = nullptr;
+}
+
+void ft::RigidBall::applyState() {
+  body->setPosition(_startPosition);
+  body->setOrientation(_startOrientation);
+  body->setVelocity(_startVelocity);
+  body->setRotation(glm::vec3(0.0f));
 
   real_t mass = 4.0f * 0.3333f * 3.1415f * radius * radius * radius;
   body->setMass(mass);
@@ -30,6 +49,18 @@ void ft::RigidBall::setState(const glm::vec3 &position,
   body->setAwake();
 
   body->calculateDerivedData();
+  savePreviousState();
+}
+
+void ft::RigidBall::savePreviousState() {
+  _previousPosition = body->getPosition();
+  _previousOrientation = body->getOrientation();
+}
+
+void ft::RigidBall::setDrawnPose(const glm::vec3 &position,
+                                 const glm::quat &orientation) {
+  _drawnPosition = position;
+  _drawnOrientation = orientation;
 }
 
 glm::mat3 ft::RigidBall::getMatrixFromInertiaTensor(float ix, float iy,
@@ -57,12 +88,31 @@ void ft::RigidBox::setState(const glm::vec3 &position,
                             const glm::quat &orientation,
                             const glm::vec3 &extent,
                             const glm::vec3 &velocity) {
+  _startPosition = position;
+  _startOrientation = orientation;
+  _startVelocity = velocity;
+  halfSize = extent;
+  if (body)
+    applyState();
+}
+
+void ft::RigidBox::createBody() {
+  if (body)
+    return;
+  body = new RigidBody;
+  applyState();
+}
+
+void ft::RigidBox::destroyBody() {
+  delete body;
+  body = nullptr;
+}
 
-  body->setPosition(position);
-  body->setOrientation(orientation);
-  body->setVelocity(velocity);
+void ft::RigidBox::applyState() {
+  body->setPosition(_startPosition);
+  body->setOrientation(_startOrientation);
+  body->setVelocity(_startVelocity);
   body->setRotation(glm::vec3(0, 0, 0));
-  halfSize = extent;
 
   real_t mass = halfSize.x * halfSize.y * halfSize.z * 8.0f;
   body->setMass(mass);
@@ -83,6 +133,18 @@ void ft::RigidBox::setState(const glm::vec3 &position,
   body->setAwake();
 
   body->calculateDerivedData();
+  savePreviousState();
+}
+
+void ft::RigidBox::savePreviousState() {
+  _previousPosition = body->getPosition();
+  _previousOrientation = body->getOrientation();
+}
+
+void ft::RigidBox::setDrawnPose(const glm::vec3 &position,
+                                const glm::quat &orientation) {
+  _drawnPosition = position;
+  _drawnOrientation = orientation;
 }
 
 glm::mat3 ft::RigidBox::getMatrixFromInertiaTensor(float ix, float iy, float iz,
@@ -0,0 +1,260 @@
+#include "../includes/ft_simScene.h"
+#include "ft_random.h"
+#include <cmath>
+#include <fstream>
+#include <glm/gtc/quaternion.hpp>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+
+static glm::vec3 _readVec3(const nlohmann::json &data) {
+  return {data[0], data[1], data[2]};
+}
+
+ft::SimScene ft::SimScene::load(const std::string &path) {
+  std::ifstream file(path);
+  if (!file)
+    throw std::runtime_error("Could not load " + path +
+                             ", make sure the file exists and is readable!");
+
+  nlohmann::json jsonData;
+  file >> jsonData;
+  file.close();
+
+  SimScene scene;
+
+  if (jsonData.contains("physics")) {
+    auto &physics = jsonData["physics"];
+    if (physics.contains("timeStep"))
+      scene.timeStep = physics["timeStep"];
+    if (physics.contains("maxSubsteps"))
+      scene.maxSubsteps = physics["maxSubsteps"];
+    if (scene.timeStep <= 0)
+      throw std::runtime_error("the physics time step must be positive !");
+    if (scene.maxSubsteps == 0)
+      throw std::runtime_error("the physics needs at least one substep !");
+  }
+
+  if (!jsonData.contains("rigidBodies") ||
+      !jsonData["rigidBodies"].contains("objects"))
+    throw std::runtime_error(path + " has no rigid bodies !");
+  auto &rigidBodies = jsonData["rigidBodies"];
+
+  if (rigidBodies.contains("planes")) {
+    for (auto &p : rigidBodies["planes"]) {
+      CollisionPlane plane;
+      plane.direction = glm::normalize(_readVec3(p["direction"]));
+      plane.offset = p.value("offset", 0.0f);
+      scene.planes.push_back(plane);
+    }
+  }
+
+  for (auto &object : rigidBodies["objects"]) {
+    Body body;
+
+    std::string type = object["type"];
+    if (type == "box")
+      body.shape = Body::Shape::BOX;
+    else if (type == "ball")
+      body.shape = Body::Shape::BALL;
+    else
+      throw std::runtime_error("unknown rigid body type " + type + " !");
+
+    body.position = _readVec3(object["position"]);
+    if (object.contains("rotation")) {
+      auto &r = object["rotation"];
+      float angle = r[0];
+      glm::vec3 axis = {r[1], r[2], r[3]};
+      if (glm::length(axis) > 0.0f)
+        body.orientation =
+            glm::angleAxis(glm::radians(angle), glm::normalize(axis));
+    }
+    if (object.contains("extents"))
+      body.extents = _readVec3(object["extents"]);
+    if (object.contains("radius"))
+      body.extents.x = object["radius"];
+    if (object.contains("velocity"))
+      body.velocity = _readVec3(object["velocity"]);
+
+    scene.bodies.push_back(body);
+  }
+
+  return scene;
+}
+
+ft::SimScene ft::SimScene::generate(uint32_t count, unsigned seed) {
+  SimScene scene;
+
+  // Columns on a square grid, about as many layers high as the grid
+  // is wide; every fourth body is a ball.
+  ft::Random random(seed);
+  uint32_t side = std::max(1u, (uint32_t)std::cbrt((double)count));
+  scene.bodies.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t column = i % (side * side);
+    uint32_t layer = i / (side * side);
+
+    Body body;
+    body.shape = i % 4 == 3 ? Body::Shape::BALL : Body::Shape::BOX;
+    body.position = glm::vec3((real_t)(column % side) * 1.5f,
+                              1.0f + (real_t)layer * 1.5f,
+                              (real_t)(column / side) * 1.5f);
+    body.position += random.randomXZVector(0.2f);
+    body.orientation = random.randomQuaternion();
+    body.extents = glm::vec3(0.5f);
+    scene.bodies.push_back(body);
+  }
+
+  return scene;
+}
+
+// The layouts of generate, each adding count bodies to the scene.
+
+static void _pyramid(ft::SimScene &scene, uint32_t count) {
+  // the smallest base that holds count boxes, filled from the bottom
+  uint32_t base = 1;
+  for (uint32_t total = 1; total < count; total += base * base)
+    ++base;
+
+  uint32_t made = 0;
+  for (uint32_t layer = 0; layer < base && made < count; ++layer) {
+    uint32_t side = base - layer;
+    real_t corner = (real_t)layer * 0.5f;
+    for (uint32_t i = 0; i < side * side && made < count; ++i, ++made) {
+      ft::SimScene::Body body;
+      body.position = glm::vec3(corner + (real_t)(i % side),
+                                0.5f + (real_t)layer,
+                                corner + (real_t)(i / side));
+      scene.bodies.push_back(body);
+    }
+  }
+}
+
+static void _ballPit(ft::SimScene &scene, uint32_t count, unsigned seed) {
+  // a pit about as wide as the balls are high once they have settled
+  ft::Random random(seed);
+  uint32_t side = std::max(2u, (uint32_t)std::cbrt((double)count) + 1);
+  real_t width = (real_t)side * 1.1f;
+  scene.planes.push_back({glm::vec3(1.0f, 0.0f, 0.0f), 0.0f});
+  scene.planes.push_back({glm::vec3(-1.0f, 0.0f, 0.0f), -width});
+  scene.planes.push_back({glm::vec3(0.0f, 0.0f, 1.0f), 0.0f});
+  scene.planes.push_back({glm::vec3(0.0f, 0.0f, -1.0f), -width});
+
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t cell = i % (side * side);
+    uint32_t layer = i / (side * side);
+    ft::SimScene::Body body;
+    body.shape = ft::SimScene::Body::Shape::BALL;
+    body.position = glm::vec3(0.55f + (real_t)(cell % side) * 1.1f,
+                              1.0f + (real_t)layer * 1.2f,
+                              0.55f + (real_t)(cell / side) * 1.1f);
+    body.position += random.randomXZVector(0.04f);
+    body.extents = glm::vec3(0.5f);
+    scene.bodies.push_back(body);
+  }
+}
+
+static void _smallPiles(ft::SimScene &scene, uint32_t count, unsigned seed) {
+  ft::Random random(seed);
+  uint32_t piles = (count + 4) / 5;
+  uint32_t side = std::max(1u, (uint32_t)std::ceil(std::sqrt((double)piles)));
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t pile = i / 5;
+    uint32_t level = i % 5;
+    ft::SimScene::Body body;
+    body.position = glm::vec3((real_t)(pile % side) * 4.0f,
+                              0.5f + (real_t)level * 1.05f,
+                              (real_t)(pile / side) * 4.0f);
+    body.position += random.randomXZVector(0.1f);
+    scene.bodies.push_back(body);
+  }
+}
+
+static void _dominoes(ft::SimScene &scene, uint32_t count) {
+  constexpr uint32_t ROW = 100;
+  glm::quat tipped = glm::angleAxis(glm::radians(-20.0f),
+                                    glm::vec3(0.0f, 0.0f, 1.0f));
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t row = i / ROW;
+    uint32_t place = i % ROW;
+    ft::SimScene::Body body;
+    body.position =
+        glm::vec3((real_t)place * 1.2f, 1.0f, (real_t)row * 3.0f);
+    body.extents = glm::vec3(0.1f, 1.0f, 0.5f);
+    if (place == 0) {
+      body.position += glm::vec3(0.3f, 0.05f, 0.0f);
+      body.orientation = tipped;
+    }
+    scene.bodies.push_back(body);
+  }
+}
+
+static void _boxRain(ft::SimScene &scene, uint32_t count, unsigned seed) {
+  // a hundred boxes a layer, the layers far enough apart that they
+  // land one after the other
+  ft::Random random(seed);
+  real_t width = std::max(4.0f, std::sqrt((real_t)count) * 1.5f);
+  for (uint32_t i = 0; i < count; ++i) {
+    ft::SimScene::Body body;
+    body.position =
+        glm::vec3(random.randomReal(0.0f, width),
+                  5.0f + (real_t)(i / 100) * 3.0f + random.randomReal(1.0f),
+                  random.randomReal(0.0f, width));
+    body.orientation = random.randomQuaternion();
+    body.velocity = glm::vec3(0.0f, -5.0f, 0.0f);
+    scene.bodies.push_back(body);
+  }
+}
+
+ft::SimScene ft::SimScene::generate(const std::string &layout,
+                                    uint32_t count, unsigned seed) {
+  if (layout == "pile")
+    return generate(count, seed);
+
+  SimScene scene;
+  scene.bodies.reserve(count);
+  if (layout == "pyramid")
+    _pyramid(scene, count);
+  else if (layout == "pit")
+    _ballPit(scene, count, seed);
+  else if (layout == "piles")
+    _smallPiles(scene, count, seed);
+  else if (layout == "dominoes")
+    _dominoes(scene, count);
+  else if (layout == "rain")
+    _boxRain(scene, count, seed);
+  else
+    throw std::runtime_error("unknown scene layout " + layout + " !");
+  return scene;
+}
+
+const std::vector<std::string> &ft::SimScene::getLayouts() {
+  static const std::vector<std::string> layouts = {
+      "pile", "pyramid", "pit", "piles", "dominoes", "rain"};
+  return layouts;
+}
+
+void ft::SimScene::build(SimpleRigidApplication &app,
+                         std::vector<RigidBox::pointer> &boxes,
+                         std::vector<RigidBall::pointer> &balls) const {
+  app.setTimeStep(timeStep);
+  app.setMaxSubsteps(maxSubsteps);
+
+  for (auto &plane : planes)
+    app.addCollisionPlane(std::make_shared<CollisionPlane>(plane));
+
+  for (auto &body : bodies) {
+    if (body.shape == Body::Shape::BOX) {
+      auto box = std::make_shared<RigidBox>();
+      box->setState(body.position, body.orientation, body.extents,
+                    body.velocity);
+      app.addRigidBox(box);
+      boxes.push_back(box);
+    } else {
+      auto ball = std::make_shared<RigidBall>();
+      ball->setState(body.position, body.orientation, body.extents.x,
+                     body.velocity);
+      app.addRigidBall(ball);
+      balls.push_back(ball);
+    }
+  }
+}
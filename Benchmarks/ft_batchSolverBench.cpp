@@ -0,0 +1,192 @@
+/**
+ * Measures the batched sequential impulse solver on a single large
+ * island: a pyramid of 18 layers, 2109 boxes, resting on the ground.
+ * Island level parallelism can't do anything for it.
+ *
+ * The pyramid is solved without batching on one worker, then with
+ * batching on 1, 2, 4 and 8 workers (the pool has one thread less,
+ * the calling thread being a worker too). It reports the mean time
+ * of a solve, the speed up over the batched solve on one worker, the
+ * number of batches and the height of the pyramid at the end.
+ *
+ * Returns a non zero exit code if the batched runs don't all end with
+ * the boxes in the very same places, or if the pyramid falls.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr unsigned LAYERS = 18;
+constexpr unsigned FRAMES = 60;
+constexpr real_t DURATION = 1.0f / 60.0f;
+
+struct Result {
+  double solveMs;
+  unsigned batches;
+  real_t height;
+  std::vector<glm::vec3> positions;
+};
+
+struct Scene {
+  ft::RigidBodyStore store;
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  std::vector<ft::CollisionBox> boxes;
+  std::vector<glm::vec3> start;
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+  std::vector<ft::Contact> contacts;
+  ft::CollisionData data;
+  ft::CollisionPlane ground;
+  ft::ContactManifoldCache manifolds;
+  ft::IslandBuilder islands;
+};
+
+void makeScene(Scene &scene) {
+  for (unsigned layer = 0; layer < LAYERS; ++layer) {
+    unsigned side = LAYERS - layer;
+    for (unsigned i = 0; i < side * side; ++i)
+      scene.start.push_back(glm::vec3(
+          (real_t)(i % side) * 1.01f + 0.505f * (real_t)layer,
+          0.5f + (real_t)layer,
+          (real_t)(i / side) * 1.01f + 0.505f * (real_t)layer));
+  }
+
+  unsigned count = (unsigned)scene.start.size();
+  scene.boxes.resize(count);
+  for (unsigned i = 0; i < count; ++i) {
+    auto body = std::make_unique<ft::RigidBody>(&scene.store);
+    body->setMass(1.0f);
+    body->setInertiaTensor(glm::mat3(1.0f / 6.0f));
+    body->setDamping(0.95f, 0.8f);
+    body->setAcceleration(0, -9.81f, 0);
+    body->setCanSleep(false);
+    scene.boxes[i].body = body.get();
+    scene.boxes[i].halfSize = glm::vec3(0.5f);
+    scene.islands.addBody(body.get());
+    scene.bodies.push_back(std::move(body));
+  }
+
+  // The boxes hardly move: the pairs that can touch are found once.
+  for (unsigned i = 0; i < count; ++i)
+    for (unsigned other = i + 1; other < count; ++other)
+      if (glm::length(scene.start[i] - scene.start[other]) < 1.8f)
+        scene.pairs.push_back({i, other});
+
+  scene.contacts.resize(count * 24);
+  scene.data.contactArray = scene.contacts.data();
+  scene.data.friction = 0.9f;
+  scene.data.restitution = 0.1f;
+  scene.data.tolerance = 0.01f;
+  scene.ground.direction = glm::vec3(0, 1, 0);
+  scene.ground.offset = 0;
+}
+
+/**
+ * Puts the boxes back in place. The same bodies are used for every
+ * run: the manifolds order the bodies by address, which would change
+ * the order in which the contacts are solved.
+ */
+void resetScene(Scene &scene) {
+  for (unsigned i = 0; i < scene.bodies.size(); ++i) {
+    ft::RigidBody *body = scene.bodies[i].get();
+    body->setPosition(scene.start[i]);
+    body->setOrientation(1, 0, 0, 0);
+    body->setVelocity(0, 0, 0);
+    body->setRotation(0, 0, 0);
+    body->setAwake(true);
+    body->calculateDerivedData();
+    scene.boxes[i].calculateInternals();
+  }
+  scene.manifolds.clear();
+}
+
+void generateContacts(Scene &scene) {
+  ft::CollisionData &data = scene.data;
+  data.reset((unsigned)scene.contacts.size());
+  unsigned bottom = LAYERS * LAYERS;
+  for (unsigned i = 0; i < bottom && data.hasMoreContacts(); ++i)
+    ft::CollisionDetector::boxAndHalfSpace(scene.boxes[i], scene.ground, &data);
+  for (auto &pair : scene.pairs) {
+    if (!data.hasMoreContacts())
+      return;
+    ft::CollisionDetector::boxAndBox(scene.boxes[pair.first],
+                                     scene.boxes[pair.second], &data);
+  }
+}
+
+Result run(Scene *scene, unsigned workers, bool batching) {
+  resetScene(*scene);
+  auto scheduler =
+      workers > 1 ? std::make_shared<ft::Scheduler>(workers - 1) : nullptr;
+  ft::IslandSolver solver(scheduler, workers);
+  ft::SequentialImpulseSolver settings;
+  settings.setBatching(batching);
+  solver.setSolverType(ft::ContactSolverType::SEQUENTIAL_IMPULSE);
+  solver.setSolvers(ft::ContactResolver(1), settings);
+
+  Result result = {0, 0, 0, {}};
+  for (unsigned frame = 0; frame < FRAMES; ++frame) {
+    scene->store.integrateAll(DURATION);
+    for (auto &box : scene->boxes)
+      box.calculateInternals();
+    generateContacts(*scene);
+    unsigned count =
+        scene->manifolds.update(scene->contacts.data(),
+                                scene->data.contactCount,
+                                (unsigned)scene->contacts.size());
+    scene->islands.build(scene->contacts.data(), count);
+
+    ft::bench::Timer timer;
+    solver.solve(scene->islands, scene->contacts.data(), DURATION);
+    result.solveMs += timer.elapsedMs();
+    scene->manifolds.storeImpulses(scene->contacts.data());
+  }
+  result.solveMs /= FRAMES;
+  result.batches = solver.getBatchCount(0);
+  for (auto &body : scene->bodies) {
+    result.positions.push_back(body->getPosition());
+    result.height = std::fmax(result.height, body->getPosition().y + 0.5f);
+  }
+  return result;
+}
+
+void print(const char *name, unsigned workers, const Result &result,
+           double reference) {
+  std::printf("%12s %8u %10.3f %10.2f %8u %8.2f\n", name, workers,
+              result.solveMs, reference / result.solveMs, result.batches,
+              result.height);
+}
+
+} // namespace
+
+int main() {
+  const unsigned workerCounts[] = {1, 2, 4, 8};
+  auto scene = std::make_unique<Scene>();
+  makeScene(*scene);
+  bool ok = true;
+
+  std::printf("pyramid of %zu boxes\n", scene->bodies.size());
+  std::printf("%12s %8s %10s %10s %8s %8s\n", "solver", "workers",
+              "solve ms", "speed up", "batches", "height");
+  Result plain = run(scene.get(), 1, false);
+  Result single = run(scene.get(), 1, true);
+  print("plain", 1, plain, single.solveMs);
+  for (unsigned workers : workerCounts) {
+    Result result = workers == 1 ? single : run(scene.get(), workers, true);
+    print("batched", workers, result, single.solveMs);
+    if (std::memcmp(result.positions.data(), single.positions.data(),
+                    single.positions.size() * sizeof(single.positions[0]))) {
+      std::fprintf(stderr, "%u workers didn't agree with one\n", workers);
+      ok = false;
+    }
+    if (result.height < 0.9f * (real_t)LAYERS) {
+      std::fprintf(stderr, "the pyramid fell to %.2f\n", result.height);
+      ok = false;
+    }
+  }
+  return ok ? 0 : 1;
+}
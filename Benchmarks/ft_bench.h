@@ -0,0 +1,60 @@
+/**
+ * @file
+ *
+ * Small helpers shared by the benchmark executables: a wall clock
+ * timer and a function that runs a piece of code several times and
+ * reports the mean time of one run.
+ */
+#ifndef FT_BENCH_H
+#define FT_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+namespace ft {
+namespace bench {
+
+/**
+ * Measures the wall clock time elapsed since its creation.
+ */
+class Timer {
+public:
+  Timer() : _start(std::chrono::steady_clock::now()) {}
+
+  void reset() { _start = std::chrono::steady_clock::now(); }
+
+  /**
+   * Returns the elapsed time in milliseconds.
+   */
+  double elapsedMs() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - _start)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point _start;
+};
+
+/**
+ * Runs the given function once to warm up, then as many times as
+ * needed to spend at least minMs milliseconds (and at least
+ * minRuns times). Returns the mean time of one run in milliseconds.
+ */
+inline double measureMs(const std::function<void()> &fn, double minMs = 200.0,
+                        unsigned minRuns = 3) {
+  fn();
+  unsigned runs = 0;
+  Timer timer;
+  while (runs < minRuns || timer.elapsedMs() < minMs) {
+    fn();
+    ++runs;
+  }
+  return timer.elapsedMs() / runs;
+}
+
+} // namespace bench
+} // namespace ft
+
+#endif // FT_BENCH_H
@@ -0,0 +1,143 @@
+/**
+ * Measures the batched integration of a RigidBodyStore against
+ * integrating the same bodies one at a time through their RigidBody
+ * views, and checks that both give exactly the same state. The batch
+ * is run with the scalar instruction set, the vectorised ones are
+ * checked by ftSimdIntegrationBench.
+ *
+ * Returns a non zero exit code if the states differ.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const real_t DURATION = 1.0f / 60.0f;
+
+/**
+ * Fills the store with the given number of bodies, in a state that
+ * only depends on the seed. A few bodies are left asleep and a few
+ * are never allowed to sleep.
+ */
+std::vector<std::unique_ptr<ft::RigidBody>>
+makeBodies(ft::RigidBodyStore &store, unsigned count, unsigned seed) {
+  ft::Random random(seed);
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  bodies.reserve(count);
+  for (unsigned i = 0; i < count; ++i) {
+    auto body = std::make_unique<ft::RigidBody>(&store);
+    body->setMass(random.randomReal(0.5f, 4.0f));
+    glm::vec3 extents = random.randomVector(glm::vec3(0.2f, 0.2f, 0.2f),
+                                            glm::vec3(1.0f, 1.0f, 1.0f));
+    body->setInertiaTensor(glm::mat3(extents.x, 0, 0, 0, extents.y, 0, 0, 0,
+                                     extents.z));
+    body->setDamping(0.99f, 0.8f);
+    body->setPosition(random.randomVector(glm::vec3(-50, 0, -50),
+                                          glm::vec3(50, 50, 50)));
+    body->setOrientation(random.randomQuaternion());
+    body->setVelocity(random.randomVector(2.0f));
+    body->setRotation(random.randomVector(1.0f));
+    body->setAcceleration(0, -9.81f, 0);
+    body->setCanSleep(i % 7 != 0);
+    body->setAwake(i % 11 != 0);
+    body->calculateDerivedData();
+    bodies.push_back(std::move(body));
+  }
+  return bodies;
+}
+
+/**
+ * Pushes every body around a little, the same way for every store.
+ */
+void applyForces(std::vector<std::unique_ptr<ft::RigidBody>> &bodies,
+                 unsigned frame) {
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    if ((i + frame) % 5 != 0)
+      continue;
+    real_t s = (real_t)((i * 31 + frame) % 17) - 8.0f;
+    bodies[i]->addForce(glm::vec3(s, 0.5f * s, -s));
+    bodies[i]->addTorque(glm::vec3(0.1f * s, 0, 0.2f));
+  }
+}
+
+bool sameArray(const std::vector<real_t> &one,
+               const std::vector<real_t> &two) {
+  return one.size() == two.size() &&
+         std::memcmp(one.data(), two.data(), one.size() * sizeof(real_t)) ==
+             0;
+}
+
+bool sameArray(const ft::Vec3Array &one, const ft::Vec3Array &two) {
+  return sameArray(one.x, two.x) && sameArray(one.y, two.y) &&
+         sameArray(one.z, two.z);
+}
+
+bool sameState(const ft::RigidBodyStore &one, const ft::RigidBodyStore &two) {
+  bool same = one.isAwake == two.isAwake &&
+              sameArray(one.position, two.position) &&
+              sameArray(one.velocity, two.velocity) &&
+              sameArray(one.rotation, two.rotation) &&
+              sameArray(one.motion, two.motion) &&
+              sameArray(one.lastFrameAcceleration, two.lastFrameAcceleration) &&
+              sameArray(one.orientation.w, two.orientation.w) &&
+              sameArray(one.orientation.x, two.orientation.x) &&
+              sameArray(one.orientation.y, two.orientation.y) &&
+              sameArray(one.orientation.z, two.orientation.z);
+  for (int i = 0; i < 9; ++i)
+    same = same && sameArray(one.inverseInertiaTensorWorld.m[i],
+                             two.inverseInertiaTensorWorld.m[i]);
+  for (int i = 0; i < 16; ++i)
+    same = same &&
+           sameArray(one.transformMatrix.m[i], two.transformMatrix.m[i]);
+  return same;
+}
+
+} // namespace
+
+int main() {
+  const unsigned counts[] = {1000, 10000, 100000};
+  const unsigned frames = 120;
+  bool ok = true;
+
+  std::printf("%8s %14s %14s %8s\n", "bodies", "per body ms", "batched ms",
+              "same");
+  for (unsigned count : counts) {
+    ft::RigidBodyStore batchedStore;
+    ft::RigidBodyStore singleStore;
+    batchedStore.setSimdLevel(ft::SimdLevel::SCALAR);
+    auto batched = makeBodies(batchedStore, count, 5);
+    auto single = makeBodies(singleStore, count, 5);
+
+    // Check first, before the timing loops change the state further.
+    for (unsigned frame = 0; frame < frames; ++frame) {
+      applyForces(batched, frame);
+      batchedStore.integrateAll(DURATION);
+
+      applyForces(single, frame);
+      for (auto &body : single)
+        body->integrate(DURATION);
+    }
+    bool same = sameState(batchedStore, singleStore);
+    ok = ok && same;
+
+    // Keep everything awake while timing, so both do the full work.
+    for (unsigned i = 0; i < count; ++i) {
+      batched[i]->setCanSleep(false);
+      single[i]->setCanSleep(false);
+    }
+    double singleMs = ft::bench::measureMs([&]() {
+      for (auto &body : single)
+        body->integrate(DURATION);
+    });
+    double batchedMs = ft::bench::measureMs(
+        [&]() { batchedStore.integrateAll(DURATION); });
+
+    std::printf("%8u %14.3f %14.3f %8s\n", count, singleMs, batchedMs,
+                same ? "yes" : "NO");
+  }
+
+  return ok ? 0 : 1;
+}
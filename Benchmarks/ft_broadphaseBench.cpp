@@ -0,0 +1,95 @@
+/**
+ * Measures how the cost of generating candidate pairs scales with the
+ * number of bodies. The bodies are unit boxes scattered at constant
+ * density, so the number of real overlaps grows linearly with the
+ * body count and any super linear cost is the algorithm's own.
+ *
+ * The legacy column is the loop that SimpleRigidApplication used to
+ * run: every body against every other body, each pair seen twice.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cmath>
+#include <vector>
+
+namespace {
+
+std::vector<ft::BoundingBox> makeBoxes(unsigned count, unsigned seed) {
+  ft::Random random(seed);
+  // about 8 cubic units of space per unit box
+  real_t side = std::cbrt((real_t)count * 8.0f);
+  std::vector<ft::BoundingBox> boxes;
+  boxes.reserve(count);
+  for (unsigned i = 0; i < count; ++i) {
+    glm::vec3 centre = random.randomVector(glm::vec3(0, 0, 0),
+                                           glm::vec3(side, side, side));
+    glm::vec3 half(0.5f, 0.5f, 0.5f);
+    boxes.emplace_back(centre - half, centre + half);
+  }
+  return boxes;
+}
+
+unsigned legacyPairs(const std::vector<ft::BoundingBox> &boxes) {
+  unsigned tests = 0;
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    for (size_t j = 0; j < boxes.size(); ++j) {
+      if (i == j)
+        continue;
+      if (boxes[i].overlaps(&boxes[j]))
+        ++tests;
+    }
+  }
+  return tests;
+}
+
+double runBroadphase(ft::Broadphase &broadphase,
+                     const std::vector<ft::BoundingBox> &boxes,
+                     size_t &pairCount) {
+  for (auto &box : boxes)
+    broadphase.createProxy(box);
+  std::vector<ft::BroadphasePair> pairs;
+  double ms = ft::bench::measureMs([&]() { broadphase.findPairs(pairs); });
+  pairCount = pairs.size();
+  return ms;
+}
+
+} // namespace
+
+int main() {
+  const unsigned counts[] = {100, 1000, 10000};
+  int status = 0;
+
+  std::printf("%8s %14s %14s %14s %14s %10s\n", "bodies", "legacy ms",
+              "brute ms", "sweep ms", "tree ms", "pairs");
+  for (unsigned count : counts) {
+    auto boxes = makeBoxes(count, 42);
+
+    unsigned legacy = 0;
+    double legacyMs =
+        ft::bench::measureMs([&]() { legacy = legacyPairs(boxes); });
+
+    ft::BruteForceBroadphase brute;
+    size_t brutePairs = 0;
+    double bruteMs = runBroadphase(brute, boxes, brutePairs);
+
+    ft::SortAndSweepBroadphase sweep;
+    size_t sweepPairs = 0;
+    double sweepMs = runBroadphase(sweep, boxes, sweepPairs);
+
+    ft::AABBTreeBroadphase tree;
+    size_t treePairs = 0;
+    double treeMs = runBroadphase(tree, boxes, treePairs);
+
+    std::printf("%8u %14.4f %14.4f %14.4f %14.4f %10zu\n", count, legacyMs,
+                bruteMs, sweepMs, treeMs, treePairs);
+
+    // the legacy loop reports every pair twice
+    if (brutePairs * 2 != legacy || sweepPairs != brutePairs ||
+        treePairs != brutePairs) {
+      std::fprintf(stderr, "pair mismatch at %u bodies: %u %zu %zu %zu\n",
+                   count, legacy, brutePairs, sweepPairs, treePairs);
+      status = 1;
+    }
+  }
+  return status;
+}
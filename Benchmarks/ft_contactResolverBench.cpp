@@ -0,0 +1,177 @@
+/**
+ * Compares the contact resolver with and without its contact graph on
+ * a stack of 1000 boxes: ten layers of ten by ten boxes resting on the
+ * ground and against each other.
+ *
+ * The same stack is simulated twice, once with each resolver, and the
+ * state of every body is compared after every frame. The graph only
+ * changes which contacts are visited, so the two must stay exactly
+ * the same. Returns a non zero exit code if they differ.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr unsigned SIDE = 10;
+constexpr unsigned LAYERS = 10;
+constexpr unsigned FRAMES = 10;
+constexpr unsigned MAX_CONTACTS = 32 * SIDE * SIDE * LAYERS;
+constexpr real_t DURATION = 1.0f / 60.0f;
+
+struct Stack {
+  ft::RigidBodyStore store;
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  std::vector<ft::CollisionBox> boxes;
+  std::vector<ft::Contact> contacts;
+  ft::CollisionData data;
+  ft::CollisionPlane ground;
+  ft::ContactResolver resolver{1};
+  unsigned contactCount = 0;
+  double resolveMs = 0;
+};
+
+unsigned boxIndex(unsigned x, unsigned y, unsigned z) {
+  return (y * SIDE + z) * SIDE + x;
+}
+
+/**
+ * Builds the stack. The boxes sink a little into the ones below them
+ * and are nudged sideways, so that the first frames have plenty of
+ * contacts to resolve.
+ */
+void makeStack(Stack &stack, bool useContactGraph) {
+  ft::Random random(42);
+  stack.store.setSimdLevel(ft::SimdLevel::SCALAR);
+  stack.boxes.resize(SIDE * SIDE * LAYERS);
+  for (unsigned y = 0; y < LAYERS; ++y)
+    for (unsigned z = 0; z < SIDE; ++z)
+      for (unsigned x = 0; x < SIDE; ++x) {
+        auto body = std::make_unique<ft::RigidBody>(&stack.store);
+        body->setMass(1.0f);
+        body->setInertiaTensor(glm::mat3(1.0f / 6.0f));
+        body->setDamping(0.95f, 0.8f);
+        body->setAcceleration(0, -9.81f, 0);
+        glm::vec3 position((real_t)x, 0.5f + 0.98f * (real_t)y, (real_t)z);
+        body->setPosition(position + random.randomXZVector(0.02f));
+        body->setAwake(true);
+        body->calculateDerivedData();
+
+        ft::CollisionBox &box = stack.boxes[boxIndex(x, y, z)];
+        box.body = body.get();
+        box.halfSize = glm::vec3(0.5f);
+        box.calculateInternals();
+        stack.bodies.push_back(std::move(body));
+      }
+
+  stack.contacts.resize(MAX_CONTACTS);
+  stack.data.contactArray = stack.contacts.data();
+  stack.data.friction = 0.9f;
+  stack.data.restitution = 0.1f;
+  stack.data.tolerance = 0.01f;
+  stack.ground.direction = glm::vec3(0, 1, 0);
+  stack.ground.offset = 0;
+  stack.resolver.setUseContactGraph(useContactGraph);
+}
+
+/**
+ * Tests every box against its neighbours in the grid, and the bottom
+ * layer against the ground.
+ */
+void generateContacts(Stack &stack) {
+  ft::CollisionData &data = stack.data;
+  data.reset(MAX_CONTACTS);
+  for (unsigned y = 0; y < LAYERS; ++y)
+    for (unsigned z = 0; z < SIDE; ++z)
+      for (unsigned x = 0; x < SIDE; ++x) {
+        const ft::CollisionBox &box = stack.boxes[boxIndex(x, y, z)];
+        if (y == 0 && data.hasMoreContacts())
+          ft::CollisionDetector::boxAndHalfSpace(box, stack.ground, &data);
+        for (unsigned other = boxIndex(x, y, z) + 1;
+             other < stack.boxes.size(); ++other) {
+          unsigned ox = other % SIDE, oz = (other / SIDE) % SIDE,
+                   oy = other / (SIDE * SIDE);
+          if (oy > y + 1 || ox + 1 < x || ox > x + 1 || oz + 1 < z ||
+              oz > z + 1)
+            continue;
+          if (!data.hasMoreContacts())
+            return;
+          ft::CollisionDetector::boxAndBox(box, stack.boxes[other], &data);
+        }
+      }
+}
+
+void step(Stack &stack) {
+  stack.store.integrateAll(DURATION);
+  for (auto &box : stack.boxes)
+    box.calculateInternals();
+  generateContacts(stack);
+  stack.contactCount = stack.data.contactCount;
+
+  stack.resolver.setIterations(stack.contactCount * 8);
+  ft::bench::Timer timer;
+  stack.resolver.resolveContacts(stack.contacts.data(), stack.contactCount,
+                                 DURATION);
+  stack.resolveMs += timer.elapsedMs();
+}
+
+bool sameArray(const std::vector<real_t> &one,
+               const std::vector<real_t> &two) {
+  return std::memcmp(one.data(), two.data(), one.size() * sizeof(real_t)) ==
+         0;
+}
+
+bool sameState(const ft::RigidBodyStore &one, const ft::RigidBodyStore &two) {
+  return sameArray(one.position.x, two.position.x) &&
+         sameArray(one.position.y, two.position.y) &&
+         sameArray(one.position.z, two.position.z) &&
+         sameArray(one.orientation.w, two.orientation.w) &&
+         sameArray(one.orientation.x, two.orientation.x) &&
+         sameArray(one.orientation.y, two.orientation.y) &&
+         sameArray(one.orientation.z, two.orientation.z) &&
+         sameArray(one.velocity.x, two.velocity.x) &&
+         sameArray(one.velocity.y, two.velocity.y) &&
+         sameArray(one.velocity.z, two.velocity.z) &&
+         sameArray(one.rotation.x, two.rotation.x) &&
+         sameArray(one.rotation.y, two.rotation.y) &&
+         sameArray(one.rotation.z, two.rotation.z) &&
+         one.isAwake == two.isAwake;
+}
+
+} // namespace
+
+int main() {
+  auto scan = std::make_unique<Stack>();
+  auto graph = std::make_unique<Stack>();
+  makeStack(*scan, false);
+  makeStack(*graph, true);
+
+  bool ok = true;
+  std::printf("%6s %9s %11s %11s %11s %11s %6s\n", "frame", "contacts",
+              "position it", "velocity it", "scan ms", "graph ms", "same");
+  for (unsigned frame = 0; frame < FRAMES; ++frame) {
+    double scanBefore = scan->resolveMs, graphBefore = graph->resolveMs;
+    step(*scan);
+    step(*graph);
+
+    bool same = scan->contactCount == graph->contactCount &&
+                scan->resolver._positionIterationsUsed ==
+                    graph->resolver._positionIterationsUsed &&
+                scan->resolver._velocityIterationsUsed ==
+                    graph->resolver._velocityIterationsUsed &&
+                sameState(scan->store, graph->store);
+    ok = ok && same;
+    std::printf("%6u %9u %11u %11u %11.3f %11.3f %6s\n", frame,
+                graph->contactCount, graph->resolver._positionIterationsUsed,
+                graph->resolver._velocityIterationsUsed,
+                scan->resolveMs - scanBefore, graph->resolveMs - graphBefore,
+                same ? "yes" : "NO");
+  }
+  std::printf("mean resolve: scan %.3f ms, graph %.3f ms\n",
+              scan->resolveMs / FRAMES, graph->resolveMs / FRAMES);
+
+  return ok ? 0 : 1;
+}
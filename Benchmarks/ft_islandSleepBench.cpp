@@ -0,0 +1,139 @@
+/**
+ * Measures what a settled scene costs once its islands are asleep: a
+ * World with a grid of small piles, three boxes each, dropped on the
+ * ground and left to come to rest.
+ *
+ * It reports the mean time of a frame while everything is awake and
+ * once the piles have gone to sleep, then throws one more box on a
+ * single pile. The whole pile has to wake up in the frame the box
+ * hits it, and only that pile. Returns a non zero exit code if the
+ * piles don't go to sleep, or if the wrong bodies wake up.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr unsigned SIDE = 30;
+constexpr unsigned LEVELS = 3;
+constexpr unsigned FRAMES = 1200;
+constexpr real_t SPACING = 3.0f;
+constexpr real_t DURATION = 1.0f / 60.0f;
+
+struct Scene {
+  ft::RigidBodyStore store;
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  std::vector<std::unique_ptr<ft::CollisionBox>> boxes;
+  ft::CollisionPlane ground;
+  ft::World world{SIDE * SIDE * LEVELS * 16, 0};
+};
+
+ft::RigidBody *addBox(Scene &scene, const glm::vec3 &position) {
+  auto body = std::make_unique<ft::RigidBody>(&scene.store);
+  body->setMass(1.0f);
+  body->setInertiaTensor(glm::mat3(1.0f / 6.0f));
+  body->setDamping(0.95f, 0.8f);
+  body->setAcceleration(0, -9.81f, 0);
+  body->setPosition(position);
+  body->setAwake(true);
+  body->calculateDerivedData();
+
+  auto box = std::make_unique<ft::CollisionBox>();
+  box->body = body.get();
+  box->halfSize = glm::vec3(0.5f);
+  scene.world.addBody(body.get());
+  scene.world.addPrimitive(box.get());
+
+  ft::RigidBody *raw = body.get();
+  scene.bodies.push_back(std::move(body));
+  scene.boxes.push_back(std::move(box));
+  return raw;
+}
+
+void makeScene(Scene &scene) {
+  scene.world.setSolverType(ft::ContactSolverType::SEQUENTIAL_IMPULSE);
+  scene.ground.direction = glm::vec3(0, 1, 0);
+  scene.ground.offset = 0;
+  scene.world.addPlane(&scene.ground);
+  for (unsigned pile = 0; pile < SIDE * SIDE; ++pile)
+    for (unsigned level = 0; level < LEVELS; ++level)
+      addBox(scene, glm::vec3((real_t)(pile % SIDE) * SPACING,
+                              0.5f + (real_t)level,
+                              (real_t)(pile / SIDE) * SPACING));
+}
+
+/**
+ * Runs the given number of frames, returning the mean time of one.
+ */
+double step(Scene &scene, unsigned frames) {
+  ft::bench::Timer timer;
+  for (unsigned frame = 0; frame < frames; ++frame) {
+    scene.world.startFrame();
+    scene.world.runPhysics(DURATION);
+  }
+  return timer.elapsedMs() / frames;
+}
+
+unsigned countAwake(const Scene &scene, unsigned first, unsigned count) {
+  unsigned awake = 0;
+  for (unsigned i = first; i < first + count; ++i)
+    awake += scene.bodies[i]->getAwake() ? 1 : 0;
+  return awake;
+}
+
+} // namespace
+
+int main() {
+  auto scene = std::make_unique<Scene>();
+  makeScene(*scene);
+  unsigned count = (unsigned)scene->bodies.size();
+  bool ok = true;
+
+  double awakeMs = step(*scene, 30);
+  const ft::IslandBuilder &islands = scene->world.getIslands();
+  unsigned settled = 30;
+  while (islands.getAwakeCount() != 0 && settled < FRAMES) {
+    step(*scene, 1);
+    ++settled;
+  }
+  double asleepMs = step(*scene, 30);
+  std::printf("%u boxes in %u piles\n", count, SIDE * SIDE);
+  std::printf("awake:   %8.3f ms per frame\n", awakeMs);
+  std::printf("asleep after %u frames\n", settled);
+  std::printf("settled: %8.3f ms per frame, %u awake, %u asleep\n", asleepMs,
+              islands.getAwakeCount(), islands.getAsleepCount());
+  if (countAwake(*scene, 0, count) != 0) {
+    std::fprintf(stderr, "the piles didn't go to sleep\n");
+    ok = false;
+  }
+
+  // Throw a box on the first pile, and step until it lands.
+  ft::RigidBody *thrown =
+      addBox(*scene, glm::vec3(0.0f, (real_t)LEVELS + 1.5f, 0.0f));
+  thrown->setVelocity(0, -5.0f, 0);
+  unsigned frame = 0;
+  while (countAwake(*scene, 0, LEVELS) == 0 && frame < FRAMES) {
+    step(*scene, 1);
+    ++frame;
+  }
+  unsigned pileAwake = countAwake(*scene, 0, LEVELS);
+  unsigned othersAwake = countAwake(*scene, LEVELS, count - LEVELS);
+  std::printf("hit after %u frames: %u of %u pile boxes awake, %u others\n",
+              frame, pileAwake, LEVELS, othersAwake);
+  if (pileAwake != LEVELS || othersAwake != 0) {
+    std::fprintf(stderr, "the wrong bodies woke up\n");
+    ok = false;
+  }
+
+  for (frame = 0; islands.getAwakeCount() != 0 && frame < FRAMES; ++frame)
+    step(*scene, 1);
+  std::printf("after:   %u awake, %u asleep\n", islands.getAwakeCount(),
+              islands.getAsleepCount());
+  if (islands.getAwakeCount() != 0) {
+    std::fprintf(stderr, "the pile didn't go back to sleep\n");
+    ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+/**
+ * Measures how the solving of the islands scales with the number of
+ * workers, on a scene made of many separate piles: 24 by 24 piles of
+ * five boxes, resting on the ground and never going to sleep, solved
+ * with the sequential impulse solver.
+ *
+ * The contacts are found the same way for every run, and only the
+ * time spent in IslandSolver::solve is measured. It reports the mean
+ * time of a solve and the speed up over a single worker, for 1, 2, 4
+ * and 8 workers (the pool has one thread less, the calling thread
+ * being a worker too), along with the number of islands the busiest
+ * worker solved in the last frame.
+ *
+ * Returns a non zero exit code if the boxes don't end up in the very
+ * same places whatever the number of workers.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr unsigned SIDE = 24;
+constexpr unsigned LEVELS = 5;
+constexpr unsigned FRAMES = 120;
+constexpr real_t SPACING = 3.0f;
+constexpr real_t DURATION = 1.0f / 60.0f;
+
+struct Result {
+  double solveMs;
+  unsigned busiest;
+  std::vector<glm::vec3> positions;
+};
+
+struct Scene {
+  ft::RigidBodyStore store;
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  std::vector<ft::CollisionBox> boxes;
+  std::vector<ft::Contact> contacts;
+  ft::CollisionData data;
+  ft::CollisionPlane ground;
+  ft::ContactManifoldCache manifolds;
+  ft::IslandBuilder islands;
+};
+
+void makeScene(Scene &scene) {
+  unsigned count = SIDE * SIDE * LEVELS;
+  scene.boxes.resize(count);
+  for (unsigned i = 0; i < count; ++i) {
+    auto body = std::make_unique<ft::RigidBody>(&scene.store);
+    body->setMass(1.0f);
+    body->setInertiaTensor(glm::mat3(1.0f / 6.0f));
+    body->setDamping(0.95f, 0.8f);
+    body->setAcceleration(0, -9.81f, 0);
+    body->setCanSleep(false);
+    scene.boxes[i].body = body.get();
+    scene.boxes[i].halfSize = glm::vec3(0.5f);
+    scene.islands.addBody(body.get());
+    scene.bodies.push_back(std::move(body));
+  }
+
+  scene.contacts.resize(count * 16);
+  scene.data.contactArray = scene.contacts.data();
+  scene.data.friction = 0.9f;
+  scene.data.restitution = 0.1f;
+  scene.data.tolerance = 0.01f;
+  scene.ground.direction = glm::vec3(0, 1, 0);
+  scene.ground.offset = 0;
+}
+
+/**
+ * Puts the boxes back in their piles. The same bodies are used for
+ * every run: the manifolds order the bodies by address, which would
+ * change the order in which the contacts are solved.
+ */
+void resetScene(Scene &scene) {
+  for (unsigned i = 0; i < scene.bodies.size(); ++i) {
+    unsigned pile = i / LEVELS, level = i % LEVELS;
+    ft::RigidBody *body = scene.bodies[i].get();
+    body->setPosition((real_t)(pile % SIDE) * SPACING, 0.5f + (real_t)level,
+                      (real_t)(pile / SIDE) * SPACING);
+    body->setOrientation(1, 0, 0, 0);
+    body->setVelocity(0, 0, 0);
+    body->setRotation(0, 0, 0);
+    body->setAwake(true);
+    body->calculateDerivedData();
+    scene.boxes[i].calculateInternals();
+  }
+  scene.manifolds.clear();
+}
+
+/**
+ * Tests each box against the ground and the boxes above it in its
+ * pile.
+ */
+void generateContacts(Scene &scene) {
+  ft::CollisionData &data = scene.data;
+  data.reset((unsigned)scene.contacts.size());
+  for (unsigned i = 0; i < scene.boxes.size(); ++i) {
+    if (!data.hasMoreContacts())
+      return;
+    ft::CollisionDetector::boxAndHalfSpace(scene.boxes[i], scene.ground, &data);
+    unsigned top = (i / LEVELS + 1) * LEVELS;
+    for (unsigned other = i + 1; other < top && data.hasMoreContacts();
+         ++other)
+      ft::CollisionDetector::boxAndBox(scene.boxes[i], scene.boxes[other],
+                                       &data);
+  }
+}
+
+Result run(Scene *scene, unsigned workers) {
+  resetScene(*scene);
+  auto scheduler =
+      workers > 1 ? std::make_shared<ft::Scheduler>(workers - 1) : nullptr;
+  ft::IslandSolver solver(scheduler, workers);
+  solver.setSolverType(ft::ContactSolverType::SEQUENTIAL_IMPULSE);
+
+  Result result = {0, 0, {}};
+  for (unsigned frame = 0; frame < FRAMES; ++frame) {
+    scene->store.integrateAll(DURATION);
+    for (auto &box : scene->boxes)
+      box.calculateInternals();
+    generateContacts(*scene);
+    unsigned count =
+        scene->manifolds.update(scene->contacts.data(),
+                                scene->data.contactCount,
+                                (unsigned)scene->contacts.size());
+    scene->islands.build(scene->contacts.data(), count);
+
+    ft::bench::Timer timer;
+    solver.solve(scene->islands, scene->contacts.data(), DURATION);
+    result.solveMs += timer.elapsedMs();
+    scene->manifolds.storeImpulses(scene->contacts.data());
+  }
+  result.solveMs /= FRAMES;
+  for (unsigned worker = 0; worker < solver.getWorkerCount(); ++worker)
+    result.busiest = std::max(result.busiest, solver.getIslandsSolved(worker));
+  for (auto &body : scene->bodies)
+    result.positions.push_back(body->getPosition());
+  return result;
+}
+
+} // namespace
+
+int main() {
+  const unsigned workerCounts[] = {1, 2, 4, 8};
+  bool same = true;
+
+  std::printf("%u piles of %u boxes\n", SIDE * SIDE, LEVELS);
+  std::printf("%8s %10s %10s %10s\n", "workers", "solve ms", "speed up",
+              "busiest");
+  auto scene = std::make_unique<Scene>();
+  makeScene(*scene);
+  Result single = run(scene.get(), 1);
+  for (unsigned workers : workerCounts) {
+    Result result = workers == 1 ? single : run(scene.get(), workers);
+    std::printf("%8u %10.3f %10.2f %10u\n", workers, result.solveMs,
+                single.solveMs / result.solveMs, result.busiest);
+    same = same && std::memcmp(result.positions.data(),
+                               single.positions.data(),
+                               single.positions.size() *
+                                   sizeof(single.positions[0])) == 0;
+  }
+
+  if (!same)
+    std::fprintf(stderr, "the workers didn't agree on the result\n");
+  return same ? 0 : 1;
+}
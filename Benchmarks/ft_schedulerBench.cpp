@@ -0,0 +1,191 @@
+/**
+ * Compares the work-stealing Scheduler with a thread pool sharing one
+ * locked queue, the way the engine ran its tasks before, on batches
+ * of tasks of about 1, 10 and 100 microseconds of work each, the same
+ * total amount of work for each size.
+ *
+ * The pool gets one addTask per task and waits on the futures.
+ * The Scheduler is given the same tasks one submit at a time, then as
+ * a parallelFor with one index per chunk. For each it reports the
+ * time of the batch, the time per task and the speed up over running
+ * the tasks in a loop.
+ *
+ * Each task writes the result of its work to its own slot. Returns a
+ * non zero exit code if any run leaves a result different from the
+ * loop's.
+ */
+#include "ft_bench.h"
+#include "ft_scheduler.h"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t THREADS = 4;
+constexpr double TOTAL_US = 40000.0;
+
+/**
+ * The pool the Scheduler replaced: every task is allocated, queued
+ * under a single lock, and hands its end over through a future.
+ */
+class QueuePool {
+public:
+  explicit QueuePool(uint32_t threadCount) {
+    for (uint32_t i = 0; i < threadCount; ++i)
+      _threads.emplace_back([this]() { work(); });
+  }
+
+  ~QueuePool() {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _condition.notify_all();
+    for (auto &thread : _threads)
+      thread.join();
+  }
+
+  template <typename F> std::future<void> addTask(F &&f) {
+    auto task =
+        std::make_shared<std::packaged_task<void()>>(std::forward<F>(f));
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _queue.push([task]() { (*task)(); });
+    }
+    _condition.notify_one();
+    return task->get_future();
+  }
+
+private:
+  void work() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;) {
+      _condition.wait(lock, [this]() { return _stop || !_queue.empty(); });
+      if (_queue.empty())
+        return;
+      std::function<void()> task = std::move(_queue.front());
+      _queue.pop();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex _mutex;
+  std::condition_variable _condition;
+  std::queue<std::function<void()>> _queue;
+  std::vector<std::thread> _threads;
+  bool _stop = false;
+};
+
+/**
+ * Stands for the work of a task: a chain of xorshift steps.
+ */
+uint32_t spin(uint32_t seed, uint32_t iterations) {
+  uint32_t x = seed | 1;
+  for (uint32_t i = 0; i < iterations; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+  }
+  return x;
+}
+
+/**
+ * Returns the number of spin iterations taking about a microsecond.
+ */
+uint32_t calibrate() {
+  constexpr uint32_t ITERATIONS = 1 << 22;
+  volatile uint32_t sink = 0;
+  double ms = ft::bench::measureMs(
+      [&sink]() { sink = sink + spin(sink, ITERATIONS); }, 100.0);
+  return std::max((uint32_t)1, (uint32_t)(ITERATIONS / (ms * 1000.0)));
+}
+
+struct Batch {
+  uint32_t count;
+  uint32_t iterations;
+  std::vector<uint32_t> results;
+
+  void run(uint32_t i) { results[i] = spin(i, iterations); }
+};
+
+bool print(const char *runner, double taskUs, const Batch &batch, double ms,
+           double serialMs, const std::vector<uint32_t> &expected) {
+  std::printf("%8.0f %7u %14s %10.3f %12.3f %8.2f\n", taskUs, batch.count,
+              runner, ms, ms * 1000.0 / batch.count, serialMs / ms);
+  if (batch.results == expected)
+    return true;
+  std::fprintf(stderr, "%s: wrong results for %.0f us tasks\n", runner,
+               taskUs);
+  return false;
+}
+
+} // namespace
+
+int main() {
+  uint32_t perUs = calibrate();
+  QueuePool pool(THREADS);
+  ft::Scheduler scheduler(THREADS);
+  bool ok = true;
+
+  std::printf("%u threads, %u iterations per us\n", THREADS, perUs);
+  std::printf("%8s %7s %14s %10s %12s %8s\n", "task us", "tasks", "runner",
+              "ms", "us per task", "speed up");
+  for (double taskUs : {1.0, 10.0, 100.0}) {
+    Batch batch;
+    batch.count = (uint32_t)(TOTAL_US / taskUs);
+    batch.iterations = (uint32_t)(taskUs * perUs);
+    batch.results.assign(batch.count, 0);
+
+    double serialMs = ft::bench::measureMs([&batch]() {
+      for (uint32_t i = 0; i < batch.count; ++i)
+        batch.run(i);
+    });
+    std::vector<uint32_t> expected = batch.results;
+    ok = print("loop", taskUs, batch, serialMs, serialMs, expected) && ok;
+
+    std::vector<std::future<void>> futures;
+    batch.results.assign(batch.count, 0);
+    double ms = ft::bench::measureMs([&]() {
+      futures.clear();
+      for (uint32_t i = 0; i < batch.count; ++i)
+        futures.push_back(pool.addTask([&batch, i]() { batch.run(i); }));
+      for (auto &future : futures)
+        future.get();
+    });
+    ok = print("thread pool", taskUs, batch, ms, serialMs, expected) && ok;
+
+    std::vector<ft::Task> tasks(batch.count);
+    batch.results.assign(batch.count, 0);
+    ms = ft::bench::measureMs([&]() {
+      ft::WaitGroup group;
+      for (uint32_t i = 0; i < batch.count; ++i) {
+        Batch *b = &batch;
+        tasks[i].set([b, i]() { b->run(i); });
+        scheduler.submit(tasks[i], group);
+      }
+      scheduler.wait(group);
+    });
+    ok = print("submit", taskUs, batch, ms, serialMs, expected) && ok;
+
+    batch.results.assign(batch.count, 0);
+    ms = ft::bench::measureMs([&]() {
+      scheduler.parallelFor(0, batch.count, 1,
+                            [&batch](uint32_t first, uint32_t last) {
+                              for (uint32_t i = first; i < last; ++i)
+                                batch.run(i);
+                            });
+    });
+    ok = print("parallel for", taskUs, batch, ms, serialMs, expected) && ok;
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+/**
+ * Compares the broad phases on a settling pile of 5000 unit boxes.
+ *
+ * The motion is scripted rather than simulated, so that every broad
+ * phase sees exactly the same frames and only its own cost is
+ * measured: the boxes fall in columns onto the ground plane, land on
+ * their layer and keep shaking a little while they come to rest,
+ * which is the kind of coherent motion the incremental sweep and
+ * prune is made for.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cmath>
+#include <vector>
+
+namespace {
+
+constexpr unsigned BODIES = 5000;
+constexpr unsigned FRAMES = 300;
+constexpr real_t DURATION = 1.0f / 60.0f;
+
+struct PileBody {
+  glm::vec3 rest;
+  real_t drop;
+  real_t phase;
+};
+
+std::vector<PileBody> makePile() {
+  ft::Random random(1234);
+  std::vector<PileBody> bodies;
+  unsigned side = 25;
+  for (unsigned i = 0; i < BODIES; ++i) {
+    unsigned column = i % (side * side);
+    unsigned layer = i / (side * side);
+    glm::vec3 rest((real_t)(column % side) * 1.02f, 0.5f + (real_t)layer,
+                   (real_t)(column / side) * 1.02f);
+    rest += random.randomXZVector(0.05f);
+    bodies.push_back({rest, random.randomReal(1.0f, 6.0f),
+                      random.randomReal(0.0f, 6.28f)});
+  }
+  return bodies;
+}
+
+/**
+ * Returns the box of the given body at the given frame: free fall
+ * from its drop height, then a damped wobble around its rest place.
+ */
+ft::BoundingBox boxAt(const PileBody &body, unsigned frame) {
+  real_t time = (real_t)frame * DURATION;
+  real_t fallTime = std::sqrt(2.0f * body.drop / 10.0f);
+  glm::vec3 centre = body.rest;
+  if (time < fallTime) {
+    centre.y += body.drop - 5.0f * time * time;
+  } else {
+    real_t t = time - fallTime;
+    real_t amplitude = 0.05f * std::exp(-2.0f * t);
+    centre.x += amplitude * std::sin(7.0f * t + body.phase);
+    centre.y += amplitude * std::fabs(std::sin(11.0f * t + body.phase));
+    centre.z += amplitude * std::cos(5.0f * t + body.phase);
+  }
+  glm::vec3 half(0.5f, 0.5f, 0.5f);
+  return ft::BoundingBox(centre - half, centre + half);
+}
+
+struct Result {
+  double setupMs;
+  double frameMs;
+  double settledMs;
+  double maxFrameMs;
+  size_t pairs;
+};
+
+/**
+ * Every body has landed by then, the frames after it only hold the
+ * boxes coming to rest.
+ */
+constexpr unsigned SETTLED_FRAME = 200;
+
+Result run(ft::Broadphase &broadphase, const std::vector<PileBody> &pile) {
+  Result result = {0, 0, 0, 0, 0};
+  std::vector<uint32_t> proxies;
+  std::vector<ft::BroadphasePair> pairs;
+
+  ft::bench::Timer timer;
+  for (auto &body : pile)
+    proxies.push_back(broadphase.createProxy(boxAt(body, 0)));
+  broadphase.findPairs(pairs);
+  result.setupMs = timer.elapsedMs();
+
+  for (unsigned frame = 1; frame <= FRAMES; ++frame) {
+    timer.reset();
+    for (size_t i = 0; i < pile.size(); ++i)
+      broadphase.moveProxy(proxies[i], boxAt(pile[i], frame));
+    broadphase.findPairs(pairs);
+    double ms = timer.elapsedMs();
+    result.frameMs += ms;
+    if (frame > SETTLED_FRAME)
+      result.settledMs += ms;
+    if (ms > result.maxFrameMs)
+      result.maxFrameMs = ms;
+  }
+  result.frameMs /= FRAMES;
+  result.settledMs /= FRAMES - SETTLED_FRAME;
+  result.pairs = pairs.size();
+  return result;
+}
+
+} // namespace
+
+int main() {
+  auto pile = makePile();
+
+  // The time spent computing the boxes is the same for everyone,
+  // measure it so it can be taken out.
+  double scriptMs = ft::bench::measureMs([&]() {
+    for (unsigned frame = 1; frame <= FRAMES; ++frame)
+      for (auto &body : pile)
+        (void)boxAt(body, frame);
+  });
+  scriptMs /= FRAMES;
+
+  std::printf("%u boxes, %u frames, %.4f ms per frame to script the motion\n",
+              BODIES, FRAMES, scriptMs);
+  std::printf("%18s %12s %12s %12s %12s %10s\n", "broadphase", "setup ms",
+              "frame ms", "settled ms", "max ms", "pairs");
+
+  struct Entry {
+    const char *name;
+    ft::BroadphaseType type;
+  };
+  const Entry entries[] = {{"aabb tree", ft::BroadphaseType::AABB_TREE},
+                           {"sweep and prune",
+                            ft::BroadphaseType::SWEEP_AND_PRUNE},
+                           {"sort and sweep",
+                            ft::BroadphaseType::SORT_AND_SWEEP}};
+
+  size_t expected = 0;
+  int status = 0;
+  for (auto &entry : entries) {
+    auto broadphase = ft::createBroadphase(entry.type);
+    Result result = run(*broadphase, pile);
+    std::printf("%18s %12.4f %12.4f %12.4f %12.4f %10zu\n", entry.name,
+                result.setupMs, result.frameMs - scriptMs,
+                result.settledMs - scriptMs, result.maxFrameMs, result.pairs);
+    if (expected == 0)
+      expected = result.pairs;
+    else if (expected != result.pairs)
+      status = 1;
+  }
+
+  if (status)
+    std::fprintf(stderr, "the broad phases disagree on the pairs\n");
+  return status;
+}
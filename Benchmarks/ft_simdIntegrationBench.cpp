@@ -0,0 +1,184 @@
+/**
+ * Measures RigidBodyStore::integrateAll with every instruction set
+ * the processor supports, and checks the vectorised results against
+ * the scalar ones.
+ *
+ * The check integrates one step from the same state with the scalar
+ * path and with each vectorised one, for several states, and compares
+ * every field with a relative tolerance. The vectorised damping uses
+ * a polynomial instead of std::pow, so the results are not expected
+ * to be bit identical. Returns a non zero exit code if a value is out
+ * of tolerance.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cmath>
+#include <vector>
+
+namespace {
+
+const real_t DURATION = 1.0f / 60.0f;
+const real_t TOLERANCE = 1e-4f;
+
+const char *levelName(ft::SimdLevel level) {
+  switch (level) {
+  case ft::SimdLevel::AVX2:
+    return "avx2";
+  case ft::SimdLevel::SSE:
+    return "sse";
+  default:
+    return "scalar";
+  }
+}
+
+/**
+ * Fills the store with bodies in a random state. Some are asleep and
+ * some have a damping of zero, to go through every branch.
+ */
+void fillStore(ft::RigidBodyStore &store, unsigned count, ft::Random &random) {
+  for (unsigned i = 0; i < count; ++i) {
+    uint32_t h = store.create();
+    store.inverseMass[h] = random.randomReal(0.25f, 2.0f);
+    store.linearDamping[h] = i % 13 == 0 ? 0.0f : random.randomReal(0.5f, 1);
+    store.angularDamping[h] = random.randomReal(0.5f, 1.0f);
+    store.motion[h] = random.randomReal(0.0f, 2.0f);
+    store.position.set(h, random.randomVector(glm::vec3(-50, 0, -50),
+                                            glm::vec3(50, 50, 50)));
+    store.orientation.set(h, random.randomQuaternion());
+    store.velocity.set(h, random.randomVector(i % 3 == 0 ? 0.05f : 3.0f));
+    store.rotation.set(h, random.randomVector(i % 3 == 0 ? 0.05f : 1.0f));
+    glm::vec3 inertia = random.randomVector(glm::vec3(0.5f, 0.5f, 0.5f),
+                                            glm::vec3(2.0f, 2.0f, 2.0f));
+    store.inverseInertiaTensor.set(
+        h, glm::mat3(inertia.x, 0, 0, 0, inertia.y, 0, 0, 0, inertia.z));
+    store.forceAccum.set(h, random.randomVector(5.0f));
+    store.torqueAccum.set(h, random.randomVector(1.0f));
+    store.acceleration.set(h, glm::vec3(0, -9.81f, 0));
+    store.canSleep[h] = i % 7 != 0;
+    store.isAwake[h] = i % 11 != 0;
+    store.calculateDerivedData(h);
+  }
+}
+
+bool close(real_t one, real_t two) {
+  return std::fabs(one - two) <=
+         TOLERANCE * std::fmax((real_t)1, std::fmax(std::fabs(one),
+                                                    std::fabs(two)));
+}
+
+bool close(const glm::vec3 &one, const glm::vec3 &two) {
+  return close(one.x, two.x) && close(one.y, two.y) && close(one.z, two.z);
+}
+
+bool close(const glm::quat &one, const glm::quat &two) {
+  return close(one.w, two.w) && close(one.x, two.x) && close(one.y, two.y) &&
+         close(one.z, two.z);
+}
+
+bool close(const glm::mat3 &one, const glm::mat3 &two) {
+  return close(one[0], two[0]) && close(one[1], two[1]) &&
+         close(one[2], two[2]);
+}
+
+bool close(const glm::mat4 &one, const glm::mat4 &two) {
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 4; ++r)
+      if (!close(one[c][r], two[c][r]))
+        return false;
+  return true;
+}
+
+/**
+ * Returns the number of bodies whose state differs between the two
+ * stores by more than the tolerance.
+ */
+unsigned countMismatches(const ft::RigidBodyStore &one,
+                         const ft::RigidBodyStore &two) {
+  unsigned mismatches = 0;
+  for (uint32_t h = 0; h < one.getCapacity(); ++h) {
+    bool same = one.isAwake[h] == two.isAwake[h] &&
+                close(one.motion[h], two.motion[h]) &&
+                close(one.position.get(h), two.position.get(h)) &&
+                close(one.orientation.get(h), two.orientation.get(h)) &&
+                close(one.velocity.get(h), two.velocity.get(h)) &&
+                close(one.rotation.get(h), two.rotation.get(h)) &&
+                close(one.forceAccum.get(h), two.forceAccum.get(h)) &&
+                close(one.lastFrameAcceleration.get(h),
+                      two.lastFrameAcceleration.get(h)) &&
+                close(one.inverseInertiaTensorWorld.get(h),
+                      two.inverseInertiaTensorWorld.get(h)) &&
+                close(one.transformMatrix.get(h), two.transformMatrix.get(h));
+    if (!same)
+      ++mismatches;
+  }
+  return mismatches;
+}
+
+} // namespace
+
+int main() {
+  const unsigned counts[] = {1000, 10000, 100000};
+  const ft::SimdLevel levels[] = {ft::SimdLevel::SCALAR, ft::SimdLevel::SSE,
+                                  ft::SimdLevel::AVX2};
+  ft::SimdLevel supported = ft::getSupportedSimdLevel();
+  ft::Random random(21);
+  bool ok = true;
+
+  std::printf("supported: %s\n", levelName(supported));
+
+  // Correctness, on a count that leaves a scalar tail.
+  for (unsigned state = 0; state < 8; ++state) {
+    ft::RigidBodyStore reference;
+    reference.setSimdLevel(ft::SimdLevel::SCALAR);
+    fillStore(reference, 1003, random);
+
+    for (ft::SimdLevel level : levels) {
+      if ((int)level > (int)supported || level == ft::SimdLevel::SCALAR)
+        continue;
+      ft::RigidBodyStore store = reference;
+      store.setSimdLevel(level);
+      store.integrateAll(DURATION);
+
+      ft::RigidBodyStore expected = reference;
+      expected.integrateAll(DURATION);
+
+      unsigned mismatches = countMismatches(expected, store);
+      if (mismatches) {
+        std::printf("%s: %u bodies out of tolerance\n", levelName(level),
+                    mismatches);
+        ok = false;
+      }
+    }
+  }
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+
+  std::printf("%8s", "bodies");
+  for (ft::SimdLevel level : levels)
+    std::printf(" %10s ms", levelName(level));
+  std::printf("\n");
+  for (unsigned count : counts) {
+    ft::RigidBodyStore initial;
+    fillStore(initial, count, random);
+    for (uint32_t h = 0; h < count; ++h) {
+      // Everything awake and never sleeping, so every run does the
+      // same amount of work.
+      initial.canSleep[h] = 0;
+      initial.isAwake[h] = 1;
+    }
+
+    std::printf("%8u", count);
+    for (ft::SimdLevel level : levels) {
+      if ((int)level > (int)supported) {
+        std::printf(" %13s", "-");
+        continue;
+      }
+      ft::RigidBodyStore store = initial;
+      store.setSimdLevel(level);
+      double ms = ft::bench::measureMs([&]() { store.integrateAll(DURATION); });
+      std::printf(" %13.3f", ms);
+    }
+    std::printf("\n");
+  }
+
+  return ok ? 0 : 1;
+}
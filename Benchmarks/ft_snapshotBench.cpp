@@ -0,0 +1,225 @@
+/**
+ * Measures saving and restoring the state of a World of some 10000
+ * boxes, a grid of piles three boxes high, and checks that the frames
+ * run after a restore play out as the ones run after the save.
+ *
+ * It reports the time of World::saveState and World::restoreState,
+ * against the 50 microseconds a rollback can spend on them, and the
+ * time of a plain memcpy of as many bytes: saving and restoring only
+ * copy arrays, so that is as fast as they can be on the machine. The
+ * round trips run in deterministic mode: a snapshot is saved, some
+ * frames are run and hashed, the snapshot is restored and the same
+ * frames run again. This is done while the piles fall, then once they
+ * sleep, with one pile kicked awake after the save so that the
+ * restore has to move sleeping boxes back. Last, a box is replaced
+ * by a new one, which is given its handle, and the restore must then
+ * fail. Returns a non zero exit code if any hash differs, if saving or
+ * restoring again reallocates the snapshot, or if the snapshot is
+ * restored onto the new box.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr unsigned SIDE = 58;
+constexpr unsigned LEVELS = 3;
+constexpr unsigned FRAMES = 1200;
+constexpr unsigned AHEAD = 60;
+constexpr real_t SPACING = 3.0f;
+constexpr real_t DURATION = 1.0f / 60.0f;
+constexpr double TARGET_US = 50.0;
+
+struct Scene {
+  ft::RigidBodyStore store;
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  std::vector<std::unique_ptr<ft::CollisionBox>> boxes;
+  ft::CollisionPlane ground;
+  ft::World world{SIDE * SIDE * LEVELS * 16, 0};
+};
+
+void addBox(Scene &scene, const glm::vec3 &position) {
+  auto body = std::make_unique<ft::RigidBody>(&scene.store);
+  body->setMass(1.0f);
+  body->setInertiaTensor(glm::mat3(1.0f / 6.0f));
+  body->setDamping(0.95f, 0.8f);
+  body->setAcceleration(0, -9.81f, 0);
+  body->setPosition(position);
+  body->setAwake(true);
+  body->calculateDerivedData();
+
+  auto box = std::make_unique<ft::CollisionBox>();
+  box->body = body.get();
+  box->halfSize = glm::vec3(0.5f);
+  scene.world.addBody(body.get());
+  scene.world.addPrimitive(box.get());
+
+  scene.bodies.push_back(std::move(body));
+  scene.boxes.push_back(std::move(box));
+}
+
+void makeScene(Scene &scene) {
+  scene.world.setSolverType(ft::ContactSolverType::SEQUENTIAL_IMPULSE);
+  scene.world.setDeterministic(true);
+  scene.ground.direction = glm::vec3(0, 1, 0);
+  scene.ground.offset = 0;
+  scene.world.addPlane(&scene.ground);
+  for (unsigned pile = 0; pile < SIDE * SIDE; ++pile)
+    for (unsigned level = 0; level < LEVELS; ++level)
+      addBox(scene, glm::vec3((real_t)(pile % SIDE) * SPACING,
+                              0.5f + (real_t)level,
+                              (real_t)(pile / SIDE) * SPACING));
+}
+
+void step(Scene &scene) {
+  scene.world.startFrame();
+  scene.world.runPhysics(DURATION);
+}
+
+/**
+ * Wakes the top box of the first pile and throws it up.
+ */
+void kick(Scene &scene) {
+  ft::RigidBody &top = *scene.bodies[LEVELS - 1];
+  top.setAwake(true);
+  top.setVelocity(1.0f, 6.0f, 0.0f);
+}
+
+/**
+ * Saves a snapshot, runs AHEAD frames, restores it and runs them
+ * again, kicking the first pile after the save if asked to. Returns
+ * false if the hash of the restored state or of any frame differs.
+ */
+bool roundTrip(Scene &scene, ft::SimulationSnapshot &snapshot, bool kicked,
+               const char *name) {
+  if (!scene.world.saveState(snapshot)) {
+    std::fprintf(stderr, "%s: could not save the state\n", name);
+    return false;
+  }
+  uint64_t saved = scene.world.getStateHash();
+
+  std::vector<uint64_t> hashes;
+  if (kicked)
+    kick(scene);
+  for (unsigned frame = 0; frame < AHEAD; ++frame) {
+    step(scene);
+    hashes.push_back(scene.world.getStateHash());
+  }
+
+  if (!scene.world.restoreState(snapshot)) {
+    std::fprintf(stderr, "%s: could not restore the state\n", name);
+    return false;
+  }
+  if (scene.world.getStateHash() != saved) {
+    std::fprintf(stderr, "%s: the restored hash differs\n", name);
+    return false;
+  }
+
+  if (kicked)
+    kick(scene);
+  for (unsigned frame = 0; frame < AHEAD; ++frame) {
+    step(scene);
+    if (scene.world.getStateHash() != hashes[frame]) {
+      std::fprintf(stderr, "%s: parted on frame %u after the restore\n",
+                   name, frame + 1);
+      return false;
+    }
+  }
+  std::printf("%-8s %u frames replayed to the bit\n", name, AHEAD);
+  return true;
+}
+
+/**
+ * Saves a snapshot, then replaces the last box by a new one, which
+ * gets the handle of the old one. Returns false if the snapshot is
+ * restored anyway.
+ */
+bool replaced(Scene &scene, ft::SimulationSnapshot &snapshot) {
+  if (!scene.world.saveState(snapshot)) {
+    std::fprintf(stderr, "replaced: could not save the state\n");
+    return false;
+  }
+  uint32_t handle = scene.bodies.back()->getHandle();
+  scene.world.removePrimitive(scene.boxes.back().get());
+  scene.world.removeBody(scene.bodies.back().get());
+  scene.boxes.pop_back();
+  scene.bodies.pop_back();
+  addBox(scene, glm::vec3(-SPACING, 0.5f, -SPACING));
+  if (scene.bodies.back()->getHandle() != handle) {
+    std::fprintf(stderr, "replaced: the handle wasn't handed out again\n");
+    return false;
+  }
+
+  uint64_t hash = scene.world.getStateHash();
+  if (scene.world.restoreState(snapshot)) {
+    std::fprintf(stderr, "replaced: restored onto another box\n");
+    return false;
+  }
+  if (scene.world.getStateHash() != hash) {
+    std::fprintf(stderr, "replaced: the failed restore changed the state\n");
+    return false;
+  }
+  std::printf("%-8s restore refused\n", "replaced");
+  return true;
+}
+
+} // namespace
+
+int main() {
+  auto scene = std::make_unique<Scene>();
+  makeScene(*scene);
+  const ft::IslandBuilder &islands = scene->world.getIslands();
+  bool ok = true;
+  std::printf("%u boxes in %u piles\n", (unsigned)scene->bodies.size(),
+              SIDE * SIDE);
+
+  for (unsigned frame = 0; frame < 30; ++frame)
+    step(*scene);
+  ft::SimulationSnapshot snapshot;
+  ok &= roundTrip(*scene, snapshot, false, "falling");
+
+  // Saving into the same snapshot again must reuse its room.
+  const real_t *values = snapshot.bodies.values.data();
+  const void *manifolds = snapshot.contacts.manifolds.data();
+  double saveMs =
+      ft::bench::measureMs([&] { scene->world.saveState(snapshot); });
+  double restoreMs =
+      ft::bench::measureMs([&] { scene->world.restoreState(snapshot); });
+  if (snapshot.bodies.values.data() != values ||
+      snapshot.contacts.manifolds.data() != manifolds) {
+    std::fprintf(stderr, "saving again reallocated the snapshot\n");
+    ok = false;
+  }
+  std::vector<real_t> copy(snapshot.bodies.values.size());
+  double copyMs = ft::bench::measureMs([&] {
+    std::memcpy(copy.data(), snapshot.bodies.values.data(),
+                copy.size() * sizeof(real_t));
+  });
+  std::printf("%u manifolds, %.2f MB of bodies\n",
+              (unsigned)snapshot.contacts.manifolds.size(),
+              (double)(copy.size() * sizeof(real_t)) / (1024.0 * 1024.0));
+  std::printf("save:    %8.2f us\n", saveMs * 1000.0);
+  std::printf("restore: %8.2f us\n", restoreMs * 1000.0);
+  std::printf("memcpy:  %8.2f us\n", copyMs * 1000.0);
+  std::printf("target:  %8.2f us each%s\n", TARGET_US,
+              saveMs * 1000.0 > TARGET_US || restoreMs * 1000.0 > TARGET_US
+                  ? ", missed"
+                  : "");
+
+  unsigned settled = 0;
+  while (islands.getAwakeCount() != 0 && settled < FRAMES) {
+    step(*scene);
+    ++settled;
+  }
+  std::printf("asleep after %u more frames\n", settled);
+  if (islands.getAwakeCount() != 0) {
+    std::fprintf(stderr, "the piles didn't go to sleep\n");
+    ok = false;
+  }
+  ok &= roundTrip(*scene, snapshot, true, "kicked");
+  ok &= replaced(*scene, snapshot);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/**
+ * Measures the spatial hash grid on a pit of balls of similar size,
+ * against the AABB tree, and the particle collisions built on it.
+ *
+ * Every frame all the balls move a little and the pairs are found
+ * again, so the grid pays for its full rebuild every time.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cmath>
+#include <vector>
+
+namespace {
+
+struct Ball {
+  glm::vec3 centre;
+  real_t radius;
+};
+
+std::vector<Ball> makeBalls(unsigned count, ft::Random &random) {
+  // About a third of the space is filled.
+  real_t side = std::cbrt((real_t)count * 0.5f / 0.3f);
+  std::vector<Ball> balls;
+  balls.reserve(count);
+  for (unsigned i = 0; i < count; ++i)
+    balls.push_back({random.randomVector(glm::vec3(0, 0, 0),
+                                         glm::vec3(side, side, side)),
+                     random.randomReal(0.4f, 0.6f)});
+  return balls;
+}
+
+ft::BoundingBox boxOf(const Ball &ball) {
+  glm::vec3 extent(ball.radius, ball.radius, ball.radius);
+  return ft::BoundingBox(ball.centre - extent, ball.centre + extent);
+}
+
+double runFrames(ft::Broadphase &broadphase, std::vector<Ball> balls,
+                 ft::Random &random, size_t &pairCount) {
+  std::vector<uint32_t> proxies;
+  for (auto &ball : balls)
+    proxies.push_back(broadphase.createProxy(boxOf(ball)));
+
+  std::vector<ft::BroadphasePair> pairs;
+  double ms = ft::bench::measureMs([&]() {
+    for (size_t i = 0; i < balls.size(); ++i) {
+      balls[i].centre += random.randomVector(0.01f);
+      broadphase.moveProxy(proxies[i], boxOf(balls[i]));
+    }
+    broadphase.findPairs(pairs);
+  });
+  pairCount = pairs.size();
+  return ms;
+}
+
+} // namespace
+
+int main() {
+  const unsigned counts[] = {1000, 10000, 100000};
+  ft::Random random(99);
+
+  std::printf("%8s %12s %12s %10s %14s\n", "balls", "hash ms", "tree ms",
+              "pairs", "particles ms");
+  for (unsigned count : counts) {
+    auto balls = makeBalls(count, random);
+
+    ft::SpatialHashBroadphase hash;
+    size_t hashPairs = 0;
+    double hashMs = runFrames(hash, balls, random, hashPairs);
+
+    ft::AABBTreeBroadphase tree;
+    size_t treePairs = 0;
+    double treeMs = runFrames(tree, balls, random, treePairs);
+
+    // The same balls as particles of the median radius.
+    std::vector<ft::Particle> particles(count);
+    std::vector<ft::Particle::raw_ptr> pointers;
+    for (unsigned i = 0; i < count; ++i) {
+      particles[i].setPosition(balls[i].centre);
+      pointers.push_back(&particles[i]);
+    }
+    ft::ParticleCollisions collisions;
+    collisions.init(&pointers, 0.5f);
+    std::vector<ft::ParticleContact> contacts(count * 8);
+    unsigned used = 0;
+    double particleMs = ft::bench::measureMs([&]() {
+      used = collisions.addContact(contacts.data(), (unsigned)contacts.size());
+    });
+
+    std::printf("%8u %12.4f %12.4f %10zu %14.4f (%u contacts)\n", count,
+                hashMs, treeMs, hashPairs, particleMs, used);
+  }
+  return 0;
+}
@@ -0,0 +1,227 @@
+/**
+ * Compares the two contact solvers on resting stacks: a single column
+ * of 20 boxes and a block of ten layers of ten by ten boxes. The boxes
+ * never sleep, so the solvers have to deal with every contact at
+ * every frame.
+ *
+ * After each solve, the speed at which the bodies of each contact
+ * still approach each other is measured. For each solver it reports
+ * the mean time of a solve, the iterations used, the mean of the
+ * largest approach speed left after each solve, the speed of the
+ * fastest box at the end and the height of the stack.
+ *
+ * Each solver is run on the contacts straight from the collision
+ * detection, then on the points of a ContactManifoldCache, which
+ * keeps up to four points per pair of boxes and hands the impulses
+ * of the last frame back to the sequential impulse solver. Returns a
+ * non zero exit code if a solver lets the simulation blow up, or if
+ * the stacks don't stand with the manifolds and the sequential
+ * impulse solver.
+ */
+#include "ft_bench.h"
+#include "ftPhysics.h"
+#include <cmath>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr real_t DURATION = 1.0f / 60.0f;
+constexpr unsigned FRAMES = 60;
+constexpr unsigned IMPULSE_ITERATIONS = 10;
+
+struct Scene {
+  const char *name;
+  unsigned side;
+  unsigned layers;
+};
+
+struct Result {
+  double solveMs;
+  double iterations;
+  unsigned contacts;
+  double approach;
+  real_t maxSpeed;
+  real_t height;
+};
+
+struct Stack {
+  unsigned side;
+  unsigned layers;
+  ft::RigidBodyStore store;
+  std::vector<std::unique_ptr<ft::RigidBody>> bodies;
+  std::vector<ft::CollisionBox> boxes;
+  std::vector<ft::Contact> contacts;
+  ft::CollisionData data;
+  ft::CollisionPlane ground;
+};
+
+void makeStack(Stack &stack, const Scene &scene) {
+  stack.side = scene.side;
+  stack.layers = scene.layers;
+  unsigned count = scene.side * scene.side * scene.layers;
+  stack.boxes.resize(count);
+  for (unsigned i = 0; i < count; ++i) {
+    unsigned x = i % scene.side, z = (i / scene.side) % scene.side,
+             y = i / (scene.side * scene.side);
+    auto body = std::make_unique<ft::RigidBody>(&stack.store);
+    body->setMass(1.0f);
+    body->setInertiaTensor(glm::mat3(1.0f / 6.0f));
+    body->setDamping(0.95f, 0.8f);
+    body->setAcceleration(0, -9.81f, 0);
+    body->setPosition((real_t)x * 1.01f, 0.5f + (real_t)y, (real_t)z * 1.01f);
+    body->setCanSleep(false);
+    body->setAwake(true);
+    body->calculateDerivedData();
+    stack.boxes[i].body = body.get();
+    stack.boxes[i].halfSize = glm::vec3(0.5f);
+    stack.boxes[i].calculateInternals();
+    stack.bodies.push_back(std::move(body));
+  }
+
+  stack.contacts.resize(count * 16);
+  stack.data.contactArray = stack.contacts.data();
+  stack.data.friction = 0.9f;
+  stack.data.restitution = 0.1f;
+  stack.data.tolerance = 0.01f;
+  stack.ground.direction = glm::vec3(0, 1, 0);
+  stack.ground.offset = 0;
+}
+
+/**
+ * Tests every box against its neighbours in the grid, and the bottom
+ * layer against the ground.
+ */
+void generateContacts(Stack &stack) {
+  ft::CollisionData &data = stack.data;
+  data.reset((unsigned)stack.contacts.size());
+  unsigned layer = stack.side * stack.side;
+  for (unsigned i = 0; i < stack.boxes.size(); ++i) {
+    unsigned x = i % stack.side, z = (i / stack.side) % stack.side,
+             y = i / layer;
+    if (y == 0 && data.hasMoreContacts())
+      ft::CollisionDetector::boxAndHalfSpace(stack.boxes[i], stack.ground,
+                                             &data);
+    for (unsigned other = i + 1; other < stack.boxes.size(); ++other) {
+      unsigned ox = other % stack.side, oz = (other / stack.side) % stack.side,
+               oy = other / layer;
+      if (oy > y + 1 || ox + 1 < x || ox > x + 1 || oz + 1 < z || oz > z + 1)
+        continue;
+      if (!data.hasMoreContacts())
+        return;
+      ft::CollisionDetector::boxAndBox(stack.boxes[i], stack.boxes[other],
+                                       &data);
+    }
+  }
+}
+
+glm::vec3 pointVelocity(const ft::RigidBody *body, const glm::vec3 &point) {
+  if (!body)
+    return glm::vec3(0.0f);
+  return body->getVelocity() +
+         glm::cross(body->getRotation(), point - body->getPosition());
+}
+
+/**
+ * Returns the largest speed at which the bodies of a contact still
+ * move into each other.
+ */
+real_t maxApproach(const ft::Contact *contacts, unsigned count) {
+  real_t approach = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    const ft::Contact &contact = contacts[i];
+    const glm::vec3 &point = contact._contactPoint;
+    glm::vec3 velocity = pointVelocity(contact._body[0], point) -
+                         pointVelocity(contact._body[1], point);
+    approach = std::fmax(approach, -glm::dot(velocity, contact._contactNormal));
+  }
+  return approach;
+}
+
+Result run(const Scene &scene, ft::ContactSolverType type, bool manifolds) {
+  auto stack = std::make_unique<Stack>();
+  makeStack(*stack, scene);
+  ft::ContactResolver resolver(1);
+  ft::SequentialImpulseSolver impulseSolver(IMPULSE_ITERATIONS);
+  ft::ContactManifoldCache cache;
+
+  Result result = {0, 0, 0, 0, 0, 0};
+  for (unsigned frame = 0; frame < FRAMES; ++frame) {
+    stack->store.integrateAll(DURATION);
+    for (auto &box : stack->boxes)
+      box.calculateInternals();
+    generateContacts(*stack);
+    unsigned count = stack->data.contactCount;
+    if (manifolds)
+      count = cache.update(stack->contacts.data(), count,
+                           (unsigned)stack->contacts.size());
+
+    ft::bench::Timer timer;
+    if (type == ft::ContactSolverType::ITERATIVE) {
+      resolver.setIterations(count * 4);
+      resolver.resolveContacts(stack->contacts.data(), count, DURATION);
+      result.iterations += resolver._velocityIterationsUsed +
+                           resolver._positionIterationsUsed;
+    } else {
+      impulseSolver.resolveContacts(stack->contacts.data(), count, DURATION);
+      result.iterations += impulseSolver.getIterations();
+    }
+    result.solveMs += timer.elapsedMs();
+    if (manifolds)
+      cache.storeImpulses(stack->contacts.data());
+
+    result.approach += maxApproach(stack->contacts.data(), count);
+    result.contacts = count;
+  }
+  result.solveMs /= FRAMES;
+  result.iterations /= FRAMES;
+  result.approach /= FRAMES;
+  for (auto &body : stack->bodies) {
+    result.maxSpeed =
+        std::fmax(result.maxSpeed, glm::length(body->getVelocity()));
+    result.height = std::fmax(result.height, body->getPosition().y + 0.5f);
+  }
+  return result;
+}
+
+bool print(const Scene &scene, const char *solver, const Result &result) {
+  std::printf("%16s %20s %9u %10.3f %12.1f %10.4f %10.4f %8.2f\n",
+              scene.name, solver, result.contacts, result.solveMs,
+              result.iterations, result.approach, result.maxSpeed,
+              result.height);
+  return std::isfinite(result.approach) && std::isfinite(result.maxSpeed);
+}
+
+} // namespace
+
+int main() {
+  const Scene scenes[] = {{"column of 20", 1, 20}, {"1000 box block", 10, 10}};
+  bool ok = true;
+  bool standing = true;
+
+  std::printf("%16s %20s %9s %10s %12s %10s %10s %8s\n", "scene", "solver",
+              "contacts", "solve ms", "iterations", "approach", "max speed",
+              "height");
+  for (const Scene &scene : scenes) {
+    ok = print(scene, "iterative",
+               run(scene, ft::ContactSolverType::ITERATIVE, false)) &&
+         ok;
+    ok = print(scene, "sequential impulse",
+               run(scene, ft::ContactSolverType::SEQUENTIAL_IMPULSE, false)) &&
+         ok;
+    ok = print(scene, "iterative, manifolds",
+               run(scene, ft::ContactSolverType::ITERATIVE, true)) &&
+         ok;
+    Result result = run(scene, ft::ContactSolverType::SEQUENTIAL_IMPULSE, true);
+    ok = print(scene, "impulse, manifolds", result) && ok;
+    if (result.height < 0.9f * (real_t)scene.layers) {
+      std::fprintf(stderr, "%s: fell to %.2f with manifolds\n", scene.name,
+                   result.height);
+      standing = false;
+    }
+  }
+
+  if (!ok)
+    std::fprintf(stderr, "a solver blew the simulation up\n");
+  return ok && standing ? 0 : 1;
+}
@@ -10,6 +10,7 @@
 #include "ft_device.h"
 #include "ft_event.h"
 #include "ft_frameBuffer.h"
+#include "ft_frameGraph.h"
 #include "ft_headers.h"
 #include "ft_image.h"
 #include "ft_instance.h"
@@ -17,7 +17,9 @@ namespace ft {
 
 static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
 constexpr int POINT_LIGHT_MAX_COUNT = 10;
+// the threads of the scheduler, shared by the frame and the physics
 static constexpr uint32_t THREAD_POOL_SIZE = 10;
+static constexpr const char *PROFILER_TRACE_FILE = "ft_trace.json";
 
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
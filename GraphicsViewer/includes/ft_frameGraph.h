@@ -0,0 +1,93 @@
+#ifndef FTGRAPHICS_FT_FRAMEGRAPH_H
+#define FTGRAPHICS_FT_FRAMEGRAPH_H
+
+#include "ft_scheduler.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ft {
+
+// The work of one frame, as a graph of nodes run on a scheduler.
+//
+// Each node declares the resources it reads and writes, as bits of a
+// mask whose meaning is up to the application. A node runs after every
+// node added before it that writes something it reads or writes, or
+// reads something it writes; the others run at the same time. Nodes
+// that must stay on the thread calling run (window, gui, queue
+// submission) are flagged as such.
+//
+// The graph is built once and run every frame: running it allocates
+// nothing. Each run times every node, and finds the critical path: the
+// chain of dependent nodes that took the longest.
+class FrameGraph {
+
+public:
+  using pointer = std::shared_ptr<FrameGraph>;
+
+  // adds a node, returns its index
+  uint32_t addNode(const std::string &name, uint64_t reads, uint64_t writes,
+                   bool mainThread, std::function<void()> work);
+
+  // runs every node once, and returns when they are all done
+  void run(Scheduler &scheduler);
+
+  uint32_t getNodeCount() const;
+  const std::string &getNodeName(uint32_t node) const;
+  // when the node started, from the start of the run, and how long it
+  // took, in milliseconds
+  double getNodeStart(uint32_t node) const;
+  double getNodeTime(uint32_t node) const;
+
+  double getFrameTime() const;
+  double getCriticalPathTime() const;
+  const std::vector<uint32_t> &getCriticalPath() const;
+
+  // prints the timings of the last run, critical path included
+  void report(std::ostream &out) const;
+
+private:
+  struct Node {
+    std::string name;
+    uint64_t reads;
+    uint64_t writes;
+    bool mainThread;
+    std::function<void()> work;
+    std::vector<uint32_t> predecessors;
+    std::vector<uint32_t> successors;
+
+    std::atomic<uint32_t> pending{0};
+    bool started = false;
+    Task task;
+    double start = 0.0;
+    double time = 0.0;
+
+    // the longest chain of nodes ending with this one
+    double pathTime = 0.0;
+    uint32_t pathPrevious = -1u;
+  };
+
+  void execute(uint32_t node);
+  void release(uint32_t node);
+  void findCriticalPath();
+  double now() const;
+
+  std::vector<std::unique_ptr<Node>> _nodes;
+  std::vector<uint32_t> _mainNodes;
+  Scheduler *_scheduler = nullptr;
+  WaitGroup *_group = nullptr;
+  std::atomic<uint32_t> _remaining{0};
+  std::chrono::steady_clock::time_point _start;
+  double _frameTime = 0.0;
+  double _pathTime = 0.0;
+  std::vector<uint32_t> _criticalPath;
+};
+
+} // namespace ft
+
+#endif // FTGRAPHICS_FT_FRAMEGRAPH_H
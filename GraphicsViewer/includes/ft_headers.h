@@ -6,6 +6,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #define GLM_ENABLE_EXPERIMENTAL
 // #define SHOW_FRAME_RATE
+// update the scene objects one task each, as before the chunks, to
+// compare the update time printed with the frame rate
+// #define PER_OBJECT_UPDATE
 #include "algorithm"
 #include "any"
 #include "array"
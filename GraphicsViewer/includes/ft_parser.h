@@ -4,8 +4,8 @@
 #include "ft_device.h"
 #include "ft_rendering_systems.h"
 #include "ft_scene.h"
+#include "ft_scheduler.h"
 #include "ft_texture.h"
-#include "ft_threads.h"
 #include <memory>
 #include <nlohmann/json.hpp>
 
@@ -16,7 +16,7 @@ public:
   using pointer = std::shared_ptr<Parser>;
 
   Parser(const Device::pointer &, const TexturePool::pointer &,
-         const ThreadPool::pointer &);
+         const Scheduler::pointer &);
   virtual ~Parser() = default;
 
   virtual void parseSceneFile(const ft::Scene::pointer &scene,
@@ -28,7 +28,7 @@ public:
 protected:
   Device::pointer _ftDevice;
   TexturePool::pointer _ftMaterialPool;
-  ThreadPool::pointer _ftThreadPool;
+  Scheduler::pointer _ftScheduler;
 };
 
 } // namespace ft
@@ -12,9 +12,9 @@
 #include "ft_pipeline.h"
 #include "ft_rendering_systems.h"
 #include "ft_sceneObject.h"
+#include "ft_scheduler.h"
 #include "ft_swapChain.h"
 #include "ft_texture.h"
-#include "ft_threads.h"
 #include "ft_tools.h"
 #include "ft_vertex.h"
 #include <cstdint>
@@ -139,8 +139,14 @@ public:
   ft::Gizmo::pointer getGizmo() const;
   bool hasGizmo() const;
 
-  // scene update
-  void updateSceneObjects(float duration, ft::ThreadPool::pointer &pool);
+  // scene update, spread over the scheduler in chunks of
+  // UPDATE_GRAIN objects, or one task per object with PER_OBJECT_UPDATE
+  static constexpr uint32_t UPDATE_GRAIN = 64;
+  void updateSceneObjects(float duration, ft::Scheduler::pointer &scheduler);
+  // the time taken by the last update in milliseconds, and the mean
+  // over every update so far
+  double getUpdateTime() const;
+  double getMeanUpdateTime() const;
 
   // set properties of the scene
   void addMaterialToObj(uint32_t id, Material::pointer texture);
@@ -188,6 +194,10 @@ private:
   Gizmo::pointer _ftGizmo;
   State _state;
   std::vector<SceneNode> _sceneGraph;
+  std::vector<Task> _updateTasks;
+  double _updateTime = 0.0;
+  double _totalUpdateTime = 0.0;
+  uint64_t _updateCount = 0;
 };
 
 } // namespace ft
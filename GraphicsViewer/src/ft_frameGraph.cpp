@@ -0,0 +1,159 @@
+#include "../includes/ft_frameGraph.h"
+#include <algorithm>
+#include <thread>
+
+uint32_t ft::FrameGraph::addNode(const std::string &name, uint64_t reads,
+                                 uint64_t writes, bool mainThread,
+                                 std::function<void()> work) {
+  auto node = std::make_unique<Node>();
+  node->name = name;
+  node->reads = reads;
+  node->writes = writes;
+  node->mainThread = mainThread;
+  node->work = std::move(work);
+
+  uint32_t index = (uint32_t)_nodes.size();
+  for (uint32_t i = 0; i < index; ++i) {
+    Node &other = *_nodes[i];
+    if ((other.writes & (reads | writes)) || (other.reads & writes)) {
+      other.successors.push_back(index);
+      node->predecessors.push_back(i);
+    }
+  }
+
+  if (mainThread)
+    _mainNodes.push_back(index);
+  _nodes.push_back(std::move(node));
+  _criticalPath.reserve(_nodes.size());
+  return index;
+}
+
+void ft::FrameGraph::run(Scheduler &scheduler) {
+  WaitGroup group;
+  _scheduler = &scheduler;
+  _group = &group;
+  _start = std::chrono::steady_clock::now();
+
+  for (auto &node : _nodes) {
+    node->pending.store((uint32_t)node->predecessors.size(),
+                        std::memory_order_relaxed);
+    node->started = false;
+  }
+  _remaining.store((uint32_t)_nodes.size(), std::memory_order_release);
+
+  // the nodes without predecessors start right away, the others are
+  // started by the last of their predecessors
+  for (uint32_t i = 0; i < _nodes.size(); ++i)
+    if (_nodes[i]->predecessors.empty())
+      release(i);
+
+  // the main thread runs its own nodes as they become ready, and helps
+  // with the others in between
+  while (_remaining.load(std::memory_order_acquire) > 0) {
+    bool ran = false;
+    for (uint32_t i : _mainNodes) {
+      Node &node = *_nodes[i];
+      if (!node.started && node.pending.load(std::memory_order_acquire) == 0) {
+        node.started = true;
+        execute(i);
+        ran = true;
+        break;
+      }
+    }
+    if (!ran && !scheduler.help())
+      std::this_thread::yield();
+  }
+  scheduler.wait(group);
+
+  _frameTime = now();
+  findCriticalPath();
+}
+
+void ft::FrameGraph::release(uint32_t index) {
+  Node &node = *_nodes[index];
+  if (node.mainThread)
+    return;
+  node.task.set([this, index]() { execute(index); });
+  _scheduler->submit(node.task, *_group);
+}
+
+void ft::FrameGraph::execute(uint32_t index) {
+  Node &node = *_nodes[index];
+  node.start = now();
+  node.work();
+  node.time = now() - node.start;
+
+  for (uint32_t successor : node.successors)
+    if (_nodes[successor]->pending.fetch_sub(1, std::memory_order_acq_rel) ==
+        1)
+      release(successor);
+  _remaining.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ft::FrameGraph::findCriticalPath() {
+  // the nodes are in dependency order already
+  uint32_t last = -1u;
+  _pathTime = 0.0;
+  for (uint32_t i = 0; i < _nodes.size(); ++i) {
+    Node &node = *_nodes[i];
+    node.pathTime = node.time;
+    node.pathPrevious = -1u;
+    for (uint32_t previous : node.predecessors) {
+      double time = _nodes[previous]->pathTime + node.time;
+      if (time > node.pathTime) {
+        node.pathTime = time;
+        node.pathPrevious = previous;
+      }
+    }
+    if (node.pathTime > _pathTime || last == -1u) {
+      _pathTime = node.pathTime;
+      last = i;
+    }
+  }
+
+  _criticalPath.clear();
+  for (uint32_t i = last; i != -1u; i = _nodes[i]->pathPrevious)
+    _criticalPath.push_back(i);
+  std::reverse(_criticalPath.begin(), _criticalPath.end());
+}
+
+double ft::FrameGraph::now() const {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - _start)
+      .count();
+}
+
+uint32_t ft::FrameGraph::getNodeCount() const {
+  return (uint32_t)_nodes.size();
+}
+
+const std::string &ft::FrameGraph::getNodeName(uint32_t node) const {
+  return _nodes[node]->name;
+}
+
+double ft::FrameGraph::getNodeStart(uint32_t node) const {
+  return _nodes[node]->start;
+}
+
+double ft::FrameGraph::getNodeTime(uint32_t node) const {
+  return _nodes[node]->time;
+}
+
+double ft::FrameGraph::getFrameTime() const { return _frameTime; }
+
+double ft::FrameGraph::getCriticalPathTime() const { return _pathTime; }
+
+const std::vector<uint32_t> &ft::FrameGraph::getCriticalPath() const {
+  return _criticalPath;
+}
+
+void ft::FrameGraph::report(std::ostream &out) const {
+  out << "frame: " << _frameTime << " ms" << std::endl;
+  for (auto &node : _nodes)
+    out << "  " << node->name << ": " << node->time << " ms at "
+        << node->start << (node->mainThread ? " (main)" : "") << std::endl;
+  out << "  critical path: " << _pathTime << " ms,";
+  for (uint32_t i : _criticalPath)
+    out << " " << _nodes[i]->name;
+  out << std::endl;
+}
@@ -11,5 +11,5 @@
 
 ft::Parser::Parser(const Device::pointer &device,
                    const TexturePool::pointer &mPool,
-                   const ThreadPool::pointer &tPool)
-    : _ftDevice(device), _ftMaterialPool(mPool), _ftThreadPool(tPool) {}
+                   const Scheduler::pointer &scheduler)
+    : _ftDevice(device), _ftMaterialPool(mPool), _ftScheduler(scheduler) {}
@@ -1,4 +1,6 @@
 #include "../includes/ft_scene.h"
+#include "ft_profiler.h"
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <glm/ext/matrix_transform.hpp>
@@ -941,17 +943,41 @@ std::vector<ft::Scene::SceneNode> &ft::Scene::getSceneGraph() {
   return _sceneGraph;
 }
 
-// todo: this can be made concurent !
 void ft::Scene::updateSceneObjects(float duration,
-                                   ft::ThreadPool::pointer &pool) {
-
-  std::vector<std::future<void>> tasks;
-  for (auto &obj : _objects) {
-    tasks.push_back(
-        pool->addTask(std::bind(&SceneObject::update, *obj, duration)));
-  }
-
-  // wait for all tasks
-  for (auto &t : tasks)
-    t.wait();
+                                   ft::Scheduler::pointer &scheduler) {
+  FT_PROFILE_ZONE("Scene::updateSceneObjects");
+  auto start = std::chrono::steady_clock::now();
+
+#ifdef PER_OBJECT_UPDATE
+  // one task per object, the tasks don't move once submitted
+  _updateTasks.resize(_objects.size());
+  WaitGroup group;
+  for (size_t i = 0; i < _objects.size(); ++i) {
+    SceneObject *object = _objects[i].get();
+    _updateTasks[i].set([object, duration]() { object->update(duration); });
+    scheduler->submit(_updateTasks[i], group);
+  }
+  scheduler->wait(group);
+#else
+  // each chunk updates a range of objects in place, nothing is copied
+  // nor allocated
+  SceneObject::pointer *objects = _objects.data();
+  scheduler->parallelFor(0, (uint32_t)_objects.size(), UPDATE_GRAIN,
+                         [objects, duration](uint32_t first, uint32_t last) {
+                           for (uint32_t i = first; i < last; ++i)
+                             objects[i]->update(duration);
+                         });
+#endif
+
+  _updateTime = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  _totalUpdateTime += _updateTime;
+  ++_updateCount;
+}
+
+double ft::Scene::getUpdateTime() const { return _updateTime; }
+
+double ft::Scene::getMeanUpdateTime() const {
+  return _updateCount ? _totalUpdateTime / (double)_updateCount : 0.0;
 }
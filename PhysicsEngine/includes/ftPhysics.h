@@ -2,19 +2,31 @@
 #define FTPHYSICS_INCLUDE_H
 
 #include "ft_body.h"
+#include "ft_bodyStore.h"
+#include "ft_broadphase.h"
 #include "ft_collideCoarse.h"
 #include "ft_collideFine.h"
+#include "ft_contactArena.h"
+#include "ft_contactGraph.h"
 #include "ft_contacts.h"
 #include "ft_def.h"
 #include "ft_forceGenerator.h"
+#include "ft_impulseSolver.h"
+#include "ft_island.h"
+#include "ft_islandSolver.h"
 #include "ft_joint.h"
+#include "ft_manifold.h"
 #include "ft_pForceGenerator.h"
 #include "ft_particle.h"
 #include "ft_pcontacts.h"
 #include "ft_plinks.h"
 #include "ft_pworld.h"
+#include "ft_profiler.h"
 #include "ft_random.h"
-#include "ft_threads.h"
+#include "ft_scheduler.h"
+#include "ft_simd.h"
+#include "ft_snapshot.h"
+#include "ft_stateHash.h"
 #include "ft_world.h"
 
 #endif // FTPHYSICS_INCLUDE_H
@@ -1,6 +1,7 @@
 #ifndef FT_BODY_H
 #define FT_BODY_H
 
+#include "ft_bodyStore.h"
 #include "ft_def.h"
 #include <glm/ext/matrix_float3x3.hpp>
 #include <glm/fwd.hpp>
@@ -17,11 +18,10 @@ namespace ft {
  * to it. The rigid body manages its state and allows access
  * through a set of methods.
  *
- * A ridid body contains 64 words (the size of which is given
- * by the precision: sizeof(real)). It contains no virtual
- * functions, so should take up exactly 64 words in memory. Of
- * this total 15 words are padding, distributed among the
- * Vector3 data members.
+ * The data of the body is not held in the object itself but in
+ * a RigidBodyStore, which keeps every field of all its bodies in a
+ * contiguous array. A rigid body is a thin view over a handle in
+ * that store.
  */
 class RigidBody {
 public:
@@ -31,196 +31,18 @@ public:
 
 protected:
   /**
-   * @name Characteristic Data and State
-   *
-   * This data holds the state of the rigid body. There are two
-   * sets of data: characteristics and state.
-   *
-   * Characteristics are properties of the rigid body
-   * independent of its current kinematic situation. This
-   * includes mass, moment of inertia and damping
-   * properties. Two identical rigid bodys will have the same
-   * values for their characteristics.
-   *
-   * State includes all the characteristics and also includes
-   * the kinematic situation of the rigid body in the current
-   * simulation. By setting the whole state data, a rigid body's
-   * exact game state can be replicated. Note that state does
-   * not include any forces applied to the body. Two identical
-   * rigid bodies in the same simulation will not share the same
-   * state values.
-   *
-   * The state values make up the smallest set of independent
-   * data for the rigid body. Other state data is calculated
-   * from their current values. When state data is changed the
-   * dependent values need to be updated: this can be achieved
-   * either by integrating the simulation, or by calling the
-   * calculateInternals function. This two stage process is used
-   * because recalculating internals can be a costly process:
-   * all state changes should be carried out at the same time,
-   * allowing for a single call.
-   *
-   * @see calculateInternals
+   * Holds the store that keeps the data of the body, and the handle
+   * of the body in it. All the characteristics and state of the
+   * body live in the store; the rigid body only forwards to them.
    */
-  /*@{*/
-  /**
-   * Holds the inverse of the mass of the rigid body. It
-   * is more useful to hold the inverse mass because
-   * integration is simpler, and because in real time
-   * simulation it is more useful to have bodies with
-   * infinite mass (immovable) than zero mass
-   * (completely unstable in numerical simulation).
-   */
-  real_t _inverseMass;
-
-  /**
-   * Holds the inverse of the body's inertia tensor. The
-   * inertia tensor provided must not be degenerate
-   * (that would mean the body had zero inertia for
-   * spinning along one axis). As long as the tensor is
-   * finite, it will be invertible. The inverse tensor
-   * is used for similar reasons to the use of inverse
-   * mass.
-   *
-   * The inertia tensor, unlike the other variables that
-   * define a rigid body, is given in body space.
-   *
-   * @see inverseMass
-   */
-  // Matrix3 inverseInertiaTensor;
-  glm::mat3 _inverseInertiaTensor = glm::mat3(1.0f);
-
-  /**
-   * Holds the amount of damping applied to linear
-   * motion.  Damping is required to remove energy added
-   * through numerical instability in the integrator.
-   */
-  real_t _linearDamping;
-
-  /**
-   * Holds the amount of damping applied to angular
-   * motion.  Damping is required to remove energy added
-   * through numerical instability in the integrator.
-   */
-  real_t _angularDamping;
-
-  /**
-   * Holds the linear position of the rigid body in
-   * world space.
-   */
-  glm::vec3 _position;
-
-  /**
-   * Holds the angular orientation of the rigid body in
-   * world space.
-   */
-  // Quaternion orientation;
-private:
-  glm::quat _orientation;
-
-protected:
-  /**
-   * Holds the linear velocity of the rigid body in
-   * world space.
-   */
-  glm::vec3 _velocity;
-
-  /**
-   * Holds the angular velocity, or rotation, or the
-   * rigid body in world space.
-   */
-  glm::vec3 _rotation;
-
-  /*@}*/
+  RigidBodyStore *_store;
+  uint32_t _handle;
 
   /**
-   * @name Derived Data
-   *
-   * These data members hold information that is derived from
-   * the other data in the class.
-   */
-  /*@{*/
-
-  /**
-   * Holds the inverse inertia tensor of the body in world
-   * space. The inverse inertia tensor member is specified in
-   * the body's local space.
-   *
-   * @see inverseInertiaTensor
+   * True if the body created its handle, and so has to give it back
+   * to the store when it is destroyed.
    */
-  glm::mat3 _inverseInertiaTensorWorld;
-
-  /**
-   * Holds the amount of motion of the body. This is a recency
-   * weighted mean that can be used to put a body to sleap.
-   */
-  real_t _motion;
-
-  /**
-   * A body can be put to sleep to avoid it being updated
-   * by the integration functions or affected by collisions
-   * with the world.
-   */
-  bool _isAwake;
-
-  /**
-   * Some bodies may never be allowed to fall asleep.
-   * User controlled bodies, for example, should be
-   * always awake.
-   */
-  bool _canSleep;
-
-  /**
-   * Holds a transform matrix for converting body space into
-   * world space and vice versa. This can be achieved by calling
-   * the getPointIn*Space functions.
-   *
-   * @see getPointInLocalSpace
-   * @see getPointInWorldSpace
-   * @see getTransform
-   */
-  glm::mat4 _transformMatrix = glm::mat4(1.0f);
-
-  /*@}*/
-
-  /**
-   * @name Force and Torque Accumulators
-   *
-   * These data members store the current force, torque and
-   * acceleration of the rigid body. Forces can be added to the
-   * rigid body in any order, and the class decomposes them into
-   * their constituents, accumulating them for the next
-   * simulation step. At the simulation step, the accelerations
-   * are calculated and stored to be applied to the rigid body.
-   */
-  /*@{*/
-
-  /**
-   * Holds the accumulated force to be applied at the next
-   * integration step.
-   */
-  glm::vec3 _forceAccum;
-
-  /**
-   * Holds the accumulated torque to be applied at the next
-   * integration step.
-   */
-  glm::vec3 _torqueAccum;
-
-  /**
-   * Holds the acceleration of the rigid body.  This value
-   * can be used to set acceleration due to gravity (its primary
-   * use), or any other constant acceleration.
-   */
-  glm::vec3 _acceleration;
-
-  /**
-   * Holds the linear acceleration of the rigid body, for the
-   * previous frame.
-   */
-  glm::vec3 _lastFrameAcceleration;
-
-  /*@}*/
+  bool _ownsHandle;
 
 public:
   static void printMat3(const glm::mat3 &m) {
@@ -242,37 +64,74 @@ public:
   }
 
   void printInfo() const {
-    //  glm::mat4 _transformMatrix;
-
-    std::cout << "inverseMass: " << _inverseMass << "\n";
-    std::cout << "linearDamping: " << _linearDamping << "\n";
-    std::cout << "angularDamping: " << _angularDamping << "\n";
-    std::cout << "motion: " << _motion << "\n";
-    std::cout << "isAwake: " << _isAwake << "\n";
-    std::cout << "canSleep: " << _canSleep << "\n";
-    std::cout << "position: " << glm::to_string(_position) << "\n";
-    std::cout << "velocity: " << glm::to_string(_velocity) << "\n";
-    std::cout << "rotation: " << glm::to_string(_rotation) << "\n"; // !
+    std::cout << "inverseMass: " << getInverseMass() << "\n";
+    std::cout << "linearDamping: " << getLinearDamping() << "\n";
+    std::cout << "angularDamping: " << getAngularDamping() << "\n";
+    std::cout << "motion: " << _store->motion[_handle] << "\n";
+    std::cout << "isAwake: " << getAwake() << "\n";
+    std::cout << "canSleep: " << getCanSleep() << "\n";
+    std::cout << "position: " << glm::to_string(getPosition()) << "\n";
+    std::cout << "velocity: " << glm::to_string(getVelocity()) << "\n";
+    std::cout << "rotation: " << glm::to_string(getRotation()) << "\n"; // !
     std::cout << "inverseInertiaTensor: ";
-    printMat3(_inverseInertiaTensor);
+    printMat3(getInverseInertiaTensor());
     std::cout << "inverseInertiaTensorWorld: ";
-    printMat3(_inverseInertiaTensorWorld);
+    printMat3(getInverseInertiaTensorWorld());
     std::cout << "orientation: ";
-    printQuat(_orientation);
+    printQuat(getOrientation());
     std::cout << "transformation: ";
-    printMat4(_transformMatrix);
+    printMat4(getTransform());
     std::cout << std::endl;
   }
 
   /**
    * @name Constructor and Destructor
    *
-   * There are no data members in the rigid body class that are
-   * created on the heap. So all data storage is handled
-   * automatically.
+   * A rigid body created on its own gets a new handle in a store,
+   * and gives it back when it is destroyed. It can also be made a
+   * view over a handle that already exists, in which case the
+   * handle is left alone.
    */
   /*@{*/
 
+  /**
+   * Creates a new body in the given store, or in the default store
+   * if none is given.
+   */
+  RigidBody(RigidBodyStore *store = nullptr);
+
+  /**
+   * Creates a view over an existing body of the given store.
+   */
+  RigidBody(RigidBodyStore *store, uint32_t handle);
+
+  ~RigidBody();
+
+  RigidBody(const RigidBody &) = delete;
+  RigidBody &operator=(const RigidBody &) = delete;
+
+  /**
+   * Returns the store holding the data of the body.
+   */
+  RigidBodyStore *getStore() const { return _store; }
+
+  /**
+   * Returns the handle of the body in its store.
+   */
+  uint32_t getHandle() const { return _handle; }
+
+  /**
+   * Returns true if the first body comes before the second in the
+   * order of their handles, which is the same on every run, unlike
+   * the order of their addresses. Bodies of different stores are in
+   * the order of their stores.
+   */
+  static bool handleOrder(const RigidBody *one, const RigidBody *two) {
+    if (one->_store != two->_store)
+      return std::less<const RigidBodyStore *>()(one->_store, two->_store);
+    return one->_handle < two->_handle;
+  }
+
   /*@}*/
 
   /**
@@ -822,7 +681,7 @@ public:
    *
    * @return The awake state of the body.
    */
-  bool getAwake() const { return _isAwake; }
+  bool getAwake() const { return _store->isAwake[_handle] != 0; }
 
   /**
    * Sets the awake state of the body. If the body is set to be
@@ -838,7 +697,9 @@ public:
    * Returns true if the body is allowed to go to sleep at
    * any time.
    */
-  inline bool getCanSleep() const { return _canSleep; }
+  inline bool getCanSleep() const {
+    return _store->canSleep[_handle] != 0;
+  }
 
   /**
    * Sets whether the body is ever allowed to go to sleep. Bodies
@@ -850,6 +711,12 @@ public:
    */
   void setCanSleep(const bool canSleep = true);
 
+  /**
+   * Returns the recency weighted average of the body's kinetic
+   * energy, compared against SLEEP_EPSILON to put it to sleep.
+   */
+  real_t getMotion() const { return _store->motion[_handle]; }
+
   /*@}*/
 
   /**
@@ -0,0 +1,318 @@
+/**
+ * @file
+ *
+ * This file contains the storage of the rigid body data. Instead of
+ * keeping every body in its own object, the state of all the bodies
+ * is held in one array per field, so that the integration can run
+ * over all the bodies in a few tight loops that touch only the data
+ * they need.
+ */
+#ifndef FT_BODYSTORE_H
+#define FT_BODYSTORE_H
+
+#include "ft_def.h"
+#include "ft_simd.h"
+#include <cstdint>
+#include <vector>
+
+namespace ft {
+
+/**
+ * Holds an array of vectors as one array per coordinate, so that the
+ * same coordinate of consecutive bodies is contiguous in memory and
+ * can be loaded into vector registers at once.
+ */
+struct Vec3Array {
+  std::vector<real_t> x, y, z;
+
+  glm::vec3 get(uint32_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+  void set(uint32_t i, const glm::vec3 &v) {
+    x[i] = v.x;
+    y[i] = v.y;
+    z[i] = v.z;
+  }
+
+  void resize(size_t size) {
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+  }
+};
+
+/**
+ * Holds an array of quaternions as one array per component.
+ */
+struct QuatArray {
+  std::vector<real_t> w, x, y, z;
+
+  glm::quat get(uint32_t i) const { return glm::quat(w[i], x[i], y[i], z[i]); }
+
+  void set(uint32_t i, const glm::quat &q) {
+    w[i] = q.w;
+    x[i] = q.x;
+    y[i] = q.y;
+    z[i] = q.z;
+  }
+
+  void resize(size_t size) {
+    w.resize(size);
+    x.resize(size);
+    y.resize(size);
+    z.resize(size);
+  }
+};
+
+/**
+ * Holds an array of square matrices of the given size as one array
+ * per element. Element m[column * N + row] holds that element of
+ * every matrix.
+ */
+template <typename Matrix, int N> struct MatrixArray {
+  std::vector<real_t> m[N * N];
+
+  Matrix get(uint32_t i) const {
+    Matrix matrix;
+    for (int c = 0; c < N; ++c)
+      for (int r = 0; r < N; ++r)
+        matrix[c][r] = m[c * N + r][i];
+    return matrix;
+  }
+
+  void set(uint32_t i, const Matrix &matrix) {
+    for (int c = 0; c < N; ++c)
+      for (int r = 0; r < N; ++r)
+        m[c * N + r][i] = matrix[c][r];
+  }
+
+  void resize(size_t size) {
+    for (auto &element : m)
+      element.resize(size);
+  }
+};
+
+using Mat3Array = MatrixArray<glm::mat3, 3>;
+using Mat4Array = MatrixArray<glm::mat4, 4>;
+
+class RigidBodyStore {
+public:
+  using pointer = std::shared_ptr<RigidBodyStore>;
+  using raw_ptr = RigidBodyStore *;
+
+  /**
+   * A copy of the state of every body of a store, taken by saveState:
+   * the position, orientation, velocity, rotation, motion, awake flag,
+   * accumulators and the data derived from them, everything a step
+   * changes. The characteristics set by the application, the mass or
+   * the damping for instance, aren't part of it.
+   *
+   * The arrays keep their room from one save to the next, so saving
+   * again into the same state allocates nothing.
+   */
+  struct State {
+    /**
+     * The saved arrays one after the other, each as long as the
+     * arrays of the store.
+     */
+    std::vector<real_t> values;
+    std::vector<uint8_t> isAwake;
+    std::vector<uint8_t> alive;
+    /**
+     * The number of bodies the store had created and destroyed when
+     * the state was saved.
+     */
+    uint64_t changes = 0;
+  };
+
+  /**
+   * The number of arrays of real_t in a State.
+   */
+  static constexpr uint32_t STATE_ARRAYS = 44;
+
+  /**
+   * The value returned for an invalid handle.
+   */
+  static constexpr uint32_t NULL_HANDLE = 0xffffffff;
+
+  /**
+   * Returns the store used by the rigid bodies that are not given
+   * one explicitly.
+   */
+  static RigidBodyStore &getDefault();
+
+  /**
+   * Creates an empty store, integrating with the widest instruction
+   * set the processor supports.
+   */
+  RigidBodyStore();
+
+  /**
+   * Adds a new body to the store and returns its handle. The body is
+   * awake, allowed to sleep, has an identity orientation and inertia
+   * tensor and everything else set to zero.
+   *
+   * The lowest free handle is handed out first, so that the bodies
+   * made in the same order get the same handles whatever the store
+   * held before: the contacts are solved in the order of the handles.
+   */
+  uint32_t create();
+
+  /**
+   * Removes the given body. Its handle may be handed out again.
+   */
+  void destroy(uint32_t handle);
+
+  /**
+   * Returns true if the handle refers to a live body.
+   */
+  bool isValid(uint32_t handle) const {
+    return handle < alive.size() && alive[handle];
+  }
+
+  /**
+   * Returns the number of live bodies.
+   */
+  uint32_t getCount() const { return _count; }
+
+  /**
+   * Returns the size of the arrays, live bodies and free slots
+   * included.
+   */
+  uint32_t getCapacity() const { return (uint32_t)alive.size(); }
+
+  /**
+   * Calculates the transform matrix and the world inverse inertia
+   * tensor of the given body from its position and orientation.
+   */
+  void calculateDerivedData(uint32_t handle);
+
+  /**
+   * Integrates the given body forward in time by the given amount,
+   * in the same way as RigidBody::integrate.
+   */
+  void integrate(uint32_t handle, real_t duration);
+
+  /**
+   * Integrates every live and awake body of the store forward in
+   * time by the given amount. With the scalar instruction set the
+   * results are exactly the ones of calling integrate for every body.
+   * With SSE or AVX2 the awake bodies are integrated four or eight at
+   * a time; the results then match the scalar ones up to the rounding
+   * of the vectorised damping.
+   */
+  void integrateAll(real_t duration);
+
+  /**
+   * Sets the instruction set used by integrateAll. Asking for one
+   * the processor doesn't support falls back to the widest one it
+   * does.
+   */
+  void setSimdLevel(SimdLevel level);
+  SimdLevel getSimdLevel() const { return _simdLevel; }
+
+  /**
+   * Returns the raw arrays of the store, for the vectorised kernels.
+   * They are invalidated when a body is created.
+   */
+  IntegrationArrays getArrays();
+
+  /**
+   * Copies the state of every body into the given state, one array
+   * at a time.
+   */
+  void saveState(State &state) const;
+
+  /**
+   * Copies the given state back into the bodies. It fails, and
+   * changes nothing, if a body was created or destroyed since the
+   * state was saved, even one whose handle was handed out again.
+   *
+   * If moved is given, it is set to the handles of the bodies asleep
+   * in the state whose position or orientation was not the saved one:
+   * the simulation only updates what depends on the pose of the
+   * bodies, their collision shapes, for the awake ones.
+   */
+  bool restoreState(const State &state,
+                    std::vector<uint32_t> *moved = nullptr);
+
+  /**
+   * Sets the awake state of the given body, as RigidBody::setAwake.
+   */
+  void setAwake(uint32_t handle, bool awake);
+
+  /**
+   * Sets whether the given body is put to sleep by the islands it
+   * belongs to rather than on its own. Integrating such a body still
+   * tracks its motion, but never puts it to sleep: an IslandBuilder
+   * sets it for the bodies registered with it, and only whole islands
+   * are put to sleep. It is off for a new body.
+   */
+  void setIslandSleep(uint32_t handle, bool islandSleep) {
+    this->islandSleep[handle] = islandSleep;
+  }
+  bool getIslandSleep(uint32_t handle) const {
+    return islandSleep[handle] != 0;
+  }
+
+  /**
+   * @name Characteristic Data and State
+   *
+   * Each array holds one field of every body, indexed by handle.
+   * See the RigidBody accessors for the meaning of each field.
+   */
+  /*@{*/
+  std::vector<real_t> inverseMass;
+  std::vector<real_t> linearDamping;
+  std::vector<real_t> angularDamping;
+  std::vector<real_t> motion;
+  Vec3Array position;
+  QuatArray orientation;
+  Vec3Array velocity;
+  Vec3Array rotation;
+  /**
+   * The inverse inertia tensors in body space and in world space.
+   */
+  Mat3Array inverseInertiaTensor;
+  Mat3Array inverseInertiaTensorWorld;
+  Mat4Array transformMatrix;
+  /**
+   * Flags are stored as bytes rather than in a vector of bool, so
+   * that they can be read and written without masking.
+   */
+  std::vector<uint8_t> isAwake;
+  std::vector<uint8_t> canSleep;
+  std::vector<uint8_t> islandSleep;
+  std::vector<uint8_t> alive;
+  /*@}*/
+
+  /**
+   * @name Force and Torque Accumulators
+   */
+  /*@{*/
+  Vec3Array forceAccum;
+  Vec3Array torqueAccum;
+  Vec3Array acceleration;
+  Vec3Array lastFrameAcceleration;
+  /*@}*/
+
+protected:
+  /**
+   * The free handles, in a heap with the lowest on top.
+   */
+  std::vector<uint32_t> _freeHandles;
+  uint32_t _count = 0;
+  /**
+   * Counts the bodies created and destroyed, so that a restored state
+   * can tell a reused handle from the body it was saved with.
+   */
+  uint64_t _changes = 0;
+  SimdLevel _simdLevel;
+  /**
+   * Holds the handles of the awake bodies during integrateAll.
+   */
+  std::vector<uint32_t> _awakeHandles;
+};
+
+} // namespace ft
+
+#endif // FT_BODYSTORE_H
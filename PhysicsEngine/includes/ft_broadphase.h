@@ -0,0 +1,345 @@
+/**
+ * @file
+ *
+ * This file contains the broad phase of the collision detection
+ * system. A broad phase keeps a bounding box (a proxy) for every
+ * object in the simulation and reports the pairs of proxies whose
+ * boxes overlap. Only those pairs are then handed to the fine grained
+ * tests in the CollisionDetector.
+ */
+#ifndef FT_BROADPHASE_H
+#define FT_BROADPHASE_H
+
+#include "ft_collideCoarse.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ft {
+
+/**
+ * Holds a pair of proxies whose bounding boxes overlap. A pair is
+ * always reported once, with the smaller proxy id first.
+ */
+struct BroadphasePair {
+  uint32_t first;
+  uint32_t second;
+};
+
+/**
+ * This is the basic polymorphic interface for broad phase
+ * algorithms. Objects are registered with a bounding box and get
+ * back a proxy id, which is a small integer that the caller can use
+ * to index its own tables.
+ */
+class Broadphase {
+public:
+  using pointer = std::shared_ptr<Broadphase>;
+  using raw_ptr = Broadphase *;
+
+  /**
+   * The value returned for an invalid proxy.
+   */
+  static constexpr uint32_t NULL_PROXY = 0xffffffff;
+
+  virtual ~Broadphase() = default;
+
+  /**
+   * Registers a new proxy with the given bounding box and returns
+   * its id.
+   */
+  virtual uint32_t createProxy(const BoundingBox &box) = 0;
+
+  /**
+   * Removes the given proxy. Its id may be handed out again by a
+   * later call to createProxy.
+   */
+  virtual void destroyProxy(uint32_t proxy) = 0;
+
+  /**
+   * Updates the bounding box of the given proxy.
+   */
+  virtual void moveProxy(uint32_t proxy, const BoundingBox &box) = 0;
+
+  /**
+   * Clears the given vector and fills it with every pair of proxies
+   * whose bounding boxes overlap. Each pair is reported only once.
+   */
+  virtual void findPairs(std::vector<BroadphasePair> &pairs) = 0;
+
+  /**
+   * Returns the number of live proxies.
+   */
+  virtual uint32_t getProxyCount() const = 0;
+};
+
+/**
+ * A broad phase that tests every proxy against every other one. It
+ * is O(n^2) and is only meant as a reference for the other
+ * algorithms and for very small scenes.
+ */
+class BruteForceBroadphase : public Broadphase {
+public:
+  using pointer = std::shared_ptr<BruteForceBroadphase>;
+  using raw_ptr = BruteForceBroadphase *;
+
+  uint32_t createProxy(const BoundingBox &box) override;
+  void destroyProxy(uint32_t proxy) override;
+  void moveProxy(uint32_t proxy, const BoundingBox &box) override;
+  void findPairs(std::vector<BroadphasePair> &pairs) override;
+  uint32_t getProxyCount() const override;
+
+protected:
+  std::vector<BoundingBox> _boxes;
+  std::vector<bool> _alive;
+  std::vector<uint32_t> _freeProxies;
+  uint32_t _proxyCount = 0;
+};
+
+/**
+ * A broad phase that sorts the proxies along one axis every time
+ * pairs are requested and sweeps over the sorted list, only testing
+ * proxies whose intervals on that axis overlap. The axis is chosen
+ * as the one along which the proxies are the most spread out. This
+ * needs no persistent state beyond the boxes, which makes it a good
+ * default for scenes where everything moves.
+ */
+class SortAndSweepBroadphase : public Broadphase {
+public:
+  using pointer = std::shared_ptr<SortAndSweepBroadphase>;
+  using raw_ptr = SortAndSweepBroadphase *;
+
+  uint32_t createProxy(const BoundingBox &box) override;
+  void destroyProxy(uint32_t proxy) override;
+  void moveProxy(uint32_t proxy, const BoundingBox &box) override;
+  void findPairs(std::vector<BroadphasePair> &pairs) override;
+  uint32_t getProxyCount() const override;
+
+protected:
+  /**
+   * Holds one entry of the sorted list: the extent of the box on
+   * the sweep axis and the proxy it belongs to.
+   */
+  struct SweepEntry {
+    real_t min;
+    real_t max;
+    uint32_t proxy;
+  };
+
+  std::vector<BoundingBox> _boxes;
+  std::vector<bool> _alive;
+  std::vector<uint32_t> _freeProxies;
+  std::vector<SweepEntry> _sorted;
+  uint32_t _proxyCount = 0;
+};
+
+/**
+ * A broad phase built on a DynamicAABBTree. Proxies that only move a
+ * little stay in their leaf, so the cost of a frame is mostly the
+ * pair query, which only visits the parts of the tree that overlap.
+ * This is the default broad phase of the engine.
+ */
+class AABBTreeBroadphase : public Broadphase {
+public:
+  using pointer = std::shared_ptr<AABBTreeBroadphase>;
+  using raw_ptr = AABBTreeBroadphase *;
+
+  /**
+   * Creates the broad phase. The margin is how much the boxes are
+   * fattened in the tree.
+   */
+  AABBTreeBroadphase(real_t margin = (real_t)0.1);
+
+  uint32_t createProxy(const BoundingBox &box) override;
+  void destroyProxy(uint32_t proxy) override;
+  void moveProxy(uint32_t proxy, const BoundingBox &box) override;
+  void findPairs(std::vector<BroadphasePair> &pairs) override;
+  uint32_t getProxyCount() const override;
+
+  /**
+   * Gives access to the underlying tree, for queries.
+   */
+  const DynamicAABBTree &getTree() const { return _tree; }
+
+protected:
+  DynamicAABBTree _tree;
+  /**
+   * Holds the exact box of every proxy. The tree only knows the
+   * fattened boxes, so the pairs it reports are checked again
+   * against these before being returned.
+   */
+  std::vector<BoundingBox> _boxes;
+  std::vector<uint32_t> _leaves;
+  std::vector<uint32_t> _freeProxies;
+  uint32_t _proxyCount = 0;
+};
+
+/**
+ * An incremental sweep and prune broad phase. The minimum and
+ * maximum of every proxy on each of the three axes are kept in three
+ * sorted endpoint arrays. When a proxy moves its endpoints are moved
+ * to their new place with an insertion sort, which costs next to
+ * nothing when the motion is coherent, as in a pile of bodies
+ * settling down. Every time two endpoints of different proxies swap,
+ * the overlap of those two proxies is checked again, so the set of
+ * overlapping pairs is always up to date and never has to be rebuilt.
+ *
+ * Like the AABB tree, the endpoints come from fattened boxes, so a
+ * proxy that barely moves doesn't touch the arrays at all. The pair
+ * cache holds the pairs whose fat boxes overlap; findPairs only
+ * returns the ones whose exact boxes overlap, while the added and
+ * removed pairs report the changes of the cache itself since the
+ * previous call to findPairs.
+ */
+class SweepAndPruneBroadphase : public Broadphase {
+public:
+  using pointer = std::shared_ptr<SweepAndPruneBroadphase>;
+  using raw_ptr = SweepAndPruneBroadphase *;
+
+  /**
+   * Creates the broad phase. The margin is how much the boxes are
+   * fattened in the endpoint arrays.
+   */
+  SweepAndPruneBroadphase(real_t margin = (real_t)0.1);
+
+  uint32_t createProxy(const BoundingBox &box) override;
+  void destroyProxy(uint32_t proxy) override;
+  void moveProxy(uint32_t proxy, const BoundingBox &box) override;
+  void findPairs(std::vector<BroadphasePair> &pairs) override;
+  uint32_t getProxyCount() const override;
+
+  /**
+   * Returns the pairs that entered the cache before the last call
+   * to findPairs and after the one before it.
+   */
+  const std::vector<BroadphasePair> &getAddedPairs() const {
+    return _addedPairs;
+  }
+
+  /**
+   * Returns the pairs that left the cache before the last call to
+   * findPairs and after the one before it. Pairs that lost a proxy
+   * because it was destroyed are included.
+   */
+  const std::vector<BroadphasePair> &getRemovedPairs() const {
+    return _removedPairs;
+  }
+
+protected:
+  /**
+   * One end of the interval of a proxy on one axis. The lowest bit
+   * of data tells if this is the maximum, the other bits hold the
+   * proxy.
+   */
+  struct Endpoint {
+    real_t value;
+    uint32_t data;
+
+    uint32_t getProxy() const { return data >> 1; }
+    bool isMax() const { return (data & 1) != 0; }
+  };
+
+  /**
+   * Holds where the endpoints of a proxy are in the sorted arrays.
+   */
+  struct SapProxy {
+    uint32_t min[3];
+    uint32_t max[3];
+    bool alive;
+  };
+
+  static uint64_t pairKey(uint32_t one, uint32_t two);
+  static bool endpointLess(const Endpoint &one, const Endpoint &two);
+  void sortDown(int axis, uint32_t index);
+  void sortUp(int axis, uint32_t index);
+  void setEndpointIndex(int axis, uint32_t index);
+  void beginOverlap(uint32_t moving, uint32_t other);
+  void endOverlap(uint32_t moving, uint32_t other);
+  bool removePair(uint64_t key);
+
+  std::vector<Endpoint> _endpoints[3];
+  std::vector<SapProxy> _proxies;
+  std::vector<BoundingBox> _boxes;
+  std::vector<BoundingBox> _fatBoxes;
+  std::vector<uint32_t> _freeProxies;
+  uint32_t _proxyCount = 0;
+  /**
+   * Holds the fat box of the proxy being moved as it was before the
+   * move.
+   */
+  BoundingBox _movingBox;
+  real_t _margin;
+
+  /**
+   * Holds the pair cache, packed, and where each pair is in it.
+   */
+  std::vector<BroadphasePair> _cachedPairs;
+  std::unordered_map<uint64_t, uint32_t> _pairIndex;
+  /**
+   * Holds the net change of every pair touched since the last call
+   * to findPairs: +1 if it was added, -1 if it was removed and 0 if
+   * it went back to where it was.
+   */
+  std::unordered_map<uint64_t, int> _pairChanges;
+  std::vector<BroadphasePair> _addedPairs;
+  std::vector<BroadphasePair> _removedPairs;
+};
+
+/**
+ * A broad phase built on a SpatialHashGrid, rebuilt from scratch
+ * every time pairs are requested. It is the fastest choice when the
+ * objects all have about the same size, as in a pit of balls, and
+ * its cost doesn't depend on how the objects move.
+ */
+class SpatialHashBroadphase : public Broadphase {
+public:
+  using pointer = std::shared_ptr<SpatialHashBroadphase>;
+  using raw_ptr = SpatialHashBroadphase *;
+
+  /**
+   * Creates the broad phase. If the cell size is not positive, it
+   * is picked from the median radius of the proxies at every
+   * rebuild.
+   */
+  SpatialHashBroadphase(real_t cellSize = 0);
+
+  uint32_t createProxy(const BoundingBox &box) override;
+  void destroyProxy(uint32_t proxy) override;
+  void moveProxy(uint32_t proxy, const BoundingBox &box) override;
+  void findPairs(std::vector<BroadphasePair> &pairs) override;
+  uint32_t getProxyCount() const override;
+
+  /**
+   * Gives access to the grid for neighbour queries. It holds the
+   * proxies as they were at the last call to findPairs.
+   */
+  const SpatialHashGrid &getGrid() const { return _grid; }
+
+protected:
+  SpatialHashGrid _grid;
+  std::vector<BoundingBox> _boxes;
+  std::vector<uint32_t> _freeProxies;
+  uint32_t _proxyCount = 0;
+  real_t _cellSize;
+};
+
+/**
+ * The broad phases that can be picked by name.
+ */
+enum class BroadphaseType {
+  BRUTE_FORCE,
+  SORT_AND_SWEEP,
+  AABB_TREE,
+  SWEEP_AND_PRUNE,
+  SPATIAL_HASH
+};
+
+/**
+ * Creates a broad phase of the given type.
+ */
+Broadphase::pointer createBroadphase(BroadphaseType type);
+
+} // namespace ft
+
+#endif // FT_BROADPHASE_H
@@ -9,8 +9,12 @@
 #define FT_COLLISION_COARSE_H
 
 #include "ft_contacts.h"
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace ft {
 
@@ -60,273 +64,406 @@ public:
 };
 
 /**
- * Stores a potential contact to check later.
+ * Represents an axis aligned bounding box that can be tested for
+ * overlap. This is the volume used by the broad phase: it is cheap
+ * to build from any primitive and cheap to test.
  */
-struct PotentialContact {
+struct BoundingBox {
+  glm::vec3 min;
+  glm::vec3 max;
+
+public:
+  BoundingBox() = default;
+
+  /**
+   * Creates a new bounding box from its minimum and maximum corners.
+   */
+  BoundingBox(const glm::vec3 &min, const glm::vec3 &max);
+
+  /**
+   * Creates a bounding box to enclose the two given bounding boxes.
+   */
+  BoundingBox(const BoundingBox &one, const BoundingBox &two);
+
+  /**
+   * Checks if the bounding box overlaps with the other given
+   * bounding box.
+   */
+  bool overlaps(const BoundingBox *other) const {
+    // The tests are combined without branching: in a broad phase
+    // the result is close to random and mispredictions would cost
+    // more than the comparisons.
+    return (min.x <= other->max.x) & (other->min.x <= max.x) &
+           (min.y <= other->max.y) & (other->min.y <= max.y) &
+           (min.z <= other->max.z) & (other->min.z <= max.z);
+  }
+
+  /**
+   * Checks if the given bounding box lies completely inside this one.
+   */
+  bool contains(const BoundingBox &other) const;
+
   /**
-   * Holds the bodies that might be in contact.
+   * Reports how much the surface area of this bounding box would
+   * grow by to incorporate the given bounding box.
    */
-  RigidBody *body[2];
+  real_t getGrowth(const BoundingBox &other) const;
+
+  /**
+   * Returns the surface area of the box. Surface area is a better
+   * measure than volume for building hierarchies, since it is
+   * proportional to the chance of a random ray hitting the box.
+   */
+  real_t getSize() const {
+    glm::vec3 d = max - min;
+    return (real_t)2.0 * (d.x * d.y + d.y * d.z + d.z * d.x);
+  }
 };
 
 /**
- * A base class for nodes in a bounding volume hierarchy.
+ * A dynamic bounding volume hierarchy of axis aligned bounding boxes.
  *
- * This class uses a binary tree to store the bounding
- * volumes.
+ * Every leaf of the tree holds a fattened copy of the box it was
+ * given, so an object that moves a little stays inside its leaf and
+ * does not need to be reinserted. Nodes live in a single contiguous
+ * pool and refer to each other by index; freed nodes are kept in a
+ * free list and reused. The tree is kept balanced with rotations on
+ * the way back up from every insertion and removal, which keeps
+ * insert, remove and move at O(log n).
  */
-template <class BoundingVolumeClass> class BVHNode {
+class DynamicAABBTree {
 public:
+  using pointer = std::shared_ptr<DynamicAABBTree>;
+  using raw_ptr = DynamicAABBTree *;
+
   /**
-   * Holds the child nodes of this node.
+   * The index used for a missing node.
    */
-  BVHNode *children[2];
+  static constexpr uint32_t NULL_NODE = 0xffffffff;
 
   /**
-   * Holds a single bounding volume encompassing all the
-   * descendents of this node.
+   * Creates an empty tree. The margin is added on every side of
+   * the boxes stored in the leaves.
    */
-  BoundingVolumeClass volume;
+  DynamicAABBTree(real_t margin = (real_t)0.1);
 
   /**
-   * Holds the rigid body at this node of the hierarchy.
-   * Only leaf nodes can have a rigid body defined (see isLeaf).
-   * Note that it is possible to rewrite the algorithms in this
-   * class to handle objects at all levels of the hierarchy,
-   * but the code provided ignores this vector unless firstChild
-   * is NULL.
+   * Inserts a new leaf holding a fattened copy of the given box and
+   * the given user data. Returns the index of the leaf, which stays
+   * valid until the leaf is destroyed.
    */
-  RigidBody *body;
+  uint32_t createLeaf(const BoundingBox &box, uint32_t userData);
 
-  // ... other BVHNode code as before ...
+  /**
+   * Removes the given leaf from the tree.
+   */
+  void destroyLeaf(uint32_t leaf);
 
   /**
-   * Holds the node immediately above us in the tree.
+   * Updates the box of the given leaf. Nothing happens as long as
+   * the new box is still inside the fattened one; otherwise the leaf
+   * is reinserted with a new fattened box and true is returned.
    */
-  BVHNode *parent;
+  bool moveLeaf(uint32_t leaf, const BoundingBox &box);
 
   /**
-   * Creates a new node in the hierarchy with the given parameters.
+   * Returns the user data stored in the given leaf.
    */
-  BVHNode(BVHNode *parent, const BoundingVolumeClass &volume,
-          RigidBody *body = NULL)
-      : parent(parent), volume(volume), body(body) {
-    children[0] = children[1] = NULL;
-  }
+  uint32_t getUserData(uint32_t leaf) const { return _nodes[leaf].userData; }
 
   /**
-   * Checks if this node is at the bottom of the hierarchy.
+   * Returns the fattened box stored in the given leaf.
    */
-  bool isLeaf() const { return (body != NULL); }
+  const BoundingBox &getFatBox(uint32_t leaf) const {
+    return _nodes[leaf].box;
+  }
 
   /**
-   * Checks the potential contacts from this node downwards in
-   * the hierarchy, writing them to the given array (up to the
-   * given limit). Returns the number of potential contacts it
-   * found.
+   * Calls the given callback with the user data of every leaf whose
+   * fattened box overlaps the given box.
    */
-  unsigned getPotentialContacts(PotentialContact *contacts,
-                                unsigned limit) const;
+  template <class Callback>
+  void query(const BoundingBox &box, Callback callback) const;
 
   /**
-   * Inserts the given rigid body, with the given bounding volume,
-   * into the hierarchy. This may involve the creation of
-   * further bounding volume nodes.
+   * Calls the given callback with the user data of both leaves for
+   * every pair of leaves whose fattened boxes overlap. Each pair is
+   * visited only once.
    */
-  void insert(RigidBody *body, const BoundingVolumeClass &volume);
+  template <class Callback> void queryPairs(Callback callback) const;
 
   /**
-   * Deltes this node, removing it first from the hierarchy, along
-   * with its associated
-   * rigid body and child nodes. This method deletes the node
-   * and all its children (but obviously not the rigid bodies). This
-   * also has the effect of deleting the sibling of this node, and
-   * changing the parent node so that it contains the data currently
-   * in that sibling. Finally it forces the hierarchy above the
-   * current node to reconsider its bounding volume.
+   * Returns the height of the tree, a single leaf has a height of 0.
    */
-  ~BVHNode();
+  int getHeight() const;
 
-protected:
   /**
-   * Checks for overlapping between nodes in the hierarchy. Note
-   * that any bounding volume should have an overlaps method implemented
-   * that checks for overlapping with another object of its own type.
+   * Returns the number of leaves in the tree.
    */
-  bool overlaps(const BVHNode<BoundingVolumeClass> *other) const;
+  uint32_t getLeafCount() const { return _leafCount; }
 
   /**
-   * Checks the potential contacts between this node and the given
-   * other node, writing them to the given array (up to the
-   * given limit). Returns the number of potential contacts it
-   * found.
+   * Walks the whole tree and checks that the links, heights and
+   * boxes are consistent. Only meant for debugging.
    */
-  unsigned getPotentialContactsWith(const BVHNode<BoundingVolumeClass> *other,
-                                    PotentialContact *contacts,
-                                    unsigned limit) const;
+  bool validate() const;
 
+protected:
   /**
-   * For non-leaf nodes, this method recalculates the bounding volume
-   * based on the bounding volumes of its children.
+   * A node of the tree. Leaves have no children and hold user data;
+   * branches hold the union of the boxes of their two children. A
+   * node in the free list uses parent as the link to the next free
+   * node.
    */
-  void recalculateBoundingVolume(bool recurse = true);
+  struct TreeNode {
+    BoundingBox box;
+    uint32_t parent;
+    uint32_t children[2];
+    uint32_t userData;
+    int height;
+
+    bool isLeaf() const { return children[0] == NULL_NODE; }
+  };
+
+  uint32_t allocateNode();
+  void freeNode(uint32_t node);
+  void insertLeaf(uint32_t leaf);
+  void removeLeaf(uint32_t leaf);
+  uint32_t balance(uint32_t node);
+  bool validateNode(uint32_t node) const;
+
+  std::vector<TreeNode> _nodes;
+  uint32_t _root = NULL_NODE;
+  uint32_t _freeList = NULL_NODE;
+  uint32_t _leafCount = 0;
+  real_t _margin;
 };
 
-// Note that, because we're dealing with a template here, we
-// need to have the implementations accessible to anything that
-// imports this header.
+/**
+ * A uniform grid of cells, stored in a hash table so that it covers
+ * all of space without having to know its bounds.
+ *
+ * The grid is rebuilt from scratch from a list of boxes: every box
+ * is entered in each cell it touches, and the entries are laid out
+ * contiguously, bucket by bucket, with a counting sort. This is very
+ * cheap when all the objects have about the same size, as in a pit
+ * of balls or a cloud of particles. The cell size is picked from the
+ * median radius of the boxes unless one is given.
+ *
+ * A pair of boxes that share several cells is only reported by the
+ * cell holding the minimum corner of their intersection, so every
+ * pair is found once without having to remember what was reported.
+ */
+class SpatialHashGrid {
+public:
+  using pointer = std::shared_ptr<SpatialHashGrid>;
+  using raw_ptr = SpatialHashGrid *;
 
-template <class BoundingVolumeClass>
-bool BVHNode<BoundingVolumeClass>::overlaps(
-    const BVHNode<BoundingVolumeClass> *other) const {
-  return volume->overlaps(other->volume);
-}
+  /**
+   * How many median radii make the side of a cell, when the cell
+   * size is chosen automatically. Four radii make a cell as wide as
+   * two median objects.
+   */
+  static constexpr real_t CELL_SCALE = (real_t)4.0;
 
-template <class BoundingVolumeClass>
-void BVHNode<BoundingVolumeClass>::insert(
-    RigidBody *newBody, const BoundingVolumeClass &newVolume) {
-  // If we are a leaf, then the only option is to spawn two
-  // new children and place the new body in one.
-  if (isLeaf()) {
-    // Child one is a copy of us.
-    children[0] = new BVHNode<BoundingVolumeClass>(this, volume, body);
+  /**
+   * Rebuilds the grid from the given boxes. The index of a box in
+   * the array is the id reported by the queries. Boxes whose minimum
+   * is above their maximum are empty and are left out. If the cell
+   * size is not positive it is picked from the median radius.
+   */
+  void build(const BoundingBox *boxes, uint32_t count, real_t cellSize = 0);
 
-    // Child two holds the new body
-    children[1] = new BVHNode<BoundingVolumeClass>(this, newVolume, newBody);
+  /**
+   * Calls the given callback with the id of every box that overlaps
+   * the given box.
+   */
+  template <class Callback>
+  void query(const BoundingBox &box, Callback callback) const;
+
+  /**
+   * Calls the given callback with both ids, the smallest first, for
+   * every pair of overlapping boxes.
+   */
+  template <class Callback> void findPairs(Callback callback) const {
+    findPairs(0, getBucketCount(), callback);
+  }
 
-    // And we now loose the body (we're no longer a leaf)
-    this->body = NULL;
+  /**
+   * Same as above, but only for the pairs reported by the buckets
+   * in the range [first, last). The buckets can be split between
+   * threads this way, every pair belongs to exactly one bucket.
+   */
+  template <class Callback>
+  void findPairs(uint32_t first, uint32_t last, Callback callback) const;
 
-    // We need to recalculate our bounding volume
-    recalculateBoundingVolume();
+  uint32_t getBucketCount() const {
+    return _bucketStart.empty() ? 0 : (uint32_t)_bucketStart.size() - 1;
   }
 
-  // Otherwise we need to work out which child gets to keep
-  // the inserted body. We give it to whoever would grow the
-  // least to incorporate it.
-  else {
-    if (children[0]->volume.getGrowth(newVolume) <
-        children[1]->volume.getGrowth(newVolume)) {
-      children[0]->insert(newBody, newVolume);
-    } else {
-      children[1]->insert(newBody, newVolume);
-    }
+  real_t getCellSize() const { return _cellSize; }
+
+protected:
+  /**
+   * One box entered in one cell. The box is copied in so that the
+   * pair search reads the buckets in order.
+   */
+  struct Entry {
+    BoundingBox box;
+    uint32_t id;
+    int32_t cell[3];
+  };
+
+  int32_t cellCoordinate(real_t value) const {
+    return (int32_t)std::floor(value * _inverseCellSize);
   }
-}
 
-template <class BoundingVolumeClass> BVHNode<BoundingVolumeClass>::~BVHNode() {
-  // If we don't have a parent, then we ignore the sibling
-  // processing
-  if (parent) {
-    // Find our sibling
-    BVHNode<BoundingVolumeClass> *sibling;
-    if (parent->children[0] == this)
-      sibling = parent->children[1];
-    else
-      sibling = parent->children[0];
-
-    // Write its data to our parent
-    parent->volume = sibling->volume;
-    parent->body = sibling->body;
-    parent->children[0] = sibling->children[0];
-    parent->children[1] = sibling->children[1];
-
-    // Delete the sibling (we blank its parent and
-    // children to avoid processing/deleting them)
-    sibling->parent = NULL;
-    sibling->body = NULL;
-    sibling->children[0] = NULL;
-    sibling->children[1] = NULL;
-    delete sibling;
-
-    // Recalculate the parent's bounding volume
-    parent->recalculateBoundingVolume();
+  uint32_t hashCell(int32_t x, int32_t y, int32_t z) const {
+    return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^
+            (uint32_t)z * 83492791u) &
+           _mask;
   }
 
-  // Delete our children (again we remove their
-  // parent data so we don't try to process their siblings
-  // as they are deleted).
-  if (children[0]) {
-    children[0]->parent = NULL;
-    delete children[0];
+  /**
+   * Checks if the given cell is the one that reports the overlap of
+   * the two boxes.
+   */
+  bool ownsOverlap(const int32_t cell[3], const BoundingBox &one,
+                   const BoundingBox &two) const {
+    return cell[0] == cellCoordinate(std::max(one.min.x, two.min.x)) &&
+           cell[1] == cellCoordinate(std::max(one.min.y, two.min.y)) &&
+           cell[2] == cellCoordinate(std::max(one.min.z, two.min.z));
   }
-  if (children[1]) {
-    children[1]->parent = NULL;
-    delete children[1];
+
+  std::vector<Entry> _entries;
+  std::vector<uint32_t> _bucketStart;
+  std::vector<real_t> _radii;
+  real_t _cellSize = 1;
+  real_t _inverseCellSize = 1;
+  uint32_t _mask = 0;
+};
+
+// The queries take any callable, so they are implemented here.
+
+template <class Callback>
+void DynamicAABBTree::query(const BoundingBox &box, Callback callback) const {
+  if (_root == NULL_NODE)
+    return;
+
+  std::vector<uint32_t> stack;
+  stack.reserve(64);
+  stack.push_back(_root);
+
+  while (!stack.empty()) {
+    const TreeNode &node = _nodes[stack.back()];
+    stack.pop_back();
+
+    if (!node.box.overlaps(&box))
+      continue;
+
+    if (node.isLeaf()) {
+      callback(node.userData);
+    } else {
+      stack.push_back(node.children[0]);
+      stack.push_back(node.children[1]);
+    }
   }
 }
 
-template <class BoundingVolumeClass>
-void BVHNode<BoundingVolumeClass>::recalculateBoundingVolume(bool recurse) {
-  (void)recurse;
-  if (isLeaf())
+template <class Callback>
+void DynamicAABBTree::queryPairs(Callback callback) const {
+  if (_root == NULL_NODE)
     return;
 
-  // Use the bounding volume combining constructor.
-  volume = BoundingVolumeClass(children[0]->volume, children[1]->volume);
+  // Each entry is a pair of subtrees to test against each other. A
+  // pair made of the same node twice means the pairs inside that
+  // subtree: they are those inside each child plus those between
+  // the two children, which is how every pair is reached only once.
+  std::vector<std::pair<uint32_t, uint32_t>> stack;
+  stack.reserve(128);
+  stack.emplace_back(_root, _root);
+
+  while (!stack.empty()) {
+    auto [a, b] = stack.back();
+    stack.pop_back();
+
+    const TreeNode &one = _nodes[a];
+    if (a == b) {
+      if (one.isLeaf())
+        continue;
+      stack.emplace_back(one.children[0], one.children[0]);
+      stack.emplace_back(one.children[1], one.children[1]);
+      stack.emplace_back(one.children[0], one.children[1]);
+      continue;
+    }
 
-  // Recurse up the tree
-  if (parent)
-    parent->recalculateBoundingVolume(true);
+    const TreeNode &two = _nodes[b];
+    if (!one.box.overlaps(&two.box))
+      continue;
+
+    if (one.isLeaf() && two.isLeaf()) {
+      callback(one.userData, two.userData);
+    } else if (two.isLeaf() ||
+               (!one.isLeaf() && one.box.getSize() >= two.box.getSize())) {
+      // Descend into the bigger of the two.
+      stack.emplace_back(one.children[0], b);
+      stack.emplace_back(one.children[1], b);
+    } else {
+      stack.emplace_back(a, two.children[0]);
+      stack.emplace_back(a, two.children[1]);
+    }
+  }
 }
 
-template <class BoundingVolumeClass>
-unsigned
-BVHNode<BoundingVolumeClass>::getPotentialContacts(PotentialContact *contacts,
-                                                   unsigned limit) const {
-  // Early out if we don't have the room for contacts, or
-  // if we're a leaf node.
-  if (isLeaf() || limit == 0)
-    return 0;
-
-  // Get the potential contacts of one of our children with
-  // the other
-  return children[0]->getPotentialContactsWith(children[1], contacts, limit);
-}
+template <class Callback>
+void SpatialHashGrid::query(const BoundingBox &box, Callback callback) const {
+  if (_entries.empty())
+    return;
 
-template <class BoundingVolumeClass>
-unsigned BVHNode<BoundingVolumeClass>::getPotentialContactsWith(
-    const BVHNode<BoundingVolumeClass> *other, PotentialContact *contacts,
-    unsigned limit) const {
-  // Early out if we don't overlap or if we have no room
-  // to report contacts
-  if (!overlaps(other) || limit == 0)
-    return 0;
-
-  // If we're both at leaf nodes, then we have a potential contact
-  if (isLeaf() && other->isLeaf()) {
-    contacts->body[0] = body;
-    contacts->body[1] = other->body;
-    return 1;
+  int32_t min[3], max[3];
+  for (int i = 0; i < 3; ++i) {
+    min[i] = cellCoordinate(box.min[i]);
+    max[i] = cellCoordinate(box.max[i]);
   }
 
-  // Determine which node to descend into. If either is
-  // a leaf, then we descend the other. If both are branches,
-  // then we use the one with the largest size.
-  if (other->isLeaf() ||
-      (!isLeaf() && volume->getSize() >= other->volume->getSize())) {
-    // Recurse into ourself
-    unsigned count =
-        children[0]->getPotentialContactsWith(other, contacts, limit);
-
-    // Check we have enough slots to do the other side too
-    if (limit > count) {
-      return count + children[1]->getPotentialContactsWith(
-                         other, contacts + count, limit - count);
-    } else {
-      return count;
-    }
-  } else {
-    // Recurse into the other node
-    unsigned count =
-        getPotentialContactsWith(other->children[0], contacts, limit);
-
-    // Check we have enough slots to do the other side too
-    if (limit > count) {
-      return count + getPotentialContactsWith(other->children[1],
-                                              contacts + count, limit - count);
-    } else {
-      return count;
+  for (int32_t x = min[0]; x <= max[0]; ++x)
+    for (int32_t y = min[1]; y <= max[1]; ++y)
+      for (int32_t z = min[2]; z <= max[2]; ++z) {
+        uint32_t bucket = hashCell(x, y, z);
+        for (uint32_t i = _bucketStart[bucket]; i < _bucketStart[bucket + 1];
+             ++i) {
+          const Entry &entry = _entries[i];
+          if (entry.cell[0] != x || entry.cell[1] != y || entry.cell[2] != z)
+            continue;
+          if (entry.box.overlaps(&box) &&
+              ownsOverlap(entry.cell, box, entry.box))
+            callback(entry.id);
+        }
+      }
+}
+
+template <class Callback>
+void SpatialHashGrid::findPairs(uint32_t first, uint32_t last,
+                                Callback callback) const {
+  for (uint32_t bucket = first; bucket < last; ++bucket) {
+    uint32_t end = _bucketStart[bucket + 1];
+    for (uint32_t i = _bucketStart[bucket]; i < end; ++i) {
+      const Entry &one = _entries[i];
+      for (uint32_t j = i + 1; j < end; ++j) {
+        const Entry &two = _entries[j];
+        if (!one.box.overlaps(&two.box))
+          continue;
+        // Different cells may share a bucket.
+        if (one.cell[0] != two.cell[0] || one.cell[1] != two.cell[1] ||
+            one.cell[2] != two.cell[2])
+          continue;
+        if (!ownsOverlap(one.cell, one.box, two.box))
+          continue;
+        if (one.id < two.id)
+          callback(one.id, two.id);
+        else
+          callback(two.id, one.id);
+      }
     }
   }
 }
@@ -1,6 +1,8 @@
 #ifndef FT_COLLISION_FINE_H
 #define FT_COLLISION_FINE_H
 
+#include "ft_collideCoarse.h"
+#include "ft_contactArena.h"
 #include "ft_contacts.h"
 #include <glm/fwd.hpp>
 #include <memory>
@@ -22,6 +24,14 @@ public:
   friend class IntersectionTests;
   friend class CollisionDetector;
 
+  /**
+   * The kinds of primitives, used to pick the right collision
+   * routine when only a CollisionPrimitive is known.
+   */
+  enum class PrimitiveType { SPHERE, BOX };
+
+  CollisionPrimitive(PrimitiveType type) : _type(type) {}
+
   /**
    * The rigid body that is represented by this primitive.
    */
@@ -48,8 +58,17 @@ public:
 
   const glm::mat4 &getTransform() const { return transform; }
 
+  PrimitiveType getType() const { return _type; }
+
+  /**
+   * Returns the world space axis aligned box enclosing the
+   * primitive, whatever its type.
+   */
+  BoundingBox getBoundingBox() const;
+
 protected:
   glm::mat4 transform = glm::mat4(1.0f);
+  PrimitiveType _type;
 };
 
 /**
@@ -61,10 +80,18 @@ public:
   using pointer = std::shared_ptr<CollisionSphere>;
   using raw_ptr = CollisionSphere *;
 
+  CollisionSphere() : CollisionPrimitive(PrimitiveType::SPHERE) {}
+
   /**
    * The radius of the sphere.
    */
   real_t radius;
+
+  /**
+   * Returns the world space axis aligned box enclosing the sphere.
+   * The primitive's internals must be up to date.
+   */
+  BoundingBox getBoundingBox() const;
 };
 
 /**
@@ -97,10 +124,18 @@ public:
   using pointer = std::shared_ptr<CollisionBox>;
   using raw_ptr = CollisionBox *;
 
+  CollisionBox() : CollisionPrimitive(PrimitiveType::BOX) {}
+
   /**
    * Holds the half-sizes of the box along each of its local axes.
    */
   glm::vec3 halfSize;
+
+  /**
+   * Returns the world space axis aligned box enclosing the box.
+   * The primitive's internals must be up to date.
+   */
+  BoundingBox getBoundingBox() const;
 };
 
 /**
@@ -125,10 +160,25 @@ public:
 /**
  * A helper structure that contains information for the detector to use
  * in building its contact data.
+ *
+ * The contacts are written either into a fixed array, which drops the
+ * contacts found once it is full, or into a ContactArena, which makes
+ * room for as many as are found.
  */
 struct CollisionData {
+  /**
+   * The most contacts a single call of the detector writes.
+   */
+  static constexpr unsigned MAX_CONTACTS_PER_CALL = 8;
+
   Contact *contactArray;
 
+  /**
+   * Holds the arena the contacts are taken from, if any, in place of
+   * the contact array.
+   */
+  ContactArena *arena = nullptr;
+
   /** Holds the contact array to write into. */
   Contact *contacts;
 
@@ -160,11 +210,22 @@ struct CollisionData {
    * Resets the data so that it has no used contacts recorded.
    */
   void reset(unsigned maxContacts) {
+    arena = nullptr;
     contactsLeft = maxContacts;
     contactCount = 0;
     contacts = contactArray;
   }
 
+  /**
+   * Resets the data to take its contacts from the given arena, after
+   * those already taken from it. There is always room for more.
+   */
+  void reset(ContactArena &contactArena) {
+    arena = &contactArena;
+    contactCount = 0;
+    reserve();
+  }
+
   /**
    * Notifies the data that the given number of contacts have
    * been added.
@@ -176,9 +237,44 @@ struct CollisionData {
 
     // Move the array forward
     contacts += count;
+
+    if (arena) {
+      arena->commit(count);
+      if (contactsLeft < (int)MAX_CONTACTS_PER_CALL)
+        reserve();
+    }
+  }
+
+  /**
+   * Makes room in the arena for the next call of the detector.
+   */
+  void reserve() {
+    unsigned available;
+    contacts = arena->reserve(MAX_CONTACTS_PER_CALL, available);
+    contactsLeft = (int)available;
   }
 };
 
+/**
+ * The routines that find the contacts between pairs of primitives
+ * and write them into a CollisionData.
+ *
+ * Each contact gets a feature id telling which parts of the bodies
+ * touch, the same from one frame to the next while they keep
+ * touching the same way:
+ *
+ * - box and half space: the index of the box vertex.
+ *
+ * - box and box: the lowest four bits hold the separating axis
+ *   chosen by the overlap tests, from 0 to 14. For a face of one box
+ *   (axes 0 to 5), the next bits hold the face of the other box, the
+ *   corner of that face and the sides of the first face that clipped
+ *   the point, if any. For two edges (axes 6 to 14), they hold which
+ *   of the four parallel edges of each box it is.
+ *
+ * - anything with a sphere or a point: zero, as there is only one
+ *   contact.
+ */
 class CollisionDetector {
 public:
   static unsigned sphereAndHalfSpace(const CollisionSphere &sphere,
@@ -206,6 +302,20 @@ public:
   static unsigned boxAndSphere(const CollisionBox &box,
                                const CollisionSphere &sphere,
                                CollisionData *data);
+
+  /**
+   * Calls the routine matching the types of the two primitives.
+   */
+  static unsigned primitiveAndPrimitive(const CollisionPrimitive &one,
+                                        const CollisionPrimitive &two,
+                                        CollisionData *data);
+
+  /**
+   * Calls the half space routine matching the type of the primitive.
+   */
+  static unsigned primitiveAndHalfSpace(const CollisionPrimitive &primitive,
+                                        const CollisionPlane &plane,
+                                        CollisionData *data);
 };
 
 } // namespace ft
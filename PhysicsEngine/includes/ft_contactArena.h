@@ -0,0 +1,121 @@
+/**
+ * @file
+ *
+ * This file contains the storage of the contacts of a frame: chunks
+ * of contacts that are added as needed and kept from one frame to the
+ * next, so that no frame has to drop contacts for lack of room, and
+ * the frames after the largest one allocate nothing.
+ */
+#ifndef FT_CONTACTARENA_H
+#define FT_CONTACTARENA_H
+
+#include "ft_contacts.h"
+#include <memory>
+#include <vector>
+
+namespace ft {
+
+/**
+ * Hands out contiguous blocks of contacts from a list of chunks.
+ *
+ * The blocks are taken one after the other, in the order they are
+ * asked for. When the current chunk doesn't have room for a block,
+ * the rest of it is left unused and the block is taken from the next
+ * chunk, a new one if there is none: the chunks never move, so the
+ * blocks handed out so far stay where they are. Each new chunk is as
+ * large as all the others together, so a frame needing many more
+ * contacts than the last one only adds a few chunks.
+ *
+ * Resetting the arena, at the start of a frame, forgets the contacts
+ * but keeps the chunks.
+ */
+class ContactArena {
+public:
+  using pointer = std::shared_ptr<ContactArena>;
+  using raw_ptr = ContactArena *;
+
+  /**
+   * The size of the first chunk, when none is given.
+   */
+  static constexpr unsigned MIN_CHUNK_SIZE = 256;
+
+  explicit ContactArena(unsigned chunkSize = MIN_CHUNK_SIZE);
+
+  /**
+   * Forgets every contact handed out, keeping the chunks.
+   */
+  void reset();
+
+  /**
+   * Returns room for at least count contacts in a row, and sets
+   * available to the room there is. The room isn't taken until
+   * commit is called: the next reserve returns the same place.
+   */
+  Contact *reserve(unsigned count, unsigned &available);
+
+  /**
+   * Takes the first count contacts of the room last reserved.
+   */
+  void commit(unsigned count);
+
+  /**
+   * Takes count contacts in a row.
+   */
+  Contact *allocate(unsigned count);
+
+  /**
+   * Calls fn on each contact taken since the reset whose index, in
+   * the order they were taken, is in [first, last).
+   */
+  template <typename F>
+  void forEach(unsigned first, unsigned last, const F &fn) const {
+    unsigned index = 0;
+    for (size_t chunk = 0; chunk <= _current && chunk < _chunks.size();
+         ++chunk) {
+      const Chunk &c = _chunks[chunk];
+      for (unsigned i = 0; i < c.used; ++i, ++index) {
+        if (index >= last)
+          return;
+        if (index >= first)
+          fn(c.contacts[i]);
+      }
+    }
+  }
+
+  /**
+   * Returns the number of contacts taken since the reset.
+   */
+  unsigned getCount() const { return _count; }
+
+  /**
+   * Returns the number of contacts the chunks hold, used or not.
+   */
+  unsigned getCapacity() const { return _capacity; }
+  unsigned getChunkCount() const { return (unsigned)_chunks.size(); }
+
+  /**
+   * Returns the largest number of contacts taken between two
+   * resets, and of chunks used, since the arena was made.
+   */
+  unsigned getHighWaterMark() const { return _highWaterMark; }
+  unsigned getChunkHighWaterMark() const { return _chunkHighWaterMark; }
+
+protected:
+  struct Chunk {
+    std::unique_ptr<Contact[]> contacts;
+    unsigned size;
+    unsigned used;
+  };
+
+  std::vector<Chunk> _chunks;
+  size_t _current = 0;
+  unsigned _chunkSize;
+  unsigned _count = 0;
+  unsigned _capacity = 0;
+  unsigned _highWaterMark = 0;
+  unsigned _chunkHighWaterMark = 0;
+};
+
+} // namespace ft
+
+#endif // FT_CONTACTARENA_H
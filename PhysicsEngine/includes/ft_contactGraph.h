@@ -0,0 +1,228 @@
+/**
+ * @file
+ *
+ * This file contains the bookkeeping the contact resolver uses to
+ * avoid scanning every contact on each of its iterations: a list of
+ * the contacts touching each body, and a priority queue of the
+ * contacts that still need resolving.
+ */
+#ifndef FT_CONTACTGRAPH_H
+#define FT_CONTACTGRAPH_H
+
+#include "ft_def.h"
+#include <cstdint>
+#include <vector>
+
+namespace ft {
+
+class Contact;
+class RigidBody;
+
+/**
+ * Links every body to the contacts it takes part in. It is rebuilt
+ * from the contact array once per call to the resolver; resolving a
+ * contact then only has to revisit the contacts that share one of
+ * its bodies, rather than every contact.
+ */
+class ContactGraph {
+public:
+  /**
+   * The index given to the missing body of a contact with the
+   * scenery.
+   */
+  static constexpr uint32_t NO_BODY = 0xffffffff;
+
+  /**
+   * Rebuilds the graph for the given contacts. The storage is kept
+   * between calls, so a graph that is rebuilt every frame only
+   * allocates when the number of contacts grows.
+   */
+  void build(const Contact *contacts, unsigned numContacts);
+
+  /**
+   * Fills the given list with the contacts that share at least one
+   * body with the given contact, the contact itself included. Every
+   * contact is listed once.
+   */
+  void getNeighbours(unsigned contact, std::vector<uint32_t> &neighbours);
+
+  /**
+   * Returns the number of different bodies taking part in the
+   * contacts. They are numbered from zero.
+   */
+  uint32_t getBodyCount() const { return (uint32_t)_bodyStart.size() - 1; }
+
+  /**
+   * Returns the body with the given number.
+   */
+  RigidBody *getBody(uint32_t body) const {
+    return _entries[_bodyStart[body]].body;
+  }
+
+  /**
+   * Returns the number of the body on the given side of a contact,
+   * or NO_BODY if that side is the scenery.
+   */
+  uint32_t getBodyIndex(unsigned contact, unsigned side) const {
+    return _contactBodies[contact * 2 + side];
+  }
+
+private:
+  /**
+   * A body of a contact, used to sort the contacts by body.
+   */
+  struct Entry {
+    RigidBody *body;
+    uint32_t contact;
+    uint32_t side;
+  };
+
+  std::vector<Entry> _entries;
+
+  /**
+   * The contacts of body n are _bodyContacts[_bodyStart[n]] up to
+   * _bodyContacts[_bodyStart[n + 1]].
+   */
+  std::vector<uint32_t> _bodyStart;
+  std::vector<uint32_t> _bodyContacts;
+
+  /**
+   * Holds, for each side of each contact, the index of its body in
+   * _bodyStart, or NO_BODY for the scenery.
+   */
+  std::vector<uint32_t> _contactBodies;
+
+  /**
+   * Holds the call to getNeighbours that last listed each contact,
+   * so that a contact touching both bodies is only listed once.
+   */
+  std::vector<uint32_t> _listed;
+  uint32_t _stamp = 0;
+};
+
+/**
+ * Splits the contacts into batches in which no two contacts share a
+ * body that can move, with a greedy colouring of the contact graph.
+ * The contacts of a batch can then be solved in any order, or all at
+ * the same time. Bodies that can't move, and the scenery, don't keep
+ * two contacts apart: they are only read by the solvers.
+ *
+ * Each body remembers the colours of its contacts in a 64 bit mask.
+ * The contacts of a body already in 64 batches go into one last
+ * batch, whose contacts may share bodies and which has to be solved
+ * in order.
+ */
+class ContactBatches {
+public:
+  /**
+   * The largest number of batches whose contacts never share a
+   * movable body.
+   */
+  static constexpr unsigned MAX_COLOURS = 64;
+
+  /**
+   * Colours the contacts of the given graph. movable holds, for each
+   * body of the graph, whether it can move. Contacts are taken in
+   * order and put in the first batch free on both of their bodies.
+   */
+  void build(const ContactGraph &graph, unsigned numContacts,
+             const std::vector<uint8_t> &movable);
+
+  unsigned getBatchCount() const {
+    return (unsigned)_batchStart.size() - 1;
+  }
+
+  /**
+   * Returns the contacts of the given batch, in increasing order.
+   */
+  const uint32_t *getContacts(unsigned batch) const {
+    return _batchContacts.data() + _batchStart[batch];
+  }
+
+  unsigned getContactCount(unsigned batch) const {
+    return _batchStart[batch + 1] - _batchStart[batch];
+  }
+
+  /**
+   * Returns true if the contacts of the batch may share bodies, in
+   * which case it is the last one.
+   */
+  bool isOverflow(unsigned batch) const {
+    return _overflow && batch + 1 == getBatchCount();
+  }
+
+private:
+  std::vector<uint64_t> _bodyColours;
+  std::vector<uint32_t> _contactColours;
+  std::vector<uint32_t> _batchStart{0};
+  std::vector<uint32_t> _batchContacts;
+  bool _overflow = false;
+};
+
+/**
+ * A binary max-heap of contact indices that knows where each contact
+ * sits, so that the key of any contact can be changed or the contact
+ * removed in logarithmic time. Contacts with equal keys come out
+ * lowest index first, which is the order a linear scan for the
+ * largest key finds them in.
+ */
+class ContactHeap {
+public:
+  /**
+   * Empties the heap and makes room for the given number of
+   * contacts.
+   */
+  void reset(unsigned numContacts);
+
+  /**
+   * Sets the key of a contact without restoring the heap order.
+   * Used to fill the heap before a call to heapify.
+   */
+  void push(uint32_t contact, real_t key);
+
+  /**
+   * Restores the heap order after a series of calls to push.
+   */
+  void heapify();
+
+  /**
+   * Sets the key of a contact, adding it to the heap if needed.
+   */
+  void update(uint32_t contact, real_t key);
+
+  /**
+   * Removes the contact from the heap, if it is in it.
+   */
+  void remove(uint32_t contact);
+
+  bool empty() const { return _heap.empty(); }
+
+  /**
+   * Returns the contact with the largest key. The heap must not be
+   * empty.
+   */
+  uint32_t top() const { return _heap.front(); }
+
+private:
+  static constexpr uint32_t NOT_IN_HEAP = 0xffffffff;
+
+  bool before(uint32_t one, uint32_t two) const {
+    return _keys[one] > _keys[two] || (_keys[one] == _keys[two] && one < two);
+  }
+
+  void place(uint32_t slot, uint32_t contact) {
+    _heap[slot] = contact;
+    _slots[contact] = slot;
+  }
+
+  void siftUp(uint32_t slot);
+  void siftDown(uint32_t slot);
+
+  std::vector<real_t> _keys;
+  std::vector<uint32_t> _heap;
+  std::vector<uint32_t> _slots;
+};
+
+} // namespace ft
+
+#endif // FT_CONTACTGRAPH_H
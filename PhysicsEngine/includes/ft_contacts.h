@@ -15,6 +15,7 @@
 #define FT_CONTACTS_H
 
 #include "ft_body.h"
+#include "ft_contactGraph.h"
 #include "ft_def.h"
 
 namespace ft {
@@ -53,6 +54,7 @@ class Contact {
    * set and effect the contact.
    */
   friend class ContactResolver;
+  friend class SequentialImpulseSolver;
 
 public:
   using pointer = std::shared_ptr<Contact>;
@@ -90,9 +92,27 @@ public:
    */
   real_t _penetration;
 
+  /**
+   * Identifies the features of the bodies that touch at this
+   * contact, so that the same contact can be recognised in the next
+   * frame. It only means something between contacts of the same two
+   * bodies: see the CollisionDetector for what each detector puts
+   * in it.
+   */
+  uint32_t _featureId;
+
+  /**
+   * Holds the total impulse applied to the first body at this
+   * contact, in world coordinates. The contact manifold cache fills
+   * it in from the previous frame, the sequential impulse solver
+   * starts from it and leaves its own result in it.
+   */
+  glm::vec3 _impulse;
+
   /**
    * Sets the data that doesn't normally depend on the position
    * of the contact (i.e. the bodies, and their material properties).
+   * The feature and the impulse are reset.
    */
   void setBodyData(RigidBody *one, RigidBody *two, real_t friction,
                    real_t restitution);
@@ -305,6 +325,23 @@ private:
    */
   bool _validSettings;
 
+  /**
+   * True if the worst contact is taken from a heap and only the
+   * contacts sharing a body with it are updated, false to scan every
+   * contact on every iteration. Both give the same results.
+   */
+  bool _useContactGraph = true;
+
+  /**
+   * The bodies of the contacts being resolved, the contacts ordered
+   * by how badly they need resolving, and a scratch list of the
+   * contacts touched by one iteration. They are kept between calls
+   * so that their storage is reused.
+   */
+  ContactGraph _graph;
+  ContactHeap _heap;
+  std::vector<uint32_t> _neighbours;
+
 public:
   /**
    * Creates a new contact resolver with the given number of iterations
@@ -344,6 +381,16 @@ public:
    */
   void setEpsilon(real_t velocityEpsilon, real_t positionEpsilon);
 
+  /**
+   * Sets whether each iteration only revisits the contacts that
+   * share a body with the contact it resolved (the default), or
+   * rescans every contact. The results are the same either way; the
+   * rescan is kept as a reference.
+   */
+  void setUseContactGraph(bool useContactGraph) {
+    _useContactGraph = useContactGraph;
+  }
+
   /**
    * Resolves a set of contacts for both penetration and velocity.
    *
@@ -395,6 +442,22 @@ protected:
    */
   void adjustPositions(Contact *contacts, unsigned numContacts,
                        real_t duration);
+
+  /**
+   * Updates the closing velocity of the given contact after the
+   * resolved contact changed the velocities of its bodies.
+   */
+  void updateVelocity(Contact &contact, const Contact &resolved,
+                      const glm::vec3 velocityChange[2],
+                      const glm::vec3 rotationChange[2], real_t duration);
+
+  /**
+   * Updates the penetration of the given contact after the resolved
+   * contact moved its bodies.
+   */
+  void updatePenetration(Contact &contact, const Contact &resolved,
+                         const glm::vec3 linearChange[2],
+                         const glm::vec3 angularChange[2]);
 };
 
 /**
@@ -412,6 +475,17 @@ public:
    * been written.
    */
   virtual unsigned addContact(Contact *contact, unsigned limit) const = 0;
+
+  /**
+   * Fills in the bodies the generator ties together, which are kept
+   * in the same simulation island even in the frames where it
+   * generates no contact. Returns how many there are, none by
+   * default.
+   */
+  virtual unsigned getBodies(RigidBody *bodies[2]) const {
+    (void)bodies;
+    return 0;
+  }
 };
 
 } // namespace ft
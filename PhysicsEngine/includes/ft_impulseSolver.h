@@ -0,0 +1,282 @@
+/**
+ * @file
+ *
+ * This file contains a second contact resolution system, working on
+ * the same contacts as the ContactResolver. Rather than resolving the
+ * worst contact first, it sweeps over every contact a fixed number of
+ * times, applying a small corrective impulse to each (projected
+ * Gauss-Seidel, also known as sequential impulses). The impulses
+ * found in one frame are used as the starting point of the next, so
+ * that resting stacks need very few sweeps.
+ */
+#ifndef FT_IMPULSESOLVER_H
+#define FT_IMPULSESOLVER_H
+
+#include "ft_contactGraph.h"
+#include "ft_contacts.h"
+#include "ft_scheduler.h"
+#include <atomic>
+#include <vector>
+
+namespace ft {
+
+/**
+ * The contact solvers a simulation can pick from.
+ */
+enum class ContactSolverType {
+  /**
+   * The ContactResolver, resolving the worst contact first.
+   */
+  ITERATIVE,
+  /**
+   * The SequentialImpulseSolver.
+   */
+  SEQUENTIAL_IMPULSE
+};
+
+/**
+ * Resolves a set of contacts with sequential impulses.
+ *
+ * The impulse of each contact is accumulated over the iterations and
+ * the total is clamped, rather than each increment: the normal
+ * impulse can never pull the bodies together and the friction
+ * impulse along each tangent stays within the friction coefficient
+ * times the normal impulse. Penetration is removed by asking for a
+ * small separating velocity (Baumgarte stabilisation) instead of
+ * moving the bodies.
+ *
+ * The total impulses of each contact are cached at the end of every
+ * call, and left in the contact. In the next call, a contact that
+ * comes with an impulse, from a ContactManifoldCache, starts from it
+ * (warm starting). Otherwise a contact between the same bodies at
+ * about the same place on the first body starts from the cached
+ * impulses.
+ *
+ * With batching on, each sweep goes over the batches of a
+ * ContactBatches colouring rather than over the contacts in order.
+ * The contacts of a batch share no movable body, so they are split
+ * between the workers of a scheduler, if there is one, with every
+ * worker waiting for the batch to be done before moving on to the
+ * next. The results don't depend on the number of workers.
+ */
+class SequentialImpulseSolver {
+public:
+  using pointer = std::shared_ptr<SequentialImpulseSolver>;
+  using raw_ptr = SequentialImpulseSolver *;
+
+  /**
+   * Creates a solver doing the given number of sweeps over the
+   * contacts per call.
+   */
+  SequentialImpulseSolver(unsigned iterations = 10);
+
+  void setIterations(unsigned iterations) { _iterations = iterations; }
+  unsigned getIterations() const { return _iterations; }
+
+  /**
+   * Sets whether the impulses of the previous call are used as the
+   * starting point. Turning it off forgets the cached impulses.
+   */
+  void setWarmStarting(bool warmStarting);
+  bool getWarmStarting() const { return _warmStarting; }
+
+  /**
+   * Sets the fraction of the penetration removed at each step, and
+   * the penetration that is left alone to avoid jitter on resting
+   * contacts.
+   */
+  void setPositionCorrection(real_t bias, real_t slop);
+  real_t getPositionBias() const { return _positionBias; }
+  real_t getPositionSlop() const { return _positionSlop; }
+
+  /**
+   * Sets whether the contacts are swept batch by batch. It changes
+   * the order in which they are solved, so the results aren't the
+   * same as without batching.
+   */
+  void setBatching(bool batching) { _batching = batching; }
+  bool getBatching() const { return _batching; }
+
+  /**
+   * Sets the scheduler the batches are solved on, and the number of
+   * workers, the calling thread included. It is only used with
+   * batching, on calls with at least MIN_PARALLEL_CONTACTS contacts.
+   */
+  void setScheduler(Scheduler::pointer scheduler, unsigned workerCount);
+
+  /**
+   * The smallest number of contacts worth spreading over the workers.
+   */
+  static constexpr unsigned MIN_PARALLEL_CONTACTS = 256;
+
+  /**
+   * Copies the settings of the given solver, but not its cache nor
+   * its scheduler.
+   */
+  void copySettings(const SequentialImpulseSolver &other);
+
+  /**
+   * Forgets the impulses of the previous call.
+   */
+  void clearCache() { _cache.clear(); }
+
+  /**
+   * Resolves the velocities of the given contacts. The contacts may
+   * be in any state: their internals are calculated here.
+   */
+  void resolveContacts(Contact *contacts, unsigned numContacts,
+                       real_t duration);
+
+  /**
+   * Returns the number of contacts in the last call that started
+   * from a cached impulse.
+   */
+  unsigned getWarmStartedCount() const { return _warmStartedCount; }
+
+  /**
+   * Returns the number of batches of the last call, zero without
+   * batching.
+   */
+  unsigned getBatchCount() const { return _batchCount; }
+
+protected:
+  /**
+   * The velocities and mass properties of a body, copied out of the
+   * body for the duration of a call. Bodies that don't move (no
+   * finite mass, or asleep) have a zero inverse mass and tensor.
+   */
+  struct SolverBody {
+    glm::vec3 velocity;
+    glm::vec3 rotation;
+    glm::mat3 inverseInertiaTensor;
+    real_t inverseMass;
+  };
+
+  /**
+   * The data of one contact, set up once per call. Axis 0 is the
+   * contact normal and axes 1 and 2 are the tangents, the columns of
+   * the contact basis. The impulses are along those axes, applied
+   * positively to the first body and negatively to the second.
+   */
+  struct SolverContact {
+    uint32_t body[2];
+    glm::vec3 axis[3];
+    glm::vec3 relativeCross[2][3];
+    glm::vec3 angularChange[2][3];
+    real_t mass[3];
+    real_t targetVelocity;
+    real_t friction;
+    glm::vec3 impulse;
+  };
+
+  /**
+   * The total impulses of a contact at the end of a call. The
+   * bodies are ordered by address, the point is in the space of the
+   * first one and the friction impulse, in world space, is the one
+   * applied to the first one.
+   */
+  struct CachedImpulse {
+    RigidBody *first;
+    RigidBody *second;
+    glm::vec3 localPoint;
+    real_t normalImpulse;
+    glm::vec3 frictionImpulse;
+  };
+
+  static bool cacheOrder(const CachedImpulse &one, const CachedImpulse &two);
+
+  void prepareBodies();
+  void prepareContacts(Contact *contacts, unsigned numContacts,
+                       real_t duration);
+  void warmStart(const Contact &contact, SolverContact &solverContact);
+  void storeImpulses(Contact *contacts, unsigned numContacts);
+
+  /**
+   * Applies the corrective impulses of one contact.
+   */
+  void solveContact(SolverContact &contact);
+
+  /**
+   * Runs the sweeps batch by batch, on the scheduler if there is
+   * one.
+   */
+  void sweepBatches();
+
+  /**
+   * Spreads the sweeps over the workers, one batch at a time.
+   */
+  void sweepOnScheduler();
+
+  /**
+   * Takes pieces of the batches, one step at a time, until every
+   * sweep is done. Run by each worker.
+   */
+  void sweepWork();
+
+  /**
+   * Returns the number of pieces the contacts of a batch are split
+   * into. The overflow batch is a single piece.
+   */
+  unsigned getPieceCount(unsigned batch) const;
+
+  /**
+   * Returns the relative velocity of the bodies of the contact along
+   * the given axis.
+   */
+  real_t relativeVelocity(const SolverContact &contact, unsigned axis) const;
+
+  /**
+   * Applies the given impulse along the given axis.
+   */
+  void applyImpulse(const SolverContact &contact, unsigned axis,
+                    real_t impulse);
+
+  /**
+   * The number of contacts of a batch given to a worker at a time.
+   */
+  static constexpr unsigned PIECE_SIZE = 32;
+
+  /**
+   * The progress of one step, a batch of one sweep: the pieces taken
+   * and the pieces done. Each step has its own, so that a worker
+   * late on the previous step can't take a piece of the next one.
+   */
+  struct alignas(64) SweepStep {
+    std::atomic<uint32_t> taken;
+    std::atomic<uint32_t> done;
+  };
+
+  unsigned _iterations;
+  bool _warmStarting = true;
+  bool _batching = false;
+  real_t _positionBias = 0.2f;
+  real_t _positionSlop = 0.01f;
+  unsigned _warmStartedCount = 0;
+
+  ContactGraph _graph;
+  std::vector<SolverBody> _bodies;
+  std::vector<SolverContact> _contacts;
+  std::vector<CachedImpulse> _cache;
+  std::vector<CachedImpulse> _nextCache;
+
+  /**
+   * The batches, and the contacts copied in batch order for the
+   * sweeps.
+   */
+  ContactBatches _batches;
+  std::vector<SolverContact> _batchedContacts;
+  std::vector<uint8_t> _movable;
+  unsigned _batchCount = 0;
+
+  Scheduler::pointer _scheduler;
+  unsigned _workerCount = 1;
+  std::unique_ptr<SweepStep[]> _steps;
+  unsigned _stepCapacity = 0;
+  unsigned _stepCount = 0;
+  std::atomic<uint32_t> _step{0};
+  std::vector<Task> _tasks;
+};
+
+} // namespace ft
+
+#endif // FT_IMPULSESOLVER_H
@@ -0,0 +1,194 @@
+/**
+ * @file
+ *
+ * This file contains the simulation islands: the groups of bodies
+ * that touch each other, directly or through other bodies, or are
+ * tied together by joints. Bodies in different islands can't affect
+ * each other within a frame, so each island is solved on its own,
+ * and an island can only go to sleep as a whole.
+ */
+#ifndef FT_ISLAND_H
+#define FT_ISLAND_H
+
+#include "ft_contacts.h"
+#include <unordered_map>
+#include <vector>
+
+namespace ft {
+
+/**
+ * Splits the bodies into islands at every frame, with a union-find
+ * over the contacts and the links between bodies, and puts islands
+ * to sleep when every one of their bodies has been still for long
+ * enough.
+ *
+ * The bodies of an island put to sleep are remembered together. A
+ * sleeping body doesn't take part in the collision detection unless
+ * an awake body hits it, so there are no contacts to find its island
+ * from: when any body of a sleeping island is woken up, by a contact
+ * or by the application, the whole island is woken up with it.
+ *
+ * Static bodies (with an infinite mass) never join two islands
+ * together.
+ */
+class IslandBuilder {
+public:
+  using pointer = std::shared_ptr<IslandBuilder>;
+  using raw_ptr = IslandBuilder *;
+
+  /**
+   * The island of the contacts that don't touch any registered,
+   * awake and movable body, and the end of a list of sleeping
+   * bodies.
+   */
+  static constexpr uint32_t NONE = 0xffffffff;
+
+  /**
+   * Registers a body. It stops being put to sleep on its own (see
+   * RigidBodyStore::setIslandSleep) until it is unregistered: it
+   * sleeps with its island.
+   */
+  void addBody(RigidBody *body);
+
+  /**
+   * Unregisters the given body, and the links to it. Its sleeping
+   * island, if any, is woken up, and the body is put to sleep on its
+   * own again.
+   */
+  void removeBody(RigidBody *body);
+
+  /**
+   * Keeps the two bodies in the same island, as long as both are
+   * registered.
+   */
+  void addLink(RigidBody *one, RigidBody *two);
+
+  /**
+   * Wakes up the sleeping islands touched by an awake body, or with
+   * a body woken up since the last frame, then splits the awake
+   * bodies and the given contacts into islands.
+   */
+  void build(const Contact *contacts, unsigned numContacts);
+
+  /**
+   * Returns the number of islands found by the last build. The
+   * contacts that don't belong to any island, if there are any, come
+   * last in an island of their own without bodies.
+   */
+  unsigned getIslandCount() const {
+    return (unsigned)_islandContactStart.size() - 1;
+  }
+
+  /**
+   * Returns the places, in the array given to build, of the contacts
+   * of the given island.
+   */
+  const uint32_t *getContactIndices(unsigned island) const {
+    return _order.data() + _islandContactStart[island];
+  }
+
+  unsigned getContactCount(unsigned island) const {
+    return _islandContactStart[island + 1] - _islandContactStart[island];
+  }
+
+  unsigned getBodyCount(unsigned island) const {
+    return _islandBodyStart[island + 1] - _islandBodyStart[island];
+  }
+
+  /**
+   * Puts to sleep every island of the last build whose bodies can
+   * all sleep and have all been still for long enough. Call it once
+   * the contacts are solved.
+   */
+  void sleepIslands();
+
+  /**
+   * Returns the number of registered bodies that are awake and
+   * asleep, as of the last build or sleepIslands.
+   */
+  unsigned getAwakeCount() const { return _awakeCount; }
+  unsigned getAsleepCount() const {
+    return (unsigned)_bodies.size() - _awakeCount;
+  }
+
+  /**
+   * Which bodies sleep together, saved by saveState. It keeps its
+   * room from one save to the next.
+   */
+  struct State {
+    std::vector<uint32_t> sleepNext;
+    unsigned awakeCount = 0;
+  };
+
+  /**
+   * Copies the sleeping islands into the given state, or back from
+   * it. Restoring fails, and changes nothing, if bodies were added or
+   * removed since the state was saved.
+   */
+  void saveState(State &state) const;
+  bool restoreState(const State &state);
+
+protected:
+  uint32_t getNode(const RigidBody *body) const;
+  uint32_t find(uint32_t node);
+  void unite(uint32_t one, uint32_t two);
+
+  /**
+   * Returns true if the body can carry an island: registered,
+   * awake and with a finite mass.
+   */
+  bool isMovable(uint32_t node) const;
+
+  /**
+   * Wakes up the body and the rest of its sleeping island.
+   */
+  void wake(uint32_t node);
+
+  /**
+   * Wakes up whichever body of the pair is asleep, if the other one
+   * is awake and movable.
+   */
+  void wakePair(RigidBody *one, RigidBody *two);
+
+  std::vector<RigidBody *> _bodies;
+  std::unordered_map<const RigidBody *, uint32_t> _nodes;
+  std::vector<std::pair<RigidBody *, RigidBody *>> _links;
+
+  /**
+   * Holds, for each body of a sleeping island, the next body of the
+   * island, the last one pointing back to the first. NONE for the
+   * other bodies.
+   */
+  std::vector<uint32_t> _sleepNext;
+
+  std::vector<uint32_t> _parent;
+  std::vector<uint32_t> _island;
+  std::vector<uint32_t> _cursor;
+
+  /**
+   * Holds the body of each side of each contact, NONE if it isn't
+   * registered. Once the islands are known, the first one of each
+   * pair is replaced by the island of the contact.
+   */
+  std::vector<uint32_t> _contactNodes;
+
+  /**
+   * The bodies of island n are _islandBodies[_islandBodyStart[n]] up
+   * to _islandBodies[_islandBodyStart[n + 1]], and the same for the
+   * contacts.
+   */
+  std::vector<uint32_t> _islandBodyStart{0};
+  std::vector<uint32_t> _islandBodies;
+  std::vector<uint32_t> _islandContactStart{0};
+
+  /**
+   * Holds the places of the contacts, in island order.
+   */
+  std::vector<uint32_t> _order;
+
+  unsigned _awakeCount = 0;
+};
+
+} // namespace ft
+
+#endif // FT_ISLAND_H
@@ -0,0 +1,165 @@
+/**
+ * @file
+ *
+ * This file contains the solving of the simulation islands, spread
+ * over the workers of a scheduler. The islands can't affect each
+ * other within a frame, so any number of them can be solved at the
+ * same time.
+ */
+#ifndef FT_ISLANDSOLVER_H
+#define FT_ISLANDSOLVER_H
+
+#include "ft_contacts.h"
+#include "ft_impulseSolver.h"
+#include "ft_island.h"
+#include "ft_scheduler.h"
+#include <atomic>
+#include <vector>
+
+namespace ft {
+
+/**
+ * Resolves the contacts of the islands found by an IslandBuilder.
+ *
+ * Each worker has its own solvers and its own contact buffer: the
+ * contacts of an island are copied into the buffer of the worker
+ * that takes it, resolved there and copied back to their places.
+ * Two islands never share anything but the bodies that can't move,
+ * which the solvers only read. The sequential impulse solvers only
+ * warm start from the impulses the contacts carry, from a
+ * ContactManifoldCache, so that the results don't depend on which
+ * worker took which island.
+ *
+ * The islands are handed out largest first, from a shared counter,
+ * so that a big pile doesn't start last and hold everyone up. The
+ * calling thread is one of the workers; the others run on the
+ * scheduler, if there is one. With the sequential impulse solver and
+ * batching on, an island holding more than its share of the
+ * contacts is solved first, with its batches spread over all the
+ * workers (see SequentialImpulseSolver::setBatching).
+ */
+class IslandSolver {
+public:
+  using pointer = std::shared_ptr<IslandSolver>;
+  using raw_ptr = IslandSolver *;
+
+  /**
+   * Creates a solver running on the given number of workers, the
+   * calling thread and workerCount - 1 tasks of the scheduler.
+   * Without a scheduler, every island is solved on the calling
+   * thread.
+   */
+  IslandSolver(Scheduler::pointer scheduler = nullptr,
+               unsigned workerCount = 1);
+
+  /**
+   * Sets the scheduler the islands are solved on, and the number of
+   * workers, the calling thread included.
+   */
+  void setScheduler(Scheduler::pointer scheduler, unsigned workerCount);
+  unsigned getWorkerCount() const { return (unsigned)_workers.size(); }
+
+  /**
+   * Sets the solver used on the contacts, the iterative resolver by
+   * default.
+   */
+  void setSolverType(ContactSolverType type) { _solverType = type; }
+  ContactSolverType getSolverType() const { return _solverType; }
+
+  /**
+   * Sets whether the iterative resolver is given four iterations per
+   * contact of each island, rather than the iterations it was set up
+   * with.
+   */
+  void setCalculateIterations(bool calculate) {
+    _calculateIterations = calculate;
+  }
+
+  /**
+   * Copies the settings of the given solvers into the solvers of
+   * every worker.
+   */
+  void setSolvers(const ContactResolver &resolver,
+                  const SequentialImpulseSolver &impulseSolver);
+
+  /**
+   * Resolves the contacts of every island of the last build of the
+   * given islands. The contacts are the ones given to that build.
+   */
+  void solve(const IslandBuilder &islands, Contact *contacts,
+             real_t duration);
+
+  /**
+   * Returns the number of islands, and of contacts, resolved by the
+   * given worker in the last call to solve.
+   */
+  unsigned getIslandsSolved(unsigned worker) const {
+    return _workers[worker]->islandsSolved;
+  }
+  unsigned getContactsSolved(unsigned worker) const {
+    return _workers[worker]->contactsSolved;
+  }
+
+  /**
+   * Returns the largest number of batches of the islands the given
+   * worker solved in the last call, zero without batching.
+   */
+  unsigned getBatchCount(unsigned worker) const {
+    return _workers[worker]->batchCount;
+  }
+
+  /**
+   * Returns the iterations the solvers used over every island in the
+   * last call to solve. The sequential impulse solver has no position
+   * iterations.
+   */
+  unsigned getVelocityIterationsUsed() const;
+  unsigned getPositionIterationsUsed() const;
+
+protected:
+  /**
+   * The state of one worker. Each one is allocated on its own, so
+   * that the workers don't write next to each other.
+   */
+  struct Worker {
+    std::vector<Contact> contacts;
+    ContactResolver resolver{1};
+    SequentialImpulseSolver impulseSolver;
+    unsigned islandsSolved;
+    unsigned contactsSolved;
+    unsigned batchCount;
+    unsigned velocityIterations;
+    unsigned positionIterations;
+  };
+
+  /**
+   * Takes islands off the queue until there are none left.
+   */
+  void work(Worker &worker);
+
+  /**
+   * Resolves one island in the buffer of the worker.
+   */
+  void solveIsland(Worker &worker, unsigned island);
+
+  Scheduler::pointer _scheduler;
+  std::vector<std::unique_ptr<Worker>> _workers;
+  ContactSolverType _solverType = ContactSolverType::ITERATIVE;
+  bool _calculateIterations = false;
+
+  /**
+   * The islands of the call in progress, largest first, and the
+   * index of the next one to hand out.
+   */
+  std::vector<uint32_t> _queue;
+  std::atomic<unsigned> _next{0};
+  std::vector<Task> _tasks;
+
+  const IslandBuilder *_islands = nullptr;
+  Contact *_contacts = nullptr;
+  real_t _duration = 0;
+};
+
+} // namespace ft
+
+#endif // FT_ISLANDSOLVER_H
@@ -49,6 +49,11 @@ public:
    * has been violated.
    */
   unsigned addContact(Contact::raw_ptr contact, unsigned limit) const;
+
+  /**
+   * Fills in the two bodies of the joint.
+   */
+  unsigned getBodies(RigidBody *bodies[2]) const;
 };
 
 } // namespace ft
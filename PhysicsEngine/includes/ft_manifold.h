@@ -0,0 +1,188 @@
+/**
+ * @file
+ *
+ * This file contains the contact manifolds: the contact points kept
+ * for each pair of touching bodies from one frame to the next. The
+ * collision detectors find every contact again from scratch at each
+ * frame; the manifolds recognise the ones they already had, hand
+ * them the impulses the solver found for them in the previous frame,
+ * and keep the number of points per pair down.
+ */
+#ifndef FT_MANIFOLD_H
+#define FT_MANIFOLD_H
+
+#include "ft_contactArena.h"
+#include "ft_contacts.h"
+#include <vector>
+
+namespace ft {
+
+/**
+ * Holds up to MAX_POINTS contact points for each pair of bodies that
+ * touched in the last frame.
+ *
+ * Each point remembers where it was on both bodies. When the pair is
+ * found touching again, the old points are moved with the bodies and
+ * kept as long as the bodies haven't slid or moved apart by more
+ * than the breaking distance. A new contact with the feature id of
+ * an old point, or very close to one, takes its place and its
+ * impulse. When there are more than MAX_POINTS points left, the
+ * deepest one is kept along with the ones covering the largest area
+ * around it, which is all a solver needs to hold a box flat.
+ *
+ * Pairs that aren't found touching in a frame are forgotten.
+ */
+class ContactManifoldCache {
+public:
+  using pointer = std::shared_ptr<ContactManifoldCache>;
+  using raw_ptr = ContactManifoldCache *;
+
+  /**
+   * The largest number of points kept for a pair of bodies.
+   */
+  static constexpr unsigned MAX_POINTS = 4;
+
+  /**
+   * Merges the given contacts, just found by the collision
+   * detection, into the manifolds of the last frame. The points of
+   * the manifolds are then written over the contacts, with the
+   * impulse of the last frame for those that were already there.
+   * At most maxContacts are written; returns how many.
+   */
+  unsigned update(Contact *contacts, unsigned numContacts,
+                  unsigned maxContacts);
+
+  /**
+   * Merges the contacts taken from the arena since its reset, from
+   * the given one on, into the manifolds of the last frame. Returns
+   * the number of points of the manifolds, to be written by write.
+   */
+  unsigned update(const ContactArena &found, unsigned first = 0);
+
+  /**
+   * Writes the points of the manifolds of the last update as
+   * contacts, at most maxContacts of them. Returns how many.
+   */
+  unsigned write(Contact *contacts, unsigned maxContacts = -1u);
+
+  /**
+   * Keeps the impulses left by the solver in the contacts written by
+   * the last call to update, for the next frame. The contacts must
+   * be the same ones, in the same order.
+   */
+  void storeImpulses(const Contact *contacts);
+
+  /**
+   * Forgets every manifold.
+   */
+  void clear();
+
+  /**
+   * A copy of the manifolds, taken by saveState. It keeps its room
+   * from one save to the next.
+   */
+  struct State;
+
+  /**
+   * Copies the manifolds into the given state, or back from it.
+   */
+  void saveState(State &state) const;
+  void restoreState(const State &state);
+
+  /**
+   * Sets how far the two sides of a point may separate, along the
+   * normal or across it, before the point is dropped.
+   */
+  void setBreakingDistance(real_t distance) { _breakingDistance = distance; }
+  real_t getBreakingDistance() const { return _breakingDistance; }
+
+  /**
+   * Returns the number of pairs of bodies in contact.
+   */
+  unsigned getManifoldCount() const { return (unsigned)_manifolds.size(); }
+
+  /**
+   * Returns the number of contacts given to the last call to update
+   * that took the place of a point of the previous frame.
+   */
+  unsigned getMatchedCount() const { return _matchedCount; }
+
+protected:
+  /**
+   * A contact point. It is anchored in the space of each body (in
+   * world space for the scenery) at the point where it was found,
+   * with the penetration it had then. The position and depth are
+   * the current ones.
+   */
+  struct ManifoldPoint {
+    glm::vec3 anchor[2];
+    glm::vec3 normal;
+    real_t penetration;
+    uint32_t featureId;
+    glm::vec3 impulse;
+
+    glm::vec3 position;
+    real_t depth;
+    bool found;
+  };
+
+  /**
+   * The points of a pair of bodies, ordered by handle. The normals
+   * are the ones of the first body.
+   */
+  struct Manifold {
+    RigidBody *first;
+    RigidBody *second;
+    real_t friction;
+    real_t restitution;
+    unsigned count;
+    ManifoldPoint points[MAX_POINTS];
+  };
+
+  /**
+   * Moves an old point with its bodies. Returns false if it has
+   * broken.
+   */
+  bool refresh(const Manifold &manifold, ManifoldPoint &point) const;
+
+  /**
+   * Adds the new contact to the candidates, in place of the old
+   * point it matches if any.
+   */
+  void merge(const Contact &contact);
+
+  /**
+   * Picks the points of the manifold out of the candidates.
+   */
+  void reduce(Manifold &manifold);
+
+  /**
+   * Builds the manifolds of this frame from the contacts found.
+   * Returns the number of points they hold.
+   */
+  unsigned build();
+
+  real_t _breakingDistance = 0.02f;
+  unsigned _matchedCount = 0;
+
+  std::vector<Manifold> _manifolds;
+  std::vector<Manifold> _nextManifolds;
+  std::vector<Contact> _found;
+  std::vector<ManifoldPoint> _candidates;
+
+  /**
+   * Holds, for each contact written by the last update, its
+   * manifold times MAX_POINTS plus its point.
+   */
+  std::vector<uint32_t> _written;
+
+public:
+  // Defined here, once Manifold is.
+  struct State {
+    std::vector<Manifold> manifolds;
+  };
+};
+
+} // namespace ft
+
+#endif // FT_MANIFOLD_H
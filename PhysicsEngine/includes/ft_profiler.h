@@ -0,0 +1,182 @@
+/**
+ * @file
+ *
+ * This file contains a small sampling-free profiler: scoped zones that
+ * record when they begin and end, and an export of what was recorded
+ * to the Chrome trace event format, which chrome://tracing and
+ * Perfetto open.
+ *
+ * The zones are compiled in only when FT_PROFILING is defined;
+ * otherwise FT_PROFILE_ZONE and FT_PROFILE_THREAD expand to nothing.
+ */
+#ifndef FT_PROFILER_H
+#define FT_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ft {
+
+/**
+ * The zones recorded by one thread, in a ring of fixed capacity. Only
+ * its thread writes to it, without locks; once the ring is full the
+ * oldest zones are overwritten. It can be read from any thread at any
+ * time: the zones overwritten while they are read are left out.
+ */
+class ZoneBuffer {
+public:
+  static constexpr uint64_t CAPACITY = 1 << 14;
+
+  struct Zone {
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  explicit ZoneBuffer(uint32_t thread) : _thread(thread) {}
+
+  void record(const char *name, uint64_t begin, uint64_t end) {
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    Slot &slot = _slots[head & MASK];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.begin.store(begin, std::memory_order_relaxed);
+    slot.end.store(end, std::memory_order_relaxed);
+    _head.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * Appends the zones still in the ring to zones, oldest first.
+   */
+  void collect(std::vector<Zone> &zones) const {
+    uint64_t head = _head.load(std::memory_order_acquire);
+    uint64_t first = head > CAPACITY ? head - CAPACITY : 0;
+    size_t start = zones.size();
+    for (uint64_t i = first; i < head; ++i) {
+      const Slot &slot = _slots[i & MASK];
+      zones.push_back({slot.name.load(std::memory_order_relaxed),
+                       slot.begin.load(std::memory_order_relaxed),
+                       slot.end.load(std::memory_order_relaxed)});
+    }
+
+    // The writer may have lapped the reader meanwhile, and be half way
+    // through the slot after its head.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t last = _head.load(std::memory_order_relaxed) + 1;
+    if (last > first + CAPACITY) {
+      size_t lost = (size_t)std::min(last - first - CAPACITY, head - first);
+      zones.erase(zones.begin() + start, zones.begin() + start + lost);
+    }
+  }
+
+  uint32_t getThread() const { return _thread; }
+  const std::string &getName() const { return _name; }
+  void setName(const std::string &name) { _name = name; }
+
+private:
+  static constexpr uint64_t MASK = CAPACITY - 1;
+
+  struct Slot {
+    std::atomic<const char *> name{nullptr};
+    std::atomic<uint64_t> begin{0};
+    std::atomic<uint64_t> end{0};
+  };
+
+  alignas(64) std::atomic<uint64_t> _head{0};
+  Slot _slots[CAPACITY];
+  uint32_t _thread;
+  std::string _name;
+};
+
+/**
+ * Keeps the ring of every thread that recorded a zone, and exports
+ * them. A thread gets its ring on its first zone, the only time a lock
+ * is taken; the rings outlive their threads, so their zones can still
+ * be exported.
+ *
+ * There is one profiler in the process, defined in ftPhysics, which
+ * the other libraries link to.
+ */
+class Profiler {
+public:
+  static Profiler &get();
+
+  /**
+   * Returns the time of the steady clock, in nanoseconds.
+   */
+  static uint64_t now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  ZoneBuffer &getThreadBuffer();
+
+  /**
+   * Names the calling thread in the trace.
+   */
+  void setThreadName(const std::string &name);
+
+  /**
+   * Writes every zone still recorded as a Chrome trace event JSON
+   * document. The times are in microseconds from the earliest zone.
+   */
+  void writeChromeTrace(std::ostream &out) const;
+
+  /**
+   * Writes the trace to the given file. Returns false if it can't be
+   * written.
+   */
+  bool writeChromeTrace(const std::string &path) const;
+
+private:
+  Profiler() = default;
+
+  static void writeString(std::ostream &out, const char *text);
+
+  mutable std::mutex _mutex;
+  std::vector<std::unique_ptr<ZoneBuffer>> _buffers;
+};
+
+/**
+ * Records the time between its construction and its destruction as a
+ * zone of the given name. The name must be a string that lives for the
+ * whole program, a literal.
+ */
+class ProfileZone {
+public:
+  explicit ProfileZone(const char *name)
+      : _name(name), _begin(Profiler::now()) {}
+  ~ProfileZone() {
+    Profiler::get().getThreadBuffer().record(_name, _begin, Profiler::now());
+  }
+
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+  const char *_name;
+  uint64_t _begin;
+};
+
+} // namespace ft
+
+#define FT_PROFILE_CONCAT_(a, b) a##b
+#define FT_PROFILE_CONCAT(a, b) FT_PROFILE_CONCAT_(a, b)
+
+#ifdef FT_PROFILING
+#define FT_PROFILE_ZONE(name)                                                  \
+  ::ft::ProfileZone FT_PROFILE_CONCAT(_ftProfileZone, __LINE__)(name)
+#define FT_PROFILE_THREAD(name) ::ft::Profiler::get().setThreadName(name)
+#else
+#define FT_PROFILE_ZONE(name) (void)0
+#define FT_PROFILE_THREAD(name) (void)0
+#endif
+
+#endif // FT_PROFILER_H
@@ -1,6 +1,7 @@
 #ifndef FT_PWORLD_H
 #define FT_PWORLD_H
 
+#include "ft_collideCoarse.h"
 #include "ft_def.h"
 #include "ft_pForceGenerator.h"
 #include "ft_particle.h"
@@ -130,6 +131,37 @@ private:
   std::vector<Particle::raw_ptr> *_particles;
 };
 
+/**
+ * A contact generator that treats the particles of an STL vector as
+ * spheres of the same radius and collides them with each other. The
+ * neighbours are found with a SpatialHashGrid rebuilt at every call.
+ */
+class ParticleCollisions : public ParticleContactGenerator {
+
+public:
+  using pointer = std::shared_ptr<ParticleCollisions>;
+  using raw_ptr = ParticleCollisions *;
+
+  void init(std::vector<Particle::raw_ptr> *particles, real_t radius,
+            real_t restitution = 0.5f);
+
+  unsigned addContact(ParticleContact::raw_ptr contact,
+                      unsigned limit) const override;
+
+  /**
+   * Gives access to the grid for neighbour queries. It holds the
+   * particles as they were at the last call to addContact.
+   */
+  const SpatialHashGrid &getGrid() const { return _grid; }
+
+private:
+  std::vector<Particle::raw_ptr> *_particles;
+  real_t _radius;
+  real_t _restitution;
+  mutable std::vector<BoundingBox> _boxes;
+  mutable SpatialHashGrid _grid;
+};
+
 }; // namespace ft
 
 #endif // !FT_PWORLD_H
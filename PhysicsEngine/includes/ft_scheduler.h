@@ -0,0 +1,396 @@
+#ifndef FT_SCHEDULER_H
+#define FT_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ft {
+
+/**
+ * Counts the tasks of a group that haven't run yet.
+ */
+class WaitGroup {
+public:
+  void add(uint32_t count = 1) {
+    _count.fetch_add(count, std::memory_order_relaxed);
+  }
+  void done() { _count.fetch_sub(1, std::memory_order_acq_rel); }
+  bool isDone() const { return _count.load(std::memory_order_acquire) == 0; }
+
+private:
+  std::atomic<uint32_t> _count{0};
+};
+
+/**
+ * A task of the Scheduler. The callable is copied into the task
+ * itself, so it must be small and trivially copyable: a lambda
+ * capturing a few pointers, references or numbers. Nothing is
+ * allocated; the task belongs to whoever submits it and must outlive
+ * its run.
+ */
+class Task {
+public:
+  static constexpr size_t CAPACITY = 48;
+
+  Task() = default;
+  template <typename F> explicit Task(const F &f) { set(f); }
+
+  template <typename F> void set(const F &f) {
+    static_assert(sizeof(F) <= CAPACITY, "the callable is too big for a task");
+    static_assert(alignof(F) <= alignof(std::max_align_t),
+                  "the callable is over-aligned for a task");
+    static_assert(std::is_trivially_copyable<F>::value &&
+                      std::is_trivially_destructible<F>::value,
+                  "the callable of a task must be trivially copyable");
+    new (_storage) F(f);
+    _function = [](void *storage) { (*static_cast<F *>(storage))(); };
+  }
+
+  void run() {
+    WaitGroup *group = _group;
+    _function(_storage);
+    if (group)
+      group->done();
+  }
+
+private:
+  friend class Scheduler;
+
+  alignas(std::max_align_t) unsigned char _storage[CAPACITY];
+  void (*_function)(void *) = nullptr;
+  WaitGroup *_group = nullptr;
+};
+
+/**
+ * A Chase-Lev work-stealing deque of tasks, of a fixed capacity. The
+ * owner pushes and pops at the bottom, the other threads steal from
+ * the top.
+ */
+class WorkDeque {
+public:
+  static constexpr int64_t CAPACITY = 4096;
+
+  /**
+   * Returns false if the deque is full.
+   */
+  bool push(Task *task) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY)
+      return false;
+    _tasks[bottom & MASK].store(task, std::memory_order_relaxed);
+    _bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+  }
+
+  Task *pop() {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    Task *task = _tasks[bottom & MASK].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // The last task: race the thieves for it.
+      if (!_top.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed))
+        task = nullptr;
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  Task *steal() {
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+      return nullptr;
+    Task *task = _tasks[top & MASK].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      return nullptr;
+    return task;
+  }
+
+  bool isEmpty() const {
+    return _top.load(std::memory_order_acquire) >=
+           _bottom.load(std::memory_order_acquire);
+  }
+
+private:
+  static constexpr int64_t MASK = CAPACITY - 1;
+
+  alignas(64) std::atomic<int64_t> _top{0};
+  alignas(64) std::atomic<int64_t> _bottom{0};
+  alignas(64) std::atomic<Task *> _tasks[CAPACITY];
+};
+
+/**
+ * Runs tasks on a set of threads, each with its own deque, taking
+ * work from the others when its own runs out. Tasks submitted from a
+ * thread of the scheduler go to its deque; the others go to a shared
+ * one. A thread waiting for a group runs tasks in the meantime, so
+ * tasks may submit and wait for tasks of their own.
+ *
+ * Idle threads spin for a little while, then sleep until a task is
+ * submitted.
+ */
+class Scheduler {
+public:
+  using pointer = std::shared_ptr<Scheduler>;
+
+  /**
+   * The most helpers a parallelFor hands its range to.
+   */
+  static constexpr uint32_t MAX_HELPERS = 64;
+
+  explicit Scheduler(uint32_t threadCount)
+      : _deques(threadCount + 1), _busyTimes(threadCount),
+        _threadCount(threadCount) {
+    _threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+      _threads.emplace_back([this, i]() { workerLoop(i); });
+  }
+
+  ~Scheduler() {
+    {
+      std::lock_guard<std::mutex> lock(_sleepMutex);
+      _stop.store(true, std::memory_order_release);
+    }
+    _wake.notify_all();
+    for (auto &thread : _threads)
+      thread.join();
+  }
+
+  Scheduler(const Scheduler &) = delete;
+  Scheduler &operator=(const Scheduler &) = delete;
+
+  /**
+   * Returns the number of threads of the scheduler plus one, for the
+   * thread that submits and waits.
+   */
+  uint32_t getWorkerCount() const { return _threadCount + 1; }
+
+  /**
+   * Returns the time the threads of the scheduler spent running
+   * tasks since it started, in nanoseconds, summed over the threads.
+   * The tasks run by the other threads aren't counted.
+   */
+  uint64_t getBusyTime() const {
+    uint64_t total = 0;
+    for (auto &busy : _busyTimes)
+      total += busy.time.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  uint32_t getThreadCount() const { return _threadCount; }
+
+  /**
+   * Queues the task in the given group. The task runs on the calling
+   * thread if the deque is full.
+   */
+  void submit(Task &task, WaitGroup &group) {
+    group.add();
+    task._group = &group;
+
+    bool pushed;
+    uint32_t self = getSelf();
+    if (self < _threadCount) {
+      pushed = _deques[self].push(&task);
+    } else {
+      std::lock_guard<std::mutex> lock(_sharedMutex);
+      pushed = _deques[_threadCount].push(&task);
+    }
+    if (!pushed) {
+      task.run();
+      return;
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load(std::memory_order_relaxed) > 0) {
+      std::lock_guard<std::mutex> lock(_sleepMutex);
+      _wake.notify_one();
+    }
+  }
+
+  /**
+   * Runs one queued task, of any group, on the calling thread.
+   * Returns false if there were none.
+   */
+  bool help() { return runOne(getSelf()); }
+
+  /**
+   * Runs tasks until every task of the group has run.
+   */
+  void wait(WaitGroup &group) {
+    uint32_t self = getSelf();
+    while (!group.isDone())
+      if (!runOne(self))
+        std::this_thread::yield();
+  }
+
+  /**
+   * Calls fn(first, last) over [begin, end) in chunks of grain
+   * indices, spread over the threads, and returns once every chunk is
+   * done. The calling thread takes chunks too.
+   */
+  template <typename F>
+  void parallelFor(uint32_t begin, uint32_t end, uint32_t grain, const F &fn) {
+    if (begin >= end)
+      return;
+    grain = std::max(grain, (uint32_t)1);
+    uint32_t chunks = (end - begin - 1) / grain + 1;
+
+    std::atomic<uint32_t> next{0};
+    auto drain = [&next, &fn, begin, end, grain, chunks]() {
+      uint32_t chunk;
+      while ((chunk = next.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+        uint32_t first = begin + chunk * grain;
+        fn(first, first + std::min(grain, end - first));
+      }
+    };
+
+    uint32_t helpers = std::min({chunks - 1, _threadCount, MAX_HELPERS});
+    Task tasks[MAX_HELPERS];
+    WaitGroup group;
+    for (uint32_t i = 0; i < helpers; ++i) {
+      tasks[i].set(drain);
+      submit(tasks[i], group);
+    }
+    drain();
+    wait(group);
+  }
+
+private:
+  /**
+   * Returns the deque of the calling thread, the shared one for the
+   * threads of other schedulers and the rest.
+   */
+  uint32_t getSelf() const {
+    return _currentScheduler == this ? _currentIndex : _threadCount;
+  }
+
+  /**
+   * Runs a task of the given deque, or of another one. Returns false
+   * if there were none.
+   */
+  bool runOne(uint32_t self) {
+    Task *task = nullptr;
+    if (self < _threadCount) {
+      task = _deques[self].pop();
+    } else {
+      std::lock_guard<std::mutex> lock(_sharedMutex);
+      task = _deques[_threadCount].pop();
+    }
+
+    // Steal from the others, starting from a different one each
+    // time.
+    uint32_t count = (uint32_t)_deques.size();
+    uint32_t start = nextVictim() % count;
+    for (uint32_t i = 0; !task && i < count; ++i) {
+      uint32_t victim = (start + i) % count;
+      if (victim != self)
+        task = _deques[victim].steal();
+    }
+
+    if (!task)
+      return false;
+    if (self < _threadCount) {
+      auto start = std::chrono::steady_clock::now();
+      task->run();
+      auto time = std::chrono::steady_clock::now() - start;
+      _busyTimes[self].time.fetch_add(
+          (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(time)
+              .count(),
+          std::memory_order_relaxed);
+    } else {
+      task->run();
+    }
+    return true;
+  }
+
+  bool hasWork() const {
+    for (auto &deque : _deques)
+      if (!deque.isEmpty())
+        return true;
+    return false;
+  }
+
+  void workerLoop(uint32_t index) {
+    _currentScheduler = this;
+    _currentIndex = index;
+
+    unsigned idle = 0;
+    while (!_stop.load(std::memory_order_acquire)) {
+      if (runOne(index)) {
+        idle = 0;
+        continue;
+      }
+      if (++idle < SPIN_COUNT) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      // The wait times out in case a submit missed the count of the
+      // sleeping threads.
+      std::unique_lock<std::mutex> lock(_sleepMutex);
+      _sleeping.fetch_add(1, std::memory_order_seq_cst);
+      if (!hasWork() && !_stop.load(std::memory_order_acquire))
+        _wake.wait_for(lock, std::chrono::milliseconds(1));
+      _sleeping.fetch_sub(1, std::memory_order_relaxed);
+      idle = 0;
+    }
+
+    _currentScheduler = nullptr;
+  }
+
+  static uint32_t nextVictim() {
+    _victimSeed ^= _victimSeed << 13;
+    _victimSeed ^= _victimSeed >> 17;
+    _victimSeed ^= _victimSeed << 5;
+    return _victimSeed;
+  }
+
+  static constexpr unsigned SPIN_COUNT = 64;
+
+  /**
+   * The time a thread spent in tasks, on a line of its own.
+   */
+  struct alignas(64) BusyTime {
+    std::atomic<uint64_t> time{0};
+  };
+
+  inline static thread_local const Scheduler *_currentScheduler = nullptr;
+  inline static thread_local uint32_t _currentIndex = 0;
+  inline static thread_local uint32_t _victimSeed = 2463534242u;
+
+  std::vector<WorkDeque> _deques;
+  std::vector<BusyTime> _busyTimes;
+  std::vector<std::thread> _threads;
+  uint32_t _threadCount;
+  std::mutex _sharedMutex;
+
+  std::mutex _sleepMutex;
+  std::condition_variable _wake;
+  std::atomic<uint32_t> _sleeping{0};
+  std::atomic<bool> _stop{false};
+};
+
+} // namespace ft
+
+#endif // FT_SCHEDULER_H
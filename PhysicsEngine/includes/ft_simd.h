@@ -0,0 +1,416 @@
+/**
+ * @file
+ *
+ * This file contains the vectorised integration of rigid bodies. The
+ * kernel is written once, as a template over a set of lane
+ * operations, and compiled in one translation unit per instruction
+ * set (SSE and AVX2) with the matching compiler flags. The instruction
+ * set is picked at run time, so the library still runs on processors
+ * that lack them.
+ *
+ * The store keeps one array per coordinate, so when the awake bodies
+ * are consecutive the lanes are filled with plain vector loads; they
+ * are gathered one by one otherwise.
+ *
+ * The kernel only works on raw arrays of floats: everything it calls
+ * is either an intrinsic or a template over the lane operations, so
+ * no code compiled for a wider instruction set can leak into the rest
+ * of the library through a shared inline function.
+ */
+#ifndef FT_SIMD_H
+#define FT_SIMD_H
+
+#include "ft_def.h"
+#include <cstdint>
+
+namespace ft {
+
+/**
+ * The instruction sets the batched integration can use, from the
+ * narrowest to the widest.
+ */
+enum class SimdLevel { SCALAR, SSE, AVX2 };
+
+/**
+ * Returns the widest instruction set supported by both the build and
+ * the processor running it.
+ */
+SimdLevel getSupportedSimdLevel();
+
+/**
+ * Returns the number of bodies processed at once by the given
+ * instruction set.
+ */
+uint32_t getSimdWidth(SimdLevel level);
+
+/**
+ * Holds where the data of a RigidBodyStore is, as raw arrays of
+ * floats: one per coordinate of the vectors, one per component of the
+ * quaternions (w, x, y, z) and one per element of the matrices
+ * (column * size + row).
+ */
+struct IntegrationArrays {
+  float *inverseMass;
+  float *linearDamping;
+  float *angularDamping;
+  float *motion;
+  float *position[3];
+  float *velocity[3];
+  float *rotation[3];
+  float *forceAccum[3];
+  float *torqueAccum[3];
+  float *acceleration[3];
+  float *lastFrameAcceleration[3];
+  float *orientation[4];
+  float *inverseInertiaTensor[9];
+  float *inverseInertiaTensorWorld[9];
+  float *transformMatrix[16];
+  uint8_t *isAwake;
+  uint8_t *canSleep;
+  /**
+   * The bodies whose motion dropping low enough doesn't put them to
+   * sleep, see RigidBodyStore::setIslandSleep.
+   */
+  uint8_t *islandSleep;
+};
+
+/**
+ * Integrates the given bodies forward in time, as
+ * RigidBodyStore::integrate does, a full group of lanes at a time.
+ * The handles must be sorted, the count must be a multiple of the
+ * width of the instruction set, and every body must be awake. The
+ * bias is pow(0.5, duration), the weight of the old motion in the
+ * sleep test.
+ */
+void integrateSse(const IntegrationArrays &arrays, const uint32_t *handles,
+                  uint32_t count, float duration, float bias);
+void integrateAvx2(const IntegrationArrays &arrays, const uint32_t *handles,
+                   uint32_t count, float duration, float bias);
+
+namespace simd {
+
+/**
+ * Three lanes of vectors, one per coordinate.
+ */
+template <typename Ops> struct Vec3Lanes {
+  typename Ops::V x, y, z;
+};
+
+/**
+ * One group of bodies, a full set of lanes. It loads and stores the
+ * lanes directly when the handles are consecutive.
+ */
+template <typename Ops> struct Group {
+  using V = typename Ops::V;
+
+  const uint32_t *handles;
+  bool contiguous;
+
+  explicit Group(const uint32_t *h)
+      : handles(h), contiguous(h[Ops::WIDTH - 1] - h[0] == Ops::WIDTH - 1) {}
+
+  V load(const float *array) const {
+    if (contiguous)
+      return Ops::loadu(array + handles[0]);
+    return Ops::gather(array, handles);
+  }
+
+  void store(float *array, V value) const {
+    if (contiguous) {
+      Ops::storeu(array + handles[0], value);
+      return;
+    }
+    alignas(32) float lanes[Ops::WIDTH];
+    Ops::store(lanes, value);
+    for (uint32_t l = 0; l < Ops::WIDTH; ++l)
+      array[handles[l]] = lanes[l];
+  }
+
+  Vec3Lanes<Ops> load3(float *const *arrays) const {
+    return {load(arrays[0]), load(arrays[1]), load(arrays[2])};
+  }
+
+  void store3(float *const *arrays, const Vec3Lanes<Ops> &value) const {
+    store(arrays[0], value.x);
+    store(arrays[1], value.y);
+    store(arrays[2], value.z);
+  }
+};
+
+/**
+ * Natural logarithm of positive values, using the Cephes polynomial.
+ */
+template <typename Ops> inline typename Ops::V log(typename Ops::V x) {
+  using V = typename Ops::V;
+  const V one = Ops::set1(1.0f);
+
+  x = Ops::max(x, Ops::set1(1.17549435e-38f));
+  auto exponent = Ops::srli(Ops::asInt(x), 23);
+  x = Ops::asFloat(Ops::andInt(Ops::asInt(x), Ops::set1Int(~0x7f800000)));
+  x = Ops::bitOr(x, Ops::set1(0.5f));
+
+  exponent = Ops::subInt(exponent, Ops::set1Int(0x7f));
+  V e = Ops::add(Ops::toFloat(exponent), one);
+
+  V mask = Ops::lt(x, Ops::set1(0.707106781186547524f));
+  V tmp = Ops::bitAnd(x, mask);
+  x = Ops::sub(x, one);
+  e = Ops::sub(e, Ops::bitAnd(one, mask));
+  x = Ops::add(x, tmp);
+
+  V z = Ops::mul(x, x);
+  V y = Ops::set1(7.0376836292e-2f);
+  y = Ops::add(Ops::mul(y, x), Ops::set1(-1.1514610310e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(1.1676998740e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(-1.2420140846e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(1.4249322787e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(-1.6668057665e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(2.0000714765e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(-2.4999993993e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(3.3333331174e-1f));
+  y = Ops::mul(Ops::mul(y, x), z);
+
+  y = Ops::add(y, Ops::mul(e, Ops::set1(-2.12194440e-4f)));
+  y = Ops::sub(y, Ops::mul(z, Ops::set1(0.5f)));
+  x = Ops::add(x, y);
+  return Ops::add(x, Ops::mul(e, Ops::set1(0.693359375f)));
+}
+
+/**
+ * Exponential, using the Cephes polynomial.
+ */
+template <typename Ops> inline typename Ops::V exp(typename Ops::V x) {
+  using V = typename Ops::V;
+  const V one = Ops::set1(1.0f);
+
+  x = Ops::min(x, Ops::set1(88.3762626647949f));
+  x = Ops::max(x, Ops::set1(-88.3762626647949f));
+
+  V fx = Ops::add(Ops::mul(x, Ops::set1(1.44269504088896341f)),
+                  Ops::set1(0.5f));
+  V floor = Ops::toFloat(Ops::toInt(fx));
+  fx = Ops::sub(floor, Ops::bitAnd(Ops::gt(floor, fx), one));
+
+  x = Ops::sub(x, Ops::mul(fx, Ops::set1(0.693359375f)));
+  x = Ops::sub(x, Ops::mul(fx, Ops::set1(-2.12194440e-4f)));
+
+  V z = Ops::mul(x, x);
+  V y = Ops::set1(1.9875691500e-4f);
+  y = Ops::add(Ops::mul(y, x), Ops::set1(1.3981999507e-3f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(8.3334519073e-3f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(4.1665795894e-2f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(1.6666665459e-1f));
+  y = Ops::add(Ops::mul(y, x), Ops::set1(5.0000001201e-1f));
+  y = Ops::add(Ops::add(Ops::mul(y, z), x), one);
+
+  auto power = Ops::addInt(Ops::toInt(fx), Ops::set1Int(0x7f));
+  return Ops::mul(y, Ops::asFloat(Ops::slli(power, 23)));
+}
+
+/**
+ * Raises the damping values to the given power. Damping values that
+ * are not positive give zero, as std::pow does for them.
+ */
+template <typename Ops>
+inline typename Ops::V dampingPow(typename Ops::V damping, float duration) {
+  typename Ops::V result =
+      exp<Ops>(Ops::mul(log<Ops>(damping), Ops::set1(duration)));
+  return Ops::bitAnd(result, Ops::gt(damping, Ops::set1(0.0f)));
+}
+
+/**
+ * The integration kernel. It does, lane by lane, what the scalar
+ * stages of RigidBodyStore do: velocity, position and orientation,
+ * derived data, then the accumulators and the sleep test.
+ */
+template <typename Ops>
+void integrate(const IntegrationArrays &a, const uint32_t *handles,
+               uint32_t count, float duration, float bias) {
+  using V = typename Ops::V;
+  using V3 = Vec3Lanes<Ops>;
+  const V dt = Ops::set1(duration);
+  const V zero = Ops::set1(0.0f);
+  const V one = Ops::set1(1.0f);
+  const V two = Ops::set1(2.0f);
+  const V half = Ops::set1(0.5f);
+
+  for (uint32_t first = 0; first < count; first += Ops::WIDTH) {
+    const Group<Ops> g(handles + first);
+
+    // Velocity.
+    V inverseMass = g.load(a.inverseMass);
+    V3 force = g.load3(a.forceAccum);
+    V3 acc = g.load3(a.acceleration);
+    V3 last = {Ops::add(acc.x, Ops::mul(inverseMass, force.x)),
+               Ops::add(acc.y, Ops::mul(inverseMass, force.y)),
+               Ops::add(acc.z, Ops::mul(inverseMass, force.z))};
+    g.store3(a.lastFrameAcceleration, last);
+
+    V iitw[9];
+    for (uint32_t i = 0; i < 9; ++i)
+      iitw[i] = g.load(a.inverseInertiaTensorWorld[i]);
+    V3 torque = g.load3(a.torqueAccum);
+    V3 angular = {
+        Ops::add(Ops::add(Ops::mul(iitw[0], torque.x),
+                          Ops::mul(iitw[3], torque.y)),
+                 Ops::mul(iitw[6], torque.z)),
+        Ops::add(Ops::add(Ops::mul(iitw[1], torque.x),
+                          Ops::mul(iitw[4], torque.y)),
+                 Ops::mul(iitw[7], torque.z)),
+        Ops::add(Ops::add(Ops::mul(iitw[2], torque.x),
+                          Ops::mul(iitw[5], torque.y)),
+                 Ops::mul(iitw[8], torque.z))};
+
+    V3 vel = g.load3(a.velocity);
+    V3 rot = g.load3(a.rotation);
+    V linear = dampingPow<Ops>(g.load(a.linearDamping), duration);
+    V angularDamping = dampingPow<Ops>(g.load(a.angularDamping), duration);
+    vel.x = Ops::mul(Ops::add(vel.x, Ops::mul(dt, last.x)), linear);
+    vel.y = Ops::mul(Ops::add(vel.y, Ops::mul(dt, last.y)), linear);
+    vel.z = Ops::mul(Ops::add(vel.z, Ops::mul(dt, last.z)), linear);
+    rot.x = Ops::mul(Ops::add(rot.x, Ops::mul(dt, angular.x)), angularDamping);
+    rot.y = Ops::mul(Ops::add(rot.y, Ops::mul(dt, angular.y)), angularDamping);
+    rot.z = Ops::mul(Ops::add(rot.z, Ops::mul(dt, angular.z)), angularDamping);
+
+    // Position and orientation.
+    V3 pos = g.load3(a.position);
+    pos.x = Ops::add(pos.x, Ops::mul(dt, vel.x));
+    pos.y = Ops::add(pos.y, Ops::mul(dt, vel.y));
+    pos.z = Ops::add(pos.z, Ops::mul(dt, vel.z));
+
+    V qw = g.load(a.orientation[0]);
+    V qx = g.load(a.orientation[1]);
+    V qy = g.load(a.orientation[2]);
+    V qz = g.load(a.orientation[3]);
+    {
+      // (0, rotation * duration) * orientation
+      V vx = Ops::mul(rot.x, dt);
+      V vy = Ops::mul(rot.y, dt);
+      V vz = Ops::mul(rot.z, dt);
+      V tw = Ops::sub(zero, Ops::add(Ops::add(Ops::mul(vx, qx),
+                                              Ops::mul(vy, qy)),
+                                     Ops::mul(vz, qz)));
+      V tx = Ops::add(Ops::mul(qw, vx),
+                      Ops::sub(Ops::mul(vy, qz), Ops::mul(vz, qy)));
+      V ty = Ops::add(Ops::mul(qw, vy),
+                      Ops::sub(Ops::mul(vz, qx), Ops::mul(vx, qz)));
+      V tz = Ops::add(Ops::mul(qw, vz),
+                      Ops::sub(Ops::mul(vx, qy), Ops::mul(vy, qx)));
+      qw = Ops::add(qw, Ops::mul(tw, half));
+      qx = Ops::add(qx, Ops::mul(tx, half));
+      qy = Ops::add(qy, Ops::mul(ty, half));
+      qz = Ops::add(qz, Ops::mul(tz, half));
+    }
+
+    // Derived data. A null quaternion normalises to the identity.
+    {
+      V length = Ops::sqrt(Ops::add(
+          Ops::add(Ops::mul(qw, qw), Ops::mul(qx, qx)),
+          Ops::add(Ops::mul(qy, qy), Ops::mul(qz, qz))));
+      V valid = Ops::gt(length, zero);
+      V inverse = Ops::div(one, Ops::blend(one, length, valid));
+      qw = Ops::blend(one, Ops::mul(qw, inverse), valid);
+      qx = Ops::bitAnd(Ops::mul(qx, inverse), valid);
+      qy = Ops::bitAnd(Ops::mul(qy, inverse), valid);
+      qz = Ops::bitAnd(Ops::mul(qz, inverse), valid);
+    }
+    g.store(a.orientation[0], qw);
+    g.store(a.orientation[1], qx);
+    g.store(a.orientation[2], qy);
+    g.store(a.orientation[3], qz);
+
+    // The rotation matrix, m[column * 3 + row].
+    V m[9];
+    {
+      V xx = Ops::mul(qx, qx), yy = Ops::mul(qy, qy), zz = Ops::mul(qz, qz);
+      V xy = Ops::mul(qx, qy), xz = Ops::mul(qx, qz), yz = Ops::mul(qy, qz);
+      V wx = Ops::mul(qw, qx), wy = Ops::mul(qw, qy), wz = Ops::mul(qw, qz);
+      m[0] = Ops::sub(one, Ops::mul(two, Ops::add(yy, zz)));
+      m[1] = Ops::mul(two, Ops::add(xy, wz));
+      m[2] = Ops::mul(two, Ops::sub(xz, wy));
+      m[3] = Ops::mul(two, Ops::sub(xy, wz));
+      m[4] = Ops::sub(one, Ops::mul(two, Ops::add(xx, zz)));
+      m[5] = Ops::mul(two, Ops::add(yz, wx));
+      m[6] = Ops::mul(two, Ops::add(xz, wy));
+      m[7] = Ops::mul(two, Ops::sub(yz, wx));
+      m[8] = Ops::sub(one, Ops::mul(two, Ops::add(xx, yy)));
+    }
+    for (uint32_t c = 0; c < 3; ++c) {
+      for (uint32_t r = 0; r < 3; ++r)
+        g.store(a.transformMatrix[c * 4 + r], m[c * 3 + r]);
+      g.store(a.transformMatrix[c * 4 + 3], zero);
+    }
+    g.store(a.transformMatrix[12], pos.x);
+    g.store(a.transformMatrix[13], pos.y);
+    g.store(a.transformMatrix[14], pos.z);
+    g.store(a.transformMatrix[15], one);
+
+    // World inverse inertia tensor: m * iitBody * transpose(m).
+    V iit[9];
+    for (uint32_t i = 0; i < 9; ++i)
+      iit[i] = g.load(a.inverseInertiaTensor[i]);
+    for (uint32_t row = 0; row < 3; ++row) {
+      // t[k] is (m * iitBody)[row][k].
+      V t[3];
+      for (uint32_t k = 0; k < 3; ++k)
+        t[k] = Ops::add(Ops::add(Ops::mul(m[0 * 3 + row], iit[k * 3 + 0]),
+                                 Ops::mul(m[1 * 3 + row], iit[k * 3 + 1])),
+                        Ops::mul(m[2 * 3 + row], iit[k * 3 + 2]));
+      for (uint32_t col = 0; col < 3; ++col)
+        g.store(a.inverseInertiaTensorWorld[col * 3 + row],
+                Ops::add(Ops::add(Ops::mul(t[0], m[0 * 3 + col]),
+                                  Ops::mul(t[1], m[1 * 3 + col])),
+                         Ops::mul(t[2], m[2 * 3 + col])));
+    }
+
+    // Accumulators and sleep.
+    g.store3(a.forceAccum, {zero, zero, zero});
+    g.store3(a.torqueAccum, {zero, zero, zero});
+
+    alignas(32) float canSleep[Ops::WIDTH];
+    alignas(32) float selfSleep[Ops::WIDTH];
+    for (uint32_t l = 0; l < Ops::WIDTH; ++l) {
+      canSleep[l] = a.canSleep[g.handles[l]] ? 1.0f : 0.0f;
+      selfSleep[l] = a.islandSleep[g.handles[l]] ? 0.0f : 1.0f;
+    }
+    V sleepy = Ops::gt(Ops::load(canSleep), zero);
+
+    V current = Ops::add(
+        Ops::add(Ops::add(Ops::mul(vel.x, vel.x), Ops::mul(vel.y, vel.y)),
+                 Ops::mul(vel.z, vel.z)),
+        Ops::add(Ops::add(Ops::mul(rot.x, rot.x), Ops::mul(rot.y, rot.y)),
+                 Ops::mul(rot.z, rot.z)));
+    V oldMotion = g.load(a.motion);
+    V motion = Ops::add(Ops::mul(Ops::set1(bias), oldMotion),
+                        Ops::mul(Ops::set1(1.0f - bias), current));
+    V epsilon = Ops::set1(ft::SLEEP_EPSILON);
+    V asleep = Ops::bitAnd(Ops::bitAnd(sleepy, Ops::lt(motion, epsilon)),
+                           Ops::gt(Ops::load(selfSleep), zero));
+    motion = Ops::min(motion, Ops::mul(Ops::set1(10.0f), epsilon));
+    g.store(a.motion, Ops::blend(oldMotion, motion, sleepy));
+
+    vel.x = Ops::blend(vel.x, zero, asleep);
+    vel.y = Ops::blend(vel.y, zero, asleep);
+    vel.z = Ops::blend(vel.z, zero, asleep);
+    rot.x = Ops::blend(rot.x, zero, asleep);
+    rot.y = Ops::blend(rot.y, zero, asleep);
+    rot.z = Ops::blend(rot.z, zero, asleep);
+    g.store3(a.velocity, vel);
+    g.store3(a.rotation, rot);
+    g.store3(a.position, pos);
+
+    if (Ops::any(asleep)) {
+      alignas(32) float lanes[Ops::WIDTH];
+      Ops::store(lanes, Ops::bitAnd(asleep, one));
+      for (uint32_t l = 0; l < Ops::WIDTH; ++l)
+        if (lanes[l] != 0.0f)
+          a.isAwake[g.handles[l]] = 0;
+    }
+  }
+}
+
+} // namespace simd
+
+} // namespace ft
+
+#endif // FT_SIMD_H
@@ -0,0 +1,38 @@
+/**
+ * @file
+ *
+ * This file contains the snapshot of a simulation: the state of its
+ * bodies and of the data it keeps from one frame to the next, saved
+ * so that the simulation can be taken back to it, to roll back a
+ * networked game or to try out a few frames ahead.
+ */
+#ifndef FT_SNAPSHOT_H
+#define FT_SNAPSHOT_H
+
+#include "ft_bodyStore.h"
+#include "ft_island.h"
+#include "ft_manifold.h"
+#include <cstdint>
+
+namespace ft {
+
+/**
+ * Everything a frame starts from, saved by World::saveState and
+ * restored by World::restoreState: the bodies, the contact points
+ * kept between frames, which bodies sleep together, and the state
+ * hash of the last frame.
+ *
+ * A snapshot is meant to be kept and saved into again: its arrays
+ * keep their room, so that once it has been saved into, saving and
+ * restoring allocate nothing.
+ */
+struct SimulationSnapshot {
+  RigidBodyStore::State bodies;
+  ContactManifoldCache::State contacts;
+  IslandBuilder::State islands;
+  uint64_t stateHash = 0;
+};
+
+} // namespace ft
+
+#endif // FT_SNAPSHOT_H
@@ -0,0 +1,72 @@
+/**
+ * @file
+ *
+ * This file contains the hash of the state of the rigid bodies, taken
+ * after each step of a deterministic simulation, so that two runs
+ * meant to stay in lockstep can tell on which step they parted.
+ */
+#ifndef FT_STATEHASH_H
+#define FT_STATEHASH_H
+
+#include "ft_body.h"
+#include <cstdint>
+#include <cstring>
+
+namespace ft {
+
+/**
+ * A 64-bit hash of the bits of the values added to it, in the order
+ * they are added. Values that are equal but have different bits, 0
+ * and -0 for instance, hash differently: two runs meant to be the
+ * same to the bit have already parted when they differ.
+ *
+ * The values are mixed in a 64-bit word at a time, as in MurmurHash3,
+ * and the result is avalanched, so that flipping any bit of any value
+ * changes about half the bits of the hash.
+ */
+class StateHash {
+public:
+  explicit StateHash(uint64_t seed = 0) : _hash(seed), _words(0) {}
+
+  /**
+   * Mixes in a 64-bit word.
+   */
+  void add(uint64_t word) {
+    word *= 0x87c37b91114253d5ull;
+    word = (word << 31) | (word >> 33);
+    word *= 0x4cf5ad432745937full;
+    _hash ^= word;
+    _hash = ((_hash << 27) | (_hash >> 37)) * 5 + 0x52dce729;
+    ++_words;
+  }
+
+  /**
+   * Mixes in the bits of two floats, as one word.
+   */
+  void add(real_t low, real_t high) {
+    uint32_t bits[2];
+    std::memcpy(&bits[0], &low, sizeof(uint32_t));
+    std::memcpy(&bits[1], &high, sizeof(uint32_t));
+    add((uint64_t)bits[0] | (uint64_t)bits[1] << 32);
+  }
+
+  /**
+   * Mixes in the position, orientation, velocity, rotation, motion
+   * and awake state of the body: everything the next step starts
+   * from that the application doesn't set itself.
+   */
+  void addBody(const RigidBody &body);
+
+  /**
+   * Returns the hash of the values added so far.
+   */
+  uint64_t get() const;
+
+private:
+  uint64_t _hash;
+  uint64_t _words;
+};
+
+} // namespace ft
+
+#endif // FT_STATEHASH_H
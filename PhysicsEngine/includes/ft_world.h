@@ -20,7 +20,18 @@
 #define FT_WORLD_H
 
 #include "ft_body.h"
+#include "ft_broadphase.h"
+#include "ft_collideFine.h"
+#include "ft_contactArena.h"
 #include "ft_contacts.h"
+#include "ft_impulseSolver.h"
+#include "ft_island.h"
+#include "ft_islandSolver.h"
+#include "ft_manifold.h"
+#include "ft_snapshot.h"
+#include "ft_stateHash.h"
+#include <cstdint>
+#include <vector>
 
 namespace ft {
 /**
@@ -49,11 +60,27 @@ class World {
    */
   BodyRegistration *firstBody;
 
+  /**
+   * Holds the number of registered bodies and the store they live
+   * in. When they all live in the same store and nothing else does,
+   * the store is integrated in one batch.
+   */
+  unsigned bodyCount;
+  RigidBodyStore *bodyStore;
+  bool mixedStores;
+
   /**
    * Holds the resolver for sets of contacts.
    */
   ContactResolver resolver;
 
+  /**
+   * Holds the sequential impulse solver, used instead of the
+   * resolver when solverType says so.
+   */
+  SequentialImpulseSolver impulseSolver;
+  ContactSolverType solverType;
+
   /**
    * Holds one contact generators in a linked list.
    */
@@ -68,28 +95,261 @@ class World {
   ContactGenRegistration *firstContactGen;
 
   /**
-   * Holds an array of contacts, for filling by the contact
-   * generators.
+   * Holds the contacts of the frame, as taken from the arena by the
+   * contact generators and the collision detection. The contacts
+   * that are solved are written after them, in a single block.
+   */
+  ContactArena contactArena;
+
+  /**
+   * Holds the contacts solved in the last frame, in the arena: those
+   * of the contact generators, then those of the manifolds.
    */
   Contact *contacts;
 
   /**
-   * Holds the maximum number of contacts allowed (i.e. the size
-   * of the contacts array).
+   * Holds the broad phase used to find the pairs of primitives
+   * that may be in contact.
+   */
+  Broadphase::pointer broadphase;
+
+  /**
+   * Holds the registered primitives, indexed by their broad phase
+   * proxy. Removed primitives leave a NULL entry behind.
+   */
+  std::vector<CollisionPrimitive *> primitives;
+
+  /**
+   * Holds the immovable planes every primitive is tested against.
+   */
+  std::vector<CollisionPlane *> planes;
+
+  /**
+   * Holds the pairs reported by the broad phase in the last frame.
+   */
+  std::vector<BroadphasePair> pairs;
+
+  /**
+   * Holds the contact data filled by the collision detector.
+   */
+  CollisionData collisionData;
+
+  /**
+   * Holds the contact points of the last frames. The contacts of the
+   * collision detection go through it, the ones of the contact
+   * generators don't.
+   */
+  ContactManifoldCache manifolds;
+
+  /**
+   * Holds the number of contacts made by the contact generators in
+   * the last frame, in front of those of the collision detection.
    */
-  unsigned maxContacts;
+  unsigned generatedContacts;
+
+  /**
+   * Holds the islands of the registered bodies. Each island is
+   * solved on its own, and goes to sleep as a whole.
+   */
+  IslandBuilder islands;
+
+  /**
+   * Holds the solvers of the islands, one set per worker. The
+   * resolver and the impulse solver above only hold the settings.
+   */
+  IslandSolver islandSolver;
+
+  /**
+   * True if the world runs in deterministic mode, see
+   * setDeterministic.
+   */
+  bool deterministic;
+
+  /**
+   * Holds the registered bodies in the order of their handles, for
+   * the deterministic mode. It is sorted again after a body is added
+   * or removed.
+   */
+  std::vector<RigidBody *> sortedBodies;
+  bool bodiesSorted;
+
+  /**
+   * Holds the hash of the state of the bodies after the last frame,
+   * in deterministic mode.
+   */
+  uint64_t stateHash;
+
+  /**
+   * Holds the handles of the sleeping bodies restoreState has moved,
+   * and a flag for each handle of the store telling whether it is
+   * one of them. Both keep their room between restores.
+   */
+  std::vector<uint32_t> movedBodies;
+  std::vector<uint8_t> movedFlags;
+
+  /**
+   * Sorts the registered bodies by handle, if they have changed.
+   */
+  void sortBodies();
 
 public:
   /**
-   * Creates a new simulator that can handle up to the given
-   * number of contacts per frame. You can also optionally give
+   * Creates a new simulator, with room for the given number of
+   * contacts to start with; more room is made for the frames that
+   * need it. You can also optionally give
    * a number of contact-resolution iterations to use. If you
    * don't give a number of iterations, then four times the
    * number of detected contacts will be used for each frame.
    */
-  World(unsigned maxContacts, unsigned iterations = 0);
+  World(unsigned maxContacts, unsigned iterations = 0,
+        Broadphase::pointer broadphase = nullptr);
+
+  /**
+   * Creates a new simulator as above, using a broad phase of the
+   * given type.
+   */
+  World(unsigned maxContacts, unsigned iterations, BroadphaseType type);
   ~World();
 
+  /**
+   * Registers a rigid body to be integrated by the world. The
+   * world doesn't own the body.
+   */
+  void addBody(RigidBody *body);
+
+  /**
+   * Unregisters the given rigid body.
+   */
+  void removeBody(RigidBody *body);
+
+  /**
+   * Registers a contact generator, called at every frame before
+   * the collision detection. The bodies it ties together, if it
+   * says which, are kept in the same island.
+   */
+  void addContactGenerator(ContactGenerator *gen);
+
+  /**
+   * Registers a collision primitive. Its body must already be set
+   * up, since the primitive is placed in the broad phase straight
+   * away. The world doesn't own the primitive.
+   */
+  void addPrimitive(CollisionPrimitive *primitive);
+
+  /**
+   * Unregisters the given collision primitive.
+   */
+  void removePrimitive(CollisionPrimitive *primitive);
+
+  /**
+   * Registers an immovable plane to collide with.
+   */
+  void addPlane(CollisionPlane *plane);
+
+  /**
+   * Sets the friction, restitution and tolerance written into the
+   * contacts found by the collision detection.
+   */
+  void setContactParameters(real_t friction, real_t restitution,
+                            real_t tolerance);
+
+  /**
+   * Sets the solver used to resolve the contacts. The iterative
+   * resolver is used by default.
+   */
+  void setSolverType(ContactSolverType type) { solverType = type; }
+  ContactSolverType getSolverType() const { return solverType; }
+
+  /**
+   * Solves the islands on the given number of workers: the calling
+   * thread and workerCount - 1 tasks of the scheduler.
+   */
+  void setScheduler(Scheduler::pointer scheduler, unsigned workerCount) {
+    islandSolver.setScheduler(scheduler, workerCount);
+  }
+
+  /**
+   * Sets whether the world runs in deterministic mode: the same
+   * bodies, given the same forces, then end up in the same state to
+   * the bit on every run, with any number of workers and on any
+   * processor with the same floating point arithmetic.
+   *
+   * The contacts are always solved in the order of the handles of
+   * their bodies, and no result depends on which worker solved what.
+   * What the mode adds is that every body is integrated on its own,
+   * with the scalar code: the vectorised integration rounds the
+   * damping differently, and which bodies it takes depends on the
+   * widest instruction set of the processor. It also hashes the state
+   * of the bodies after every frame, see getStateHash.
+   *
+   * The bodies should all live in the same store: the order of bodies
+   * from different stores depends on where the stores are.
+   */
+  void setDeterministic(bool deterministic);
+  bool getDeterministic() const { return deterministic; }
+
+  /**
+   * Returns a hash of the state of the bodies after the last frame,
+   * see StateHash::addBody, taken in the order of their handles. Two
+   * runs in deterministic mode have parted on the first frame their
+   * hashes differ. It is zero until a frame has run in deterministic
+   * mode.
+   */
+  uint64_t getStateHash() const { return stateHash; }
+
+  /**
+   * Saves the state the next frame starts from into the given
+   * snapshot, see SimulationSnapshot. Returns false, saving nothing,
+   * unless the registered bodies are all the bodies of a single
+   * store.
+   */
+  bool saveState(SimulationSnapshot &snapshot) const;
+
+  /**
+   * Takes the world back to the state saved in the given snapshot:
+   * the frames run after restoring it play out as the ones run after
+   * saving it, to the bit in deterministic mode. The sleeping bodies
+   * whose pose changed have their primitives brought up to date; the
+   * others are when the next frame runs.
+   *
+   * Returns false, changing nothing, if bodies were added or removed
+   * since the snapshot was saved. The applied forces and torques are
+   * restored as well: a frame started with startFrame clears them.
+   */
+  bool restoreState(const SimulationSnapshot &snapshot);
+
+  /**
+   * Returns the solver of the islands, to see how the work was
+   * shared out in the last frame.
+   */
+  const IslandSolver &getIslandSolver() const { return islandSolver; }
+
+  /**
+   * Returns the sequential impulse solver, to change its settings.
+   */
+  SequentialImpulseSolver &getImpulseSolver() { return impulseSolver; }
+
+  /**
+   * Returns the contact manifolds kept between frames.
+   */
+  ContactManifoldCache &getManifolds() { return manifolds; }
+
+  /**
+   * Returns the islands of the last frame.
+   */
+  const IslandBuilder &getIslands() const { return islands; }
+
+  /**
+   * Returns the arena holding the contacts of the last frame, to see
+   * how many there were at most.
+   */
+  const ContactArena &getContactArena() const { return contactArena; }
+
+  /**
+   * Returns the broad phase used by the world.
+   */
+  Broadphase::pointer getBroadphase() const { return broadphase; }
+
   /**
    * Calls each of the registered contact generators to report
    * their contacts. Returns the number of generated contacts.
@@ -0,0 +1,374 @@
+#include "../includes/ft_bodyStore.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/quaternion_geometric.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+static inline void _quanterionAddVector(glm::quat &q, const glm::vec3 &v,
+                                        const float duration) {
+  glm::quat t = {0.0f, v * duration};
+  t *= q;
+
+  q.w += t.w * 0.5f;
+  q.x += t.x * 0.5f;
+  q.y += t.y * 0.5f;
+  q.z += t.z * 0.5f;
+}
+
+static inline void _transformInertiaTensor(glm::mat3 &iitWorld,
+                                           const glm::mat3 &iitBody,
+                                           const glm::mat4 &rotmat) {
+  real_t t4 = rotmat[0][0] * iitBody[0][0] + rotmat[1][0] * iitBody[0][1] +
+              rotmat[2][0] * iitBody[0][2];
+
+  real_t t9 = rotmat[0][0] * iitBody[1][0] + rotmat[1][0] * iitBody[1][1] +
+              rotmat[2][0] * iitBody[1][2];
+
+  real_t t14 = rotmat[0][0] * iitBody[2][0] + rotmat[1][0] * iitBody[2][1] +
+               rotmat[2][0] * iitBody[2][2];
+
+  real_t t28 = rotmat[0][1] * iitBody[0][0] + rotmat[1][1] * iitBody[0][1] +
+               rotmat[2][1] * iitBody[0][2];
+
+  real_t t33 = rotmat[0][1] * iitBody[1][0] + rotmat[1][1] * iitBody[1][1] +
+               rotmat[2][1] * iitBody[1][2];
+
+  real_t t38 = rotmat[0][1] * iitBody[2][0] + rotmat[1][1] * iitBody[2][1] +
+               rotmat[2][1] * iitBody[2][2];
+
+  real_t t52 = rotmat[0][2] * iitBody[0][0] + rotmat[1][2] * iitBody[0][1] +
+               rotmat[2][2] * iitBody[0][2];
+
+  real_t t57 = rotmat[0][2] * iitBody[1][0] + rotmat[1][2] * iitBody[1][1] +
+               rotmat[2][2] * iitBody[1][2];
+
+  real_t t62 = rotmat[0][2] * iitBody[2][0] + rotmat[1][2] * iitBody[2][1] +
+               rotmat[2][2] * iitBody[2][2];
+
+  iitWorld[0][0] = t4 * rotmat[0][0] + t9 * rotmat[1][0] + t14 * rotmat[2][0];
+  iitWorld[1][0] = t4 * rotmat[0][1] + t9 * rotmat[1][1] + t14 * rotmat[2][1];
+  iitWorld[2][0] = t4 * rotmat[0][2] + t9 * rotmat[1][2] + t14 * rotmat[2][2];
+  iitWorld[0][1] = t28 * rotmat[0][0] + t33 * rotmat[1][0] + t38 * rotmat[2][0];
+  iitWorld[1][1] = t28 * rotmat[0][1] + t33 * rotmat[1][1] + t38 * rotmat[2][1];
+  iitWorld[2][1] = t28 * rotmat[0][2] + t33 * rotmat[1][2] + t38 * rotmat[2][2];
+  iitWorld[0][2] = t52 * rotmat[0][0] + t57 * rotmat[1][0] + t62 * rotmat[2][0];
+  iitWorld[1][2] = t52 * rotmat[0][1] + t57 * rotmat[1][1] + t62 * rotmat[2][1];
+  iitWorld[2][2] = t52 * rotmat[0][2] + t57 * rotmat[1][2] + t62 * rotmat[2][2];
+}
+
+static inline void _calculateTransformMatrix(glm::mat4 &transformMatrix,
+                                             const glm::vec3 &position,
+                                             const glm::quat &orientation) {
+  transformMatrix =
+      glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(orientation);
+}
+
+ft::RigidBodyStore &ft::RigidBodyStore::getDefault() {
+  static RigidBodyStore store;
+  return store;
+}
+
+ft::RigidBodyStore::RigidBodyStore() : _simdLevel(getSupportedSimdLevel()) {}
+
+uint32_t ft::RigidBodyStore::create() {
+  uint32_t handle;
+  if (!_freeHandles.empty()) {
+    std::pop_heap(_freeHandles.begin(), _freeHandles.end(),
+                  std::greater<uint32_t>());
+    handle = _freeHandles.back();
+    _freeHandles.pop_back();
+  } else {
+    handle = (uint32_t)alive.size();
+    size_t size = handle + 1;
+    inverseMass.resize(size);
+    linearDamping.resize(size);
+    angularDamping.resize(size);
+    motion.resize(size);
+    position.resize(size);
+    orientation.resize(size);
+    velocity.resize(size);
+    rotation.resize(size);
+    inverseInertiaTensor.resize(size);
+    inverseInertiaTensorWorld.resize(size);
+    transformMatrix.resize(size);
+    isAwake.resize(size);
+    canSleep.resize(size);
+    islandSleep.resize(size);
+    alive.resize(size);
+    forceAccum.resize(size);
+    torqueAccum.resize(size);
+    acceleration.resize(size);
+    lastFrameAcceleration.resize(size);
+  }
+
+  inverseMass[handle] = 0;
+  linearDamping[handle] = 0;
+  angularDamping[handle] = 0;
+  motion[handle] = 0;
+  position.set(handle, glm::vec3(0.0f));
+  orientation.set(handle, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  velocity.set(handle, glm::vec3(0.0f));
+  rotation.set(handle, glm::vec3(0.0f));
+  inverseInertiaTensor.set(handle, glm::mat3(1.0f));
+  inverseInertiaTensorWorld.set(handle, glm::mat3(1.0f));
+  transformMatrix.set(handle, glm::mat4(1.0f));
+  isAwake[handle] = 1;
+  canSleep[handle] = 1;
+  islandSleep[handle] = 0;
+  alive[handle] = 1;
+  forceAccum.set(handle, glm::vec3(0.0f));
+  torqueAccum.set(handle, glm::vec3(0.0f));
+  acceleration.set(handle, glm::vec3(0.0f));
+  lastFrameAcceleration.set(handle, glm::vec3(0.0f));
+
+  ++_count;
+  ++_changes;
+  return handle;
+}
+
+void ft::RigidBodyStore::destroy(uint32_t handle) {
+  assert(isValid(handle));
+  alive[handle] = 0;
+  // A dead body is never awake, so the batched loops skip it with the
+  // same test as the sleeping ones.
+  isAwake[handle] = 0;
+  _freeHandles.push_back(handle);
+  std::push_heap(_freeHandles.begin(), _freeHandles.end(),
+                 std::greater<uint32_t>());
+  --_count;
+  ++_changes;
+}
+
+void ft::RigidBodyStore::calculateDerivedData(uint32_t handle) {
+  glm::quat q = glm::normalize(orientation.get(handle));
+  orientation.set(handle, q);
+
+  glm::mat4 transform;
+  _calculateTransformMatrix(transform, position.get(handle), q);
+  transformMatrix.set(handle, transform);
+
+  glm::mat3 iitWorld;
+  _transformInertiaTensor(iitWorld, inverseInertiaTensor.get(handle),
+                          transform);
+  inverseInertiaTensorWorld.set(handle, iitWorld);
+}
+
+void ft::RigidBodyStore::integrate(uint32_t handle, real_t duration) {
+  if (!isAwake[handle])
+    return;
+
+  glm::vec3 lastFrame = acceleration.get(handle);
+  lastFrame += (inverseMass[handle] * forceAccum.get(handle));
+  lastFrameAcceleration.set(handle, lastFrame);
+
+  glm::vec3 angularAcceleration =
+      inverseInertiaTensorWorld.get(handle) * torqueAccum.get(handle);
+
+  glm::vec3 v = velocity.get(handle);
+  glm::vec3 r = rotation.get(handle);
+  v += (duration * lastFrame);
+
+  r += (duration * angularAcceleration);
+
+  v *= std::pow(linearDamping[handle], duration);
+  r *= std::pow(angularDamping[handle], duration);
+
+  position.set(handle, position.get(handle) + (duration * v));
+
+  glm::quat q = orientation.get(handle);
+  _quanterionAddVector(q, r, duration);
+  orientation.set(handle, q);
+  velocity.set(handle, v);
+  rotation.set(handle, r);
+
+  calculateDerivedData(handle);
+
+  forceAccum.set(handle, glm::vec3(0.0f));
+  torqueAccum.set(handle, glm::vec3(0.0f));
+
+  if (canSleep[handle]) {
+    real_t currentMotion = glm::dot(v, v) + glm::dot(r, r);
+
+    real_t bias = std::pow(0.5f, duration);
+    motion[handle] = bias * motion[handle] + (1 - bias) * currentMotion;
+
+    if (motion[handle] < ft::SLEEP_EPSILON) {
+      if (!islandSleep[handle])
+        setAwake(handle, false);
+    } else if (motion[handle] > 10 * ft::SLEEP_EPSILON)
+      motion[handle] = 10 * ft::SLEEP_EPSILON;
+  }
+}
+
+void ft::RigidBodyStore::integrateAll(real_t duration) {
+  uint32_t capacity = getCapacity();
+
+  _awakeHandles.clear();
+  for (uint32_t i = 0; i < capacity; ++i)
+    if (isAwake[i])
+      _awakeHandles.push_back(i);
+
+  uint32_t count = (uint32_t)_awakeHandles.size();
+  uint32_t batched = 0;
+  if (_simdLevel != SimdLevel::SCALAR) {
+    uint32_t width = getSimdWidth(_simdLevel);
+    batched = count - count % width;
+    real_t bias = std::pow(0.5f, duration);
+    IntegrationArrays arrays = getArrays();
+    if (_simdLevel == SimdLevel::AVX2)
+      integrateAvx2(arrays, _awakeHandles.data(), batched, duration, bias);
+    else
+      integrateSse(arrays, _awakeHandles.data(), batched, duration, bias);
+  }
+
+  // The bodies left over don't fill a group of lanes.
+  for (uint32_t i = batched; i < count; ++i)
+    integrate(_awakeHandles[i], duration);
+}
+
+void ft::RigidBodyStore::setSimdLevel(SimdLevel level) {
+  SimdLevel supported = getSupportedSimdLevel();
+  _simdLevel = (int)level > (int)supported ? supported : level;
+}
+
+static inline void _setPointers(float **pointers, ft::Vec3Array &array) {
+  pointers[0] = array.x.data();
+  pointers[1] = array.y.data();
+  pointers[2] = array.z.data();
+}
+
+ft::IntegrationArrays ft::RigidBodyStore::getArrays() {
+  IntegrationArrays arrays;
+  arrays.inverseMass = inverseMass.data();
+  arrays.linearDamping = linearDamping.data();
+  arrays.angularDamping = angularDamping.data();
+  arrays.motion = motion.data();
+  _setPointers(arrays.position, position);
+  _setPointers(arrays.velocity, velocity);
+  _setPointers(arrays.rotation, rotation);
+  _setPointers(arrays.forceAccum, forceAccum);
+  _setPointers(arrays.torqueAccum, torqueAccum);
+  _setPointers(arrays.acceleration, acceleration);
+  _setPointers(arrays.lastFrameAcceleration, lastFrameAcceleration);
+  arrays.orientation[0] = orientation.w.data();
+  arrays.orientation[1] = orientation.x.data();
+  arrays.orientation[2] = orientation.y.data();
+  arrays.orientation[3] = orientation.z.data();
+  for (int i = 0; i < 9; ++i) {
+    arrays.inverseInertiaTensor[i] = inverseInertiaTensor.m[i].data();
+    arrays.inverseInertiaTensorWorld[i] =
+        inverseInertiaTensorWorld.m[i].data();
+  }
+  for (int i = 0; i < 16; ++i)
+    arrays.transformMatrix[i] = transformMatrix.m[i].data();
+  arrays.isAwake = isAwake.data();
+  arrays.canSleep = canSleep.data();
+  arrays.islandSleep = islandSleep.data();
+  return arrays;
+}
+
+/**
+ * Calls f on each array of the state of the bodies, in the order they
+ * are saved in: the pose first, then the rest.
+ */
+template <typename Store, typename F>
+static void _forEachStateArray(Store &store, F f) {
+  f(store.position.x);
+  f(store.position.y);
+  f(store.position.z);
+  f(store.orientation.w);
+  f(store.orientation.x);
+  f(store.orientation.y);
+  f(store.orientation.z);
+  f(store.velocity.x);
+  f(store.velocity.y);
+  f(store.velocity.z);
+  f(store.rotation.x);
+  f(store.rotation.y);
+  f(store.rotation.z);
+  f(store.motion);
+  f(store.forceAccum.x);
+  f(store.forceAccum.y);
+  f(store.forceAccum.z);
+  f(store.torqueAccum.x);
+  f(store.torqueAccum.y);
+  f(store.torqueAccum.z);
+  f(store.lastFrameAcceleration.x);
+  f(store.lastFrameAcceleration.y);
+  f(store.lastFrameAcceleration.z);
+  // The derived data is saved rather than calculated again, which
+  // would not give back the same bits. The bottom row of the transform
+  // is always 0 0 0 1, set by create, so it is left out.
+  for (int c = 0; c < 4; ++c)
+    for (int r = 0; r < 3; ++r)
+      f(store.transformMatrix.m[c * 4 + r]);
+  for (auto &element : store.inverseInertiaTensorWorld.m)
+    f(element);
+}
+
+void ft::RigidBodyStore::saveState(State &state) const {
+  size_t capacity = alive.size();
+  state.values.resize(capacity * STATE_ARRAYS);
+  real_t *values = state.values.data();
+  _forEachStateArray(*this,
+                     [&values, capacity](const std::vector<real_t> &array) {
+                       std::memcpy(values, array.data(),
+                                   capacity * sizeof(real_t));
+                       values += capacity;
+                     });
+  assert(values == state.values.data() + capacity * STATE_ARRAYS);
+  state.isAwake = isAwake;
+  state.alive = alive;
+  state.changes = _changes;
+}
+
+bool ft::RigidBodyStore::restoreState(const State &state,
+                                      std::vector<uint32_t> *moved) {
+  size_t capacity = alive.size();
+  if (state.changes != _changes || state.alive.size() != capacity ||
+      std::memcmp(state.alive.data(), alive.data(), capacity) != 0)
+    return false;
+
+  // The pose comes first in the values: seven arrays.
+  if (moved) {
+    moved->clear();
+    const real_t *saved = state.values.data();
+    const uint8_t *savedAwake = state.isAwake.data();
+    const uint8_t *savedAlive = state.alive.data();
+    for (uint32_t h = 0; h < capacity; ++h) {
+      if (!savedAlive[h] || savedAwake[h])
+        continue;
+      if (saved[h] != position.x[h] || saved[capacity + h] != position.y[h] ||
+          saved[2 * capacity + h] != position.z[h] ||
+          saved[3 * capacity + h] != orientation.w[h] ||
+          saved[4 * capacity + h] != orientation.x[h] ||
+          saved[5 * capacity + h] != orientation.y[h] ||
+          saved[6 * capacity + h] != orientation.z[h])
+        moved->push_back(h);
+    }
+  }
+
+  const real_t *values = state.values.data();
+  _forEachStateArray(*this, [&values, capacity](std::vector<real_t> &array) {
+    std::memcpy(array.data(), values, capacity * sizeof(real_t));
+    values += capacity;
+  });
+  std::memcpy(isAwake.data(), state.isAwake.data(), capacity);
+  return true;
+}
+
+void ft::RigidBodyStore::setAwake(uint32_t handle, bool awake) {
+  if (awake) {
+    isAwake[handle] = 1;
+
+    motion[handle] = ft::SLEEP_EPSILON * 2.0f;
+  } else {
+    isAwake[handle] = 0;
+    velocity.set(handle, glm::vec3(0.0f));
+    rotation.set(handle, glm::vec3(0.0f));
+  }
+}
@@ -0,0 +1,503 @@
+#include "../includes/ft_broadphase.h"
+#include <algorithm>
+#include <limits>
+
+uint32_t ft::BruteForceBroadphase::createProxy(const BoundingBox &box) {
+  uint32_t proxy;
+  if (!_freeProxies.empty()) {
+    proxy = _freeProxies.back();
+    _freeProxies.pop_back();
+    _boxes[proxy] = box;
+    _alive[proxy] = true;
+  } else {
+    proxy = static_cast<uint32_t>(_boxes.size());
+    _boxes.push_back(box);
+    _alive.push_back(true);
+  }
+  ++_proxyCount;
+  return proxy;
+}
+
+void ft::BruteForceBroadphase::destroyProxy(uint32_t proxy) {
+  if (proxy >= _boxes.size() || !_alive[proxy])
+    return;
+  _alive[proxy] = false;
+  _freeProxies.push_back(proxy);
+  --_proxyCount;
+}
+
+void ft::BruteForceBroadphase::moveProxy(uint32_t proxy,
+                                         const BoundingBox &box) {
+  _boxes[proxy] = box;
+}
+
+void ft::BruteForceBroadphase::findPairs(std::vector<BroadphasePair> &pairs) {
+  pairs.clear();
+  uint32_t size = static_cast<uint32_t>(_boxes.size());
+  for (uint32_t i = 0; i < size; ++i) {
+    if (!_alive[i])
+      continue;
+    for (uint32_t j = i + 1; j < size; ++j) {
+      if (_alive[j] && _boxes[i].overlaps(&_boxes[j]))
+        pairs.push_back({i, j});
+    }
+  }
+}
+
+uint32_t ft::BruteForceBroadphase::getProxyCount() const {
+  return _proxyCount;
+}
+
+uint32_t ft::SortAndSweepBroadphase::createProxy(const BoundingBox &box) {
+  uint32_t proxy;
+  if (!_freeProxies.empty()) {
+    proxy = _freeProxies.back();
+    _freeProxies.pop_back();
+    _boxes[proxy] = box;
+    _alive[proxy] = true;
+  } else {
+    proxy = static_cast<uint32_t>(_boxes.size());
+    _boxes.push_back(box);
+    _alive.push_back(true);
+  }
+  ++_proxyCount;
+  return proxy;
+}
+
+void ft::SortAndSweepBroadphase::destroyProxy(uint32_t proxy) {
+  if (proxy >= _boxes.size() || !_alive[proxy])
+    return;
+  _alive[proxy] = false;
+  _freeProxies.push_back(proxy);
+  --_proxyCount;
+}
+
+void ft::SortAndSweepBroadphase::moveProxy(uint32_t proxy,
+                                           const BoundingBox &box) {
+  _boxes[proxy] = box;
+}
+
+void ft::SortAndSweepBroadphase::findPairs(
+    std::vector<BroadphasePair> &pairs) {
+  pairs.clear();
+  if (_proxyCount < 2)
+    return;
+
+  // Choose the axis along which the box centres vary the most: this
+  // keeps the intervals on that axis as disjoint as possible.
+  glm::vec3 sum(0, 0, 0);
+  glm::vec3 sumSq(0, 0, 0);
+  uint32_t size = static_cast<uint32_t>(_boxes.size());
+  for (uint32_t i = 0; i < size; ++i) {
+    if (!_alive[i])
+      continue;
+    glm::vec3 centre = (_boxes[i].min + _boxes[i].max) * (real_t)0.5;
+    sum += centre;
+    sumSq += centre * centre;
+  }
+  glm::vec3 variance = sumSq - sum * sum / (real_t)_proxyCount;
+  int axis = 0;
+  if (variance.y > variance[axis])
+    axis = 1;
+  if (variance.z > variance[axis])
+    axis = 2;
+
+  // Sort the intervals on that axis by their minimum.
+  _sorted.clear();
+  for (uint32_t i = 0; i < size; ++i) {
+    if (_alive[i])
+      _sorted.push_back({_boxes[i].min[axis], _boxes[i].max[axis], i});
+  }
+  std::sort(_sorted.begin(), _sorted.end(),
+            [](const SweepEntry &a, const SweepEntry &b) {
+              return a.min < b.min;
+            });
+
+  // Sweep: each entry only needs to be tested against the entries
+  // that start before it ends.
+  for (auto it = _sorted.begin(); it != _sorted.end(); ++it) {
+    const BoundingBox &box = _boxes[it->proxy];
+    for (auto other = it + 1; other != _sorted.end(); ++other) {
+      if (other->min > it->max)
+        break;
+      if (box.overlaps(&_boxes[other->proxy])) {
+        if (it->proxy < other->proxy)
+          pairs.push_back({it->proxy, other->proxy});
+        else
+          pairs.push_back({other->proxy, it->proxy});
+      }
+    }
+  }
+}
+
+uint32_t ft::SortAndSweepBroadphase::getProxyCount() const {
+  return _proxyCount;
+}
+
+ft::AABBTreeBroadphase::AABBTreeBroadphase(real_t margin) : _tree(margin) {}
+
+uint32_t ft::AABBTreeBroadphase::createProxy(const BoundingBox &box) {
+  uint32_t proxy;
+  if (!_freeProxies.empty()) {
+    proxy = _freeProxies.back();
+    _freeProxies.pop_back();
+    _boxes[proxy] = box;
+  } else {
+    proxy = static_cast<uint32_t>(_boxes.size());
+    _boxes.push_back(box);
+    _leaves.push_back(DynamicAABBTree::NULL_NODE);
+  }
+  _leaves[proxy] = _tree.createLeaf(box, proxy);
+  ++_proxyCount;
+  return proxy;
+}
+
+void ft::AABBTreeBroadphase::destroyProxy(uint32_t proxy) {
+  if (proxy >= _leaves.size() || _leaves[proxy] == DynamicAABBTree::NULL_NODE)
+    return;
+  _tree.destroyLeaf(_leaves[proxy]);
+  _leaves[proxy] = DynamicAABBTree::NULL_NODE;
+  _freeProxies.push_back(proxy);
+  --_proxyCount;
+}
+
+void ft::AABBTreeBroadphase::moveProxy(uint32_t proxy,
+                                       const BoundingBox &box) {
+  _boxes[proxy] = box;
+  _tree.moveLeaf(_leaves[proxy], box);
+}
+
+void ft::AABBTreeBroadphase::findPairs(std::vector<BroadphasePair> &pairs) {
+  pairs.clear();
+  _tree.queryPairs([&](uint32_t one, uint32_t two) {
+    if (!_boxes[one].overlaps(&_boxes[two]))
+      return;
+    if (one < two)
+      pairs.push_back({one, two});
+    else
+      pairs.push_back({two, one});
+  });
+}
+
+uint32_t ft::AABBTreeBroadphase::getProxyCount() const { return _proxyCount; }
+
+uint64_t ft::SweepAndPruneBroadphase::pairKey(uint32_t one, uint32_t two) {
+  if (one > two)
+    std::swap(one, two);
+  return ((uint64_t)one << 32) | two;
+}
+
+bool ft::SweepAndPruneBroadphase::endpointLess(const Endpoint &one,
+                                               const Endpoint &two) {
+  // A minimum goes before a maximum of the same value, so that two
+  // boxes that just touch are seen as overlapping, as in
+  // BoundingBox::overlaps.
+  return one.value < two.value ||
+         (one.value == two.value && !one.isMax() && two.isMax());
+}
+
+void ft::SweepAndPruneBroadphase::setEndpointIndex(int axis, uint32_t index) {
+  const Endpoint &endpoint = _endpoints[axis][index];
+  SapProxy &proxy = _proxies[endpoint.getProxy()];
+  if (endpoint.isMax())
+    proxy.max[axis] = index;
+  else
+    proxy.min[axis] = index;
+}
+
+void ft::SweepAndPruneBroadphase::sortDown(int axis, uint32_t index) {
+  std::vector<Endpoint> &endpoints = _endpoints[axis];
+  Endpoint endpoint = endpoints[index];
+
+  while (index > 0 && endpointLess(endpoint, endpoints[index - 1])) {
+    const Endpoint &previous = endpoints[index - 1];
+    // Only a minimum passing a maximum changes the overlap on this
+    // axis: a minimum going down starts an overlap, a maximum going
+    // down ends one.
+    if (previous.isMax() != endpoint.isMax() &&
+        previous.getProxy() != endpoint.getProxy()) {
+      if (endpoint.isMax())
+        endOverlap(endpoint.getProxy(), previous.getProxy());
+      else
+        beginOverlap(endpoint.getProxy(), previous.getProxy());
+    }
+
+    endpoints[index] = previous;
+    setEndpointIndex(axis, index);
+    --index;
+  }
+
+  endpoints[index] = endpoint;
+  setEndpointIndex(axis, index);
+}
+
+void ft::SweepAndPruneBroadphase::sortUp(int axis, uint32_t index) {
+  std::vector<Endpoint> &endpoints = _endpoints[axis];
+  Endpoint endpoint = endpoints[index];
+  uint32_t last = static_cast<uint32_t>(endpoints.size()) - 1;
+
+  while (index < last && endpointLess(endpoints[index + 1], endpoint)) {
+    const Endpoint &next = endpoints[index + 1];
+    if (next.isMax() != endpoint.isMax() &&
+        next.getProxy() != endpoint.getProxy()) {
+      if (endpoint.isMax())
+        beginOverlap(endpoint.getProxy(), next.getProxy());
+      else
+        endOverlap(endpoint.getProxy(), next.getProxy());
+    }
+
+    endpoints[index] = next;
+    setEndpointIndex(axis, index);
+    ++index;
+  }
+
+  endpoints[index] = endpoint;
+  setEndpointIndex(axis, index);
+}
+
+void ft::SweepAndPruneBroadphase::beginOverlap(uint32_t moving,
+                                               uint32_t other) {
+  // The boxes always hold the final position of the proxies, so the
+  // pair can be settled here even if other endpoints of the moving
+  // proxy are not sorted yet.
+  if (!_fatBoxes[moving].overlaps(&_fatBoxes[other]))
+    return;
+  uint64_t key = pairKey(moving, other);
+  auto [it, added] = _pairIndex.emplace(key, (uint32_t)_cachedPairs.size());
+  if (!added)
+    return;
+  if (moving < other)
+    _cachedPairs.push_back({moving, other});
+  else
+    _cachedPairs.push_back({other, moving});
+  ++_pairChanges[key];
+}
+
+void ft::SweepAndPruneBroadphase::endOverlap(uint32_t moving,
+                                             uint32_t other) {
+  // The two endpoints that just swapped hold their final values, so
+  // the boxes don't overlap any more. The pair can only be in the
+  // set if they overlapped before the move.
+  if (!_movingBox.overlaps(&_fatBoxes[other]))
+    return;
+  removePair(pairKey(moving, other));
+}
+
+bool ft::SweepAndPruneBroadphase::removePair(uint64_t key) {
+  auto it = _pairIndex.find(key);
+  if (it == _pairIndex.end())
+    return false;
+
+  // Move the last pair into the hole to keep the cache packed.
+  uint32_t index = it->second;
+  _pairIndex.erase(it);
+  const BroadphasePair &last = _cachedPairs.back();
+  if (index + 1 != _cachedPairs.size()) {
+    _cachedPairs[index] = last;
+    _pairIndex[pairKey(last.first, last.second)] = index;
+  }
+  _cachedPairs.pop_back();
+
+  --_pairChanges[key];
+  return true;
+}
+
+ft::SweepAndPruneBroadphase::SweepAndPruneBroadphase(real_t margin)
+    : _margin(margin) {}
+
+uint32_t ft::SweepAndPruneBroadphase::createProxy(const BoundingBox &box) {
+  glm::vec3 margin(_margin, _margin, _margin);
+  BoundingBox fatBox(box.min - margin, box.max + margin);
+
+  uint32_t proxy;
+  if (!_freeProxies.empty()) {
+    proxy = _freeProxies.back();
+    _freeProxies.pop_back();
+    _boxes[proxy] = box;
+    _fatBoxes[proxy] = fatBox;
+  } else {
+    proxy = static_cast<uint32_t>(_proxies.size());
+    _proxies.emplace_back();
+    _boxes.push_back(box);
+    _fatBoxes.push_back(fatBox);
+  }
+  _proxies[proxy].alive = true;
+
+  // A new proxy has no pairs to lose.
+  real_t far = std::numeric_limits<real_t>::max();
+  _movingBox = BoundingBox(glm::vec3(far, far, far), glm::vec3(-far, -far, -far));
+
+  // Add both endpoints at the end of each axis and sort them down:
+  // the minimum passes the maximum of every proxy that overlaps on
+  // that axis, which registers the new pairs.
+  for (int axis = 0; axis < 3; ++axis) {
+    std::vector<Endpoint> &endpoints = _endpoints[axis];
+
+    endpoints.push_back({fatBox.min[axis], proxy << 1});
+    sortDown(axis, static_cast<uint32_t>(endpoints.size()) - 1);
+
+    endpoints.push_back({fatBox.max[axis], (proxy << 1) | 1});
+    sortDown(axis, static_cast<uint32_t>(endpoints.size()) - 1);
+  }
+
+  ++_proxyCount;
+  return proxy;
+}
+
+void ft::SweepAndPruneBroadphase::destroyProxy(uint32_t proxy) {
+  if (proxy >= _proxies.size() || !_proxies[proxy].alive)
+    return;
+
+  for (int axis = 0; axis < 3; ++axis) {
+    std::vector<Endpoint> &endpoints = _endpoints[axis];
+    uint32_t min = _proxies[proxy].min[axis];
+    uint32_t max = _proxies[proxy].max[axis];
+
+    endpoints.erase(endpoints.begin() + max);
+    endpoints.erase(endpoints.begin() + min);
+    for (uint32_t i = min; i < endpoints.size(); ++i)
+      setEndpointIndex(axis, i);
+  }
+
+  // Walk backwards, removing a pair moves the last one into its
+  // place, which has already been looked at.
+  for (size_t i = _cachedPairs.size(); i-- > 0;) {
+    const BroadphasePair &pair = _cachedPairs[i];
+    if (pair.first == proxy || pair.second == proxy)
+      removePair(pairKey(pair.first, pair.second));
+  }
+
+  _proxies[proxy].alive = false;
+  _freeProxies.push_back(proxy);
+  --_proxyCount;
+}
+
+void ft::SweepAndPruneBroadphase::moveProxy(uint32_t proxy,
+                                            const BoundingBox &box) {
+  _boxes[proxy] = box;
+
+  // The endpoints hold fattened boxes, as in the AABB tree: as long
+  // as the proxy stays inside its fat box and the fat box is not
+  // much bigger than it, nothing has to move. This is what makes a
+  // pile at rest free.
+  glm::vec3 margin(_margin, _margin, _margin);
+  BoundingBox old = _fatBoxes[proxy];
+  BoundingBox largeBox(box.min - margin * (real_t)4.0,
+                       box.max + margin * (real_t)4.0);
+  if (old.contains(box) && largeBox.contains(old))
+    return;
+
+  BoundingBox fatBox(box.min - margin, box.max + margin);
+  _movingBox = old;
+  _fatBoxes[proxy] = fatBox;
+  SapProxy &sapProxy = _proxies[proxy];
+
+  // Grow before shrinking, so that the minimum and the maximum of
+  // the proxy never have to pass each other.
+  for (int axis = 0; axis < 3; ++axis) {
+    std::vector<Endpoint> &endpoints = _endpoints[axis];
+
+    if (fatBox.max[axis] > old.max[axis]) {
+      endpoints[sapProxy.max[axis]].value = fatBox.max[axis];
+      sortUp(axis, sapProxy.max[axis]);
+    }
+    if (fatBox.min[axis] < old.min[axis]) {
+      endpoints[sapProxy.min[axis]].value = fatBox.min[axis];
+      sortDown(axis, sapProxy.min[axis]);
+    }
+    if (fatBox.min[axis] > old.min[axis]) {
+      endpoints[sapProxy.min[axis]].value = fatBox.min[axis];
+      sortUp(axis, sapProxy.min[axis]);
+    }
+    if (fatBox.max[axis] < old.max[axis]) {
+      endpoints[sapProxy.max[axis]].value = fatBox.max[axis];
+      sortDown(axis, sapProxy.max[axis]);
+    }
+  }
+}
+
+void ft::SweepAndPruneBroadphase::findPairs(
+    std::vector<BroadphasePair> &pairs) {
+  // The cached pairs overlap with their fat boxes, only report the
+  // ones that really overlap.
+  pairs.clear();
+  for (const BroadphasePair &pair : _cachedPairs) {
+    if (_boxes[pair.first].overlaps(&_boxes[pair.second]))
+      pairs.push_back(pair);
+  }
+
+  _addedPairs.clear();
+  _removedPairs.clear();
+  for (auto &[key, change] : _pairChanges) {
+    BroadphasePair pair = {static_cast<uint32_t>(key >> 32),
+                           static_cast<uint32_t>(key & 0xffffffff)};
+    if (change > 0)
+      _addedPairs.push_back(pair);
+    else if (change < 0)
+      _removedPairs.push_back(pair);
+  }
+  _pairChanges.clear();
+}
+
+uint32_t ft::SweepAndPruneBroadphase::getProxyCount() const {
+  return _proxyCount;
+}
+
+ft::SpatialHashBroadphase::SpatialHashBroadphase(real_t cellSize)
+    : _cellSize(cellSize) {}
+
+uint32_t ft::SpatialHashBroadphase::createProxy(const BoundingBox &box) {
+  uint32_t proxy;
+  if (!_freeProxies.empty()) {
+    proxy = _freeProxies.back();
+    _freeProxies.pop_back();
+    _boxes[proxy] = box;
+  } else {
+    proxy = static_cast<uint32_t>(_boxes.size());
+    _boxes.push_back(box);
+  }
+  ++_proxyCount;
+  return proxy;
+}
+
+void ft::SpatialHashBroadphase::destroyProxy(uint32_t proxy) {
+  if (proxy >= _boxes.size() || _boxes[proxy].min.x > _boxes[proxy].max.x)
+    return;
+  // An empty box is left out of the grid.
+  _boxes[proxy].min = glm::vec3(1, 1, 1);
+  _boxes[proxy].max = glm::vec3(-1, -1, -1);
+  _freeProxies.push_back(proxy);
+  --_proxyCount;
+}
+
+void ft::SpatialHashBroadphase::moveProxy(uint32_t proxy,
+                                          const BoundingBox &box) {
+  _boxes[proxy] = box;
+}
+
+void ft::SpatialHashBroadphase::findPairs(std::vector<BroadphasePair> &pairs) {
+  pairs.clear();
+  _grid.build(_boxes.data(), static_cast<uint32_t>(_boxes.size()), _cellSize);
+  _grid.findPairs(
+      [&](uint32_t one, uint32_t two) { pairs.push_back({one, two}); });
+}
+
+uint32_t ft::SpatialHashBroadphase::getProxyCount() const {
+  return _proxyCount;
+}
+
+ft::Broadphase::pointer ft::createBroadphase(BroadphaseType type) {
+  switch (type) {
+  case BroadphaseType::BRUTE_FORCE:
+    return std::make_shared<BruteForceBroadphase>();
+  case BroadphaseType::SORT_AND_SWEEP:
+    return std::make_shared<SortAndSweepBroadphase>();
+  case BroadphaseType::SWEEP_AND_PRUNE:
+    return std::make_shared<SweepAndPruneBroadphase>();
+  case BroadphaseType::SPATIAL_HASH:
+    return std::make_shared<SpatialHashBroadphase>();
+  case BroadphaseType::AABB_TREE:
+  default:
+    return std::make_shared<AABBTreeBroadphase>();
+  }
+}
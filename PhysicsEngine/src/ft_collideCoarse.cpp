@@ -1,4 +1,6 @@
 #include "../includes/ft_collideCoarse.h"
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 
 ft::BoundingSphere::BoundingSphere(const glm::vec3 &centre, real_t radius) {
@@ -43,3 +45,416 @@ real_t ft::BoundingSphere::getGrowth(const BoundingSphere &other) const {
 
   return newSphere.radius * newSphere.radius - radius * radius;
 }
+
+ft::BoundingBox::BoundingBox(const glm::vec3 &min, const glm::vec3 &max)
+    : min(min), max(max) {}
+
+ft::BoundingBox::BoundingBox(const BoundingBox &one, const BoundingBox &two)
+    : min(glm::min(one.min, two.min)), max(glm::max(one.max, two.max)) {}
+
+bool ft::BoundingBox::contains(const BoundingBox &other) const {
+  return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z &&
+         other.max.x <= max.x && other.max.y <= max.y && other.max.z <= max.z;
+}
+
+real_t ft::BoundingBox::getGrowth(const BoundingBox &other) const {
+  BoundingBox newBox(*this, other);
+
+  return newBox.getSize() - getSize();
+}
+
+/*********************************DynamicAABBTree***************************/
+
+ft::DynamicAABBTree::DynamicAABBTree(real_t margin) : _margin(margin) {}
+
+uint32_t ft::DynamicAABBTree::allocateNode() {
+  uint32_t node;
+  if (_freeList == NULL_NODE) {
+    node = static_cast<uint32_t>(_nodes.size());
+    _nodes.emplace_back();
+  } else {
+    node = _freeList;
+    _freeList = _nodes[node].parent;
+  }
+
+  TreeNode &n = _nodes[node];
+  n.parent = NULL_NODE;
+  n.children[0] = n.children[1] = NULL_NODE;
+  n.userData = NULL_NODE;
+  n.height = 0;
+  return node;
+}
+
+void ft::DynamicAABBTree::freeNode(uint32_t node) {
+  _nodes[node].parent = _freeList;
+  _nodes[node].height = -1;
+  _freeList = node;
+}
+
+uint32_t ft::DynamicAABBTree::createLeaf(const BoundingBox &box,
+                                         uint32_t userData) {
+  uint32_t leaf = allocateNode();
+  glm::vec3 margin(_margin, _margin, _margin);
+  _nodes[leaf].box = BoundingBox(box.min - margin, box.max + margin);
+  _nodes[leaf].userData = userData;
+
+  insertLeaf(leaf);
+  ++_leafCount;
+  return leaf;
+}
+
+void ft::DynamicAABBTree::destroyLeaf(uint32_t leaf) {
+  assert(leaf < _nodes.size() && _nodes[leaf].isLeaf());
+  removeLeaf(leaf);
+  freeNode(leaf);
+  --_leafCount;
+}
+
+bool ft::DynamicAABBTree::moveLeaf(uint32_t leaf, const BoundingBox &box) {
+  assert(leaf < _nodes.size() && _nodes[leaf].isLeaf());
+
+  // Keep the leaf as long as the fat box holds the new box and is
+  // not much bigger than it: a leaf that stays too large after the
+  // object slowed down would report pairs for nothing.
+  glm::vec3 margin(_margin, _margin, _margin);
+  const BoundingBox &fatBox = _nodes[leaf].box;
+  BoundingBox largeBox(box.min - margin * (real_t)4.0,
+                       box.max + margin * (real_t)4.0);
+  if (fatBox.contains(box) && largeBox.contains(fatBox))
+    return false;
+
+  removeLeaf(leaf);
+  _nodes[leaf].box = BoundingBox(box.min - margin, box.max + margin);
+  insertLeaf(leaf);
+  return true;
+}
+
+void ft::DynamicAABBTree::insertLeaf(uint32_t leaf) {
+  if (_root == NULL_NODE) {
+    _root = leaf;
+    _nodes[leaf].parent = NULL_NODE;
+    return;
+  }
+
+  // Walk down to the best sibling, using the increase in surface
+  // area as the cost of placing the leaf below each node.
+  BoundingBox leafBox = _nodes[leaf].box;
+  uint32_t index = _root;
+  while (!_nodes[index].isLeaf()) {
+    const TreeNode &node = _nodes[index];
+    real_t area = node.box.getSize();
+    real_t combinedArea = BoundingBox(node.box, leafBox).getSize();
+
+    // Cost of creating a new parent for this node and the leaf.
+    real_t cost = (real_t)2.0 * combinedArea;
+    // Minimum cost of pushing the leaf further down the tree.
+    real_t inheritance = (real_t)2.0 * (combinedArea - area);
+
+    real_t childCost[2];
+    for (int i = 0; i < 2; ++i) {
+      const TreeNode &child = _nodes[node.children[i]];
+      real_t grownArea = BoundingBox(child.box, leafBox).getSize();
+      if (child.isLeaf())
+        childCost[i] = grownArea + inheritance;
+      else
+        childCost[i] = grownArea - child.box.getSize() + inheritance;
+    }
+
+    if (cost < childCost[0] && cost < childCost[1])
+      break;
+
+    index = childCost[0] < childCost[1] ? node.children[0] : node.children[1];
+  }
+  uint32_t sibling = index;
+
+  // Create a new parent for the sibling and the leaf.
+  uint32_t oldParent = _nodes[sibling].parent;
+  uint32_t newParent = allocateNode();
+  _nodes[newParent].parent = oldParent;
+  _nodes[newParent].box = BoundingBox(leafBox, _nodes[sibling].box);
+  _nodes[newParent].height = _nodes[sibling].height + 1;
+  _nodes[newParent].children[0] = sibling;
+  _nodes[newParent].children[1] = leaf;
+  _nodes[sibling].parent = newParent;
+  _nodes[leaf].parent = newParent;
+
+  if (oldParent != NULL_NODE) {
+    TreeNode &parent = _nodes[oldParent];
+    if (parent.children[0] == sibling)
+      parent.children[0] = newParent;
+    else
+      parent.children[1] = newParent;
+  } else {
+    _root = newParent;
+  }
+
+  // Walk back up, fixing the heights and boxes and rebalancing.
+  index = _nodes[leaf].parent;
+  while (index != NULL_NODE) {
+    index = balance(index);
+
+    TreeNode &node = _nodes[index];
+    const TreeNode &one = _nodes[node.children[0]];
+    const TreeNode &two = _nodes[node.children[1]];
+    node.height = 1 + std::max(one.height, two.height);
+    node.box = BoundingBox(one.box, two.box);
+
+    index = node.parent;
+  }
+}
+
+void ft::DynamicAABBTree::removeLeaf(uint32_t leaf) {
+  if (leaf == _root) {
+    _root = NULL_NODE;
+    return;
+  }
+
+  uint32_t parent = _nodes[leaf].parent;
+  uint32_t grandParent = _nodes[parent].parent;
+  uint32_t sibling = _nodes[parent].children[0] == leaf
+                         ? _nodes[parent].children[1]
+                         : _nodes[parent].children[0];
+
+  if (grandParent == NULL_NODE) {
+    _root = sibling;
+    _nodes[sibling].parent = NULL_NODE;
+    freeNode(parent);
+    return;
+  }
+
+  // Replace the parent by the sibling and refit the ancestors.
+  TreeNode &grand = _nodes[grandParent];
+  if (grand.children[0] == parent)
+    grand.children[0] = sibling;
+  else
+    grand.children[1] = sibling;
+  _nodes[sibling].parent = grandParent;
+  freeNode(parent);
+
+  uint32_t index = grandParent;
+  while (index != NULL_NODE) {
+    index = balance(index);
+
+    TreeNode &node = _nodes[index];
+    const TreeNode &one = _nodes[node.children[0]];
+    const TreeNode &two = _nodes[node.children[1]];
+    node.height = 1 + std::max(one.height, two.height);
+    node.box = BoundingBox(one.box, two.box);
+
+    index = node.parent;
+  }
+}
+
+uint32_t ft::DynamicAABBTree::balance(uint32_t iA) {
+  TreeNode &A = _nodes[iA];
+  if (A.isLeaf() || A.height < 2)
+    return iA;
+
+  uint32_t iB = A.children[0];
+  uint32_t iC = A.children[1];
+  TreeNode &B = _nodes[iB];
+  TreeNode &C = _nodes[iC];
+
+  int diff = C.height - B.height;
+
+  // Rotate C up: A takes the place of C's shorter child.
+  if (diff > 1) {
+    uint32_t iF = C.children[0];
+    uint32_t iG = C.children[1];
+    TreeNode &F = _nodes[iF];
+    TreeNode &G = _nodes[iG];
+
+    C.children[0] = iA;
+    C.parent = A.parent;
+    A.parent = iC;
+
+    if (C.parent != NULL_NODE) {
+      TreeNode &parent = _nodes[C.parent];
+      if (parent.children[0] == iA)
+        parent.children[0] = iC;
+      else
+        parent.children[1] = iC;
+    } else {
+      _root = iC;
+    }
+
+    if (F.height > G.height) {
+      C.children[1] = iF;
+      A.children[1] = iG;
+      G.parent = iA;
+      A.box = BoundingBox(B.box, G.box);
+      C.box = BoundingBox(A.box, F.box);
+      A.height = 1 + std::max(B.height, G.height);
+      C.height = 1 + std::max(A.height, F.height);
+    } else {
+      C.children[1] = iG;
+      A.children[1] = iF;
+      F.parent = iA;
+      A.box = BoundingBox(B.box, F.box);
+      C.box = BoundingBox(A.box, G.box);
+      A.height = 1 + std::max(B.height, F.height);
+      C.height = 1 + std::max(A.height, G.height);
+    }
+    return iC;
+  }
+
+  // Rotate B up: A takes the place of B's shorter child.
+  if (diff < -1) {
+    uint32_t iD = B.children[0];
+    uint32_t iE = B.children[1];
+    TreeNode &D = _nodes[iD];
+    TreeNode &E = _nodes[iE];
+
+    B.children[0] = iA;
+    B.parent = A.parent;
+    A.parent = iB;
+
+    if (B.parent != NULL_NODE) {
+      TreeNode &parent = _nodes[B.parent];
+      if (parent.children[0] == iA)
+        parent.children[0] = iB;
+      else
+        parent.children[1] = iB;
+    } else {
+      _root = iB;
+    }
+
+    if (D.height > E.height) {
+      B.children[1] = iD;
+      A.children[0] = iE;
+      E.parent = iA;
+      A.box = BoundingBox(C.box, E.box);
+      B.box = BoundingBox(A.box, D.box);
+      A.height = 1 + std::max(C.height, E.height);
+      B.height = 1 + std::max(A.height, D.height);
+    } else {
+      B.children[1] = iE;
+      A.children[0] = iD;
+      D.parent = iA;
+      A.box = BoundingBox(C.box, D.box);
+      B.box = BoundingBox(A.box, E.box);
+      A.height = 1 + std::max(C.height, D.height);
+      B.height = 1 + std::max(A.height, E.height);
+    }
+    return iB;
+  }
+
+  return iA;
+}
+
+int ft::DynamicAABBTree::getHeight() const {
+  if (_root == NULL_NODE)
+    return 0;
+  return _nodes[_root].height;
+}
+
+bool ft::DynamicAABBTree::validate() const {
+  if (_root == NULL_NODE)
+    return _leafCount == 0;
+  if (_nodes[_root].parent != NULL_NODE)
+    return false;
+  return validateNode(_root);
+}
+
+bool ft::DynamicAABBTree::validateNode(uint32_t index) const {
+  const TreeNode &node = _nodes[index];
+  if (node.isLeaf())
+    return node.height == 0 && node.children[1] == NULL_NODE;
+
+  const TreeNode &one = _nodes[node.children[0]];
+  const TreeNode &two = _nodes[node.children[1]];
+  if (one.parent != index || two.parent != index)
+    return false;
+  if (node.height != 1 + std::max(one.height, two.height))
+    return false;
+  if (std::abs(one.height - two.height) > 1)
+    return false;
+  if (!node.box.contains(one.box) || !node.box.contains(two.box))
+    return false;
+
+  return validateNode(node.children[0]) && validateNode(node.children[1]);
+}
+
+/*********************************SpatialHashGrid***************************/
+
+void ft::SpatialHashGrid::build(const BoundingBox *boxes, uint32_t count,
+                                real_t cellSize) {
+  // Pick the cell size from the median radius of the boxes.
+  if (cellSize <= 0) {
+    _radii.clear();
+    for (uint32_t id = 0; id < count; ++id) {
+      const BoundingBox &box = boxes[id];
+      if (box.min.x > box.max.x)
+        continue;
+      glm::vec3 extent = box.max - box.min;
+      _radii.push_back((real_t)0.5 *
+                       std::max(extent.x, std::max(extent.y, extent.z)));
+    }
+    cellSize = 1;
+    if (!_radii.empty()) {
+      auto median = _radii.begin() + _radii.size() / 2;
+      std::nth_element(_radii.begin(), median, _radii.end());
+      if (*median > 0)
+        cellSize = CELL_SCALE * *median;
+    }
+  }
+  _cellSize = cellSize;
+  _inverseCellSize = (real_t)1.0 / cellSize;
+
+  // First pass: count the entries, to size the table.
+  uint32_t total = 0;
+  for (uint32_t id = 0; id < count; ++id) {
+    const BoundingBox &box = boxes[id];
+    if (box.min.x > box.max.x)
+      continue;
+    uint32_t cells = 1;
+    for (int i = 0; i < 3; ++i)
+      cells *= (uint32_t)(cellCoordinate(box.max[i]) -
+                          cellCoordinate(box.min[i]) + 1);
+    total += cells;
+  }
+
+  uint32_t tableSize = 16;
+  while (tableSize < total)
+    tableSize <<= 1;
+  _mask = tableSize - 1;
+
+  // Second pass: count the entries of every bucket.
+  _bucketStart.assign(tableSize + 1, 0);
+  for (uint32_t id = 0; id < count; ++id) {
+    const BoundingBox &box = boxes[id];
+    if (box.min.x > box.max.x)
+      continue;
+    int32_t min[3], max[3];
+    for (int i = 0; i < 3; ++i) {
+      min[i] = cellCoordinate(box.min[i]);
+      max[i] = cellCoordinate(box.max[i]);
+    }
+    for (int32_t x = min[0]; x <= max[0]; ++x)
+      for (int32_t y = min[1]; y <= max[1]; ++y)
+        for (int32_t z = min[2]; z <= max[2]; ++z)
+          ++_bucketStart[hashCell(x, y, z)];
+  }
+
+  // Turn the counts into the end of every bucket...
+  for (uint32_t i = 1; i <= tableSize; ++i)
+    _bucketStart[i] += _bucketStart[i - 1];
+
+  // ...and fill the buckets from their end, which leaves every
+  // counter at the start of its bucket.
+  _entries.resize(total);
+  for (uint32_t id = 0; id < count; ++id) {
+    const BoundingBox &box = boxes[id];
+    if (box.min.x > box.max.x)
+      continue;
+    int32_t min[3], max[3];
+    for (int i = 0; i < 3; ++i) {
+      min[i] = cellCoordinate(box.min[i]);
+      max[i] = cellCoordinate(box.max[i]);
+    }
+    for (int32_t x = min[0]; x <= max[0]; ++x)
+      for (int32_t y = min[1]; y <= max[1]; ++y)
+        for (int32_t z = min[2]; z <= max[2]; ++z)
+          _entries[--_bucketStart[hashCell(x, y, z)]] = {box, id, {x, y, z}};
+  }
+}
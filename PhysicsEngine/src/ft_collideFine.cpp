@@ -13,6 +13,28 @@ void ft::CollisionPrimitive::calculateInternals() {
   transform = body->getTransform() * offset;
 }
 
+ft::BoundingBox ft::CollisionPrimitive::getBoundingBox() const {
+  if (_type == PrimitiveType::SPHERE)
+    return static_cast<const CollisionSphere *>(this)->getBoundingBox();
+  return static_cast<const CollisionBox *>(this)->getBoundingBox();
+}
+
+ft::BoundingBox ft::CollisionSphere::getBoundingBox() const {
+  glm::vec3 centre = getAxis(3);
+  glm::vec3 extent(radius, radius, radius);
+
+  return BoundingBox(centre - extent, centre + extent);
+}
+
+ft::BoundingBox ft::CollisionBox::getBoundingBox() const {
+  glm::vec3 centre = getAxis(3);
+  glm::vec3 extent = glm::abs(getAxis(0)) * halfSize.x +
+                     glm::abs(getAxis(1)) * halfSize.y +
+                     glm::abs(getAxis(2)) * halfSize.z;
+
+  return BoundingBox(centre - extent, centre + extent);
+}
+
 bool ft::IntersectionTests::sphereAndHalfSpace(const CollisionSphere &sphere,
                                                const CollisionPlane &plane) {
   real_t ballDistance =
@@ -208,7 +230,8 @@ static inline bool tryAxis(const ft::CollisionBox &one,
 
 void fillPointFaceBoxBox(const ft::CollisionBox &one,
                          const ft::CollisionBox &two, const glm::vec3 &toCentre,
-                         ft::CollisionData *data, unsigned best, real_t pen) {
+                         ft::CollisionData *data, unsigned best, real_t pen,
+                         unsigned axisId) {
 
   ft::Contact *contact = data->contacts;
 
@@ -217,18 +240,118 @@ void fillPointFaceBoxBox(const ft::CollisionBox &one,
     normal = normal * -1.0f;
   }
 
+  unsigned vertexId = 0;
   glm::vec3 vertex = two.halfSize;
-  if (glm::dot(two.getAxis(0), normal) < 0)
-    vertex.x = -vertex.x;
-  if (glm::dot(two.getAxis(1), normal) < 0)
-    vertex.y = -vertex.y;
-  if (glm::dot(two.getAxis(2), normal) < 0)
-    vertex.z = -vertex.z;
+  for (unsigned i = 0; i < 3; i++) {
+    if (glm::dot(two.getAxis(i), normal) < 0) {
+      vertex[i] = -vertex[i];
+      vertexId |= 1 << i;
+    }
+  }
 
   contact->_contactNormal = normal;
   contact->_penetration = pen;
   contact->_contactPoint = two.getTransform() * glm::vec4(vertex, 1.0f);
   contact->setBodyData(one.body, two.body, data->friction, data->restitution);
+  contact->_featureId = axisId | (vertexId << 4) | (1 << 15);
+}
+
+/**
+ * Fills in the contacts between a face of the first box and the face
+ * of the second box that is most turned towards it. The second face
+ * is clipped by the four sides of the first one, and every corner of
+ * what is left that is inside the first box becomes a contact.
+ * Returns the number of contacts written, which is zero when the
+ * boxes only touch at an edge or a vertex.
+ */
+static unsigned clipFaceBoxBox(const ft::CollisionBox &one,
+                               const ft::CollisionBox &two,
+                               const glm::vec3 &toCentre,
+                               ft::CollisionData *data, unsigned best,
+                               unsigned axisId) {
+
+  glm::vec3 normal = one.getAxis(best);
+  if (glm::dot(normal, toCentre) > 0)
+    normal = normal * -1.0f;
+  glm::vec3 referenceCentre = one.getAxis(3) - normal * one.halfSize[best];
+
+  // The face of the second box facing the first one.
+  unsigned face = 0;
+  real_t faceDot = 0;
+  for (unsigned i = 0; i < 3; i++) {
+    real_t d = glm::dot(two.getAxis(i), normal);
+    if (std::abs(d) > std::abs(faceDot)) {
+      faceDot = d;
+      face = i;
+    }
+  }
+  real_t side = faceDot > 0 ? 1.0f : -1.0f;
+  glm::vec3 faceCentre =
+      two.getAxis(3) + two.getAxis(face) * (side * two.halfSize[face]);
+  glm::vec3 u = two.getAxis((face + 1) % 3) * two.halfSize[(face + 1) % 3];
+  glm::vec3 v = two.getAxis((face + 2) % 3) * two.halfSize[(face + 2) % 3];
+  unsigned faceId = axisId | ((face * 2 + (faceDot > 0 ? 0 : 1)) << 4);
+
+  // Two buffers, clipped into each other in turn. Clipping a convex
+  // polygon by a plane adds at most one vertex.
+  glm::vec3 points[2][8];
+  unsigned ids[2][8];
+  unsigned count = 4;
+  points[0][0] = faceCentre + u + v;
+  points[0][1] = faceCentre - u + v;
+  points[0][2] = faceCentre - u - v;
+  points[0][3] = faceCentre + u - v;
+  for (unsigned i = 0; i < 4; i++)
+    ids[0][i] = faceId | (i << 7);
+
+  unsigned in = 0;
+  for (unsigned plane = 0; plane < 4 && count > 0; plane++) {
+    unsigned axis = (best + 1 + plane / 2) % 3;
+    glm::vec3 direction = one.getAxis(axis) * ((plane & 1) ? -1.0f : 1.0f);
+    real_t limit = glm::dot(one.getAxis(3), direction) + one.halfSize[axis];
+
+    unsigned out = 1 - in;
+    unsigned clipped = 0;
+    for (unsigned i = 0; i < count; i++) {
+      const glm::vec3 &current = points[in][i];
+      const glm::vec3 &next = points[in][(i + 1) % count];
+      real_t currentDistance = glm::dot(current, direction) - limit;
+      real_t nextDistance = glm::dot(next, direction) - limit;
+
+      if (currentDistance <= 0) {
+        points[out][clipped] = current;
+        ids[out][clipped++] = ids[in][i];
+      }
+      if ((currentDistance <= 0) != (nextDistance <= 0)) {
+        real_t t = currentDistance / (currentDistance - nextDistance);
+        unsigned id = ids[in][i];
+        id |= (plane + 1) << ((id >> 9) & 7 ? 12 : 9);
+        points[out][clipped] = current + (next - current) * t;
+        ids[out][clipped++] = id;
+      }
+    }
+    count = clipped;
+    in = out;
+  }
+
+  unsigned contactsUsed = 0;
+  for (unsigned i = 0; i < count; i++) {
+    if (contactsUsed == (unsigned)data->contactsLeft)
+      break;
+    real_t depth = glm::dot(referenceCentre - points[in][i], -normal);
+    if (depth < 0)
+      continue;
+
+    ft::Contact *contact = data->contacts + contactsUsed;
+    contact->_contactNormal = normal;
+    contact->_penetration = depth;
+    contact->_contactPoint = points[in][i];
+    contact->setBodyData(one.body, two.body, data->friction,
+                         data->restitution);
+    contact->_featureId = ids[in][i];
+    contactsUsed++;
+  }
+  return contactsUsed;
 }
 
 static inline glm::vec3 contactPoint(const glm::vec3 &pOne,
@@ -307,15 +430,22 @@ unsigned ft::CollisionDetector::boxAndBox(const CollisionBox &one,
 
   assert(best != std::numeric_limits<unsigned>::max());
 
-  if (best < 3) {
-    fillPointFaceBoxBox(one, two, toCentre, data, best, pen);
-    data->addContacts(1);
-    return 1;
-  } else if (best < 6) {
-    fillPointFaceBoxBox(two, one, toCentre * -1.0f, data, best - 3, pen);
-    data->addContacts(1);
-    return 1;
+  if (best < 6) {
+    const CollisionBox &reference = best < 3 ? one : two;
+    const CollisionBox &incident = best < 3 ? two : one;
+    glm::vec3 referenceToCentre = best < 3 ? toCentre : toCentre * -1.0f;
+
+    unsigned used = clipFaceBoxBox(reference, incident, referenceToCentre,
+                                   data, best % 3, best);
+    if (used == 0) {
+      fillPointFaceBoxBox(reference, incident, referenceToCentre, data,
+                          best % 3, pen, best);
+      used = 1;
+    }
+    data->addContacts(used);
+    return used;
   } else {
+    unsigned axisId = best;
     best -= 6;
     unsigned oneAxisIndex = best / 3;
     unsigned twoAxisIndex = best % 3;
@@ -328,16 +458,21 @@ unsigned ft::CollisionDetector::boxAndBox(const CollisionBox &one,
 
     glm::vec3 ptOnOneEdge = one.halfSize;
     glm::vec3 ptOnTwoEdge = two.halfSize;
+    unsigned edgeIds = 0;
     for (unsigned i = 0; i < 3; i++) {
       if (i == oneAxisIndex)
         ptOnOneEdge[i] = 0;
-      else if (glm::dot(one.getAxis(i), axis) > 0)
+      else if (glm::dot(one.getAxis(i), axis) > 0) {
         ptOnOneEdge[i] = -ptOnOneEdge[i];
+        edgeIds |= 1 << i;
+      }
 
       if (i == twoAxisIndex)
         ptOnTwoEdge[i] = 0;
-      else if (glm::dot(two.getAxis(i), axis) < 0)
+      else if (glm::dot(two.getAxis(i), axis) < 0) {
         ptOnTwoEdge[i] = -ptOnTwoEdge[i];
+        edgeIds |= 8 << i;
+      }
     }
 
     ptOnOneEdge = one.transform * glm::vec4(ptOnOneEdge, 0.0f);
@@ -353,6 +488,7 @@ unsigned ft::CollisionDetector::boxAndBox(const CollisionBox &one,
     contact->_contactNormal = axis;
     contact->_contactPoint = vertex;
     contact->setBodyData(one.body, two.body, data->friction, data->restitution);
+    contact->_featureId = axisId | (edgeIds << 4);
     data->addContacts(1);
     return 1;
   }
@@ -363,7 +499,8 @@ unsigned ft::CollisionDetector::boxAndBox(const CollisionBox &one,
 unsigned ft::CollisionDetector::boxAndPoint(const CollisionBox &box,
                                             const glm::vec3 &point,
                                             CollisionData *data) {
-  glm::vec3 relPt = box.transform * glm::vec4(point, 1.0f);
+  // the point in the frame of the box
+  glm::vec3 relPt = glm::inverse(box.transform) * glm::vec4(point, 1.0f);
 
   glm::vec3 normal;
 
@@ -442,11 +579,29 @@ unsigned ft::CollisionDetector::boxAndSphere(const CollisionBox &box,
     return 0;
 
   glm::vec3 closestPtWorld = box.transform * glm::vec4(closestPt, 1.0f);
+  glm::vec3 normal;
+  real_t penetration;
+
+  if (dist > 0) {
+    normal = glm::normalize(closestPtWorld - centre);
+    penetration = sphere.radius - std::sqrt(dist);
+  } else {
+    // The centre is inside the box, its own closest point: it leaves
+    // through the nearest face.
+    glm::vec3 depth = box.halfSize - glm::abs(relCentre);
+    unsigned axis = depth.x < depth.y ? (depth.x < depth.z ? 0 : 2)
+                                      : (depth.y < depth.z ? 1 : 2);
+    real_t side = relCentre[axis] < 0 ? -1.0f : 1.0f;
+    closestPt[axis] = side * box.halfSize[axis];
+    closestPtWorld = box.transform * glm::vec4(closestPt, 1.0f);
+    normal = -side * box.getAxis(axis);
+    penetration = sphere.radius + depth[axis];
+  }
 
   Contact *contact = data->contacts;
-  contact->_contactNormal = glm::normalize(closestPtWorld - centre);
+  contact->_contactNormal = normal;
   contact->_contactPoint = closestPtWorld;
-  contact->_penetration = sphere.radius - std::sqrt(dist);
+  contact->_penetration = penetration;
   contact->setBodyData(box.body, sphere.body, data->friction,
                        data->restitution);
 
@@ -487,6 +642,7 @@ unsigned ft::CollisionDetector::boxAndHalfSpace(const CollisionBox &box,
       contact->_penetration = plane.offset - vertexDistance;
 
       contact->setBodyData(box.body, NULL, data->friction, data->restitution);
+      contact->_featureId = i;
 
       contact++;
       contactsUsed++;
@@ -498,3 +654,32 @@ unsigned ft::CollisionDetector::boxAndHalfSpace(const CollisionBox &box,
   data->addContacts(contactsUsed);
   return contactsUsed;
 }
+
+unsigned ft::CollisionDetector::primitiveAndPrimitive(
+    const CollisionPrimitive &one, const CollisionPrimitive &two,
+    CollisionData *data) {
+  using Type = CollisionPrimitive::PrimitiveType;
+
+  if (one.getType() == Type::BOX) {
+    const auto &box = static_cast<const CollisionBox &>(one);
+    if (two.getType() == Type::BOX)
+      return boxAndBox(box, static_cast<const CollisionBox &>(two), data);
+    return boxAndSphere(box, static_cast<const CollisionSphere &>(two), data);
+  }
+
+  const auto &sphere = static_cast<const CollisionSphere &>(one);
+  if (two.getType() == Type::BOX)
+    return boxAndSphere(static_cast<const CollisionBox &>(two), sphere, data);
+  return sphereAndSphere(sphere, static_cast<const CollisionSphere &>(two),
+                         data);
+}
+
+unsigned ft::CollisionDetector::primitiveAndHalfSpace(
+    const CollisionPrimitive &primitive, const CollisionPlane &plane,
+    CollisionData *data) {
+  if (primitive.getType() == CollisionPrimitive::PrimitiveType::BOX)
+    return boxAndHalfSpace(static_cast<const CollisionBox &>(primitive), plane,
+                           data);
+  return sphereAndHalfSpace(static_cast<const CollisionSphere &>(primitive),
+                            plane, data);
+}
@@ -0,0 +1,49 @@
+#include "../includes/ft_contactArena.h"
+#include <algorithm>
+
+ft::ContactArena::ContactArena(unsigned chunkSize)
+    : _chunkSize(std::max(chunkSize, 1u)) {}
+
+void ft::ContactArena::reset() {
+  for (size_t chunk = 0; chunk <= _current && chunk < _chunks.size(); ++chunk)
+    _chunks[chunk].used = 0;
+  _current = 0;
+  _count = 0;
+}
+
+ft::Contact *ft::ContactArena::reserve(unsigned count, unsigned &available) {
+  count = std::max(count, 1u);
+
+  // The chunks after the current one are empty; the ones too small
+  // for the block are skipped until the next reset.
+  for (; _current < _chunks.size(); ++_current) {
+    Chunk &chunk = _chunks[_current];
+    if (chunk.size - chunk.used >= count) {
+      available = chunk.size - chunk.used;
+      return chunk.contacts.get() + chunk.used;
+    }
+  }
+
+  unsigned size = std::max({count, _chunkSize, _capacity});
+  _chunks.push_back({std::unique_ptr<Contact[]>(new Contact[size]()), size, 0});
+  _capacity += size;
+  available = size;
+  return _chunks.back().contacts.get();
+}
+
+void ft::ContactArena::commit(unsigned count) {
+  if (count == 0)
+    return;
+  _chunks[_current].used += count;
+  _count += count;
+  _highWaterMark = std::max(_highWaterMark, _count);
+  _chunkHighWaterMark =
+      std::max(_chunkHighWaterMark, (unsigned)_current + 1);
+}
+
+ft::Contact *ft::ContactArena::allocate(unsigned count) {
+  unsigned available;
+  Contact *contacts = reserve(count, available);
+  commit(count);
+  return contacts;
+}
@@ -0,0 +1,190 @@
+#include "../includes/ft_contactGraph.h"
+#include "../includes/ft_contacts.h"
+#include <algorithm>
+#include <functional>
+
+void ft::ContactGraph::build(const Contact *contacts, unsigned numContacts) {
+  _entries.clear();
+  for (uint32_t i = 0; i < numContacts; ++i)
+    for (uint32_t b = 0; b < 2; ++b)
+      if (contacts[i]._body[b])
+        _entries.push_back({contacts[i]._body[b], i, b});
+
+  std::sort(_entries.begin(), _entries.end(),
+            [](const Entry &one, const Entry &two) {
+              if (one.body != two.body)
+                return std::less<const RigidBody *>()(one.body, two.body);
+              return one.contact < two.contact;
+            });
+
+  _contactBodies.assign(numContacts * 2, NO_BODY);
+  _bodyContacts.resize(_entries.size());
+  _bodyStart.clear();
+  for (size_t i = 0; i < _entries.size(); ++i) {
+    const Entry &entry = _entries[i];
+    if (i == 0 || entry.body != _entries[i - 1].body)
+      _bodyStart.push_back((uint32_t)i);
+    _contactBodies[entry.contact * 2 + entry.side] =
+        (uint32_t)_bodyStart.size() - 1;
+    _bodyContacts[i] = entry.contact;
+  }
+  _bodyStart.push_back((uint32_t)_entries.size());
+
+  _listed.assign(numContacts, 0);
+  _stamp = 0;
+}
+
+void ft::ContactGraph::getNeighbours(unsigned contact,
+                                     std::vector<uint32_t> &neighbours) {
+  neighbours.clear();
+  if (++_stamp == 0) {
+    std::fill(_listed.begin(), _listed.end(), 0);
+    _stamp = 1;
+  }
+
+  for (unsigned side = 0; side < 2; ++side) {
+    uint32_t body = _contactBodies[contact * 2 + side];
+    if (body == NO_BODY)
+      continue;
+    for (uint32_t i = _bodyStart[body]; i < _bodyStart[body + 1]; ++i) {
+      uint32_t other = _bodyContacts[i];
+      if (_listed[other] != _stamp) {
+        _listed[other] = _stamp;
+        neighbours.push_back(other);
+      }
+    }
+  }
+}
+
+void ft::ContactBatches::build(const ContactGraph &graph,
+                               unsigned numContacts,
+                               const std::vector<uint8_t> &movable) {
+  _bodyColours.assign(graph.getBodyCount(), 0);
+  _contactColours.resize(numContacts);
+  _batchStart.assign(MAX_COLOURS + 2, 0);
+  for (unsigned i = 0; i < numContacts; ++i) {
+    uint64_t used = 0;
+    for (unsigned side = 0; side < 2; ++side) {
+      uint32_t body = graph.getBodyIndex(i, side);
+      if (body != ContactGraph::NO_BODY && movable[body])
+        used |= _bodyColours[body];
+    }
+
+    uint32_t colour = 0;
+    while (colour < MAX_COLOURS && (used >> colour) & 1)
+      ++colour;
+    if (colour < MAX_COLOURS)
+      for (unsigned side = 0; side < 2; ++side) {
+        uint32_t body = graph.getBodyIndex(i, side);
+        if (body != ContactGraph::NO_BODY && movable[body])
+          _bodyColours[body] |= (uint64_t)1 << colour;
+      }
+    _contactColours[i] = colour;
+    ++_batchStart[colour + 1];
+  }
+
+  // Drop the colours no contact took; only the last ones can be
+  // missing, besides the overflow.
+  _overflow = _batchStart[MAX_COLOURS + 1] > 0;
+  unsigned colours = 0;
+  while (colours < MAX_COLOURS && _batchStart[colours + 1] > 0)
+    ++colours;
+  if (_overflow) {
+    _batchStart[colours + 1] = _batchStart[MAX_COLOURS + 1];
+    for (unsigned i = 0; i < numContacts; ++i)
+      if (_contactColours[i] == MAX_COLOURS)
+        _contactColours[i] = colours;
+    ++colours;
+  }
+  _batchStart.resize(colours + 1);
+  for (unsigned colour = 0; colour < colours; ++colour)
+    _batchStart[colour + 1] += _batchStart[colour];
+
+  // The contacts go in their batches in increasing order.
+  _batchContacts.resize(numContacts);
+  for (unsigned i = 0; i < numContacts; ++i)
+    _batchContacts[_batchStart[_contactColours[i]]++] = i;
+  for (unsigned colour = colours; colour > 0; --colour)
+    _batchStart[colour] = _batchStart[colour - 1];
+  _batchStart[0] = 0;
+}
+
+void ft::ContactHeap::reset(unsigned numContacts) {
+  _keys.resize(numContacts);
+  _slots.assign(numContacts, NOT_IN_HEAP);
+  _heap.clear();
+}
+
+void ft::ContactHeap::push(uint32_t contact, real_t key) {
+  _keys[contact] = key;
+  _slots[contact] = (uint32_t)_heap.size();
+  _heap.push_back(contact);
+}
+
+void ft::ContactHeap::heapify() {
+  for (uint32_t slot = (uint32_t)_heap.size() / 2; slot-- > 0;)
+    siftDown(slot);
+}
+
+void ft::ContactHeap::update(uint32_t contact, real_t key) {
+  uint32_t slot = _slots[contact];
+  if (slot == NOT_IN_HEAP) {
+    push(contact, key);
+    siftUp((uint32_t)_heap.size() - 1);
+    return;
+  }
+
+  real_t old = _keys[contact];
+  _keys[contact] = key;
+  if (key > old)
+    siftUp(slot);
+  else if (key < old)
+    siftDown(slot);
+}
+
+void ft::ContactHeap::remove(uint32_t contact) {
+  uint32_t slot = _slots[contact];
+  if (slot == NOT_IN_HEAP)
+    return;
+
+  _slots[contact] = NOT_IN_HEAP;
+  uint32_t last = _heap.back();
+  _heap.pop_back();
+  if (last == contact)
+    return;
+
+  // Move the last contact into the hole, then let it find its place
+  // in whichever direction it belongs.
+  place(slot, last);
+  siftUp(slot);
+  siftDown(_slots[last]);
+}
+
+void ft::ContactHeap::siftUp(uint32_t slot) {
+  uint32_t contact = _heap[slot];
+  while (slot > 0) {
+    uint32_t parent = (slot - 1) / 2;
+    if (!before(contact, _heap[parent]))
+      break;
+    place(slot, _heap[parent]);
+    slot = parent;
+  }
+  place(slot, contact);
+}
+
+void ft::ContactHeap::siftDown(uint32_t slot) {
+  uint32_t contact = _heap[slot];
+  uint32_t size = (uint32_t)_heap.size();
+  while (true) {
+    uint32_t child = slot * 2 + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && before(_heap[child + 1], _heap[child]))
+      ++child;
+    if (!before(_heap[child], contact))
+      break;
+    place(slot, _heap[child]);
+    slot = child;
+  }
+  place(slot, contact);
+}
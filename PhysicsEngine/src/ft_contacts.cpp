@@ -1,4 +1,5 @@
 #include "../includes/ft_contacts.h"
+#include "../includes/ft_profiler.h"
 #include <assert.h>
 #include <cstdlib>
 #include <glm/common.hpp>
@@ -35,6 +36,8 @@ void ft::Contact::setBodyData(RigidBody *one, RigidBody *two, real_t friction,
   ft::Contact::_body[1] = two;
   ft::Contact::_friction = friction;
   ft::Contact::_restitution = restitution;
+  ft::Contact::_featureId = 0;
+  ft::Contact::_impulse = glm::vec3(0.0f);
 }
 
 void ft::Contact::matchAwakeState() {
@@ -182,8 +185,12 @@ void ft::Contact::applyVelocityChange(glm::vec3 velocityChange[2],
   rotationChange[0] = inverseInertiaTensor[0] * impulsiveTorque;
   velocityChange[0] = _body[0]->getInverseMass() * impulse;
 
-  _body[0]->addVelocity(velocityChange[0]);
-  _body[0]->addRotation(rotationChange[0]);
+  // Bodies that can't move are left untouched, so that islands
+  // sharing one can be resolved at the same time.
+  if (_body[0]->hasFiniteMass()) {
+    _body[0]->addVelocity(velocityChange[0]);
+    _body[0]->addRotation(rotationChange[0]);
+  }
 
   if (_body[1]) {
     glm::vec3 impulsiveTorque =
@@ -191,8 +198,10 @@ void ft::Contact::applyVelocityChange(glm::vec3 velocityChange[2],
     rotationChange[1] = inverseInertiaTensor[1] * impulsiveTorque;
     velocityChange[1] = -_body[1]->getInverseMass() * impulse;
 
-    _body[1]->addVelocity(velocityChange[1]);
-    _body[1]->addRotation(rotationChange[1]);
+    if (_body[1]->hasFiniteMass()) {
+      _body[1]->addVelocity(velocityChange[1]);
+      _body[1]->addRotation(rotationChange[1]);
+    }
   }
 }
 
@@ -347,6 +356,8 @@ void ft::Contact::applyPositionChange(glm::vec3 linearChange[2],
       }
 
       linearChange[i] = _contactNormal * linearMove[i];
+      if (!_body[i]->hasFiniteMass())
+        continue;
 
       glm::vec3 pos = _body[i]->getPosition() + linearMove[i] * _contactNormal;
       _body[i]->setPosition(pos);
@@ -399,12 +410,25 @@ void ft::ContactResolver::resolveContacts(Contact *contacts,
     return;
   if (!isValid())
     return;
+  FT_PROFILE_ZONE("ContactResolver::resolveContacts");
 
-  prepareContacts(contacts, numContacts, duration);
+  {
+    FT_PROFILE_ZONE("prepare");
+    prepareContacts(contacts, numContacts, duration);
+
+    if (_useContactGraph)
+      _graph.build(contacts, numContacts);
+  }
 
-  adjustPositions(contacts, numContacts, duration);
+  {
+    FT_PROFILE_ZONE("positions");
+    adjustPositions(contacts, numContacts, duration);
+  }
 
-  adjustVelocities(contacts, numContacts, duration);
+  {
+    FT_PROFILE_ZONE("velocities");
+    adjustVelocities(contacts, numContacts, duration);
+  }
 }
 
 void ft::ContactResolver::prepareContacts(Contact *contacts,
@@ -416,19 +440,76 @@ void ft::ContactResolver::prepareContacts(Contact *contacts,
   }
 }
 
+void ft::ContactResolver::updateVelocity(Contact &contact,
+                                         const Contact &resolved,
+                                         const glm::vec3 velocityChange[2],
+                                         const glm::vec3 rotationChange[2],
+                                         real_t duration) {
+  glm::mat3 m = glm::transpose(contact._contactToWorld);
+  for (unsigned b = 0; b < 2; b++)
+    if (contact._body[b]) {
+      for (unsigned d = 0; d < 2; d++) {
+        if (contact._body[b] == resolved._body[d]) {
+          glm::vec3 deltaVel =
+              velocityChange[d] +
+              glm::cross(rotationChange[d],
+                         contact._relativeContactPosition[b]);
+
+          contact._contactVelocity += (b ? -1.0f : 1.0f) * (m * deltaVel);
+
+          contact.calculateDesiredDeltaVelocity(duration);
+        }
+      }
+    }
+}
+
+void ft::ContactResolver::updatePenetration(Contact &contact,
+                                            const Contact &resolved,
+                                            const glm::vec3 linearChange[2],
+                                            const glm::vec3 angularChange[2]) {
+  for (unsigned b = 0; b < 2; b++)
+    if (contact._body[b]) {
+      for (unsigned d = 0; d < 2; d++) {
+        if (contact._body[b] == resolved._body[d]) {
+          glm::vec3 deltaPosition =
+              linearChange[d] +
+              glm::cross(angularChange[d], contact._relativeContactPosition[b]);
+
+          contact._penetration +=
+              (real_t)(b ? 1.0f : -1.0f) *
+              glm::dot(deltaPosition, contact._contactNormal);
+        }
+      }
+    }
+}
+
 void ft::ContactResolver::adjustVelocities(Contact *c, unsigned numContacts,
                                            real_t duration) {
   glm::vec3 velocityChange[2] = {}, rotationChange[2] = {};
-  glm::vec3 deltaVel = {};
+
+  // Only the contacts above the tolerance are kept in the heap, so
+  // its top is the contact the linear scan would pick.
+  if (_useContactGraph) {
+    _heap.reset(numContacts);
+    for (unsigned i = 0; i < numContacts; i++)
+      if (c[i]._desiredDeltaVelocity > _velocityEpsilon)
+        _heap.push(i, c[i]._desiredDeltaVelocity);
+    _heap.heapify();
+  }
 
   _velocityIterationsUsed = 0;
   while (_velocityIterationsUsed < _velocityIterations) {
-    real_t max = _velocityEpsilon;
     unsigned index = numContacts;
-    for (unsigned i = 0; i < numContacts; i++) {
-      if (c[i]._desiredDeltaVelocity > max) {
-        max = c[i]._desiredDeltaVelocity;
-        index = i;
+    if (_useContactGraph) {
+      if (!_heap.empty())
+        index = _heap.top();
+    } else {
+      real_t max = _velocityEpsilon;
+      for (unsigned i = 0; i < numContacts; i++) {
+        if (c[i]._desiredDeltaVelocity > max) {
+          max = c[i]._desiredDeltaVelocity;
+          index = i;
+        }
       }
     }
 
@@ -439,23 +520,20 @@ void ft::ContactResolver::adjustVelocities(Contact *c, unsigned numContacts,
 
     c[index].applyVelocityChange(velocityChange, rotationChange);
 
-    for (unsigned i = 0; i < numContacts; i++) {
-      glm::mat3 m = glm::transpose(c[i]._contactToWorld);
-      for (unsigned b = 0; b < 2; b++)
-        if (c[i]._body[b]) {
-          for (unsigned d = 0; d < 2; d++) {
-            if (c[i]._body[b] == c[index]._body[d]) {
-
-              deltaVel = velocityChange[d] +
-                         glm::cross(rotationChange[d],
-                                    c[i]._relativeContactPosition[b]);
-
-              c[i]._contactVelocity += (b ? -1.0f : 1.0f) * (m * deltaVel);
-
-              c[i].calculateDesiredDeltaVelocity(duration);
-            }
-          }
-        }
+    if (_useContactGraph) {
+      _graph.getNeighbours(index, _neighbours);
+      for (uint32_t i : _neighbours) {
+        updateVelocity(c[i], c[index], velocityChange, rotationChange,
+                       duration);
+        if (c[i]._desiredDeltaVelocity > _velocityEpsilon)
+          _heap.update(i, c[i]._desiredDeltaVelocity);
+        else
+          _heap.remove(i);
+      }
+    } else {
+      for (unsigned i = 0; i < numContacts; i++)
+        updateVelocity(c[i], c[index], velocityChange, rotationChange,
+                       duration);
     }
     _velocityIterationsUsed++;
   }
@@ -465,19 +543,29 @@ void ft::ContactResolver::adjustPositions(Contact::raw_ptr c,
                                           unsigned numContacts,
                                           real_t duration) {
   (void)duration;
-  unsigned i, index;
   glm::vec3 linearChange[2] = {}, angularChange[2] = {};
-  real_t max;
-  glm::vec3 deltaPosition = {};
+
+  if (_useContactGraph) {
+    _heap.reset(numContacts);
+    for (unsigned i = 0; i < numContacts; i++)
+      if (c[i]._penetration > _positionEpsilon)
+        _heap.push(i, c[i]._penetration);
+    _heap.heapify();
+  }
 
   _positionIterationsUsed = 0;
   while (_positionIterationsUsed < _positionIterations) {
-    max = _positionEpsilon;
-    index = numContacts;
-    for (i = 0; i < numContacts; i++) {
-      if (c[i]._penetration > max) {
-        max = c[i]._penetration;
-        index = i;
+    unsigned index = numContacts;
+    if (_useContactGraph) {
+      if (!_heap.empty())
+        index = _heap.top();
+    } else {
+      real_t max = _positionEpsilon;
+      for (unsigned i = 0; i < numContacts; i++) {
+        if (c[i]._penetration > max) {
+          max = c[i]._penetration;
+          index = i;
+        }
       }
     }
 
@@ -486,22 +574,21 @@ void ft::ContactResolver::adjustPositions(Contact::raw_ptr c,
 
     c[index].matchAwakeState();
 
-    c[index].applyPositionChange(linearChange, angularChange, max);
-
-    for (i = 0; i < numContacts; i++) {
-      for (unsigned b = 0; b < 2; b++)
-        if (c[i]._body[b]) {
-          for (unsigned d = 0; d < 2; d++) {
-            if (c[i]._body[b] == c[index]._body[d]) {
-              deltaPosition = linearChange[d] +
-                              glm::cross(angularChange[d],
-                                         c[i]._relativeContactPosition[b]);
-
-              c[i]._penetration += (real_t)(b ? 1.0f : -1.0f) *
-                                   glm::dot(deltaPosition, c[i]._contactNormal);
-            }
-          }
-        }
+    c[index].applyPositionChange(linearChange, angularChange,
+                                 c[index]._penetration);
+
+    if (_useContactGraph) {
+      _graph.getNeighbours(index, _neighbours);
+      for (uint32_t i : _neighbours) {
+        updatePenetration(c[i], c[index], linearChange, angularChange);
+        if (c[i]._penetration > _positionEpsilon)
+          _heap.update(i, c[i]._penetration);
+        else
+          _heap.remove(i);
+      }
+    } else {
+      for (unsigned i = 0; i < numContacts; i++)
+        updatePenetration(c[i], c[index], linearChange, angularChange);
     }
     _positionIterationsUsed++;
   }
@@ -0,0 +1,401 @@
+#include "../includes/ft_impulseSolver.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+/**
+ * Contacts closing slower than this don't bounce, as in the
+ * ContactResolver.
+ */
+static const real_t VELOCITY_LIMIT = 0.25f;
+
+/**
+ * A cached impulse is reused by a contact whose point, in the space
+ * of the first body, is at most this far from the cached one.
+ */
+static const real_t MATCH_DISTANCE = 0.05f;
+
+ft::SequentialImpulseSolver::SequentialImpulseSolver(unsigned iterations)
+    : _iterations(iterations) {}
+
+void ft::SequentialImpulseSolver::setWarmStarting(bool warmStarting) {
+  _warmStarting = warmStarting;
+  if (!warmStarting)
+    clearCache();
+}
+
+void ft::SequentialImpulseSolver::setPositionCorrection(real_t bias,
+                                                        real_t slop) {
+  _positionBias = bias;
+  _positionSlop = slop;
+}
+
+void ft::SequentialImpulseSolver::setScheduler(Scheduler::pointer scheduler,
+                                               unsigned workerCount) {
+  _scheduler = scheduler;
+  _workerCount = scheduler && workerCount > 1 ? workerCount : 1;
+}
+
+void ft::SequentialImpulseSolver::copySettings(
+    const SequentialImpulseSolver &other) {
+  _iterations = other._iterations;
+  _warmStarting = other._warmStarting;
+  _positionBias = other._positionBias;
+  _positionSlop = other._positionSlop;
+  _batching = other._batching;
+}
+
+void ft::SequentialImpulseSolver::resolveContacts(Contact *contacts,
+                                                  unsigned numContacts,
+                                                  real_t duration) {
+  _warmStartedCount = 0;
+  if (numContacts == 0 || duration <= 0) {
+    _cache.clear();
+    return;
+  }
+
+  for (unsigned i = 0; i < numContacts; ++i) {
+    contacts[i].calculateInternals(duration);
+    contacts[i].matchAwakeState();
+  }
+
+  _graph.build(contacts, numContacts);
+  prepareBodies();
+  prepareContacts(contacts, numContacts, duration);
+  if (_warmStarting)
+    for (unsigned i = 0; i < numContacts; ++i)
+      warmStart(contacts[i], _contacts[i]);
+
+  _batchCount = 0;
+  if (_batching)
+    sweepBatches();
+  else
+    for (unsigned iteration = 0; iteration < _iterations; ++iteration)
+      for (SolverContact &contact : _contacts)
+        solveContact(contact);
+
+  for (uint32_t i = 0; i < _bodies.size(); ++i) {
+    if (_bodies[i].inverseMass == 0)
+      continue;
+    RigidBody *body = _graph.getBody(i);
+    body->setVelocity(_bodies[i].velocity);
+    body->setRotation(_bodies[i].rotation);
+  }
+
+  storeImpulses(contacts, numContacts);
+}
+
+void ft::SequentialImpulseSolver::solveContact(SolverContact &contact) {
+  // Friction first, so that the normal impulse, which matters most,
+  // is the last one to be corrected.
+  real_t limit = contact.friction * contact.impulse.x;
+  for (unsigned axis = 1; axis < 3; ++axis) {
+    real_t change = -relativeVelocity(contact, axis) * contact.mass[axis];
+    real_t total =
+        std::max(-limit, std::min(limit, contact.impulse[axis] + change));
+    change = total - contact.impulse[axis];
+    contact.impulse[axis] = total;
+    applyImpulse(contact, axis, change);
+  }
+
+  real_t change =
+      (contact.targetVelocity - relativeVelocity(contact, 0)) * contact.mass[0];
+  real_t total = std::max((real_t)0, contact.impulse.x + change);
+  change = total - contact.impulse.x;
+  contact.impulse.x = total;
+  applyImpulse(contact, 0, change);
+}
+
+void ft::SequentialImpulseSolver::sweepBatches() {
+  _movable.resize(_bodies.size());
+  for (size_t i = 0; i < _bodies.size(); ++i)
+    _movable[i] = _bodies[i].inverseMass != 0;
+  _batches.build(_graph, (unsigned)_contacts.size(), _movable);
+  _batchCount = _batches.getBatchCount();
+
+  // The contacts are swept in batch order, which is the order of
+  // _batches.getContacts(0) through the last batch.
+  const uint32_t *order = _batches.getContacts(0);
+  _batchedContacts.resize(_contacts.size());
+  for (size_t i = 0; i < _contacts.size(); ++i)
+    _batchedContacts[i] = _contacts[order[i]];
+
+  if (_workerCount == 1 || _contacts.size() < MIN_PARALLEL_CONTACTS) {
+    for (unsigned iteration = 0; iteration < _iterations; ++iteration)
+      for (SolverContact &contact : _batchedContacts)
+        solveContact(contact);
+  } else {
+    sweepOnScheduler();
+  }
+
+  for (size_t i = 0; i < _contacts.size(); ++i)
+    _contacts[order[i]].impulse = _batchedContacts[i].impulse;
+}
+
+void ft::SequentialImpulseSolver::sweepOnScheduler() {
+  _stepCount = _iterations * _batchCount;
+  if (_stepCapacity < _stepCount) {
+    _steps.reset(new SweepStep[_stepCount]);
+    _stepCapacity = _stepCount;
+  }
+  for (unsigned step = 0; step < _stepCount; ++step) {
+    _steps[step].taken.store(0, std::memory_order_relaxed);
+    _steps[step].done.store(0, std::memory_order_relaxed);
+  }
+  _step.store(0, std::memory_order_relaxed);
+
+  // The calling thread is a worker too: it can get through every
+  // step alone if the scheduler is slow to start the others.
+  _tasks.resize(_workerCount - 1);
+  WaitGroup group;
+  for (auto &task : _tasks) {
+    task.set([this]() { sweepWork(); });
+    _scheduler->submit(task, group);
+  }
+  sweepWork();
+  _scheduler->wait(group);
+}
+
+void ft::SequentialImpulseSolver::sweepWork() {
+  const uint32_t *order = _batches.getContacts(0);
+  for (;;) {
+    uint32_t step = _step.load(std::memory_order_acquire);
+    if (step >= _stepCount)
+      return;
+
+    unsigned batch = step % _batchCount;
+    unsigned pieces = getPieceCount(batch);
+    uint32_t piece =
+        _steps[step].taken.fetch_add(1, std::memory_order_relaxed);
+    if (piece >= pieces) {
+      // Every piece is taken: wait for the others to finish theirs.
+      while (_step.load(std::memory_order_acquire) == step)
+        std::this_thread::yield();
+      continue;
+    }
+
+    SolverContact *contacts =
+        _batchedContacts.data() + (_batches.getContacts(batch) - order);
+    unsigned count = _batches.getContactCount(batch);
+    unsigned begin = 0, end = count;
+    if (pieces > 1) {
+      begin = piece * PIECE_SIZE;
+      end = std::min(count, begin + PIECE_SIZE);
+    }
+    for (unsigned i = begin; i < end; ++i)
+      solveContact(contacts[i]);
+
+    if (_steps[step].done.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+        pieces)
+      _step.store(step + 1, std::memory_order_release);
+  }
+}
+
+unsigned ft::SequentialImpulseSolver::getPieceCount(unsigned batch) const {
+  if (_batches.isOverflow(batch))
+    return 1;
+  return (_batches.getContactCount(batch) + PIECE_SIZE - 1) / PIECE_SIZE;
+}
+
+void ft::SequentialImpulseSolver::prepareBodies() {
+  uint32_t count = _graph.getBodyCount();
+  _bodies.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    RigidBody *body = _graph.getBody(i);
+    SolverBody &solverBody = _bodies[i];
+    solverBody.velocity = body->getVelocity();
+    solverBody.rotation = body->getRotation();
+    if (body->getAwake() && body->hasFiniteMass()) {
+      solverBody.inverseMass = body->getInverseMass();
+      body->getInverseInertiaTensorWorld(&solverBody.inverseInertiaTensor);
+    } else {
+      solverBody.inverseMass = 0;
+      solverBody.inverseInertiaTensor = glm::mat3(0.0f);
+    }
+  }
+}
+
+void ft::SequentialImpulseSolver::prepareContacts(Contact *contacts,
+                                                  unsigned numContacts,
+                                                  real_t duration) {
+  _contacts.resize(numContacts);
+  for (unsigned i = 0; i < numContacts; ++i) {
+    const Contact &contact = contacts[i];
+    SolverContact &solverContact = _contacts[i];
+
+    for (unsigned axis = 0; axis < 3; ++axis)
+      solverContact.axis[axis] = contact._contactToWorld[axis];
+
+    for (unsigned side = 0; side < 2; ++side) {
+      uint32_t body = _graph.getBodyIndex(i, side);
+      solverContact.body[side] = body;
+      for (unsigned axis = 0; axis < 3; ++axis) {
+        if (body == ContactGraph::NO_BODY) {
+          solverContact.relativeCross[side][axis] = glm::vec3(0.0f);
+          solverContact.angularChange[side][axis] = glm::vec3(0.0f);
+          continue;
+        }
+        glm::vec3 cross = glm::cross(contact._relativeContactPosition[side],
+                                     solverContact.axis[axis]);
+        solverContact.relativeCross[side][axis] = cross;
+        solverContact.angularChange[side][axis] =
+            _bodies[body].inverseInertiaTensor * cross;
+      }
+    }
+
+    for (unsigned axis = 0; axis < 3; ++axis) {
+      real_t inverseMass = 0;
+      for (unsigned side = 0; side < 2; ++side) {
+        uint32_t body = solverContact.body[side];
+        if (body == ContactGraph::NO_BODY)
+          continue;
+        inverseMass += _bodies[body].inverseMass +
+                       glm::dot(solverContact.relativeCross[side][axis],
+                                solverContact.angularChange[side][axis]);
+      }
+      solverContact.mass[axis] = inverseMass > 0 ? 1 / inverseMass : 0;
+    }
+
+    // Bounce off fast impacts, and push penetrating bodies apart at
+    // a rate proportional to the penetration.
+    real_t closingVelocity = relativeVelocity(solverContact, 0);
+    real_t bounce = 0;
+    if (closingVelocity < -VELOCITY_LIMIT)
+      bounce = -contact._restitution * closingVelocity;
+    real_t push = _positionBias / duration *
+                  std::max((real_t)0, contact._penetration - _positionSlop);
+    solverContact.targetVelocity = std::max(bounce, push);
+    solverContact.friction = contact._friction;
+    solverContact.impulse = glm::vec3(0.0f);
+  }
+}
+
+bool ft::SequentialImpulseSolver::cacheOrder(const CachedImpulse &one,
+                                             const CachedImpulse &two) {
+  std::less<const RigidBody *> less;
+  if (one.first != two.first)
+    return less(one.first, two.first);
+  return less(one.second, two.second);
+}
+
+/**
+ * Returns true if the bodies of the contact have to be swapped to be
+ * in the order of the cache.
+ */
+static bool _swappedInCache(const ft::RigidBody *one,
+                            const ft::RigidBody *two) {
+  return two && std::less<const ft::RigidBody *>()(two, one);
+}
+
+void ft::SequentialImpulseSolver::warmStart(const Contact &contact,
+                                            SolverContact &solverContact) {
+  // An impulse handed over with the contact, by the manifolds, comes
+  // first; otherwise look for a contact of the last call at the same
+  // place.
+  glm::vec3 impulse = contact._impulse;
+  if (impulse == glm::vec3(0.0f)) {
+    if (_cache.empty())
+      return;
+
+    bool swapped = _swappedInCache(contact._body[0], contact._body[1]);
+    CachedImpulse key;
+    key.first = contact._body[swapped ? 1 : 0];
+    key.second = contact._body[swapped ? 0 : 1];
+    glm::vec3 localPoint =
+        key.first->getPointInLocalSpace(contact._contactPoint);
+
+    auto range =
+        std::equal_range(_cache.begin(), _cache.end(), key, cacheOrder);
+    const CachedImpulse *match = nullptr;
+    real_t best = MATCH_DISTANCE * MATCH_DISTANCE;
+    for (auto it = range.first; it != range.second; ++it) {
+      glm::vec3 offset = it->localPoint - localPoint;
+      real_t distance = glm::dot(offset, offset);
+      if (distance <= best) {
+        best = distance;
+        match = &*it;
+      }
+    }
+    if (!match)
+      return;
+
+    glm::vec3 friction =
+        swapped ? -match->frictionImpulse : match->frictionImpulse;
+    impulse = match->normalImpulse * solverContact.axis[0] + friction;
+  }
+
+  solverContact.impulse =
+      glm::vec3(std::max((real_t)0, glm::dot(impulse, solverContact.axis[0])),
+                glm::dot(impulse, solverContact.axis[1]),
+                glm::dot(impulse, solverContact.axis[2]));
+  for (unsigned axis = 0; axis < 3; ++axis)
+    applyImpulse(solverContact, axis, solverContact.impulse[axis]);
+  ++_warmStartedCount;
+}
+
+void ft::SequentialImpulseSolver::storeImpulses(Contact *contacts,
+                                                unsigned numContacts) {
+  for (unsigned i = 0; i < numContacts; ++i) {
+    const SolverContact &solverContact = _contacts[i];
+    contacts[i]._impulse = solverContact.impulse.x * solverContact.axis[0] +
+                           solverContact.impulse.y * solverContact.axis[1] +
+                           solverContact.impulse.z * solverContact.axis[2];
+  }
+
+  _nextCache.clear();
+  if (_warmStarting) {
+    for (unsigned i = 0; i < numContacts; ++i) {
+      const Contact &contact = contacts[i];
+      const SolverContact &solverContact = _contacts[i];
+      bool swapped = _swappedInCache(contact._body[0], contact._body[1]);
+
+      CachedImpulse cached;
+      cached.first = contact._body[swapped ? 1 : 0];
+      cached.second = contact._body[swapped ? 0 : 1];
+      cached.localPoint =
+          cached.first->getPointInLocalSpace(contact._contactPoint);
+      cached.normalImpulse = solverContact.impulse.x;
+      cached.frictionImpulse =
+          solverContact.impulse.y * solverContact.axis[1] +
+          solverContact.impulse.z * solverContact.axis[2];
+      if (swapped)
+        cached.frictionImpulse = -cached.frictionImpulse;
+      _nextCache.push_back(cached);
+    }
+    std::sort(_nextCache.begin(), _nextCache.end(), cacheOrder);
+  }
+  _cache.swap(_nextCache);
+}
+
+real_t
+ft::SequentialImpulseSolver::relativeVelocity(const SolverContact &contact,
+                                              unsigned axis) const {
+  real_t velocity = 0;
+  for (unsigned side = 0; side < 2; ++side) {
+    uint32_t body = contact.body[side];
+    if (body == ContactGraph::NO_BODY)
+      continue;
+    real_t sideVelocity =
+        glm::dot(_bodies[body].velocity, contact.axis[axis]) +
+        glm::dot(_bodies[body].rotation, contact.relativeCross[side][axis]);
+    velocity += side ? -sideVelocity : sideVelocity;
+  }
+  return velocity;
+}
+
+void ft::SequentialImpulseSolver::applyImpulse(const SolverContact &contact,
+                                               unsigned axis, real_t impulse) {
+  for (unsigned side = 0; side < 2; ++side) {
+    uint32_t body = contact.body[side];
+    if (body == ContactGraph::NO_BODY)
+      continue;
+    SolverBody &solverBody = _bodies[body];
+    // Bodies that can't move are shared by the contacts of a batch.
+    if (solverBody.inverseMass == 0)
+      continue;
+    real_t sideImpulse = side ? -impulse : impulse;
+    solverBody.velocity +=
+        (sideImpulse * solverBody.inverseMass) * contact.axis[axis];
+    solverBody.rotation += sideImpulse * contact.angularChange[side][axis];
+  }
+}
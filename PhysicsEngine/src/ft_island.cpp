@@ -0,0 +1,235 @@
+#include "../includes/ft_island.h"
+#include <algorithm>
+
+void ft::IslandBuilder::addBody(RigidBody *body) {
+  if (_nodes.count(body))
+    return;
+  _nodes[body] = (uint32_t)_bodies.size();
+  _bodies.push_back(body);
+  _sleepNext.push_back(NONE);
+  body->getStore()->setIslandSleep(body->getHandle(), true);
+}
+
+void ft::IslandBuilder::removeBody(RigidBody *body) {
+  uint32_t node = getNode(body);
+  if (node == NONE)
+    return;
+
+  wake(node);
+  _links.erase(std::remove_if(_links.begin(), _links.end(),
+                              [body](const std::pair<RigidBody *,
+                                                     RigidBody *> &link) {
+                                return link.first == body ||
+                                       link.second == body;
+                              }),
+               _links.end());
+
+  // Move the last body into the hole, keeping its sleeping island
+  // linked up.
+  uint32_t last = (uint32_t)_bodies.size() - 1;
+  if (node != last) {
+    uint32_t next = _sleepNext[last];
+    if (next != NONE) {
+      uint32_t previous = last;
+      while (_sleepNext[previous] != last)
+        previous = _sleepNext[previous];
+      _sleepNext[previous] = node;
+      _sleepNext[node] = next == last ? node : next;
+    } else {
+      _sleepNext[node] = NONE;
+    }
+    _bodies[node] = _bodies[last];
+    _nodes[_bodies[node]] = node;
+  }
+  _bodies.pop_back();
+  _sleepNext.pop_back();
+  _nodes.erase(body);
+  body->getStore()->setIslandSleep(body->getHandle(), false);
+}
+
+void ft::IslandBuilder::addLink(RigidBody *one, RigidBody *two) {
+  _links.push_back({one, two});
+}
+
+void ft::IslandBuilder::build(const Contact *contacts, unsigned numContacts) {
+  uint32_t count = (uint32_t)_bodies.size();
+
+  // Wake up the islands the application woke a body of, then the
+  // ones an awake body touches.
+  for (uint32_t node = 0; node < count; ++node)
+    if (_sleepNext[node] != NONE && _bodies[node]->getAwake())
+      wake(node);
+  _contactNodes.resize(numContacts * 2);
+  for (unsigned i = 0; i < numContacts; ++i) {
+    const Contact &contact = contacts[i];
+    _contactNodes[i * 2] = getNode(contact._body[0]);
+    _contactNodes[i * 2 + 1] = getNode(contact._body[1]);
+    wakePair(contact._body[0], contact._body[1]);
+  }
+  for (const auto &link : _links)
+    wakePair(link.first, link.second);
+
+  _parent.resize(count);
+  for (uint32_t node = 0; node < count; ++node)
+    _parent[node] = node;
+  for (unsigned i = 0; i < numContacts; ++i) {
+    uint32_t one = _contactNodes[i * 2], two = _contactNodes[i * 2 + 1];
+    if (isMovable(one) && isMovable(two))
+      unite(one, two);
+  }
+  for (const auto &link : _links) {
+    uint32_t one = getNode(link.first), two = getNode(link.second);
+    if (isMovable(one) && isMovable(two))
+      unite(one, two);
+  }
+
+  // Number the islands in the order of their first body. The roots
+  // are the lowest bodies of their islands, so they come first.
+  _island.assign(count, NONE);
+  uint32_t islands = 0;
+  _awakeCount = 0;
+  for (uint32_t node = 0; node < count; ++node) {
+    if (!_bodies[node]->getAwake())
+      continue;
+    ++_awakeCount;
+    uint32_t root = find(node);
+    if (_island[root] == NONE)
+      _island[root] = islands++;
+    _island[node] = _island[root];
+  }
+
+  // The contacts without a movable body go in one more island.
+  uint32_t loose = 0;
+  for (unsigned i = 0; i < numContacts; ++i) {
+    uint32_t island = islands;
+    for (unsigned side = 0; side < 2; ++side) {
+      uint32_t node = _contactNodes[i * 2 + side];
+      if (isMovable(node)) {
+        island = _island[node];
+        break;
+      }
+    }
+    _contactNodes[i * 2] = island;
+    if (island == islands)
+      ++loose;
+  }
+  uint32_t total = islands + (loose ? 1 : 0);
+
+  _islandBodyStart.assign(total + 1, 0);
+  for (uint32_t node = 0; node < count; ++node)
+    if (_island[node] != NONE)
+      ++_islandBodyStart[_island[node] + 1];
+  for (uint32_t island = 0; island < total; ++island)
+    _islandBodyStart[island + 1] += _islandBodyStart[island];
+  _cursor.assign(_islandBodyStart.begin(), _islandBodyStart.end() - 1);
+  _islandBodies.resize(_awakeCount);
+  for (uint32_t node = 0; node < count; ++node)
+    if (_island[node] != NONE)
+      _islandBodies[_cursor[_island[node]]++] = node;
+
+  _islandContactStart.assign(total + 1, 0);
+  for (unsigned i = 0; i < numContacts; ++i)
+    ++_islandContactStart[_contactNodes[i * 2] + 1];
+  for (uint32_t island = 0; island < total; ++island)
+    _islandContactStart[island + 1] += _islandContactStart[island];
+  _cursor.assign(_islandContactStart.begin(), _islandContactStart.end() - 1);
+  _order.resize(numContacts);
+  for (unsigned i = 0; i < numContacts; ++i)
+    _order[_cursor[_contactNodes[i * 2]]++] = i;
+}
+
+void ft::IslandBuilder::sleepIslands() {
+  for (unsigned island = 0; island < getIslandCount(); ++island) {
+    uint32_t begin = _islandBodyStart[island];
+    uint32_t end = _islandBodyStart[island + 1];
+    if (begin == end)
+      continue;
+
+    bool still = true;
+    for (uint32_t i = begin; i < end && still; ++i) {
+      const RigidBody *body = _bodies[_islandBodies[i]];
+      still = body->getCanSleep() && body->getMotion() < SLEEP_EPSILON;
+    }
+    if (!still)
+      continue;
+
+    for (uint32_t i = begin; i < end; ++i) {
+      uint32_t node = _islandBodies[i];
+      _bodies[node]->setAwake(false);
+      _sleepNext[node] = _islandBodies[i + 1 < end ? i + 1 : begin];
+    }
+    _awakeCount -= end - begin;
+  }
+}
+
+void ft::IslandBuilder::saveState(State &state) const {
+  state.sleepNext = _sleepNext;
+  state.awakeCount = _awakeCount;
+}
+
+bool ft::IslandBuilder::restoreState(const State &state) {
+  if (state.sleepNext.size() != _sleepNext.size())
+    return false;
+  std::copy(state.sleepNext.begin(), state.sleepNext.end(),
+            _sleepNext.begin());
+  _awakeCount = state.awakeCount;
+  return true;
+}
+
+uint32_t ft::IslandBuilder::getNode(const RigidBody *body) const {
+  if (!body)
+    return NONE;
+  auto it = _nodes.find(body);
+  return it == _nodes.end() ? NONE : it->second;
+}
+
+uint32_t ft::IslandBuilder::find(uint32_t node) {
+  while (_parent[node] != node) {
+    _parent[node] = _parent[_parent[node]];
+    node = _parent[node];
+  }
+  return node;
+}
+
+void ft::IslandBuilder::unite(uint32_t one, uint32_t two) {
+  one = find(one);
+  two = find(two);
+  if (one < two)
+    _parent[two] = one;
+  else if (two < one)
+    _parent[one] = two;
+}
+
+bool ft::IslandBuilder::isMovable(uint32_t node) const {
+  return node != NONE && _bodies[node]->getAwake() &&
+         _bodies[node]->hasFiniteMass();
+}
+
+void ft::IslandBuilder::wake(uint32_t node) {
+  if (_sleepNext[node] == NONE) {
+    _bodies[node]->setAwake();
+    return;
+  }
+  uint32_t member = node;
+  do {
+    uint32_t next = _sleepNext[member];
+    _sleepNext[member] = NONE;
+    _bodies[member]->setAwake();
+    member = next;
+  } while (member != node);
+}
+
+void ft::IslandBuilder::wakePair(RigidBody *one, RigidBody *two) {
+  if (!one || !two || one->getAwake() == two->getAwake())
+    return;
+  RigidBody *asleep = one->getAwake() ? two : one;
+  RigidBody *awake = one->getAwake() ? one : two;
+  if (!awake->hasFiniteMass())
+    return;
+
+  uint32_t node = getNode(asleep);
+  if (node == NONE)
+    asleep->setAwake();
+  else
+    wake(node);
+}
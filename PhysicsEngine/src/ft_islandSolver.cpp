@@ -0,0 +1,153 @@
+#include "../includes/ft_islandSolver.h"
+#include <algorithm>
+
+ft::IslandSolver::IslandSolver(Scheduler::pointer scheduler,
+                               unsigned workerCount) {
+  setScheduler(scheduler, workerCount);
+}
+
+void ft::IslandSolver::setScheduler(Scheduler::pointer scheduler,
+                                    unsigned workerCount) {
+  _scheduler = scheduler;
+  if (!_scheduler || workerCount == 0)
+    workerCount = 1;
+
+  // Keep the workers there are, with their buffers.
+  while (_workers.size() > workerCount)
+    _workers.pop_back();
+  while (_workers.size() < workerCount) {
+    auto worker = std::make_unique<Worker>();
+    if (!_workers.empty()) {
+      worker->resolver = _workers[0]->resolver;
+      worker->impulseSolver.copySettings(_workers[0]->impulseSolver);
+    }
+    worker->islandsSolved = 0;
+    worker->contactsSolved = 0;
+    worker->batchCount = 0;
+    worker->velocityIterations = 0;
+    worker->positionIterations = 0;
+    _workers.push_back(std::move(worker));
+  }
+}
+
+void ft::IslandSolver::setSolvers(
+    const ContactResolver &resolver,
+    const SequentialImpulseSolver &impulseSolver) {
+  for (auto &worker : _workers) {
+    worker->resolver = resolver;
+    worker->impulseSolver.copySettings(impulseSolver);
+  }
+}
+
+void ft::IslandSolver::solve(const IslandBuilder &islands, Contact *contacts,
+                             real_t duration) {
+  _islands = &islands;
+  _contacts = contacts;
+  _duration = duration;
+
+  _queue.clear();
+  for (unsigned island = 0; island < islands.getIslandCount(); ++island)
+    if (islands.getContactCount(island) > 0)
+      _queue.push_back(island);
+  std::stable_sort(_queue.begin(), _queue.end(),
+                   [&islands](uint32_t one, uint32_t two) {
+                     return islands.getContactCount(one) >
+                            islands.getContactCount(two);
+                   });
+  _next.store(0, std::memory_order_relaxed);
+
+  for (auto &worker : _workers) {
+    worker->islandsSolved = 0;
+    worker->contactsSolved = 0;
+    worker->batchCount = 0;
+    worker->velocityIterations = 0;
+    worker->positionIterations = 0;
+  }
+
+  // An island too big to share out with the others, a single pile
+  // for example, has its batches spread over every worker instead.
+  Worker &first = *_workers[0];
+  if (_solverType == ContactSolverType::SEQUENTIAL_IMPULSE &&
+      first.impulseSolver.getBatching() && _workers.size() > 1) {
+    unsigned total = 0;
+    for (uint32_t island : _queue)
+      total += islands.getContactCount(island);
+    first.impulseSolver.setScheduler(_scheduler, (unsigned)_workers.size());
+    while (_next.load(std::memory_order_relaxed) < _queue.size()) {
+      uint32_t island = _queue[_next.load(std::memory_order_relaxed)];
+      unsigned count = islands.getContactCount(island);
+      if (count < SequentialImpulseSolver::MIN_PARALLEL_CONTACTS ||
+          count * _workers.size() < total)
+        break;
+      solveIsland(first, island);
+      _next.fetch_add(1, std::memory_order_relaxed);
+    }
+    first.impulseSolver.setScheduler(nullptr, 1);
+  }
+
+  // No more helpers than islands for them to take.
+  size_t left = _queue.size() - _next.load(std::memory_order_relaxed);
+  size_t helpers = std::min(_workers.size(), left);
+  helpers = helpers > 0 ? helpers - 1 : 0;
+  _tasks.resize(helpers);
+  WaitGroup group;
+  for (size_t i = 1; i <= helpers; ++i) {
+    Worker *worker = _workers[i].get();
+    _tasks[i - 1].set([this, worker]() { work(*worker); });
+    _scheduler->submit(_tasks[i - 1], group);
+  }
+  work(*_workers[0]);
+  if (helpers > 0)
+    _scheduler->wait(group);
+}
+
+void ft::IslandSolver::work(Worker &worker) {
+  unsigned next;
+  while ((next = _next.fetch_add(1, std::memory_order_relaxed)) <
+         _queue.size())
+    solveIsland(worker, _queue[next]);
+}
+
+void ft::IslandSolver::solveIsland(Worker &worker, unsigned island) {
+  const uint32_t *indices = _islands->getContactIndices(island);
+  unsigned count = _islands->getContactCount(island);
+  worker.contacts.resize(count);
+  for (unsigned i = 0; i < count; ++i)
+    worker.contacts[i] = _contacts[indices[i]];
+
+  if (_solverType == ContactSolverType::SEQUENTIAL_IMPULSE) {
+    // What the solver cached belongs to whichever island it solved
+    // last; only the impulses carried by the contacts are used.
+    worker.impulseSolver.clearCache();
+    worker.impulseSolver.resolveContacts(worker.contacts.data(), count,
+                                         _duration);
+    worker.batchCount =
+        std::max(worker.batchCount, worker.impulseSolver.getBatchCount());
+    worker.velocityIterations += worker.impulseSolver.getIterations();
+  } else {
+    if (_calculateIterations)
+      worker.resolver.setIterations(count * 4);
+    worker.resolver.resolveContacts(worker.contacts.data(), count, _duration);
+    worker.velocityIterations += worker.resolver._velocityIterationsUsed;
+    worker.positionIterations += worker.resolver._positionIterationsUsed;
+  }
+
+  for (unsigned i = 0; i < count; ++i)
+    _contacts[indices[i]] = worker.contacts[i];
+  ++worker.islandsSolved;
+  worker.contactsSolved += count;
+}
+
+unsigned ft::IslandSolver::getVelocityIterationsUsed() const {
+  unsigned used = 0;
+  for (auto &worker : _workers)
+    used += worker->velocityIterations;
+  return used;
+}
+
+unsigned ft::IslandSolver::getPositionIterationsUsed() const {
+  unsigned used = 0;
+  for (auto &worker : _workers)
+    used += worker->positionIterations;
+  return used;
+}
@@ -20,6 +20,8 @@ unsigned ft::Joint::addContact(Contact::raw_ptr contact, unsigned limit) const {
     contact->_penetration = length - error;
     contact->_friction = 1.0f;
     contact->_restitution = 0;
+    contact->_featureId = 0;
+    contact->_impulse = glm::vec3(0.0f);
     return 1;
   }
 
@@ -37,3 +39,9 @@ void ft::Joint::set(RigidBody::raw_ptr a, const glm::vec3 &a_pos,
 
   Joint::error = error;
 }
+
+unsigned ft::Joint::getBodies(RigidBody *bodies[2]) const {
+  bodies[0] = _body[0];
+  bodies[1] = _body[1];
+  return 2;
+}
@@ -0,0 +1,276 @@
+#include "../includes/ft_manifold.h"
+#include <algorithm>
+
+/**
+ * A new contact takes the place of an old point with another feature
+ * id if it is at most this far from it.
+ */
+static const real_t MATCH_DISTANCE = 0.05f;
+
+/**
+ * Orders the bodies by handle rather than by address, so that the
+ * contacts come out in the same order on every run. The scenery, a
+ * null body, comes first.
+ */
+static bool _bodyBefore(const ft::RigidBody *one, const ft::RigidBody *two) {
+  if (!one || !two)
+    return !one && two;
+  return ft::RigidBody::handleOrder(one, two);
+}
+
+static bool _pairBefore(const ft::RigidBody *first, const ft::RigidBody *second,
+                        const ft::RigidBody *otherFirst,
+                        const ft::RigidBody *otherSecond) {
+  if (first != otherFirst)
+    return _bodyBefore(first, otherFirst);
+  return _bodyBefore(second, otherSecond);
+}
+
+static bool _pairOrder(const ft::Contact &one, const ft::Contact &two) {
+  return _pairBefore(one._body[0], one._body[1], two._body[0], two._body[1]);
+}
+
+unsigned ft::ContactManifoldCache::update(Contact *contacts,
+                                          unsigned numContacts,
+                                          unsigned maxContacts) {
+  _found.assign(contacts, contacts + numContacts);
+  build();
+  return write(contacts, maxContacts);
+}
+
+unsigned ft::ContactManifoldCache::update(const ContactArena &found,
+                                          unsigned first) {
+  _found.clear();
+  found.forEach(first, found.getCount(),
+                [this](const Contact &contact) { _found.push_back(contact); });
+  return build();
+}
+
+unsigned ft::ContactManifoldCache::build() {
+  _matchedCount = 0;
+
+  // Put the bodies of every contact in handle order, then bring the
+  // contacts of each pair together, in the order they were found.
+  for (Contact &contact : _found) {
+    if (contact._body[1] && _bodyBefore(contact._body[1], contact._body[0])) {
+      std::swap(contact._body[0], contact._body[1]);
+      contact._contactNormal *= -1.0f;
+      contact._impulse *= -1.0f;
+    }
+  }
+  std::stable_sort(_found.begin(), _found.end(), _pairOrder);
+
+  // Both the contacts and the manifolds are sorted by pair, so the
+  // old manifold of each pair is found by walking along them.
+  _nextManifolds.clear();
+  auto old = _manifolds.begin();
+  for (size_t begin = 0; begin < _found.size();) {
+    Manifold manifold;
+    manifold.first = _found[begin]._body[0];
+    manifold.second = _found[begin]._body[1];
+    manifold.friction = _found[begin]._friction;
+    manifold.restitution = _found[begin]._restitution;
+
+    _candidates.clear();
+    while (old != _manifolds.end() &&
+           _pairBefore(old->first, old->second, manifold.first,
+                       manifold.second))
+      ++old;
+    if (old != _manifolds.end() && old->first == manifold.first &&
+        old->second == manifold.second) {
+      for (unsigned i = 0; i < old->count; ++i) {
+        ManifoldPoint point = old->points[i];
+        if (refresh(*old, point))
+          _candidates.push_back(point);
+      }
+    }
+
+    size_t end = begin;
+    while (end < _found.size() && !_pairOrder(_found[begin], _found[end]))
+      merge(_found[end++]);
+
+    reduce(manifold);
+    _nextManifolds.push_back(manifold);
+    begin = end;
+  }
+  _manifolds.swap(_nextManifolds);
+
+  unsigned points = 0;
+  for (const Manifold &manifold : _manifolds)
+    points += manifold.count;
+  return points;
+}
+
+unsigned ft::ContactManifoldCache::write(Contact *contacts,
+                                         unsigned maxContacts) {
+  _written.clear();
+  unsigned written = 0;
+  for (uint32_t m = 0; m < _manifolds.size(); ++m) {
+    const Manifold &manifold = _manifolds[m];
+    for (uint32_t p = 0; p < manifold.count; ++p) {
+      if (written == maxContacts)
+        return written;
+      const ManifoldPoint &point = manifold.points[p];
+      Contact &contact = contacts[written++];
+      contact.setBodyData(manifold.first, manifold.second, manifold.friction,
+                          manifold.restitution);
+      contact._contactPoint = point.position;
+      contact._contactNormal = point.normal;
+      contact._penetration = point.depth;
+      contact._featureId = point.featureId;
+      contact._impulse = point.impulse;
+      _written.push_back(m * MAX_POINTS + p);
+    }
+  }
+  return written;
+}
+
+void ft::ContactManifoldCache::storeImpulses(const Contact *contacts) {
+  for (size_t i = 0; i < _written.size(); ++i) {
+    Manifold &manifold = _manifolds[_written[i] / MAX_POINTS];
+    manifold.points[_written[i] % MAX_POINTS].impulse = contacts[i]._impulse;
+  }
+}
+
+void ft::ContactManifoldCache::clear() {
+  _manifolds.clear();
+  _written.clear();
+}
+
+void ft::ContactManifoldCache::saveState(State &state) const {
+  state.manifolds = _manifolds;
+}
+
+void ft::ContactManifoldCache::restoreState(const State &state) {
+  _manifolds = state.manifolds;
+  // The contacts written last are not those of the state.
+  _written.clear();
+}
+
+bool ft::ContactManifoldCache::refresh(const Manifold &manifold,
+                                       ManifoldPoint &point) const {
+  glm::vec3 one = manifold.first->getPointInWorldSpace(point.anchor[0]);
+  glm::vec3 two = manifold.second
+                      ? manifold.second->getPointInWorldSpace(point.anchor[1])
+                      : point.anchor[1];
+
+  // The normal pushes the first body away, so moving the first
+  // anchor along it reduces the penetration.
+  glm::vec3 offset = one - two;
+  real_t separation = glm::dot(offset, point.normal);
+  glm::vec3 slide = offset - point.normal * separation;
+
+  point.depth = point.penetration - separation;
+  point.position = (one + two) * 0.5f;
+  point.found = false;
+  return point.depth > -_breakingDistance &&
+         glm::dot(slide, slide) <= _breakingDistance * _breakingDistance;
+}
+
+void ft::ContactManifoldCache::merge(const Contact &contact) {
+  ManifoldPoint point;
+  const glm::vec3 &position = contact._contactPoint;
+  point.anchor[0] = contact._body[0]->getPointInLocalSpace(position);
+  point.anchor[1] = contact._body[1]
+                        ? contact._body[1]->getPointInLocalSpace(position)
+                        : position;
+  point.normal = contact._contactNormal;
+  point.penetration = contact._penetration;
+  point.featureId = contact._featureId;
+  point.impulse = glm::vec3(0.0f);
+  point.position = position;
+  point.depth = contact._penetration;
+  point.found = true;
+
+  // The same feature wins over a nearby point.
+  ManifoldPoint *match = nullptr;
+  real_t best = MATCH_DISTANCE * MATCH_DISTANCE;
+  for (ManifoldPoint &candidate : _candidates) {
+    if (candidate.found)
+      continue;
+    if (candidate.featureId == point.featureId) {
+      match = &candidate;
+      break;
+    }
+    glm::vec3 offset = candidate.position - position;
+    real_t distance = glm::dot(offset, offset);
+    if (distance <= best) {
+      best = distance;
+      match = &candidate;
+    }
+  }
+
+  if (!match) {
+    _candidates.push_back(point);
+    return;
+  }
+  point.impulse = match->impulse;
+  *match = point;
+  ++_matchedCount;
+}
+
+void ft::ContactManifoldCache::reduce(Manifold &manifold) {
+  unsigned count = (unsigned)_candidates.size();
+  if (count <= MAX_POINTS) {
+    std::copy(_candidates.begin(), _candidates.end(), manifold.points);
+    manifold.count = count;
+    return;
+  }
+
+  // Keep the deepest point, the one furthest from it, the one making
+  // the largest triangle with those two, and the one adding the most
+  // area outside of that triangle.
+  unsigned chosen[MAX_POINTS] = {0, 0, 0, 0};
+  for (unsigned i = 1; i < count; ++i)
+    if (_candidates[i].depth > _candidates[chosen[0]].depth)
+      chosen[0] = i;
+  const glm::vec3 &a = _candidates[chosen[0]].position;
+
+  real_t best = -1;
+  for (unsigned i = 0; i < count; ++i) {
+    glm::vec3 offset = _candidates[i].position - a;
+    real_t distance = glm::dot(offset, offset);
+    if (i != chosen[0] && distance > best) {
+      best = distance;
+      chosen[1] = i;
+    }
+  }
+  const glm::vec3 &b = _candidates[chosen[1]].position;
+
+  best = -1;
+  for (unsigned i = 0; i < count; ++i) {
+    glm::vec3 cross = glm::cross(b - a, _candidates[i].position - a);
+    real_t area = glm::dot(cross, cross);
+    if (i != chosen[0] && i != chosen[1] && area > best) {
+      best = area;
+      chosen[2] = i;
+    }
+  }
+  const glm::vec3 &c = _candidates[chosen[2]].position;
+
+  glm::vec3 normal = glm::cross(b - a, c - a);
+  const glm::vec3 *corners[3] = {&a, &b, &c};
+  unsigned used = 3;
+  best = 0;
+  for (unsigned i = 0; i < count; ++i) {
+    if (i == chosen[0] || i == chosen[1] || i == chosen[2])
+      continue;
+    const glm::vec3 &point = _candidates[i].position;
+    real_t area = 0;
+    for (unsigned edge = 0; edge < 3; ++edge) {
+      const glm::vec3 &from = *corners[edge];
+      const glm::vec3 &to = *corners[(edge + 1) % 3];
+      area += std::max((real_t)0,
+                       -glm::dot(glm::cross(to - from, point - from), normal));
+    }
+    if (area > best) {
+      best = area;
+      chosen[3] = i;
+      used = 4;
+    }
+  }
+
+  for (unsigned i = 0; i < used; ++i)
+    manifold.points[i] = _candidates[chosen[i]];
+  manifold.count = used;
+}
@@ -0,0 +1,94 @@
+#include "../includes/ft_profiler.h"
+#include <fstream>
+#include <iomanip>
+
+// The ring of the calling thread, made on its first zone.
+static thread_local ft::ZoneBuffer *_threadBuffer = nullptr;
+
+ft::Profiler &ft::Profiler::get() {
+  static Profiler profiler;
+  return profiler;
+}
+
+ft::ZoneBuffer &ft::Profiler::getThreadBuffer() {
+  if (!_threadBuffer) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _buffers.push_back(
+        std::make_unique<ZoneBuffer>((uint32_t)_buffers.size() + 1));
+    _threadBuffer = _buffers.back().get();
+  }
+  return *_threadBuffer;
+}
+
+void ft::Profiler::setThreadName(const std::string &name) {
+  ZoneBuffer &buffer = getThreadBuffer();
+  std::lock_guard<std::mutex> lock(_mutex);
+  buffer.setName(name);
+}
+
+void ft::Profiler::writeChromeTrace(std::ostream &out) const {
+  struct ThreadZones {
+    uint32_t thread;
+    std::string name;
+    std::vector<ZoneBuffer::Zone> zones;
+  };
+  std::vector<ThreadZones> threads;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &buffer : _buffers) {
+      threads.push_back({buffer->getThread(), buffer->getName(), {}});
+      buffer->collect(threads.back().zones);
+    }
+  }
+
+  uint64_t origin = UINT64_MAX;
+  for (auto &thread : threads)
+    for (auto &zone : thread.zones)
+      origin = std::min(origin, zone.begin);
+
+  // microseconds to the nanosecond, however long the trace
+  std::ios::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3);
+
+  const char *separator = "\n";
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (auto &thread : threads) {
+    if (!thread.name.empty()) {
+      out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\","
+          << "\"pid\":1,\"tid\":" << thread.thread << ",\"args\":{\"name\":";
+      writeString(out, thread.name.c_str());
+      out << "}}";
+      separator = ",\n";
+    }
+    for (auto &zone : thread.zones) {
+      out << separator << "{\"name\":";
+      writeString(out, zone.name);
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.thread
+          << ",\"ts\":" << (double)(zone.begin - origin) / 1000.0
+          << ",\"dur\":" << (double)(zone.end - zone.begin) / 1000.0 << "}";
+      separator = ",\n";
+    }
+  }
+  out << "\n]}" << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+bool ft::Profiler::writeChromeTrace(const std::string &path) const {
+  std::ofstream file(path);
+  if (!file)
+    return false;
+  writeChromeTrace(file);
+  return (bool)file;
+}
+
+void ft::Profiler::writeString(std::ostream &out, const char *text) {
+  out << '"';
+  for (const char *c = text ? text : ""; *c; ++c) {
+    if (*c == '"' || *c == '\\')
+      out << '\\';
+    out << *c;
+  }
+  out << '"';
+}
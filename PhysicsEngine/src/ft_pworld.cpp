@@ -89,3 +89,51 @@ unsigned ft::GroundContacts::addContact(ft::ParticleContact *contact,
 
   return count;
 }
+
+void ft::ParticleCollisions::init(std::vector<ft::Particle::raw_ptr> *particles,
+                                  real_t radius, real_t restitution) {
+  _particles = particles;
+  _radius = radius;
+  _restitution = restitution;
+}
+
+unsigned ft::ParticleCollisions::addContact(ft::ParticleContact *contact,
+                                            unsigned limit) const {
+  if (limit == 0 || _particles->size() < 2)
+    return 0;
+
+  glm::vec3 extent(_radius, _radius, _radius);
+  _boxes.resize(_particles->size());
+  for (size_t i = 0; i < _particles->size(); ++i) {
+    glm::vec3 position = (*_particles)[i]->getPosition();
+    _boxes[i] = BoundingBox(position - extent, position + extent);
+  }
+
+  // The cell is as wide as two particles.
+  _grid.build(_boxes.data(), static_cast<uint32_t>(_boxes.size()),
+              (real_t)4.0 * _radius);
+
+  unsigned count = 0;
+  real_t diameter = (real_t)2.0 * _radius;
+  _grid.findPairs([&](uint32_t one, uint32_t two) {
+    if (count >= limit)
+      return;
+
+    Particle::raw_ptr first = (*_particles)[one];
+    Particle::raw_ptr second = (*_particles)[two];
+    glm::vec3 midline = first->getPosition() - second->getPosition();
+    real_t distance2 = glm::dot(midline, midline);
+    if (distance2 >= diameter * diameter || distance2 <= 0.0f)
+      return;
+
+    real_t distance = std::sqrt(distance2);
+    contact->setContactNormal(midline / distance);
+    contact->setParticles(first, second);
+    contact->setPenetration(diameter - distance);
+    contact->setRestitution(_restitution);
+    contact++;
+    count++;
+  });
+
+  return count;
+}
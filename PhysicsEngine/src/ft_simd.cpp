@@ -0,0 +1,28 @@
+#include "../includes/ft_simd.h"
+
+ft::SimdLevel ft::getSupportedSimdLevel() {
+#if defined(FT_SIMD_KERNELS) && (defined(__x86_64__) || defined(__i386__))
+  static const SimdLevel level = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+      return SimdLevel::SSE;
+    return SimdLevel::SCALAR;
+  }();
+  return level;
+#else
+  return SimdLevel::SCALAR;
+#endif
+}
+
+uint32_t ft::getSimdWidth(SimdLevel level) {
+  switch (level) {
+  case SimdLevel::AVX2:
+    return 8;
+  case SimdLevel::SSE:
+    return 4;
+  default:
+    return 1;
+  }
+}
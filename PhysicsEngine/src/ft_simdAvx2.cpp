@@ -0,0 +1,72 @@
+#include "../includes/ft_simd.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+
+/**
+ * The lane operations of the kernel on eight floats.
+ */
+struct Avx2Ops {
+  using V = __m256;
+  using I = __m256i;
+  static constexpr uint32_t WIDTH = 8;
+
+  static V load(const float *p) { return _mm256_load_ps(p); }
+  static void store(float *p, V v) { _mm256_store_ps(p, v); }
+  static V loadu(const float *p) { return _mm256_loadu_ps(p); }
+  static void storeu(float *p, V v) { _mm256_storeu_ps(p, v); }
+  static V gather(const float *p, const uint32_t *h) {
+    __m256i index = _mm256_loadu_si256((const __m256i *)h);
+    return _mm256_i32gather_ps(p, index, 4);
+  }
+  static V set1(float f) { return _mm256_set1_ps(f); }
+  static V add(V a, V b) { return _mm256_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm256_div_ps(a, b); }
+  static V sqrt(V a) { return _mm256_sqrt_ps(a); }
+  static V min(V a, V b) { return _mm256_min_ps(a, b); }
+  static V max(V a, V b) { return _mm256_max_ps(a, b); }
+  static V lt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+  static V gt(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  static V bitAnd(V a, V b) { return _mm256_and_ps(a, b); }
+  static V bitOr(V a, V b) { return _mm256_or_ps(a, b); }
+  static V blend(V a, V b, V mask) { return _mm256_blendv_ps(a, b, mask); }
+  static bool any(V mask) { return _mm256_movemask_ps(mask) != 0; }
+
+  static I asInt(V a) { return _mm256_castps_si256(a); }
+  static V asFloat(I a) { return _mm256_castsi256_ps(a); }
+  static I toInt(V a) { return _mm256_cvttps_epi32(a); }
+  static V toFloat(I a) { return _mm256_cvtepi32_ps(a); }
+  static I set1Int(int i) { return _mm256_set1_epi32(i); }
+  static I andInt(I a, I b) { return _mm256_and_si256(a, b); }
+  static I addInt(I a, I b) { return _mm256_add_epi32(a, b); }
+  static I subInt(I a, I b) { return _mm256_sub_epi32(a, b); }
+  static I srli(I a, int n) { return _mm256_srli_epi32(a, n); }
+  static I slli(I a, int n) { return _mm256_slli_epi32(a, n); }
+};
+
+} // namespace
+
+void ft::integrateAvx2(const IntegrationArrays &arrays,
+                       const uint32_t *handles, uint32_t count,
+                       float duration, float bias) {
+  simd::integrate<Avx2Ops>(arrays, handles, count, duration, bias);
+}
+
+#else
+
+void ft::integrateAvx2(const IntegrationArrays &arrays,
+                       const uint32_t *handles, uint32_t count,
+                       float duration, float bias) {
+  (void)arrays;
+  (void)handles;
+  (void)count;
+  (void)duration;
+  (void)bias;
+  assert(false && "built without AVX2");
+}
+
+#endif
@@ -0,0 +1,69 @@
+#include "../includes/ft_simd.h"
+
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+
+namespace {
+
+/**
+ * The lane operations of the kernel on four floats.
+ */
+struct SseOps {
+  using V = __m128;
+  using I = __m128i;
+  static constexpr uint32_t WIDTH = 4;
+
+  static V load(const float *p) { return _mm_load_ps(p); }
+  static void store(float *p, V v) { _mm_store_ps(p, v); }
+  static V loadu(const float *p) { return _mm_loadu_ps(p); }
+  static void storeu(float *p, V v) { _mm_storeu_ps(p, v); }
+  static V gather(const float *p, const uint32_t *h) {
+    return _mm_setr_ps(p[h[0]], p[h[1]], p[h[2]], p[h[3]]);
+  }
+  static V set1(float f) { return _mm_set1_ps(f); }
+  static V add(V a, V b) { return _mm_add_ps(a, b); }
+  static V sub(V a, V b) { return _mm_sub_ps(a, b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a, b); }
+  static V div(V a, V b) { return _mm_div_ps(a, b); }
+  static V sqrt(V a) { return _mm_sqrt_ps(a); }
+  static V min(V a, V b) { return _mm_min_ps(a, b); }
+  static V max(V a, V b) { return _mm_max_ps(a, b); }
+  static V lt(V a, V b) { return _mm_cmplt_ps(a, b); }
+  static V gt(V a, V b) { return _mm_cmpgt_ps(a, b); }
+  static V bitAnd(V a, V b) { return _mm_and_ps(a, b); }
+  static V bitOr(V a, V b) { return _mm_or_ps(a, b); }
+  static V blend(V a, V b, V mask) { return _mm_blendv_ps(a, b, mask); }
+  static bool any(V mask) { return _mm_movemask_ps(mask) != 0; }
+
+  static I asInt(V a) { return _mm_castps_si128(a); }
+  static V asFloat(I a) { return _mm_castsi128_ps(a); }
+  static I toInt(V a) { return _mm_cvttps_epi32(a); }
+  static V toFloat(I a) { return _mm_cvtepi32_ps(a); }
+  static I set1Int(int i) { return _mm_set1_epi32(i); }
+  static I andInt(I a, I b) { return _mm_and_si128(a, b); }
+  static I addInt(I a, I b) { return _mm_add_epi32(a, b); }
+  static I subInt(I a, I b) { return _mm_sub_epi32(a, b); }
+  static I srli(I a, int n) { return _mm_srli_epi32(a, n); }
+  static I slli(I a, int n) { return _mm_slli_epi32(a, n); }
+};
+
+} // namespace
+
+void ft::integrateSse(const IntegrationArrays &arrays, const uint32_t *handles,
+                      uint32_t count, float duration, float bias) {
+  simd::integrate<SseOps>(arrays, handles, count, duration, bias);
+}
+
+#else
+
+void ft::integrateSse(const IntegrationArrays &arrays, const uint32_t *handles,
+                      uint32_t count, float duration, float bias) {
+  (void)arrays;
+  (void)handles;
+  (void)count;
+  (void)duration;
+  (void)bias;
+  assert(false && "built without SSE4.1");
+}
+
+#endif
@@ -0,0 +1,27 @@
+#include "../includes/ft_stateHash.h"
+
+void ft::StateHash::addBody(const RigidBody &body) {
+  // Straight from the arrays of the store, without building vectors.
+  const RigidBodyStore &store = *body.getStore();
+  uint32_t h = body.getHandle();
+  add(store.position.x[h], store.position.y[h]);
+  add(store.position.z[h], store.orientation.w[h]);
+  add(store.orientation.x[h], store.orientation.y[h]);
+  add(store.orientation.z[h], store.velocity.x[h]);
+  add(store.velocity.y[h], store.velocity.z[h]);
+  add(store.rotation.x[h], store.rotation.y[h]);
+  add(store.rotation.z[h], store.motion[h]);
+  add((uint64_t)store.isAwake[h]);
+}
+
+uint64_t ft::StateHash::get() const {
+  // The finalisation of MurmurHash3, with the length mixed in so that
+  // trailing zero words still count.
+  uint64_t hash = _hash ^ _words;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdull;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash;
+}
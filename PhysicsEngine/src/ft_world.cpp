@@ -1,59 +1,301 @@
 #include "../includes/ft_world.h"
+#include "../includes/ft_profiler.h"
+#include <algorithm>
 #include <cstdlib>
-#include <cstring>
 
-ft::World::World(unsigned maxContacts, unsigned iterations)
-    : firstBody(NULL), resolver(iterations), firstContactGen(NULL),
-      maxContacts(maxContacts) {
-  contacts = new Contact[maxContacts];
-  std::memset(contacts, 0, maxContacts * sizeof(contacts[0]));
+ft::World::World(unsigned maxContacts, unsigned iterations,
+                 Broadphase::pointer broadphase)
+    : firstBody(NULL), bodyCount(0), bodyStore(NULL), mixedStores(false),
+      resolver(iterations), solverType(ContactSolverType::ITERATIVE),
+      firstContactGen(NULL), contactArena(maxContacts), contacts(NULL),
+      broadphase(broadphase), generatedContacts(0), deterministic(false),
+      bodiesSorted(true), stateHash(0) {
   calculateIterations = (iterations == 0);
+
+  if (!this->broadphase)
+    this->broadphase = std::make_shared<AABBTreeBroadphase>();
+
+  collisionData.contactArray = NULL;
+  collisionData.friction = (real_t)0.9;
+  collisionData.restitution = (real_t)0.1;
+  collisionData.tolerance = (real_t)0.1;
+}
+
+ft::World::World(unsigned maxContacts, unsigned iterations,
+                 BroadphaseType type)
+    : World(maxContacts, iterations, createBroadphase(type)) {}
+
+ft::World::~World() {
+  while (firstBody) {
+    BodyRegistration *next = firstBody->next;
+    delete firstBody;
+    firstBody = next;
+  }
+  while (firstContactGen) {
+    ContactGenRegistration *next = firstContactGen->next;
+    delete firstContactGen;
+    firstContactGen = next;
+  }
+}
+
+void ft::World::addBody(RigidBody *body) {
+  BodyRegistration *reg = new BodyRegistration;
+  reg->body = body;
+  reg->next = firstBody;
+  firstBody = reg;
+
+  islands.addBody(body);
+
+  if (bodyCount == 0)
+    bodyStore = body->getStore();
+  else if (body->getStore() != bodyStore)
+    mixedStores = true;
+  ++bodyCount;
+  bodiesSorted = false;
+}
+
+void ft::World::removeBody(RigidBody *body) {
+  BodyRegistration **link = &firstBody;
+  while (*link) {
+    if ((*link)->body == body) {
+      BodyRegistration *reg = *link;
+      *link = reg->next;
+      delete reg;
+      if (--bodyCount == 0)
+        mixedStores = false;
+      islands.removeBody(body);
+      bodiesSorted = false;
+      // A new body may be given the same address.
+      impulseSolver.clearCache();
+      manifolds.clear();
+      return;
+    }
+    link = &(*link)->next;
+  }
 }
 
-ft::World::~World() { delete[] contacts; }
+void ft::World::addContactGenerator(ContactGenerator *gen) {
+  ContactGenRegistration *reg = new ContactGenRegistration;
+  reg->gen = gen;
+  reg->next = firstContactGen;
+  firstContactGen = reg;
+
+  RigidBody *bodies[2];
+  if (gen->getBodies(bodies) == 2)
+    islands.addLink(bodies[0], bodies[1]);
+}
+
+void ft::World::addPrimitive(CollisionPrimitive *primitive) {
+  primitive->calculateInternals();
+  uint32_t proxy = broadphase->createProxy(primitive->getBoundingBox());
+  if (proxy >= primitives.size())
+    primitives.resize(proxy + 1, NULL);
+  primitives[proxy] = primitive;
+}
+
+void ft::World::removePrimitive(CollisionPrimitive *primitive) {
+  for (uint32_t proxy = 0; proxy < primitives.size(); ++proxy) {
+    if (primitives[proxy] == primitive) {
+      broadphase->destroyProxy(proxy);
+      primitives[proxy] = NULL;
+      return;
+    }
+  }
+}
+
+void ft::World::addPlane(CollisionPlane *plane) { planes.push_back(plane); }
+
+void ft::World::setDeterministic(bool deterministic) {
+  this->deterministic = deterministic;
+  stateHash = 0;
+}
+
+bool ft::World::saveState(SimulationSnapshot &snapshot) const {
+  if (!bodyStore || mixedStores || bodyStore->getCount() != bodyCount)
+    return false;
+  bodyStore->saveState(snapshot.bodies);
+  manifolds.saveState(snapshot.contacts);
+  islands.saveState(snapshot.islands);
+  snapshot.stateHash = stateHash;
+  return true;
+}
+
+bool ft::World::restoreState(const SimulationSnapshot &snapshot) {
+  if (!bodyStore || mixedStores || bodyStore->getCount() != bodyCount ||
+      snapshot.islands.sleepNext.size() != bodyCount)
+    return false;
+  if (!bodyStore->restoreState(snapshot.bodies, &movedBodies))
+    return false;
+  manifolds.restoreState(snapshot.contacts);
+  islands.restoreState(snapshot.islands);
+  stateHash = snapshot.stateHash;
+
+  // The sleeping bodies aren't brought up to date by the next frame.
+  if (!movedBodies.empty()) {
+    movedFlags.assign(bodyStore->getCapacity(), 0);
+    for (uint32_t handle : movedBodies)
+      movedFlags[handle] = 1;
+    for (uint32_t proxy = 0; proxy < primitives.size(); ++proxy) {
+      CollisionPrimitive *primitive = primitives[proxy];
+      if (!primitive || primitive->body->getStore() != bodyStore ||
+          !movedFlags[primitive->body->getHandle()])
+        continue;
+      primitive->calculateInternals();
+      broadphase->moveProxy(proxy, primitive->getBoundingBox());
+    }
+  }
+  return true;
+}
+
+void ft::World::sortBodies() {
+  if (bodiesSorted)
+    return;
+  sortedBodies.clear();
+  for (BodyRegistration *reg = firstBody; reg; reg = reg->next)
+    sortedBodies.push_back(reg->body);
+  std::sort(sortedBodies.begin(), sortedBodies.end(),
+            RigidBody::handleOrder);
+  bodiesSorted = true;
+}
+
+void ft::World::setContactParameters(real_t friction, real_t restitution,
+                                     real_t tolerance) {
+  collisionData.friction = friction;
+  collisionData.restitution = restitution;
+  collisionData.tolerance = tolerance;
+}
 
 void ft::World::startFrame() {
   BodyRegistration *reg = firstBody;
   while (reg) {
-    reg->body->clearAccumulators();
-    reg->body->calculateDerivedData();
+    // A sleeping body has nothing accumulated, and hasn't moved.
+    if (reg->body->getAwake()) {
+      reg->body->clearAccumulators();
+      reg->body->calculateDerivedData();
+    }
 
     reg = reg->next;
   }
 }
 
 unsigned ft::World::generateContacts() {
-  unsigned limit = maxContacts;
-  Contact *nextContact = contacts;
+  contactArena.reset();
 
+  // The contact generators first, each one given the room left in a
+  // chunk, and at least as much as a call of the collision detector.
+  generatedContacts = 0;
   ContactGenRegistration *reg = firstContactGen;
   while (reg) {
-    unsigned used = reg->gen->addContact(nextContact, limit);
-    limit -= used;
-    nextContact += used;
-
-    if (limit <= 0)
-      break;
+    unsigned available;
+    Contact *nextContact = contactArena.reserve(
+        CollisionData::MAX_CONTACTS_PER_CALL, available);
+    unsigned used = reg->gen->addContact(nextContact, available);
+    contactArena.commit(used);
+    generatedContacts += used;
 
     reg = reg->next;
   }
 
-  return maxContacts - limit;
+  // Then the collision detection, taking its contacts from the arena
+  // after the generated ones.
+  collisionData.reset(contactArena);
+
+  for (CollisionPrimitive *primitive : primitives) {
+    if (!primitive || !primitive->body->getAwake())
+      continue;
+    for (CollisionPlane *plane : planes)
+      CollisionDetector::primitiveAndHalfSpace(*primitive, *plane,
+                                               &collisionData);
+  }
+
+  broadphase->findPairs(pairs);
+  for (const BroadphasePair &pair : pairs) {
+    const CollisionPrimitive *one = primitives[pair.first];
+    const CollisionPrimitive *two = primitives[pair.second];
+    if (!one->body->getAwake() && !two->body->getAwake())
+      continue;
+    CollisionDetector::primitiveAndPrimitive(*one, *two, &collisionData);
+  }
+
+  // Merge what was found into the manifolds of the last frame, which
+  // may bring back points that weren't found again. The contacts to
+  // solve are laid out in a block of their own, the generated ones
+  // first.
+  unsigned manifoldContacts = manifolds.update(contactArena, generatedContacts);
+  contacts = contactArena.allocate(generatedContacts + manifoldContacts);
+  Contact *nextContact = contacts;
+  contactArena.forEach(0, generatedContacts,
+                       [&nextContact](const Contact &contact) {
+                         *nextContact++ = contact;
+                       });
+  manifolds.write(contacts + generatedContacts);
+  return generatedContacts + manifoldContacts;
 }
 
 void ft::World::runPhysics(real_t duration) {
+  FT_PROFILE_ZONE("World::runPhysics");
 
-  BodyRegistration *reg = firstBody;
-  while (reg) {
+  {
+    FT_PROFILE_ZONE("integrate");
+    if (deterministic) {
+      sortBodies();
+      for (RigidBody *body : sortedBodies)
+        body->integrate(duration);
+    } else if (!mixedStores && bodyStore &&
+               bodyStore->getCount() == bodyCount) {
+      bodyStore->integrateAll(duration);
+    } else {
+      BodyRegistration *reg = firstBody;
+      while (reg) {
 
-    reg->body->integrate(duration);
+        reg->body->integrate(duration);
 
-    reg = reg->next;
+        reg = reg->next;
+      }
+    }
   }
 
-  unsigned usedContacts = generateContacts();
+  // Bring the primitives up to date with their bodies. The sleeping
+  // ones haven't moved.
+  {
+    FT_PROFILE_ZONE("broadphase");
+    for (uint32_t proxy = 0; proxy < primitives.size(); ++proxy) {
+      CollisionPrimitive *primitive = primitives[proxy];
+      if (!primitive || !primitive->body->getAwake())
+        continue;
+      primitive->calculateInternals();
+      broadphase->moveProxy(proxy, primitive->getBoundingBox());
+    }
+  }
 
-  if (calculateIterations)
-    resolver.setIterations(usedContacts * 4);
-  resolver.resolveContacts(contacts, usedContacts, duration);
+  unsigned usedContacts;
+  {
+    FT_PROFILE_ZONE("contacts");
+    usedContacts = generateContacts();
+  }
+
+  {
+    FT_PROFILE_ZONE("islands");
+    islands.build(contacts, usedContacts);
+  }
+
+  {
+    FT_PROFILE_ZONE("solve");
+    islandSolver.setSolverType(solverType);
+    islandSolver.setCalculateIterations(calculateIterations);
+    islandSolver.setSolvers(resolver, impulseSolver);
+    islandSolver.solve(islands, contacts, duration);
+  }
+
+  islands.sleepIslands();
+
+  if (solverType == ContactSolverType::SEQUENTIAL_IMPULSE)
+    manifolds.storeImpulses(contacts + generatedContacts);
+
+  if (deterministic) {
+    StateHash hash;
+    for (const RigidBody *body : sortedBodies)
+      hash.addBody(*body);
+    stateHash = hash.get();
+  }
 }